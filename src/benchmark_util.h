@@ -0,0 +1,96 @@
+#pragma once
+
+#include "core/stopwatch.h"
+#include "pch/pch.h"
+
+// helpers shared by the benchmark modes of main.cpp
+struct BenchmarkUtil
+{
+    static constexpr size_t NumIterations = 5;
+    // 2237 x 2237 vertices, 2 x 2236 x 2236 = 9999392 faces
+    static constexpr uint32_t LargeGridSize = 2237;
+
+    // best of a few runs of func
+    template <typename Func>
+    static float
+    MeasureMilliSec(const Func & func, const size_t num_iterations = NumIterations)
+    {
+        float best_ms = std::numeric_limits<float>::max();
+        for (size_t i_iteration = 0; i_iteration < num_iterations; i_iteration++)
+        {
+            StopWatch stop_watch;
+            func();
+            best_ms = std::min(best_ms, static_cast<float>(stop_watch.time_micro_sec()) / 1000.0f);
+        }
+        return best_ms;
+    }
+
+    // best of a few runs of func, prepare runs before the stop watch starts
+    template <typename PrepareFunc, typename Func>
+    static float
+    MeasureMilliSec(const PrepareFunc & prepare, const Func & func, const size_t num_iterations)
+    {
+        return MeasureMilliSec(prepare, func, []() {}, num_iterations);
+    }
+
+    // best of a few runs of func, prepare runs before the stop watch starts and finish after it stops
+    template <typename PrepareFunc, typename Func, typename FinishFunc>
+    static float
+    MeasureMilliSec(const PrepareFunc & prepare, const Func & func, const FinishFunc & finish, const size_t num_iterations)
+    {
+        float best_ms = std::numeric_limits<float>::max();
+        for (size_t i_iteration = 0; i_iteration < num_iterations; i_iteration++)
+        {
+            prepare();
+            StopWatch stop_watch;
+            func();
+            best_ms = std::min(best_ms, static_cast<float>(stop_watch.time_micro_sec()) / 1000.0f);
+            finish();
+        }
+        return best_ms;
+    }
+
+    // a single mesh of grid_size x grid_size vertices and 2 x (grid_size - 1) x (grid_size - 1) triangles, so the
+    // benchmarks do not depend on assets of a particular size.
+    // AiScene only owns scenes read by its importer, ai_scene frees the mesh
+    static void
+    ConstructGridScene(aiScene * ai_scene, const uint32_t grid_size)
+    {
+        aiMesh * mesh        = new aiMesh();
+        mesh->mNumVertices   = grid_size * grid_size;
+        mesh->mVertices      = new aiVector3D[mesh->mNumVertices];
+        mesh->mNormals       = new aiVector3D[mesh->mNumVertices];
+        mesh->mNumFaces      = (grid_size - 1) * (grid_size - 1) * 2;
+        mesh->mFaces         = new aiFace[mesh->mNumFaces];
+        mesh->mMaterialIndex = 0;
+        for (uint32_t y = 0; y < grid_size; y++)
+        {
+            for (uint32_t x = 0; x < grid_size; x++)
+            {
+                mesh->mVertices[y * grid_size + x] = aiVector3D(static_cast<float>(x), 0.0f, static_cast<float>(y));
+                mesh->mNormals[y * grid_size + x]  = aiVector3D(0.0f, 1.0f, 0.0f);
+            }
+        }
+        for (uint32_t y = 0; y < grid_size - 1; y++)
+        {
+            for (uint32_t x = 0; x < grid_size - 1; x++)
+            {
+                const uint32_t v00    = y * grid_size + x;
+                const uint32_t i_face = (y * (grid_size - 1) + x) * 2;
+                for (uint32_t i_triangle = 0; i_triangle < 2; i_triangle++)
+                {
+                    aiFace & face    = mesh->mFaces[i_face + i_triangle];
+                    face.mNumIndices = 3;
+                    face.mIndices    = new unsigned int[3];
+                    face.mIndices[0] = v00;
+                    face.mIndices[1] = i_triangle == 0 ? v00 + grid_size : v00 + 1;
+                    face.mIndices[2] = v00 + grid_size + 1;
+                }
+            }
+        }
+
+        ai_scene->mNumMeshes = 1;
+        ai_scene->mMeshes    = new aiMesh *[1];
+        ai_scene->mMeshes[0] = mesh;
+    }
+};
@@ -0,0 +1,434 @@
+#pragma once
+
+#include "core/thread_pool.h"
+#include "core/vmath.h"
+#include "pch/pch.h"
+
+struct Aabb
+{
+    float3 m_min = float3(std::numeric_limits<float>::max());
+    float3 m_max = float3(-std::numeric_limits<float>::max());
+
+    void
+    grow(const float3 & point)
+    {
+        m_min = min(m_min, point);
+        m_max = max(m_max, point);
+    }
+
+    void
+    grow(const Aabb & aabb)
+    {
+        m_min = min(m_min, aabb.m_min);
+        m_max = max(m_max, aabb.m_max);
+    }
+
+    float3
+    get_centroid() const
+    {
+        return (m_min + m_max) * 0.5f;
+    }
+
+    float3
+    get_extent() const
+    {
+        return m_max - m_min;
+    }
+
+    float
+    get_half_surface_area() const
+    {
+        const float3 extent = max(get_extent(), float3(0.0f));
+        return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+    }
+
+    bool
+    is_valid() const
+    {
+        return m_min.x <= m_max.x && m_min.y <= m_max.y && m_min.z <= m_max.z;
+    }
+
+    // aabb of aabb transformed by an affine transform
+    Aabb
+    transform(const float4x4 & transform) const
+    {
+        Aabb result;
+        for (uint32_t i_corner = 0; i_corner < 8; i_corner++)
+        {
+            const float3 corner((i_corner & 1) ? m_max.x : m_min.x,
+                                (i_corner & 2) ? m_max.y : m_min.y,
+                                (i_corner & 4) ? m_max.z : m_min.z);
+            result.grow(float3(transform * float4(corner, 1.0f)));
+        }
+        return result;
+    }
+};
+
+// 32 bytes, two nodes fit in a cache line
+// inner node: m_num_prims == 0 and its children are m_nodes[m_first_index] and m_nodes[m_first_index + 1]
+// leaf node: primitives [m_first_index, m_first_index + m_num_prims) of the bvh's primitive order
+struct BvhNode
+{
+    float3   m_min;
+    uint32_t m_first_index;
+    float3   m_max;
+    uint32_t m_num_prims;
+
+    bool
+    is_leaf() const
+    {
+        return m_num_prims != 0;
+    }
+};
+static_assert(sizeof(BvhNode) == 32);
+
+// single ray for scalar traversal, inverse direction is precomputed for the slab test
+struct BvhRay
+{
+    float3 m_origin;
+    float  m_t_min;
+    float3 m_direction;
+    // shrinks to the closest hit found so far
+    float  m_t_max;
+    float3 m_inv_direction;
+
+    BvhRay() {}
+
+    BvhRay(const float3 & origin, const float3 & direction, const float t_min, const float t_max)
+    : m_origin(origin), m_t_min(t_min), m_direction(direction), m_t_max(t_max)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            // avoid inf * 0 = nan in the slab test when the origin lies on a slab plane
+            const float d          = direction[axis];
+            m_inv_direction[axis] = 1.0f / (std::abs(d) < 1e-20f ? std::copysign(1e-20f, d) : d);
+        }
+    }
+
+    // entry distance into the box, or infinity if the ray misses it
+    float
+    intersect(const float3 & aabb_min, const float3 & aabb_max) const
+    {
+        const float3 t0      = (aabb_min - m_origin) * m_inv_direction;
+        const float3 t1      = (aabb_max - m_origin) * m_inv_direction;
+        const float3 t_enter = min(t0, t1);
+        const float3 t_exit  = max(t0, t1);
+        const float  t_near  = std::max(std::max(t_enter.x, t_enter.y), std::max(t_enter.z, m_t_min));
+        const float  t_far   = std::min(std::min(t_exit.x, t_exit.y), std::min(t_exit.z, m_t_max));
+        return t_near <= t_far ? t_near : std::numeric_limits<float>::infinity();
+    }
+};
+
+// binary bvh over arbitrary primitives given by their aabbs.
+// the bvh does not own the primitives, m_prim_indices maps the leaf order back to the input order so users can
+// lay their primitive data out in leaf order for traversal.
+struct Bvh
+{
+    static constexpr uint32_t MaxDepth = 64;
+    static constexpr uint32_t NumBins  = 16;
+    // relative to the cost of intersecting one primitive
+    static constexpr float TraversalCost = 1.0f;
+    // subtrees with fewer primitives are built on the thread that splits their parent
+    static constexpr uint32_t MinNumPrimsPerTask = 4096;
+
+    std::vector<BvhNode>  m_nodes;
+    std::vector<uint32_t> m_prim_indices;
+
+    Bvh() {}
+
+    // binned sah, sibling subtrees are built in parallel on the thread pool
+    static Bvh
+    Build(const std::span<const Aabb> & prim_aabbs,
+          const uint32_t              max_leaf_size = 4,
+          ThreadPool &                thread_pool   = ThreadPool::Get())
+    {
+        Bvh result;
+        if (prim_aabbs.empty())
+        {
+            return result;
+        }
+
+        BuildContext context(prim_aabbs, max_leaf_size, &thread_pool, &result);
+        thread_pool.parallel_for(0,
+                                 prim_aabbs.size(),
+                                 [&](const size_t i_prim)
+                                 {
+                                     context.m_centroids[i_prim]   = prim_aabbs[i_prim].get_centroid();
+                                     result.m_prim_indices[i_prim] = static_cast<uint32_t>(i_prim);
+                                 },
+                                 MinNumPrimsPerTask);
+
+        context.m_num_nodes = 1;
+        context.build_node(0, 0, static_cast<uint32_t>(prim_aabbs.size()), 0);
+        result.m_nodes.resize(context.m_num_nodes.load());
+        return result;
+    }
+
+    bool
+    empty() const
+    {
+        return m_nodes.empty();
+    }
+
+    Aabb
+    get_aabb() const
+    {
+        Aabb result;
+        if (!m_nodes.empty())
+        {
+            result.m_min = m_nodes[0].m_min;
+            result.m_max = m_nodes[0].m_max;
+        }
+        return result;
+    }
+
+    // expected cost of a random ray relative to intersecting one primitive, lower is better
+    float
+    get_sah_cost() const
+    {
+        if (m_nodes.empty())
+        {
+            return 0.0f;
+        }
+
+        float cost = 0.0f;
+        for (const BvhNode & node : m_nodes)
+        {
+            const float area = Aabb{ node.m_min, node.m_max }.get_half_surface_area();
+            cost += area * (node.is_leaf() ? static_cast<float>(node.m_num_prims) : TraversalCost);
+        }
+        return cost / std::max(get_aabb().get_half_surface_area(), std::numeric_limits<float>::min());
+    }
+
+    // closest first traversal of a single ray.
+    // leaf_func(const BvhNode & leaf, BvhRay * ray) intersects the leaf's primitives, shrinks ray->m_t_max for every
+    // closer hit and returns true to stop the traversal (any hit queries).
+    template <typename LeafFunc>
+    void
+    traverse(BvhRay * ray, LeafFunc && leaf_func) const
+    {
+        if (m_nodes.empty() || ray->intersect(m_nodes[0].m_min, m_nodes[0].m_max) == std::numeric_limits<float>::infinity())
+        {
+            return;
+        }
+
+        uint32_t stack[MaxDepth];
+        uint32_t stack_size = 0;
+        uint32_t node_index = 0;
+        while (true)
+        {
+            const BvhNode & node = m_nodes[node_index];
+            if (node.is_leaf())
+            {
+                if (leaf_func(node, ray))
+                {
+                    return;
+                }
+            }
+            else
+            {
+                const uint32_t left_index  = node.m_first_index;
+                const uint32_t right_index = node.m_first_index + 1;
+                const float    left_t      = ray->intersect(m_nodes[left_index].m_min, m_nodes[left_index].m_max);
+                const float    right_t     = ray->intersect(m_nodes[right_index].m_min, m_nodes[right_index].m_max);
+                const bool     is_left     = left_t != std::numeric_limits<float>::infinity();
+                const bool     is_right    = right_t != std::numeric_limits<float>::infinity();
+                if (is_left && is_right)
+                {
+                    node_index          = left_t <= right_t ? left_index : right_index;
+                    stack[stack_size++] = left_t <= right_t ? right_index : left_index;
+                    continue;
+                }
+                if (is_left || is_right)
+                {
+                    node_index = is_left ? left_index : right_index;
+                    continue;
+                }
+            }
+
+            if (stack_size == 0)
+            {
+                return;
+            }
+            node_index = stack[--stack_size];
+        }
+    }
+
+private:
+    struct BuildContext
+    {
+        std::span<const Aabb> m_prim_aabbs;
+        std::vector<float3>   m_centroids;
+        uint32_t              m_max_leaf_size;
+        ThreadPool *          m_thread_pool;
+        Bvh *                 m_bvh;
+        // children of a node are allocated as a pair, so nodes can be allocated concurrently from a single counter
+        std::atomic<uint32_t> m_num_nodes = 0;
+
+        BuildContext(const std::span<const Aabb> & prim_aabbs,
+                     const uint32_t                max_leaf_size,
+                     ThreadPool *                  thread_pool,
+                     Bvh *                         bvh)
+        : m_prim_aabbs(prim_aabbs),
+          m_centroids(prim_aabbs.size()),
+          m_max_leaf_size(max_leaf_size),
+          m_thread_pool(thread_pool),
+          m_bvh(bvh)
+        {
+            // a binary tree with n leaves has 2n - 1 nodes
+            m_bvh->m_nodes.resize(2 * prim_aabbs.size() - 1);
+            m_bvh->m_prim_indices.resize(prim_aabbs.size());
+        }
+
+        void
+        build_node(const uint32_t node_index, const uint32_t begin, const uint32_t end, const uint32_t depth)
+        {
+            uint32_t * prim_indices = m_bvh->m_prim_indices.data();
+
+            Aabb node_aabb;
+            Aabb centroid_aabb;
+            for (uint32_t i = begin; i < end; i++)
+            {
+                node_aabb.grow(m_prim_aabbs[prim_indices[i]]);
+                centroid_aabb.grow(m_centroids[prim_indices[i]]);
+            }
+
+            BvhNode & node = m_bvh->m_nodes[node_index];
+            node.m_min     = node_aabb.m_min;
+            node.m_max     = node_aabb.m_max;
+
+            const uint32_t num_prims = end - begin;
+            auto           make_leaf = [&]()
+            {
+                node.m_first_index = begin;
+                node.m_num_prims   = num_prims;
+            };
+            if (num_prims == 1 || depth + 1 >= MaxDepth)
+            {
+                make_leaf();
+                return;
+            }
+
+            // find the cheapest bin boundary over all axes
+            const float3 extent    = centroid_aabb.get_extent();
+            float        best_cost = std::numeric_limits<float>::infinity();
+            int          best_axis = -1;
+            uint32_t     best_bin  = 0;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (extent[axis] <= 0.0f)
+                {
+                    continue;
+                }
+
+                struct Bin
+                {
+                    Aabb     m_aabb;
+                    uint32_t m_num_prims = 0;
+                };
+                Bin bins[NumBins];
+                for (uint32_t i = begin; i < end; i++)
+                {
+                    Bin & bin = bins[get_bin_index(prim_indices[i], axis, centroid_aabb)];
+                    bin.m_aabb.grow(m_prim_aabbs[prim_indices[i]]);
+                    bin.m_num_prims++;
+                }
+
+                // right side of the boundary after bin i
+                float    right_areas[NumBins - 1];
+                uint32_t right_num_prims[NumBins - 1];
+                Aabb     right_aabb;
+                uint32_t num_right = 0;
+                for (uint32_t i_bin = NumBins - 1; i_bin > 0; i_bin--)
+                {
+                    right_aabb.grow(bins[i_bin].m_aabb);
+                    num_right += bins[i_bin].m_num_prims;
+                    right_areas[i_bin - 1]     = right_aabb.get_half_surface_area();
+                    right_num_prims[i_bin - 1] = num_right;
+                }
+
+                Aabb     left_aabb;
+                uint32_t num_left = 0;
+                for (uint32_t i_bin = 0; i_bin < NumBins - 1; i_bin++)
+                {
+                    left_aabb.grow(bins[i_bin].m_aabb);
+                    num_left += bins[i_bin].m_num_prims;
+                    if (num_left == 0 || right_num_prims[i_bin] == 0)
+                    {
+                        continue;
+                    }
+                    const float cost = left_aabb.get_half_surface_area() * static_cast<float>(num_left) +
+                                       right_areas[i_bin] * static_cast<float>(right_num_prims[i_bin]);
+                    if (cost < best_cost)
+                    {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_bin  = i_bin;
+                    }
+                }
+            }
+
+            uint32_t mid;
+            if (best_axis >= 0)
+            {
+                const float split_cost =
+                    TraversalCost + best_cost / std::max(node_aabb.get_half_surface_area(), std::numeric_limits<float>::min());
+                if (num_prims <= m_max_leaf_size && static_cast<float>(num_prims) <= split_cost)
+                {
+                    make_leaf();
+                    return;
+                }
+                mid = static_cast<uint32_t>(
+                    std::partition(prim_indices + begin,
+                                   prim_indices + end,
+                                   [&](const uint32_t prim_index)
+                                   { return get_bin_index(prim_index, best_axis, centroid_aabb) <= best_bin; }) -
+                    prim_indices);
+            }
+            else
+            {
+                // every centroid is at the same spot, no sah split exists
+                if (num_prims <= m_max_leaf_size)
+                {
+                    make_leaf();
+                    return;
+                }
+                mid = begin + num_prims / 2;
+            }
+
+            const uint32_t left_index = m_num_nodes.fetch_add(2);
+            node.m_first_index        = left_index;
+            node.m_num_prims          = 0;
+
+            if (num_prims >= MinNumPrimsPerTask)
+            {
+                m_thread_pool->parallel_for(0,
+                                            2,
+                                            [&](const size_t i_child)
+                                            {
+                                                if (i_child == 0)
+                                                {
+                                                    build_node(left_index, begin, mid, depth + 1);
+                                                }
+                                                else
+                                                {
+                                                    build_node(left_index + 1, mid, end, depth + 1);
+                                                }
+                                            });
+            }
+            else
+            {
+                build_node(left_index, begin, mid, depth + 1);
+                build_node(left_index + 1, mid, end, depth + 1);
+            }
+        }
+
+        uint32_t
+        get_bin_index(const uint32_t prim_index, const int axis, const Aabb & centroid_aabb) const
+        {
+            const float scale = static_cast<float>(NumBins) / (centroid_aabb.m_max[axis] - centroid_aabb.m_min[axis]);
+            const float bin   = (m_centroids[prim_index][axis] - centroid_aabb.m_min[axis]) * scale;
+            return std::min(static_cast<uint32_t>(bin), NumBins - 1);
+        }
+    };
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "benchmark_util.h"
+#include "bvh/bvh_triangle.h"
+#include "bvh/wide_bvh.h"
+#include "core/logger.h"
+#include "core/thread_pool.h"
+#include "pch/pch.h"
+
+#include <random>
+
+// build and traversal timings of the cpu bvh over the triangles of a mesh
+struct BvhBenchmark
+{
+    static constexpr uint32_t RayGridSize  = 1024;
+    static constexpr float    RayTMax      = 100000.0f;
+    static constexpr size_t   RayChunkSize = 1024;
+
+    static void
+    Run(const std::string & name, const std::span<const BvhTriangle> & triangles)
+    {
+        Logger::Info(__FUNCTION__, " ", name, " : ", triangles.size(), " triangles");
+
+        // builds, best of a few runs to hide page faults of the first one
+        ThreadPool      single_thread_pool(0);
+        BvhTriangleMesh mesh;
+        const float     single_thread_build_ms =
+            BenchmarkUtil::MeasureMilliSec([&]() { mesh = BvhTriangleMesh::Build(triangles, single_thread_pool); });
+        const float multi_thread_build_ms =
+            BenchmarkUtil::MeasureMilliSec([&]() { mesh = BvhTriangleMesh::Build(triangles); });
+        Logger::Info(__FUNCTION__,
+                     " binned sah build : ",
+                     single_thread_build_ms,
+                     " ms on 1 thread, ",
+                     multi_thread_build_ms,
+                     " ms on ",
+                     ThreadPool::Get().get_num_threads(),
+                     " threads, ",
+                     mesh.m_bvh.m_nodes.size(),
+                     " nodes, ",
+                     mesh.m_bvh.m_nodes.size() * sizeof(BvhNode) / 1024,
+                     " KiB, sah cost ",
+                     mesh.m_bvh.get_sah_cost());
+
+        Bvh4        bvh4;
+        Bvh8        bvh8;
+        const float bvh4_collapse_ms = BenchmarkUtil::MeasureMilliSec([&]() { bvh4 = Bvh4::Collapse(mesh.m_bvh); });
+        const float bvh8_collapse_ms = BenchmarkUtil::MeasureMilliSec([&]() { bvh8 = Bvh8::Collapse(mesh.m_bvh); });
+        Logger::Info(__FUNCTION__,
+                     " bvh4 collapse : ",
+                     bvh4_collapse_ms,
+                     " ms, ",
+                     bvh4.m_nodes.size(),
+                     " nodes, ",
+                     bvh4.m_nodes.size() * sizeof(Bvh4::Node) / 1024,
+                     " KiB");
+        Logger::Info(__FUNCTION__,
+                     " bvh8 collapse : ",
+                     bvh8_collapse_ms,
+                     " ms, ",
+                     bvh8.m_nodes.size(),
+                     " nodes, ",
+                     bvh8.m_nodes.size() * sizeof(Bvh8::Node) / 1024,
+                     " KiB");
+
+        // coherent rays are a pinhole camera at the center of the mesh, incoherent rays start anywhere near the
+        // center and go in any direction
+        const Aabb          bounds = mesh.m_bvh.get_aabb();
+        std::vector<BvhRay> coherent_rays(RayGridSize * RayGridSize);
+        for (uint32_t y = 0; y < RayGridSize; y++)
+        {
+            for (uint32_t x = 0; x < RayGridSize; x++)
+            {
+                const float2 uv = (float2(x, y) + float2(0.5f)) / static_cast<float>(RayGridSize) - float2(0.5f);
+                coherent_rays[GetQuadOrderIndex(x, y)] =
+                    BvhRay(bounds.get_centroid(), normalize(float3(1.0f, uv.y, uv.x)), 0.0f, RayTMax);
+            }
+        }
+
+        std::mt19937                          rng(0);
+        std::uniform_real_distribution<float> uniform(-0.5f, 0.5f);
+        std::normal_distribution<float>       normal(0.0f, 1.0f);
+        std::vector<BvhRay>                   incoherent_rays(RayGridSize * RayGridSize);
+        for (BvhRay & ray : incoherent_rays)
+        {
+            const float3 origin    = bounds.get_centroid() + float3(uniform(rng), uniform(rng), uniform(rng)) * bounds.get_extent() * 0.5f;
+            const float3 direction = normalize(float3(normal(rng), normal(rng), normal(rng)));
+            ray                    = BvhRay(origin, direction, 0.0f, RayTMax);
+        }
+
+        for (const auto & [ray_set_name, rays] : { std::make_pair("coherent", &coherent_rays), std::make_pair("incoherent", &incoherent_rays) })
+        {
+            MeasureRays(ray_set_name, "binary", *rays, [&](BvhRay * ray, BvhHit * hit) { return mesh.intersect(ray, hit); });
+            MeasureRays(ray_set_name, "bvh4", *rays, [&](BvhRay * ray, BvhHit * hit) { return mesh.intersect(bvh4, ray, hit); });
+            MeasureRays(ray_set_name, "bvh8", *rays, [&](BvhRay * ray, BvhHit * hit) { return mesh.intersect(bvh8, ray, hit); });
+            MeasurePackets(ray_set_name, *rays, mesh);
+        }
+    }
+
+private:
+    // rays of a 2x2 quad are next to each other so the packet traversal can load them in order
+    static size_t
+    GetQuadOrderIndex(const uint32_t x, const uint32_t y)
+    {
+        const size_t quad_index = (y / 2) * (RayGridSize / 2) + (x / 2);
+        return quad_index * 4 + (y % 2) * 2 + (x % 2);
+    }
+
+    template <typename IntersectFunc>
+    static void
+    MeasureRays(const char * ray_set_name, const char * bvh_name, const std::vector<BvhRay> & rays, IntersectFunc && intersect_func)
+    {
+        std::atomic<size_t> num_hits = 0;
+        const float         time_ms  = BenchmarkUtil::MeasureMilliSec(
+            [&]()
+            {
+                num_hits = 0;
+                ThreadPool::Get().parallel_for(0,
+                                               rays.size() / RayChunkSize,
+                                               [&](const size_t i_chunk)
+                                               {
+                                                   size_t num_chunk_hits = 0;
+                                                   for (size_t i_ray = i_chunk * RayChunkSize; i_ray < (i_chunk + 1) * RayChunkSize; i_ray++)
+                                                   {
+                                                       BvhRay ray = rays[i_ray];
+                                                       BvhHit hit;
+                                                       num_chunk_hits += intersect_func(&ray, &hit) ? 1 : 0;
+                                                   }
+                                                   num_hits += num_chunk_hits;
+                                               });
+            });
+        LogRays(ray_set_name, bvh_name, rays.size(), num_hits.load(), time_ms);
+    }
+
+    static void
+    MeasurePackets(const char * ray_set_name, const std::vector<BvhRay> & rays, const BvhTriangleMesh & mesh)
+    {
+        std::atomic<size_t> num_hits = 0;
+        const float         time_ms  = BenchmarkUtil::MeasureMilliSec(
+            [&]()
+            {
+                num_hits = 0;
+                ThreadPool::Get().parallel_for(0,
+                                               rays.size() / RayChunkSize,
+                                               [&](const size_t i_chunk)
+                                               {
+                                                   size_t num_chunk_hits = 0;
+                                                   for (size_t i_ray = i_chunk * RayChunkSize; i_ray < (i_chunk + 1) * RayChunkSize; i_ray += 4)
+                                                   {
+                                                       RayPacket4 packet;
+                                                       for (uint32_t lane = 0; lane < RayPacket4::NumLanes; lane++)
+                                                       {
+                                                           const BvhRay & ray = rays[i_ray + lane];
+                                                           packet.set_ray(lane, ray.m_origin, ray.m_direction, ray.m_t_min, ray.m_t_max);
+                                                       }
+                                                       HitPacket4   hit;
+                                                       const __m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                                                       const int bits = _mm_movemask_ps(mesh.intersect<false>(packet, all, &hit, 0));
+                                                       num_chunk_hits += std::popcount(static_cast<uint32_t>(bits));
+                                                   }
+                                                   num_hits += num_chunk_hits;
+                                               });
+            });
+        LogRays(ray_set_name, "binary packet", rays.size(), num_hits.load(), time_ms);
+    }
+
+    static void
+    LogRays(const char * ray_set_name, const char * bvh_name, const size_t num_rays, const size_t num_hits, const float time_ms)
+    {
+        // hit counts must agree between layouts, a mismatch means a traversal bug
+        Logger::Info(__FUNCTION__,
+                     " ",
+                     ray_set_name,
+                     " rays, ",
+                     bvh_name,
+                     " : ",
+                     time_ms,
+                     " ms, ",
+                     static_cast<double>(num_rays) / (time_ms * 1e3),
+                     " mrays/s on ",
+                     ThreadPool::Get().get_num_threads(),
+                     " threads, ",
+                     num_hits,
+                     " hits");
+    }
+};
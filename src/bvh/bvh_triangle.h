@@ -0,0 +1,236 @@
+#pragma once
+
+#include "bvh/bvh.h"
+#include "bvh/ray_packet.h"
+#include "pch/pch.h"
+#include "shaders/shared/types.h"
+
+// triangle in bvh leaf order, edges are precomputed for the intersection test
+struct BvhTriangle
+{
+    float3   m_v0;
+    // index of the geometry the triangle came from (GeometryIndex() in hlsl)
+    uint32_t m_geometry_index;
+    float3   m_e1;
+    // index of the triangle inside its geometry (PrimitiveIndex() in hlsl)
+    uint32_t m_prim_index;
+    float3   m_e2;
+
+    static BvhTriangle
+    Create(const float3 & p0, const float3 & p1, const float3 & p2, const uint32_t geometry_index, const uint32_t prim_index)
+    {
+        BvhTriangle result;
+        result.m_v0             = p0;
+        result.m_e1             = p1 - p0;
+        result.m_e2             = p2 - p0;
+        result.m_geometry_index = geometry_index;
+        result.m_prim_index     = prim_index;
+        return result;
+    }
+
+    Aabb
+    get_aabb() const
+    {
+        Aabb result;
+        result.grow(m_v0);
+        result.grow(m_v0 + m_e1);
+        result.grow(m_v0 + m_e2);
+        return result;
+    }
+
+    // moller-trumbore, true if the ray hits closer than its current t_max
+    bool
+    intersect(const BvhRay & ray, float * t, float2 * barycentric) const
+    {
+        const float3 p   = cross(ray.m_direction, m_e2);
+        const float  det = dot(m_e1, p);
+        if (std::abs(det) <= 1e-12f)
+        {
+            return false;
+        }
+        const float  inv_det = 1.0f / det;
+        const float3 s       = ray.m_origin - m_v0;
+        const float  u       = dot(s, p) * inv_det;
+        const float3 q       = cross(s, m_e1);
+        const float  v       = dot(ray.m_direction, q) * inv_det;
+        const float  t_hit   = dot(m_e2, q) * inv_det;
+        if (u < 0.0f || v < 0.0f || u + v > 1.0f || t_hit <= ray.m_t_min || t_hit >= ray.m_t_max)
+        {
+            return false;
+        }
+        *t           = t_hit;
+        *barycentric = float2(u, v);
+        return true;
+    }
+};
+static_assert(sizeof(BvhTriangle) == 44);
+
+struct BvhHit
+{
+    static constexpr uint32_t InvalidIndex = std::numeric_limits<uint32_t>::max();
+
+    float2   m_barycentric = float2(0.0f);
+    // position of the triangle in the leaf order
+    uint32_t m_prim_index = InvalidIndex;
+
+    bool
+    is_hit() const
+    {
+        return m_prim_index != InvalidIndex;
+    }
+};
+
+// triangles of indexed geometries (as SceneResource::add_geometries lays them out) with a bvh over them
+struct BvhTriangleMesh
+{
+    Bvh                      m_bvh;
+    std::vector<BvhTriangle> m_triangles;
+
+    // positions and index words of one geometry, indices are relative to the first position (see VertexIndexT)
+    static void
+    AppendGeometry(std::vector<BvhTriangle> *          triangles,
+                   const std::span<const float3> &       positions,
+                   const std::span<const VertexIndexT> & index_words,
+                   const uint32_t                        index_stride_in_words,
+                   const uint32_t                        geometry_index)
+    {
+        const auto get_position = [&](const size_t i_index)
+        {
+            const size_t word = i_index * index_stride_in_words;
+            return positions[index_stride_in_words == 1
+                                 ? index_words[word]
+                                 : uint32_t(index_words[word]) | (uint32_t(index_words[word + 1]) << 16)];
+        };
+
+        const size_t num_indices = index_words.size() / index_stride_in_words;
+        triangles->reserve(triangles->size() + num_indices / 3);
+        for (uint32_t i_prim = 0; i_prim < num_indices / 3; i_prim++)
+        {
+            triangles->push_back(BvhTriangle::Create(get_position(i_prim * 3),
+                                                     get_position(i_prim * 3 + 1),
+                                                     get_position(i_prim * 3 + 2),
+                                                     geometry_index,
+                                                     i_prim));
+        }
+    }
+
+    static BvhTriangleMesh
+    Build(const std::span<const BvhTriangle> & triangles, ThreadPool & thread_pool = ThreadPool::Get())
+    {
+        std::vector<Aabb> aabbs(triangles.size());
+        thread_pool.parallel_for(0,
+                                 triangles.size(),
+                                 [&](const size_t i_triangle) { aabbs[i_triangle] = triangles[i_triangle].get_aabb(); },
+                                 Bvh::MinNumPrimsPerTask);
+
+        BvhTriangleMesh result;
+        result.m_bvh = Bvh::Build(aabbs, 4, thread_pool);
+
+        // store triangles in leaf order so a leaf reads a contiguous range
+        result.m_triangles.resize(triangles.size());
+        for (size_t i = 0; i < triangles.size(); i++)
+        {
+            result.m_triangles[i] = triangles[result.m_bvh.m_prim_indices[i]];
+        }
+        return result;
+    }
+
+    // closest hit, ray->m_t_max is shrunk to the hit distance
+    template <bool IsAnyHit = false>
+    bool
+    intersect(BvhRay * ray, BvhHit * hit) const
+    {
+        return intersect<IsAnyHit>(m_bvh, ray, hit);
+    }
+
+    // same as above through another bvh over the same leaf order, e.g. a Bvh4 or Bvh8 collapsed from m_bvh
+    template <bool IsAnyHit = false, typename BvhT>
+    bool
+    intersect(const BvhT & bvh, BvhRay * ray, BvhHit * hit) const
+    {
+        bool is_hit = false;
+        bvh.traverse(ray,
+                     [&](const BvhNode & leaf, BvhRay * leaf_ray)
+                     {
+                         for (uint32_t i = leaf.m_first_index; i < leaf.m_first_index + leaf.m_num_prims; i++)
+                         {
+                             float  t;
+                             float2 barycentric;
+                             if (m_triangles[i].intersect(*leaf_ray, &t, &barycentric))
+                             {
+                                 is_hit = true;
+                                 if constexpr (IsAnyHit)
+                                 {
+                                     return true;
+                                 }
+                                 leaf_ray->m_t_max  = t;
+                                 hit->m_barycentric = barycentric;
+                                 hit->m_prim_index  = i;
+                             }
+                         }
+                         return false;
+                     });
+        return is_hit;
+    }
+
+    // packet version of intersect, lanes that hit are returned and with IsAnyHit a lane stops at its first hit.
+    // closest hits are written into hit with instance_index, packet.m_t_max is shrunk to the hit distances.
+    template <bool IsAnyHit>
+    __m128
+    intersect(RayPacket4 & packet, const __m128 active, HitPacket4 * hit, const uint32_t instance_index) const
+    {
+        __m128 hit_mask = _mm_setzero_ps();
+        BvhPacket::Traverse(
+            m_bvh,
+            packet,
+            active,
+            [&](const BvhNode & leaf, __m128 leaf_active)
+            {
+                for (uint32_t i = leaf.m_first_index; i < leaf.m_first_index + leaf.m_num_prims; i++)
+                {
+                    const BvhTriangle & triangle = m_triangles[i];
+                    __m128              t;
+                    __m128              u;
+                    __m128              v;
+                    const __m128        mask =
+                        BvhPacket::IntersectTriangle(packet, triangle.m_v0, triangle.m_e1, triangle.m_e2, leaf_active, &t, &u, &v);
+                    const int bits = _mm_movemask_ps(mask);
+                    if (bits == 0)
+                    {
+                        continue;
+                    }
+
+                    hit_mask = _mm_or_ps(hit_mask, mask);
+                    if constexpr (IsAnyHit)
+                    {
+                        leaf_active = _mm_andnot_ps(mask, leaf_active);
+                        if (_mm_movemask_ps(leaf_active) == 0)
+                        {
+                            break;
+                        }
+                    }
+                    else
+                    {
+                        const __m128 t_max = _mm_load_ps(packet.m_t_max);
+                        _mm_store_ps(packet.m_t_max, _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, t_max)));
+                        alignas(16) float us[RayPacket4::NumLanes];
+                        alignas(16) float vs[RayPacket4::NumLanes];
+                        _mm_store_ps(us, u);
+                        _mm_store_ps(vs, v);
+                        for (uint32_t lane = 0; lane < RayPacket4::NumLanes; lane++)
+                        {
+                            if (bits & (1 << lane))
+                            {
+                                hit->m_u[lane]              = us[lane];
+                                hit->m_v[lane]              = vs[lane];
+                                hit->m_instance_index[lane] = instance_index;
+                                hit->m_prim_index[lane]     = i;
+                            }
+                        }
+                    }
+                }
+                return leaf_active;
+            });
+        return hit_mask;
+    }
+};
@@ -0,0 +1,243 @@
+#pragma once
+
+#include "bvh/bvh.h"
+#include "pch/pch.h"
+
+#include <immintrin.h>
+
+// 4 rays traced together, every lane is an independent ray.
+// data is kept in structure of arrays so each component of the 4 rays loads into a single sse register.
+struct RayPacket4
+{
+    static constexpr uint32_t NumLanes = 4;
+
+    alignas(16) float m_origin[3][NumLanes];
+    alignas(16) float m_direction[3][NumLanes];
+    alignas(16) float m_inv_direction[3][NumLanes];
+    alignas(16) float m_t_min[NumLanes];
+    // shrinks to the closest hit found so far
+    alignas(16) float m_t_max[NumLanes];
+
+    void
+    set_ray(const uint32_t lane, const float3 & origin, const float3 & direction, const float t_min, const float t_max)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            // avoid inf * 0 = nan in the slab test when the origin lies on a slab plane
+            const float d               = direction[axis];
+            const float safe_d          = std::abs(d) < 1e-20f ? std::copysign(1e-20f, d) : d;
+            m_origin[axis][lane]        = origin[axis];
+            m_direction[axis][lane]     = d;
+            m_inv_direction[axis][lane] = 1.0f / safe_d;
+        }
+        m_t_min[lane] = t_min;
+        m_t_max[lane] = t_max;
+    }
+
+    // inactive lanes still need finite data, they are masked out but flow through the same arithmetic
+    void
+    set_inactive(const uint32_t lane)
+    {
+        set_ray(lane, float3(0.0f), float3(0.0f, 1.0f, 0.0f), 0.0f, -1.0f);
+    }
+
+    float3
+    get_origin(const uint32_t lane) const
+    {
+        return float3(m_origin[0][lane], m_origin[1][lane], m_origin[2][lane]);
+    }
+
+    float3
+    get_direction(const uint32_t lane) const
+    {
+        return float3(m_direction[0][lane], m_direction[1][lane], m_direction[2][lane]);
+    }
+
+    // same rays in the space of an instance, t stays the same since directions are not renormalized
+    RayPacket4
+    transform(const float4x4 & world_to_object) const
+    {
+        RayPacket4 result;
+        for (uint32_t lane = 0; lane < NumLanes; lane++)
+        {
+            result.set_ray(lane,
+                           float3(world_to_object * float4(get_origin(lane), 1.0f)),
+                           float3(world_to_object * float4(get_direction(lane), 0.0f)),
+                           m_t_min[lane],
+                           m_t_max[lane]);
+        }
+        return result;
+    }
+};
+
+// m_prim_index is the primitive's position in the leaf order of the bvh it was found in
+struct HitPacket4
+{
+    static constexpr uint32_t InvalidIndex = std::numeric_limits<uint32_t>::max();
+
+    alignas(16) float m_u[RayPacket4::NumLanes];
+    alignas(16) float m_v[RayPacket4::NumLanes];
+    uint32_t          m_instance_index[RayPacket4::NumLanes];
+    uint32_t          m_prim_index[RayPacket4::NumLanes];
+
+    HitPacket4()
+    {
+        for (uint32_t lane = 0; lane < RayPacket4::NumLanes; lane++)
+        {
+            m_u[lane]              = 0.0f;
+            m_v[lane]              = 0.0f;
+            m_instance_index[lane] = InvalidIndex;
+            m_prim_index[lane]     = InvalidIndex;
+        }
+    }
+
+    bool
+    is_hit(const uint32_t lane) const
+    {
+        return m_prim_index[lane] != InvalidIndex;
+    }
+};
+
+namespace BvhPacket
+{
+// lanes whose [t_min, t_max] segment overlaps the box, t_near receives the entry distances
+inline __m128
+IntersectAabb(const float3 & aabb_min, const float3 & aabb_max, const RayPacket4 & packet, const __m128 active, __m128 * t_near)
+{
+    __m128 t_enter = _mm_load_ps(packet.m_t_min);
+    __m128 t_exit  = _mm_load_ps(packet.m_t_max);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const __m128 origin        = _mm_load_ps(packet.m_origin[axis]);
+        const __m128 inv_direction = _mm_load_ps(packet.m_inv_direction[axis]);
+        const __m128 t0            = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabb_min[axis]), origin), inv_direction);
+        const __m128 t1            = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabb_max[axis]), origin), inv_direction);
+        t_enter                    = _mm_max_ps(t_enter, _mm_min_ps(t0, t1));
+        t_exit                     = _mm_min_ps(t_exit, _mm_max_ps(t0, t1));
+    }
+    *t_near = t_enter;
+    return _mm_and_ps(active, _mm_cmple_ps(t_enter, t_exit));
+}
+
+// moller-trumbore of the 4 rays against one triangle given as v0 and edges v1 - v0, v2 - v0
+// returns the lanes that hit closer than their current t_max, with t and barycentrics of v1 and v2
+inline __m128
+IntersectTriangle(const RayPacket4 & packet,
+                  const float3 &     v0,
+                  const float3 &     e1,
+                  const float3 &     e2,
+                  const __m128       active,
+                  __m128 *           t,
+                  __m128 *           u,
+                  __m128 *           v)
+{
+    const __m128 e1x = _mm_set1_ps(e1.x), e1y = _mm_set1_ps(e1.y), e1z = _mm_set1_ps(e1.z);
+    const __m128 e2x = _mm_set1_ps(e2.x), e2y = _mm_set1_ps(e2.y), e2z = _mm_set1_ps(e2.z);
+    const __m128 dx = _mm_load_ps(packet.m_direction[0]);
+    const __m128 dy = _mm_load_ps(packet.m_direction[1]);
+    const __m128 dz = _mm_load_ps(packet.m_direction[2]);
+
+    // p = cross(d, e2)
+    const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    const __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    // s = o - v0
+    const __m128 sx = _mm_sub_ps(_mm_load_ps(packet.m_origin[0]), _mm_set1_ps(v0.x));
+    const __m128 sy = _mm_sub_ps(_mm_load_ps(packet.m_origin[1]), _mm_set1_ps(v0.y));
+    const __m128 sz = _mm_sub_ps(_mm_load_ps(packet.m_origin[2]), _mm_set1_ps(v0.z));
+    *u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv_det);
+
+    // q = cross(s, e1)
+    const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    *v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv_det);
+    *t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv_det);
+
+    const __m128 zero     = _mm_setzero_ps();
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128       mask     = _mm_cmpgt_ps(_mm_and_ps(det, abs_mask), _mm_set1_ps(1e-12f));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(*u, zero));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(*v, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(*u, *v), _mm_set1_ps(1.0f)));
+    mask = _mm_and_ps(mask, _mm_cmpgt_ps(*t, _mm_load_ps(packet.m_t_min)));
+    mask = _mm_and_ps(mask, _mm_cmplt_ps(*t, _mm_load_ps(packet.m_t_max)));
+    return _mm_and_ps(mask, active);
+}
+
+inline float
+HorizontalMin(const __m128 value)
+{
+    const __m128 min0 = _mm_min_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+    const __m128 min1 = _mm_min_ps(min0, _mm_shuffle_ps(min0, min0, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(min1);
+}
+
+// depth first traversal of the packet, children are visited front to back.
+// leaf_func(const BvhNode & leaf, __m128 active) intersects the leaf's primitives, shrinks packet.m_t_max of the
+// lanes it hits and returns the lanes that still need traversal (any hit queries drop the lanes that hit).
+template <typename LeafFunc>
+void
+Traverse(const Bvh & bvh, RayPacket4 & packet, __m128 active, LeafFunc && leaf_func)
+{
+    if (bvh.empty())
+    {
+        return;
+    }
+
+    __m128 t_near;
+    active = IntersectAabb(bvh.m_nodes[0].m_min, bvh.m_nodes[0].m_max, packet, active, &t_near);
+    if (_mm_movemask_ps(active) == 0)
+    {
+        return;
+    }
+
+    const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    uint32_t     stack[Bvh::MaxDepth];
+    uint32_t     stack_size = 0;
+    stack[stack_size++]     = 0;
+    while (stack_size > 0)
+    {
+        const BvhNode & node = bvh.m_nodes[stack[--stack_size]];
+        if (node.is_leaf())
+        {
+            active = leaf_func(node, active);
+            if (_mm_movemask_ps(active) == 0)
+            {
+                return;
+            }
+            continue;
+        }
+
+        const uint32_t  left_index  = node.m_first_index;
+        const uint32_t  right_index = node.m_first_index + 1;
+        const BvhNode & left        = bvh.m_nodes[left_index];
+        const BvhNode & right       = bvh.m_nodes[right_index];
+        __m128          left_t_near;
+        __m128          right_t_near;
+        const __m128    left_mask  = IntersectAabb(left.m_min, left.m_max, packet, active, &left_t_near);
+        const __m128    right_mask = IntersectAabb(right.m_min, right.m_max, packet, active, &right_t_near);
+        const bool      is_left    = _mm_movemask_ps(left_mask) != 0;
+        const bool      is_right   = _mm_movemask_ps(right_mask) != 0;
+        if (is_left && is_right)
+        {
+            // push the farther child first so the closer one is popped next
+            const float left_dist  = HorizontalMin(_mm_or_ps(_mm_and_ps(left_mask, left_t_near), _mm_andnot_ps(left_mask, inf)));
+            const float right_dist = HorizontalMin(_mm_or_ps(_mm_and_ps(right_mask, right_t_near), _mm_andnot_ps(right_mask, inf)));
+            stack[stack_size++]    = left_dist < right_dist ? right_index : left_index;
+            stack[stack_size++]    = left_dist < right_dist ? left_index : right_index;
+        }
+        else if (is_left)
+        {
+            stack[stack_size++] = left_index;
+        }
+        else if (is_right)
+        {
+            stack[stack_size++] = right_index;
+        }
+    }
+}
+} // namespace BvhPacket
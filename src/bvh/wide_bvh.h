@@ -0,0 +1,248 @@
+#pragma once
+
+#include "bvh/bvh.h"
+#include "pch/pch.h"
+
+#include <bit>
+#include <immintrin.h>
+
+// node with up to Width children, child bounds are stored in structure of arrays so a single ray is tested against
+// 4 children with one sse slab test
+template <uint32_t Width>
+struct alignas(64) WideBvhNode
+{
+    static_assert(Width == 4 || Width == 8, "children are tested in groups of 4");
+    static constexpr uint32_t InvalidIndex = std::numeric_limits<uint32_t>::max();
+
+    // empty slots have inverted bounds (min > max) which the ordered slab test never hits
+    alignas(16) float m_min[3][Width];
+    alignas(16) float m_max[3][Width];
+    // inner child: index of its node, leaf child: first primitive in the leaf order
+    uint32_t m_child_index[Width];
+    // 0 for inner children and empty slots
+    uint32_t m_num_prims[Width];
+
+    void
+    set_child(const uint32_t slot, const BvhNode & child, const uint32_t child_index)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            m_min[axis][slot] = child.m_min[axis];
+            m_max[axis][slot] = child.m_max[axis];
+        }
+        m_child_index[slot] = child_index;
+        m_num_prims[slot]   = child.m_num_prims;
+    }
+
+    void
+    set_empty(const uint32_t slot)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            m_min[axis][slot] = std::numeric_limits<float>::max();
+            m_max[axis][slot] = -std::numeric_limits<float>::max();
+        }
+        m_child_index[slot] = InvalidIndex;
+        m_num_prims[slot]   = 0;
+    }
+};
+static_assert(sizeof(WideBvhNode<4>) == 128);
+static_assert(sizeof(WideBvhNode<8>) == 256);
+
+// bvh4 / bvh8 collapsed from a binary bvh, the primitive order is the one of the binary bvh
+template <uint32_t Width>
+struct WideBvh
+{
+    using Node = WideBvhNode<Width>;
+
+    std::vector<Node>     m_nodes;
+    std::vector<uint32_t> m_prim_indices;
+
+    WideBvh() {}
+
+    // every wide node pulls up the largest inner descendants of a binary node until it has Width children
+    static WideBvh
+    Collapse(const Bvh & bvh)
+    {
+        WideBvh result;
+        result.m_prim_indices = bvh.m_prim_indices;
+        if (bvh.empty())
+        {
+            return result;
+        }
+
+        result.m_nodes.reserve(bvh.m_nodes.size() / (Width - 1) + 1);
+        result.m_nodes.emplace_back();
+
+        // a leaf root still gets a node so traversal always starts at an inner node
+        std::vector<std::pair<uint32_t, uint32_t>> tasks = { { 0, 0 } };
+        while (!tasks.empty())
+        {
+            const auto [wide_index, binary_index] = tasks.back();
+            tasks.pop_back();
+
+            std::vector<uint32_t> children;
+            const BvhNode &       binary_node = bvh.m_nodes[binary_index];
+            if (binary_node.is_leaf())
+            {
+                children = { binary_index };
+            }
+            else
+            {
+                children = { binary_node.m_first_index, binary_node.m_first_index + 1 };
+            }
+
+            while (children.size() < Width)
+            {
+                float  largest_area = -1.0f;
+                size_t i_largest    = children.size();
+                for (size_t i_child = 0; i_child < children.size(); i_child++)
+                {
+                    const BvhNode & child = bvh.m_nodes[children[i_child]];
+                    const float     area  = Aabb{ child.m_min, child.m_max }.get_half_surface_area();
+                    if (!child.is_leaf() && area > largest_area)
+                    {
+                        largest_area = area;
+                        i_largest    = i_child;
+                    }
+                }
+                if (i_largest == children.size())
+                {
+                    break;
+                }
+                const uint32_t first_grandchild = bvh.m_nodes[children[i_largest]].m_first_index;
+                children[i_largest]             = first_grandchild;
+                children.push_back(first_grandchild + 1);
+            }
+
+            for (uint32_t slot = 0; slot < Width; slot++)
+            {
+                if (slot >= children.size())
+                {
+                    result.m_nodes[wide_index].set_empty(slot);
+                    continue;
+                }
+
+                const BvhNode & child = bvh.m_nodes[children[slot]];
+                if (child.is_leaf())
+                {
+                    result.m_nodes[wide_index].set_child(slot, child, child.m_first_index);
+                }
+                else
+                {
+                    const uint32_t child_wide_index = static_cast<uint32_t>(result.m_nodes.size());
+                    result.m_nodes.emplace_back();
+                    result.m_nodes[wide_index].set_child(slot, child, child_wide_index);
+                    tasks.emplace_back(child_wide_index, children[slot]);
+                }
+            }
+        }
+        return result;
+    }
+
+    bool
+    empty() const
+    {
+        return m_nodes.empty();
+    }
+
+    // closest first traversal of a single ray, same contract as Bvh::traverse.
+    // entries whose distance is beyond the current hit are dropped when popped.
+    template <typename LeafFunc>
+    void
+    traverse(BvhRay * ray, LeafFunc && leaf_func) const
+    {
+        if (m_nodes.empty())
+        {
+            return;
+        }
+
+        struct StackEntry
+        {
+            uint32_t m_index;
+            uint32_t m_num_prims;
+            float    m_t;
+        };
+        StackEntry stack[Bvh::MaxDepth * (Width - 1) + Width];
+        uint32_t   stack_size = 0;
+        stack[stack_size++]   = { 0, 0, ray->m_t_min };
+
+        // the near plane of each axis only depends on the sign of the direction
+        const bool   is_negative[3] = { ray->m_inv_direction.x < 0.0f, ray->m_inv_direction.y < 0.0f, ray->m_inv_direction.z < 0.0f };
+        const __m128 origin[3]      = { _mm_set1_ps(ray->m_origin.x), _mm_set1_ps(ray->m_origin.y), _mm_set1_ps(ray->m_origin.z) };
+        const __m128 inv_direction[3] = { _mm_set1_ps(ray->m_inv_direction.x),
+                                          _mm_set1_ps(ray->m_inv_direction.y),
+                                          _mm_set1_ps(ray->m_inv_direction.z) };
+        const __m128 t_min = _mm_set1_ps(ray->m_t_min);
+
+        while (stack_size > 0)
+        {
+            const StackEntry entry = stack[--stack_size];
+            if (entry.m_t > ray->m_t_max)
+            {
+                continue;
+            }
+
+            if (entry.m_num_prims != 0)
+            {
+                BvhNode leaf       = {};
+                leaf.m_first_index = entry.m_index;
+                leaf.m_num_prims   = entry.m_num_prims;
+                if (leaf_func(leaf, ray))
+                {
+                    return;
+                }
+                continue;
+            }
+
+            // test all children, then push the hit ones far to near
+            const Node & node  = m_nodes[entry.m_index];
+            const __m128 t_max = _mm_set1_ps(ray->m_t_max);
+            StackEntry   hits[Width];
+            uint32_t     num_hits = 0;
+            for (uint32_t group = 0; group < Width; group += 4)
+            {
+                __m128 t_near = t_min;
+                __m128 t_far  = t_max;
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    const __m128 near_plane = _mm_load_ps((is_negative[axis] ? node.m_max[axis] : node.m_min[axis]) + group);
+                    const __m128 far_plane  = _mm_load_ps((is_negative[axis] ? node.m_min[axis] : node.m_max[axis]) + group);
+                    t_near = _mm_max_ps(t_near, _mm_mul_ps(_mm_sub_ps(near_plane, origin[axis]), inv_direction[axis]));
+                    t_far  = _mm_min_ps(t_far, _mm_mul_ps(_mm_sub_ps(far_plane, origin[axis]), inv_direction[axis]));
+                }
+
+                int bits = _mm_movemask_ps(_mm_cmple_ps(t_near, t_far));
+                if (bits == 0)
+                {
+                    continue;
+                }
+                alignas(16) float t_nears[4];
+                _mm_store_ps(t_nears, t_near);
+                while (bits != 0)
+                {
+                    const uint32_t lane = static_cast<uint32_t>(std::countr_zero(static_cast<uint32_t>(bits)));
+                    bits &= bits - 1;
+
+                    // insertion sort, farthest first
+                    const StackEntry hit = { node.m_child_index[group + lane], node.m_num_prims[group + lane], t_nears[lane] };
+                    uint32_t         i   = num_hits++;
+                    while (i > 0 && hits[i - 1].m_t < hit.m_t)
+                    {
+                        hits[i] = hits[i - 1];
+                        i--;
+                    }
+                    hits[i] = hit;
+                }
+            }
+
+            for (uint32_t i_hit = 0; i_hit < num_hits; i_hit++)
+            {
+                stack[stack_size++] = hits[i_hit];
+            }
+        }
+    }
+};
+
+using Bvh4 = WideBvh<4>;
+using Bvh8 = WideBvh<8>;
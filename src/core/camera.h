@@ -1,5 +1,6 @@
 #pragma once
 
+#include "file.h"
 #include "glfwhandler.h"
 #include "vmath.h"
 
@@ -84,6 +85,15 @@ struct FpsCamera
         m_aspect_ratio_w_div_h    = resolutionf.x / resolutionf.y;
     }
 
+    // places the camera without input, the field of view and up vector are kept
+    void
+    look_at(const float3 & origin, const float3 & lookat)
+    {
+        m_is_moved  = any(notEqual(origin, m_origin)) || any(notEqual(normalize(lookat - origin), m_direction));
+        m_origin    = origin;
+        m_direction = normalize(lookat - origin);
+    }
+
     void
     move_forward(const float amount)
     {
@@ -141,4 +151,59 @@ struct FpsCamera
         result.m_vp = result.m_proj * result.m_view;
         return result;
     }
-};
\ No newline at end of file
+};
+
+// keyframes replayed through FpsCamera::look_at at a fixed rate per frame rather than per second, so every run
+// renders the same views. a path file holds one keyframe per line, "origin.x origin.y origin.z lookat.x lookat.y
+// lookat.z", lines starting with # are comments
+struct CameraPath
+{
+    struct Keyframe
+    {
+        float3 m_origin;
+        float3 m_lookat;
+    };
+
+    std::vector<Keyframe> m_keyframes;
+
+    static CameraPath
+    Load(const std::filesystem::path & path)
+    {
+        CameraPath        result;
+        std::stringstream stream(File::LoadFile(path));
+        std::string       line;
+        while (std::getline(stream, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            std::stringstream line_stream(line);
+            Keyframe          keyframe;
+            line_stream >> keyframe.m_origin.x >> keyframe.m_origin.y >> keyframe.m_origin.z >> keyframe.m_lookat.x >>
+                keyframe.m_lookat.y >> keyframe.m_lookat.z;
+            if (line_stream.fail())
+            {
+                Logger::Error<true>(__FUNCTION__, " malformed keyframe \"", line, "\" in ", path.string());
+            }
+            result.m_keyframes.push_back(keyframe);
+        }
+        if (result.m_keyframes.empty())
+        {
+            Logger::Error<true>(__FUNCTION__, " no keyframe in ", path.string());
+        }
+        return result;
+    }
+
+    // t from 0 to 1 spans the whole path with evenly spaced keyframes, in between them the camera moves linearly
+    void
+    apply(FpsCamera * camera, const float t) const
+    {
+        const float  position = std::clamp(t, 0.0f, 1.0f) * static_cast<float>(m_keyframes.size() - 1);
+        const size_t i_begin  = std::min(static_cast<size_t>(position), m_keyframes.size() - 1);
+        const size_t i_end    = std::min(i_begin + 1, m_keyframes.size() - 1);
+        const float  alpha    = position - static_cast<float>(i_begin);
+        camera->look_at(mix(m_keyframes[i_begin].m_origin, m_keyframes[i_end].m_origin, alpha),
+                        mix(m_keyframes[i_begin].m_lookat, m_keyframes[i_end].m_lookat, alpha));
+    }
+};
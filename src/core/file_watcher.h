@@ -0,0 +1,107 @@
+#pragma once
+
+#include "pch/pch.h"
+
+#include <condition_variable>
+
+// watches every file under a directory on a background thread and collects the ones that were modified, added or
+// removed. polling last write times keeps the watcher portable, and a directory of shaders is cheap to scan.
+struct FileWatcher
+{
+    using WriteTimes = std::map<std::filesystem::path, std::filesystem::file_time_type>;
+
+    std::filesystem::path              m_directory;
+    std::chrono::milliseconds          m_poll_interval;
+    std::vector<std::filesystem::path> m_changed_paths;
+    std::mutex                         m_mutex;
+    std::condition_variable            m_stop_cv;
+    bool                               m_is_stopping = false;
+    std::thread                        m_thread;
+
+    FileWatcher(const std::filesystem::path & directory, const std::chrono::milliseconds poll_interval)
+    : m_directory(directory), m_poll_interval(poll_interval)
+    {
+        m_thread = std::thread([this, write_times = Scan(directory)]() mutable { watch_loop(std::move(write_times)); });
+    }
+
+    ~FileWatcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_is_stopping = true;
+        }
+        m_stop_cv.notify_all();
+        m_thread.join();
+    }
+
+    // canonical paths of the files that changed since the last call
+    std::vector<std::filesystem::path>
+    take_changed_paths()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return std::exchange(m_changed_paths, {});
+    }
+
+private:
+    static WriteTimes
+    Scan(const std::filesystem::path & directory)
+    {
+        // files being written by an editor may vanish in the middle of the scan, so every error is ignored
+        WriteTimes      result;
+        std::error_code ec;
+        for (std::filesystem::recursive_directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+        {
+            if (!it->is_regular_file(ec))
+            {
+                continue;
+            }
+            const std::filesystem::file_time_type write_time = it->last_write_time(ec);
+            if (!ec)
+            {
+                result[std::filesystem::weakly_canonical(it->path(), ec)] = write_time;
+            }
+            ec.clear();
+        }
+        return result;
+    }
+
+    void
+    watch_loop(WriteTimes write_times)
+    {
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (m_stop_cv.wait_for(lock, m_poll_interval, [&]() { return m_is_stopping; }))
+                {
+                    return;
+                }
+            }
+
+            WriteTimes                         new_write_times = Scan(m_directory);
+            std::vector<std::filesystem::path> changed_paths;
+            for (const auto & [path, write_time] : new_write_times)
+            {
+                const auto found = write_times.find(path);
+                if (found == write_times.end() || found->second != write_time)
+                {
+                    changed_paths.push_back(path);
+                }
+            }
+            for (const auto & [path, write_time] : write_times)
+            {
+                if (new_write_times.find(path) == new_write_times.end())
+                {
+                    changed_paths.push_back(path);
+                }
+            }
+            write_times = std::move(new_write_times);
+
+            if (!changed_paths.empty())
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_changed_paths.insert(m_changed_paths.end(), changed_paths.begin(), changed_paths.end());
+            }
+        }
+    }
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "core/mapped_file.h"
+#include "pch/pch.h"
+
+#include <iomanip>
+#include <optional>
+
+// 64-bit FNV-1a hash which can be fed incrementally
+struct Hash64
+{
+    static constexpr uint64_t OffsetBasis = 14695981039346656037ull;
+    static constexpr uint64_t Prime       = 1099511628211ull;
+
+    uint64_t m_value = OffsetBasis;
+
+    Hash64() {}
+
+    // a different offset basis gives an independent hash of the same data
+    explicit Hash64(const uint64_t offset_basis) : m_value(offset_basis) {}
+
+    void
+    add(const void * data, const size_t size_in_bytes)
+    {
+        const uint8_t * bytes = reinterpret_cast<const uint8_t *>(data);
+        uint64_t        value = m_value;
+        for (size_t i = 0; i < size_in_bytes; i++)
+        {
+            value ^= static_cast<uint64_t>(bytes[i]);
+            value *= Prime;
+        }
+        m_value = value;
+    }
+
+    void
+    add(const std::string_view & str)
+    {
+        // also hash the length, so ("ab", "c") and ("a", "bc") hash differently
+        add_pod(static_cast<uint64_t>(str.size()));
+        add(str.data(), str.size());
+    }
+
+    template <typename T>
+    void
+    add_pod(const T & value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        add(&value, sizeof(T));
+    }
+
+    uint64_t
+    get() const
+    {
+        return m_value;
+    }
+
+    std::string
+    to_hex_string() const
+    {
+        std::ostringstream oss;
+        oss << std::hex << std::setw(16) << std::setfill('0') << m_value;
+        return oss.str();
+    }
+
+    // hash the content of the file, return nullopt if file cannot be opened
+    static std::optional<uint64_t>
+    File(const std::filesystem::path & path)
+    {
+        MappedFile file;
+        if (!file.open(path))
+        {
+            return std::nullopt;
+        }
+        Hash64 hash;
+        hash.add(file.data(), file.size());
+        return hash.get();
+    }
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "pch/pch.h"
+
+#include <iomanip>
+
+// the few pieces of json the trace and the benchmarks write by hand
+struct Json
+{
+    // str as a quoted json string, quotes, backslashes and control characters are escaped
+    static void
+    WriteString(std::ostream & stream, const std::string_view & str)
+    {
+        stream << '"';
+        for (const char c : str)
+        {
+            if (c == '"' || c == '\\')
+            {
+                stream << '\\' << c;
+            }
+            else if (c == '\n')
+            {
+                stream << "\\n";
+            }
+            else if (c == '\t')
+            {
+                stream << "\\t";
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                stream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec
+                       << std::setfill(' ');
+            }
+            else
+            {
+                stream << c;
+            }
+        }
+        stream << '"';
+    }
+};
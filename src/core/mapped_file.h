@@ -0,0 +1,169 @@
+#pragma once
+
+#include "core/uniquehandle.h"
+#include "pch/pch.h"
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// read-only memory mapped file
+struct MappedFile
+{
+    MAKE_NONCOPYABLE(MappedFile);
+
+    MappedFile() {}
+
+    MappedFile(MappedFile && rhs) { *this = std::move(rhs); }
+
+    MappedFile &
+    operator=(MappedFile && rhs)
+    {
+        if (this != &rhs)
+        {
+            close();
+            m_data = rhs.m_data;
+            m_size = rhs.m_size;
+#ifdef _WIN32
+            m_file_handle    = rhs.m_file_handle;
+            m_mapping_handle = rhs.m_mapping_handle;
+            rhs.m_file_handle    = INVALID_HANDLE_VALUE;
+            rhs.m_mapping_handle = nullptr;
+#endif
+            rhs.m_data = nullptr;
+            rhs.m_size = 0;
+        }
+        return *this;
+    }
+
+    ~MappedFile() { close(); }
+
+    bool
+    open(const std::filesystem::path & path)
+    {
+        close();
+#ifdef _WIN32
+        m_file_handle = CreateFileW(path.wstring().c_str(),
+                                    GENERIC_READ,
+                                    FILE_SHARE_READ,
+                                    nullptr,
+                                    OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                                    nullptr);
+        if (m_file_handle == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(m_file_handle, &file_size))
+        {
+            close();
+            return false;
+        }
+        m_size = static_cast<size_t>(file_size.QuadPart);
+
+        // empty file cannot be mapped, but it is still a valid file
+        if (m_size == 0)
+        {
+            return true;
+        }
+
+        m_mapping_handle = CreateFileMappingW(m_file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping_handle == nullptr)
+        {
+            close();
+            return false;
+        }
+
+        m_data = reinterpret_cast<const std::byte *>(MapViewOfFile(m_mapping_handle, FILE_MAP_READ, 0, 0, 0));
+#else
+        const int fd = ::open(path.string().c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        m_size = static_cast<size_t>(file_stat.st_size);
+
+        if (m_size == 0)
+        {
+            ::close(fd);
+            return true;
+        }
+
+        void * mapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        m_data = mapped == MAP_FAILED ? nullptr : reinterpret_cast<const std::byte *>(mapped);
+#endif
+        if (m_data == nullptr)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void
+    close()
+    {
+#ifdef _WIN32
+        if (m_data)
+        {
+            UnmapViewOfFile(m_data);
+        }
+        if (m_mapping_handle)
+        {
+            CloseHandle(m_mapping_handle);
+        }
+        if (m_file_handle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file_handle);
+        }
+        m_mapping_handle = nullptr;
+        m_file_handle    = INVALID_HANDLE_VALUE;
+#else
+        if (m_data)
+        {
+            munmap(const_cast<std::byte *>(m_data), m_size);
+        }
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    const std::byte *
+    data() const
+    {
+        return m_data;
+    }
+
+    size_t
+    size() const
+    {
+        return m_size;
+    }
+
+    std::span<const std::byte>
+    get_span() const
+    {
+        return std::span<const std::byte>(m_data, m_size);
+    }
+
+private:
+    const std::byte * m_data = nullptr;
+    size_t            m_size = 0;
+#ifdef _WIN32
+    HANDLE m_file_handle    = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping_handle = nullptr;
+#endif
+};
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "core/vmath.h"
+#include "pch/pch.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+
+// a very simple thread pool
+// workers pull std::function jobs out of a single locked queue.
+// parallel_for lets the calling thread drain the work as well, so nested parallel_for calls (a job
+// issuing another parallel_for) never deadlock even when all workers are busy.
+struct ThreadPool
+{
+    std::vector<std::thread>          m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex                        m_jobs_mutex;
+    std::condition_variable           m_jobs_cv;
+    bool                              m_is_stopping = false;
+
+    static ThreadPool &
+    Get()
+    {
+        static ThreadPool singleton(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+        return singleton;
+    }
+
+    ThreadPool(const size_t num_workers)
+    {
+        m_workers.reserve(num_workers);
+        for (size_t i_worker = 0; i_worker < num_workers; i_worker++)
+        {
+            m_workers.emplace_back([this]() { worker_loop(); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_jobs_mutex);
+            m_is_stopping = true;
+        }
+        m_jobs_cv.notify_all();
+        for (std::thread & worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    // number of threads that can run a parallel_for at the same time (workers + caller)
+    size_t
+    get_num_threads() const
+    {
+        return m_workers.size() + 1;
+    }
+
+    template <typename Func>
+    std::future<std::invoke_result_t<Func>>
+    submit(Func && func)
+    {
+        using ResultT = std::invoke_result_t<Func>;
+        auto task     = std::make_shared<std::packaged_task<ResultT()>>(std::forward<Func>(func));
+        std::future<ResultT> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_jobs_mutex);
+            m_jobs.emplace_back([task]() { (*task)(); });
+        }
+        m_jobs_cv.notify_one();
+        return result;
+    }
+
+    // call func(i) for i in [begin, end)
+    // items are handed out in chunks of grain_size, the call returns after every item is processed
+    void
+    parallel_for(const size_t                        begin,
+                 const size_t                        end,
+                 const std::function<void(size_t)> & func,
+                 const size_t                        grain_size = 1)
+    {
+        if (begin >= end)
+        {
+            return;
+        }
+
+        const size_t num_chunks = div_ceil(end - begin, grain_size);
+        if (num_chunks == 1 || m_workers.empty())
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                func(i);
+            }
+            return;
+        }
+
+        // helpers may start after the caller has already returned, so the state is shared
+        struct ParallelForState
+        {
+            std::atomic<size_t>     m_next_chunk      = 0;
+            std::atomic<size_t>     m_num_done_chunks = 0;
+            std::mutex              m_done_mutex;
+            std::condition_variable m_done_cv;
+            std::exception_ptr      m_exception = nullptr;
+        };
+        auto state = std::make_shared<ParallelForState>();
+
+        auto run_chunks = [state, begin, end, grain_size, num_chunks, &func]()
+        {
+            size_t i_chunk;
+            while ((i_chunk = state->m_next_chunk.fetch_add(1)) < num_chunks)
+            {
+                const size_t chunk_begin = begin + i_chunk * grain_size;
+                const size_t chunk_end   = std::min(chunk_begin + grain_size, end);
+                try
+                {
+                    for (size_t i = chunk_begin; i < chunk_end; i++)
+                    {
+                        func(i);
+                    }
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(state->m_done_mutex);
+                    if (!state->m_exception)
+                    {
+                        state->m_exception = std::current_exception();
+                    }
+                }
+                if (state->m_num_done_chunks.fetch_add(1) + 1 == num_chunks)
+                {
+                    std::lock_guard<std::mutex> lock(state->m_done_mutex);
+                    state->m_done_cv.notify_all();
+                }
+            }
+        };
+
+        // wake up helpers, the caller also takes part
+        const size_t num_helpers = std::min(m_workers.size(), num_chunks - 1);
+        {
+            std::lock_guard<std::mutex> lock(m_jobs_mutex);
+            for (size_t i_helper = 0; i_helper < num_helpers; i_helper++)
+            {
+                m_jobs.emplace_back(run_chunks);
+            }
+        }
+        m_jobs_cv.notify_all();
+        run_chunks();
+
+        // only wait for chunks that are already being processed by other threads
+        std::unique_lock<std::mutex> lock(state->m_done_mutex);
+        state->m_done_cv.wait(lock, [&]() { return state->m_num_done_chunks.load() == num_chunks; });
+        if (state->m_exception)
+        {
+            std::rethrow_exception(state->m_exception);
+        }
+    }
+
+private:
+    void
+    worker_loop()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(m_jobs_mutex);
+                m_jobs_cv.wait(lock, [&]() { return m_is_stopping || !m_jobs.empty(); });
+                if (m_is_stopping && m_jobs.empty())
+                {
+                    return;
+                }
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool(ThreadPool &&) = delete;
+
+    ThreadPool &
+    operator=(const ThreadPool &) = delete;
+
+    ThreadPool &
+    operator=(ThreadPool &&) = delete;
+};
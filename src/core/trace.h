@@ -1,14 +1,82 @@
 #pragma once
 
+#include "core/json.h"
+#include "core/logger.h"
 #include "pch/pch.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <unordered_map>
+
+// scopes are compiled out of release builds unless ENABLE_TRACE is defined
+#if !defined(NDEBUG) && !defined(ENABLE_TRACE)
+    #define ENABLE_TRACE
+#endif
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b)      TRACE_CONCAT_IMPL(a, b)
+
+#ifdef ENABLE_TRACE
+    // the name is interned once per call site
+    #define TRACE_SCOPE(name)                                                                        \
+        static const uint32_t TRACE_CONCAT(trace_name_id_, __LINE__) = Trace::Get().intern(name); \
+        const TraceScope      TRACE_CONCAT(trace_scope_, __LINE__)(TRACE_CONCAT(trace_name_id_, __LINE__))
+#else
+    #define TRACE_SCOPE(name)
+#endif
+
+// a complete event, timestamps are nanoseconds of the steady clock
+struct TraceEvent
+{
+    int64_t  m_begin_ns;
+    int64_t  m_end_ns;
+    uint32_t m_name_id;
+    uint32_t m_track_id;
+};
+
+// cpu scopes and externally timed events (gpu intervals) in the chrome trace event format, which perfetto opens.
+// recording only writes a pod event into a fixed size buffer owned by the recording thread, a background thread
+// serializes the buffers while a trace is written. a full buffer drops events rather than waiting.
+// on msvc the epoch of the steady clock is the origin of the performance counter, the clock the device calibrates
+// gpu timestamps against.
 struct Trace
 {
-    std::map<std::thread::id, std::vector<std::string>>                                    m_name_stack;
-    std::map<std::thread::id, std::vector<std::chrono::high_resolution_clock::time_point>> m_time_stack;
-    std::ostream *                                                                         m_stream = nullptr;
-    std::mutex                                                                             m_pop_mutex;
-    bool                                                                                   m_need_comma = false;
+    static constexpr size_t NumEventsPerThread = 1 << 15;
+    static constexpr auto   FlushInterval      = std::chrono::milliseconds(10);
+
+    // single producer (the owning thread), single consumer (the flusher) ring
+    struct ThreadBuffer
+    {
+        std::array<TraceEvent, NumEventsPerThread> m_events;
+        std::atomic<uint64_t>                      m_num_written = 0;
+        std::atomic<uint64_t>                      m_num_read    = 0;
+        std::atomic<uint64_t>                      m_num_dropped = 0;
+        uint32_t                                   m_track_id    = 0;
+        bool                                       m_is_named    = false;
+    };
+
+    std::atomic<bool> m_is_active = false;
+
+    // buffers outlive their threads so events of exited threads are still written
+    std::mutex                                 m_buffers_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+
+    std::mutex                                m_names_mutex;
+    std::vector<std::string>                  m_names;
+    std::unordered_map<std::string, uint32_t> m_name_ids;
+    std::map<uint32_t, std::string>           m_track_names;
+
+    // only touched by the flusher while a trace is active
+    std::ostream *           m_stream     = nullptr;
+    std::vector<std::string> m_flusher_names;
+    std::vector<uint64_t>    m_flusher_nums_written;
+    bool                     m_need_comma = false;
+    std::thread              m_flusher;
+    std::mutex               m_flusher_mutex;
+    std::condition_variable  m_flusher_cv;
+    bool                     m_should_stop_flusher = false;
 
 #define QUOTE(v) "\"" << v << "\""
 
@@ -19,60 +87,126 @@ struct Trace
         return singleton;
     }
 
-    void
-    begin(std::ostream * stream)
+    static int64_t
+    GetNanoSec()
     {
-        m_stream = stream;
-        *m_stream << "{\"traceEvents\":[\n";
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
     }
 
-    void
-    push(const std::string & name)
+    bool
+    is_active() const
+    {
+        return m_is_active.load(std::memory_order_relaxed);
+    }
+
+    uint32_t
+    intern(const std::string & name)
     {
-        const std::thread::id thread_id  = std::this_thread::get_id();
-        const auto            start_time = std::chrono::high_resolution_clock::now();
-        m_time_stack[thread_id].push_back(start_time);
-        m_name_stack[thread_id].push_back(name);
+        std::lock_guard<std::mutex> guard(m_names_mutex);
+        const auto [iter, is_inserted] = m_name_ids.try_emplace(name, static_cast<uint32_t>(m_names.size()));
+        if (is_inserted)
+        {
+            m_names.push_back(name);
+        }
+        return iter->second;
     }
 
+    // events of the calling thread go to its own track unless track_id names another one, e.g. a gpu queue
     void
-    pop()
+    record(const uint32_t name_id, const int64_t begin_ns, const int64_t end_ns, const std::optional<uint32_t> track_id = std::nullopt)
     {
-        const std::thread::id thread_id = std::this_thread::get_id();
+        ThreadBuffer & buffer      = GetThreadBuffer();
+        const uint64_t num_written = buffer.m_num_written.load(std::memory_order_relaxed);
+        if (num_written - buffer.m_num_read.load(std::memory_order_acquire) == NumEventsPerThread)
+        {
+            buffer.m_num_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
 
-        // get start time and end time
-        const auto start_time = m_time_stack[thread_id].back();
-        const auto end_time   = std::chrono::high_resolution_clock::now();
+        TraceEvent & event = buffer.m_events[num_written % NumEventsPerThread];
+        event.m_begin_ns   = begin_ns;
+        event.m_end_ns     = end_ns;
+        event.m_name_id    = name_id;
+        event.m_track_id   = track_id.value_or(buffer.m_track_id);
+        buffer.m_num_written.store(num_written + 1, std::memory_order_release);
+    }
 
-        // get duration and start time in milliseconds
-        const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
-        const auto start_ms = std::chrono::time_point_cast<std::chrono::microseconds>(start_time).time_since_epoch().count();
+    // label of a track that is not a cpu thread
+    void
+    set_track_name(const uint32_t track_id, const std::string & name)
+    {
+        std::lock_guard<std::mutex> guard(m_names_mutex);
+        m_track_names[track_id] = name;
+    }
+
+    void
+    begin(std::ostream * stream)
+    {
+        assert(!is_active());
+        m_flusher_names.clear();
 
-        // get name
-        const std::string & name = m_name_stack[thread_id].back();
+        // events left over from the previous trace are stale
+        {
+            std::lock_guard<std::mutex> guard(m_buffers_mutex);
+            for (std::unique_ptr<ThreadBuffer> & buffer : m_buffers)
+            {
+                buffer->m_num_read.store(buffer->m_num_written.load(std::memory_order_acquire), std::memory_order_release);
+                buffer->m_num_dropped.store(0, std::memory_order_relaxed);
+                buffer->m_is_named = false;
+            }
+        }
 
-        std::lock_guard<std::mutex> guard(m_pop_mutex);
+        m_stream     = stream;
+        m_need_comma = false;
+        *m_stream << "{\"traceEvents\":[\n";
         {
-            if (m_need_comma) *m_stream << ",";
-            *m_stream << "{" << QUOTE("dur") << ":" << duration << "," << QUOTE("name") << ":" << QUOTE(name) << ","
-                      << QUOTE("ph") << ":" << QUOTE("X") << "," << QUOTE("pid") << ":" << 0 << "," << QUOTE("tid")
-                      << ":" << thread_id << "," << QUOTE("ts") << ":" << start_ms << "}";
-            m_need_comma = true;
+            std::lock_guard<std::mutex> guard(m_names_mutex);
+            for (const auto & [track_id, name] : m_track_names)
+            {
+                write_track_name(track_id, name);
+            }
         }
 
-        m_time_stack[thread_id].pop_back();
-        m_name_stack[thread_id].pop_back();
+        m_should_stop_flusher = false;
+        m_flusher             = std::thread([this]() { run_flusher(); });
+        m_is_active.store(true, std::memory_order_relaxed);
     }
 
-    void
+    // returns the number of events dropped since begin()
+    size_t
     end()
     {
+        m_is_active.store(false, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> guard(m_flusher_mutex);
+            m_should_stop_flusher = true;
+        }
+        m_flusher_cv.notify_one();
+        m_flusher.join();
+
+        // whatever was recorded before the trace became inactive
+        const size_t num_dropped = flush();
         *m_stream << "]}";
+        m_stream->flush();
+        m_stream = nullptr;
+        if (num_dropped > 0)
+        {
+            Logger::Warn(__FUNCTION__, " ", num_dropped, " events were dropped, the flusher could not keep up");
+        }
+        return num_dropped;
     }
 
 private:
     Trace() {}
 
+    ~Trace()
+    {
+        if (m_flusher.joinable())
+        {
+            end();
+        }
+    }
+
     Trace(const Trace &) = delete;
 
     Trace(Trace &&) = delete;
@@ -82,4 +216,185 @@ private:
 
     Trace &
     operator=(Trace &&) = delete;
-};
\ No newline at end of file
+
+    static ThreadBuffer &
+    GetThreadBuffer()
+    {
+        thread_local ThreadBuffer * buffer = nullptr;
+        if (buffer == nullptr)
+        {
+            buffer = Get().register_thread();
+        }
+        return *buffer;
+    }
+
+    ThreadBuffer *
+    register_thread()
+    {
+        std::lock_guard<std::mutex> guard(m_buffers_mutex);
+        std::unique_ptr<ThreadBuffer> buffer = std::make_unique<ThreadBuffer>();
+        buffer->m_track_id                   = static_cast<uint32_t>(m_buffers.size());
+        m_buffers.push_back(std::move(buffer));
+        return m_buffers.back().get();
+    }
+
+    void
+    run_flusher()
+    {
+        std::unique_lock<std::mutex> lock(m_flusher_mutex);
+        while (!m_should_stop_flusher)
+        {
+            m_flusher_cv.wait_for(lock, FlushInterval, [this]() { return m_should_stop_flusher; });
+            flush();
+        }
+    }
+
+    // writes every event recorded so far, returns the number of events dropped since the trace began
+    size_t
+    flush()
+    {
+        std::lock_guard<std::mutex> buffers_guard(m_buffers_mutex);
+
+        // the counts are taken first, every name an event up to them refers to was interned before the event was
+        // recorded, so the copy below has it
+        m_flusher_nums_written.resize(m_buffers.size());
+        for (size_t i_buffer = 0; i_buffer < m_buffers.size(); i_buffer++)
+        {
+            m_flusher_nums_written[i_buffer] = m_buffers[i_buffer]->m_num_written.load(std::memory_order_acquire);
+        }
+
+        // names are only appended, new ones are copied so interning never waits for serialization
+        {
+            std::lock_guard<std::mutex> names_guard(m_names_mutex);
+            m_flusher_names.insert(m_flusher_names.end(), m_names.begin() + m_flusher_names.size(), m_names.end());
+        }
+
+        size_t num_dropped = 0;
+        for (size_t i_buffer = 0; i_buffer < m_buffers.size(); i_buffer++)
+        {
+            ThreadBuffer & buffer      = *m_buffers[i_buffer];
+            const uint64_t num_written = m_flusher_nums_written[i_buffer];
+            uint64_t       num_read    = buffer.m_num_read.load(std::memory_order_relaxed);
+            if (num_read != num_written && !buffer.m_is_named)
+            {
+                write_track_name(buffer.m_track_id, "thread " + std::to_string(buffer.m_track_id));
+                buffer.m_is_named = true;
+            }
+            for (; num_read < num_written; num_read++)
+            {
+                write_event(buffer.m_events[num_read % NumEventsPerThread]);
+            }
+            buffer.m_num_read.store(num_read, std::memory_order_release);
+            num_dropped += buffer.m_num_dropped.load(std::memory_order_relaxed);
+        }
+        return num_dropped;
+    }
+
+    // microseconds with nanosecond digits
+    static void
+    WriteMicroSec(std::ostream & stream, const int64_t ns)
+    {
+        stream << ns / 1000 << "." << std::setw(3) << std::setfill('0') << ns % 1000 << std::setfill(' ');
+    }
+
+    void
+    write_event(const TraceEvent & event)
+    {
+        if (m_need_comma) *m_stream << ",";
+        *m_stream << "{" << QUOTE("dur") << ":";
+        WriteMicroSec(*m_stream, std::max(event.m_end_ns - event.m_begin_ns, int64_t(0)));
+        *m_stream << "," << QUOTE("name") << ":";
+        Json::WriteString(*m_stream, m_flusher_names[event.m_name_id]);
+        *m_stream << "," << QUOTE("ph") << ":" << QUOTE("X") << "," << QUOTE("pid") << ":" << 0 << "," << QUOTE("tid")
+                  << ":" << event.m_track_id << "," << QUOTE("ts") << ":";
+        WriteMicroSec(*m_stream, event.m_begin_ns);
+        *m_stream << "}\n";
+        m_need_comma = true;
+    }
+
+    void
+    write_track_name(const uint32_t track_id, const std::string & name)
+    {
+        if (m_need_comma) *m_stream << ",";
+        *m_stream << "{" << QUOTE("name") << ":" << QUOTE("thread_name") << "," << QUOTE("ph") << ":" << QUOTE("M")
+                  << "," << QUOTE("pid") << ":" << 0 << "," << QUOTE("tid") << ":" << track_id << ","
+                  << QUOTE("args") << ":{" << QUOTE("name") << ":";
+        Json::WriteString(*m_stream, name);
+        *m_stream << "}}\n";
+        m_need_comma = true;
+    }
+};
+
+// the begin timestamp is only taken while a trace is active, an inactive scope costs a relaxed load
+struct TraceScope
+{
+    uint32_t m_name_id;
+    int64_t  m_begin_ns = 0;
+
+    TraceScope(const uint32_t name_id) : m_name_id(name_id)
+    {
+        if (Trace::Get().is_active())
+        {
+            m_begin_ns = Trace::GetNanoSec();
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (m_begin_ns != 0 && Trace::Get().is_active())
+        {
+            Trace::Get().record(m_name_id, m_begin_ns, Trace::GetNanoSec());
+        }
+    }
+};
+
+// owns the file a trace is written to. a capture covers a fixed number of frames, or every frame until the capture
+// is destroyed when started with zero frames
+struct TraceCapture
+{
+    std::ofstream m_stream;
+    size_t        m_num_frames_left = 0;
+    bool          m_is_continuous   = false;
+
+    ~TraceCapture()
+    {
+        if (is_capturing())
+        {
+            end();
+        }
+    }
+
+    bool
+    is_capturing() const
+    {
+        return m_stream.is_open();
+    }
+
+    void
+    begin(const std::filesystem::path & path, const size_t num_frames)
+    {
+        assert(!is_capturing());
+        m_stream.open(path, std::ios::trunc);
+        m_num_frames_left = num_frames;
+        m_is_continuous   = num_frames == 0;
+        Trace::Get().begin(&m_stream);
+        Logger::Info(__FUNCTION__, " writing trace to ", path.string());
+    }
+
+    void
+    end_frame()
+    {
+        if (is_capturing() && !m_is_continuous && --m_num_frames_left == 0)
+        {
+            end();
+        }
+    }
+
+private:
+    void
+    end()
+    {
+        Trace::Get().end();
+        m_stream.close();
+    }
+};
@@ -11,6 +11,21 @@ struct EngineSetting
     static const uint32_t MaxNumIndices                  = 30000000;
     static const uint32_t MaxNumGeometryOffsetTableEntry = 14000;
     static const uint32_t MaxNumGeometryTableEntry       = 32000;
+    static const uint32_t TextureUploadBatchSize         = 16;
+    static const uint32_t StagingRingSizeInBytes         = 256 * 1024 * 1024;
+    static const bool     EnableTextureCompression       = true;
+    static const bool     EnableShaderHotReload          = true;
+    static const uint32_t ShaderHotReloadIntervalInMs    = 250;
+    // meshes with too many vertices for 16 bit indices are split into geometries with 16 bit indices, or kept whole
+    // with 32 bit indices if that takes less memory once every geometry is charged this many bytes (see AiIndexPolicy)
+    static const bool     Enable32BitIndices  = true;
+    static const uint32_t GeometryCostInBytes = 64 * 1024;
+    // the tlas is refit until the instance updates since its last rebuild exceed this many times the instance count
+    static constexpr float TlasRebuildRatio = 1.0f;
+    // cpu scopes and gpu intervals are traced every frame from startup, or for this many frames once a capture is
+    // requested from the gpu profiler window
+    static const bool     EnableContinuousTrace = false;
+    static const uint32_t TraceCaptureNumFrames = 120;
 
     inline static std::filesystem::path &
     ShaderCachePath()
@@ -18,4 +33,25 @@ struct EngineSetting
         static std::filesystem::path result = "shadercache/";
         return result;
     }
+
+    inline static std::filesystem::path &
+    TextureCachePath()
+    {
+        static std::filesystem::path result = "texturecache/";
+        return result;
+    }
+
+    inline static std::filesystem::path &
+    TracePath()
+    {
+        static std::filesystem::path result = "trace.json";
+        return result;
+    }
+
+    inline static std::filesystem::path &
+    SceneCachePath()
+    {
+        static std::filesystem::path result = "scenecache/";
+        return result;
+    }
 };
\ No newline at end of file
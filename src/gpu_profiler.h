@@ -3,6 +3,7 @@
 #include "rhi/rhi.h"
 
 #include "core/gui_event_coordinator.h"
+#include "core/trace.h"
 
 struct QueryIndices
 {
@@ -33,8 +34,40 @@ struct GpuProfilingInterval
     }
 };
 
+// maps gpu timestamps into the clock of Trace using a cpu and a gpu timestamp sampled together by
+// Device::get_sync_calibrate_cpu_gpu_time, where the cpu one is a performance counter value
+struct CpuGpuClockCalibration
+{
+    int64_t   m_cpu_nano_sec      = 0;
+    uint64_t  m_gpu_timestamp     = 0;
+    double    m_ns_from_timestamp = 1.0;
+
+    CpuGpuClockCalibration(const std::pair<uint64_t, uint64_t> & cpu_gpu_time, const float ns_from_timestamp)
+    : m_gpu_timestamp(cpu_gpu_time.second), m_ns_from_timestamp(ns_from_timestamp)
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        const uint64_t ticks_per_sec = static_cast<uint64_t>(frequency.QuadPart);
+        const uint64_t cpu_ticks     = cpu_gpu_time.first;
+        // split so the multiplication does not overflow
+        m_cpu_nano_sec = static_cast<int64_t>(cpu_ticks / ticks_per_sec * 1000000000 +
+                                              cpu_ticks % ticks_per_sec * 1000000000 / ticks_per_sec);
+    }
+
+    int64_t
+    get_cpu_nano_sec(const uint64_t gpu_timestamp) const
+    {
+        const double ns_since_calibration =
+            static_cast<double>(static_cast<int64_t>(gpu_timestamp - m_gpu_timestamp)) * m_ns_from_timestamp;
+        return m_cpu_nano_sec + static_cast<int64_t>(ns_since_calibration);
+    }
+};
+
 struct GpuProfiler
 {
+    // track of the graphics queue in traces, far from any cpu thread id
+    static constexpr uint32_t TraceTrackId = 0xFFFF0000;
+
     Rhi::QueryPool                    m_query_pool;
     uint32_t                          m_query_counter = 0;
     std::vector<GpuProfilingInterval> m_profiling_intervals;
@@ -82,6 +115,24 @@ struct GpuProfiler
             profiling_interval.m_end_timestamp   = timestamps[profiling_interval.m_end_query_index];
         }
     }
+
+    // summarized intervals as events of the gpu track, next to the cpu scopes of the trace
+    void
+    write_trace(const CpuGpuClockCalibration & calibration) const
+    {
+        for (const GpuProfilingInterval & profiling_interval : m_profiling_intervals)
+        {
+            if (profiling_interval.m_end_timestamp < profiling_interval.m_begin_timestamp ||
+                profiling_interval.m_end_timestamp == std::numeric_limits<uint64_t>::max())
+            {
+                continue;
+            }
+            Trace::Get().record(Trace::Get().intern(profiling_interval.m_name),
+                                calibration.get_cpu_nano_sec(profiling_interval.m_begin_timestamp),
+                                calibration.get_cpu_nano_sec(profiling_interval.m_end_timestamp),
+                                TraceTrackId);
+        }
+    }
 };
 
 struct GpuProfilingScope
@@ -118,6 +169,8 @@ struct GpuProfilerGui
     bool                                           m_pause                          = false;
     float                                          m_ns_from_timestamp              = 1.0f;
     size_t                                         m_flight_counter                 = 0;
+    Rhi::StagingRing::Statistics                   m_upload_statistics              = {};
+    bool                                           m_is_trace_capture_requested     = false;
 
     GpuProfilerGui(const size_t num_flights_to_records)
     : m_profiling_intervals_of_flights(num_flights_to_records)
@@ -136,6 +189,24 @@ struct GpuProfilerGui
         }
     }
 
+    // intervals passed to the last update, empty until a flight has been summarized
+    const std::vector<GpuProfilingInterval> &
+    get_latest_profiling_intervals() const
+    {
+        const size_t num_flights = m_profiling_intervals_of_flights.size();
+        return m_profiling_intervals_of_flights[(m_flight_counter + num_flights - 1) % num_flights];
+    }
+
+    // totals of the transfer queue uploads so far
+    void
+    update_upload_statistics(const Rhi::StagingRing::Statistics & upload_statistics)
+    {
+        if (!m_pause)
+        {
+            m_upload_statistics = upload_statistics;
+        }
+    }
+
     void
     draw_gui(GuiEventCoordinator & gui_event_coordinator)
     {
@@ -152,7 +223,16 @@ struct GpuProfilerGui
             const float button_height = ImGui::GetFontSize() * 1.5f;
 
             ImGui::Checkbox("Pause", &m_pause);
+            ImGui::SameLine();
+            if (ImGui::Button("Capture trace"))
+            {
+                m_is_trace_capture_requested = true;
+            }
             ImGui::SliderFloat("Zoom", &m_zoom_level, 0.0f, 10.0f, "%f", 1.0f);
+            ImGui::Text("Uploads: %.1f MB in %zu batches, %.1f MB/s",
+                        static_cast<float>(m_upload_statistics.m_num_bytes) / (1024.0f * 1024.0f),
+                        m_upload_statistics.m_num_batches,
+                        m_upload_statistics.get_bandwidth_in_mb_per_sec());
 
             size_t   i_flight   = m_flight_counter;
             uint64_t begin_time = 0;
@@ -5,6 +5,7 @@
 #include "pch/pch.h"
 
 #include "core/logger.h"
+#include "core/thread_pool.h"
 #include "core/vmath.h"
 #include "shaders/shared/compact_vertex.h"
 #include "shaders/shared/types.h"
@@ -28,6 +29,15 @@ struct AiGeometryInfo
 
     bool m_is_indices_reorder_needed;
 
+    // 1 for 16 bit indices, 2 for 32 bit indices (see VertexIndexT)
+    uint32_t m_index_stride_in_words = 1;
+
+    size_t
+    get_dst_num_index_words() const
+    {
+        return m_dst_num_indices * m_index_stride_in_words;
+    }
+
     std::string
     to_string() const
     {
@@ -35,11 +45,145 @@ struct AiGeometryInfo
         str += "m_src_mesh_index    : " + std::to_string(m_src_mesh_index) + "\n";
         str += "m_dst_num_vertices  : " + std::to_string(m_dst_num_vertices) + "\n";
         str += "m_dst_num_indices   : " + std::to_string(m_dst_num_indices) + "\n";
+        str += "m_index_stride      : " + std::to_string(m_index_stride_in_words) + "\n";
         str += "m_src_indices_range : " + m_src_faces_range.to_string() + "\n";
         return str;
     }
 };
 
+// how get_geometry_infos lays out the indices of a mesh. a mesh with too many vertices for 16 bit indices is split
+// into geometries with 16 bit indices, or kept whole with 32 bit indices if that costs less. a geometry costs its
+// vertices, its indices and m_geometry_cost_in_bytes, which stands in for its geometry table entry, its share of the
+// blas and the traversal cost of one more geometry
+struct AiIndexPolicy
+{
+    // geometries with 16 bit indices have less vertices than this
+    size_t m_max_num_vertices_per_16bit_geometry = std::numeric_limits<uint16_t>::max();
+    bool   m_is_32bit_index_allowed              = false;
+    size_t m_vertex_size_in_bytes                = 0;
+    size_t m_geometry_cost_in_bytes              = 0;
+
+    size_t
+    get_cost_in_bytes(const AiGeometryInfo & geometry_info) const
+    {
+        return geometry_info.m_dst_num_vertices * m_vertex_size_in_bytes +
+               geometry_info.get_dst_num_index_words() * sizeof(VertexIndexT) + m_geometry_cost_in_bytes;
+    }
+};
+
+// dense map from src vertex index (in ai mesh) to dst vertex index (in mortar's geometry)
+// an entry is valid iff its epoch equals the current epoch, so reset() is O(1) unless the table has to grow
+// dst vertices are inserted in order, m_src_vindices maps them back to the ai mesh
+struct AiVertexRemapTable
+{
+    std::vector<uint32_t> m_epochs;
+    std::vector<uint32_t> m_dst_vindices;
+    std::vector<uint32_t> m_src_vindices;
+    uint32_t              m_epoch = 0;
+
+    void
+    reset(const size_t num_src_vertices)
+    {
+        if (m_epochs.size() < num_src_vertices)
+        {
+            m_epochs.resize(num_src_vertices, 0);
+            m_dst_vindices.resize(num_src_vertices);
+        }
+        m_src_vindices.clear();
+
+        m_epoch++;
+        if (m_epoch == 0)
+        {
+            // epoch wrapped around, old stamps could be mistaken as valid
+            std::fill(m_epochs.begin(), m_epochs.end(), 0);
+            m_epoch = 1;
+        }
+    }
+
+    bool
+    find(const size_t src_vindex, uint32_t * dst_vindex) const
+    {
+        if (m_epochs[src_vindex] != m_epoch)
+        {
+            return false;
+        }
+        *dst_vindex = m_dst_vindices[src_vindex];
+        return true;
+    }
+
+    void
+    insert(const size_t src_vindex, const uint32_t dst_vindex)
+    {
+        assert(dst_vindex == m_src_vindices.size());
+        m_epochs[src_vindex]       = m_epoch;
+        m_dst_vindices[src_vindex] = dst_vindex;
+        m_src_vindices.push_back(static_cast<uint32_t>(src_vindex));
+    }
+};
+
+// remap tables for the threads writing geometries in parallel, owned by a single import
+// every table grows to the largest mesh its thread split, so the tables are released with the pool when the import ends
+// instead of being kept per thread for the life of the process
+struct AiVertexRemapTablePool
+{
+    std::mutex                                       m_mutex;
+    std::vector<std::unique_ptr<AiVertexRemapTable>> m_free_tables;
+
+    std::unique_ptr<AiVertexRemapTable>
+    acquire()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_free_tables.empty())
+        {
+            return std::make_unique<AiVertexRemapTable>();
+        }
+        std::unique_ptr<AiVertexRemapTable> table = std::move(m_free_tables.back());
+        m_free_tables.pop_back();
+        return table;
+    }
+
+    void
+    release(std::unique_ptr<AiVertexRemapTable> table)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free_tables.push_back(std::move(table));
+    }
+};
+
+// texcoord range the compact vertices of a geometry are quantized against (see CompactVertex) and the largest errors
+// the compact vertex format introduced
+struct AiGeometryQuantization
+{
+    float2 m_texcoord_offset              = float2(0.0f);
+    float2 m_texcoord_scale               = float2(0.0f);
+    float  m_max_snormal_error_in_degrees = 0.0f;
+    float  m_max_texcoord_error           = 0.0f;
+
+    void
+    merge_errors(const AiGeometryQuantization & quantization)
+    {
+        m_max_snormal_error_in_degrees = std::max(m_max_snormal_error_in_degrees, quantization.m_max_snormal_error_in_degrees);
+        m_max_texcoord_error           = std::max(m_max_texcoord_error, quantization.m_max_texcoord_error);
+    }
+};
+
+// assimp io system that remembers every file assimp opens while importing (e.g. .obj and its .mtl)
+struct AiRecordingIoSystem : public Assimp::DefaultIOSystem
+{
+    std::vector<std::filesystem::path> m_opened_paths;
+
+    Assimp::IOStream *
+    Open(const char * file, const char * mode = "rb") override
+    {
+        Assimp::IOStream * stream = Assimp::DefaultIOSystem::Open(file, mode);
+        if (stream != nullptr)
+        {
+            m_opened_paths.emplace_back(file);
+        }
+        return stream;
+    }
+};
+
 struct AiScene
 {
     using aiFaceSizeT     = decltype(aiMesh::mNumFaces);
@@ -52,88 +196,147 @@ struct AiScene
     std::unique_ptr<Assimp::Importer> m_ai_importer;
     const aiScene *                   m_ai_scene = nullptr;
 
+    // all files read by assimp to construct this scene
+    std::vector<std::filesystem::path> m_src_file_paths;
+
     // read AiScene from path
     static std::optional<AiScene>
     ReadScene(const std::filesystem::path & path)
     {
         AiScene result;
         result.m_ai_importer = std::make_unique<Assimp::Importer>();
-        result.m_ai_scene    = result.m_ai_importer->ReadFile(path.string(), aiProcess_GenNormals);
+
+        // importer takes the ownership of io system
+        AiRecordingIoSystem * io_system = new AiRecordingIoSystem();
+        result.m_ai_importer->SetIOHandler(io_system);
+
+        result.m_ai_scene = result.m_ai_importer->ReadFile(path.string(), aiProcess_GenNormals);
         if (result.m_ai_scene == nullptr)
         {
             return std::nullopt;
         }
+        result.m_src_file_paths = io_system->m_opened_paths;
         return result;
     }
 
-    // split assimp scene into multiple geometries where each geometry is guaranteed to have #vertices less than user-specified max num vertices
+    // split assimp scene into geometries whose indices fit the index format index_policy chooses for them
     std::vector<AiGeometryInfo>
-    get_geometry_infos(const size_t max_dst_num_vertices_per_geometry) const
+    get_geometry_infos(const AiIndexPolicy & index_policy) const
     {
-        std::vector<AiGeometryInfo> result;
+        // meshes are split independently on the thread pool, each into its own list
+        std::vector<std::vector<AiGeometryInfo>> geometries_per_mesh(m_ai_scene->mNumMeshes);
+        ThreadPool::Get().parallel_for(0,
+                                       m_ai_scene->mNumMeshes,
+                                       [&](const size_t i_mesh)
+                                       {
+                                           get_geometry_infos(&geometries_per_mesh[i_mesh],
+                                                              static_cast<aiMeshSizeT>(i_mesh),
+                                                              index_policy);
+                                       });
+
+        // then concatenated in mesh order, so the result is the same as splitting serially
+        size_t num_geometries = 0;
+        for (const std::vector<AiGeometryInfo> & geometries : geometries_per_mesh)
+        {
+            num_geometries += geometries.size();
+        }
 
-        // iterate over all meshes and split them
-        for (aiMeshSizeT i_mesh = 0; i_mesh < m_ai_scene->mNumMeshes; i_mesh++)
+        std::vector<AiGeometryInfo> result;
+        result.reserve(num_geometries);
+        for (const std::vector<AiGeometryInfo> & geometries : geometries_per_mesh)
         {
-            get_geometry_infos(&result, i_mesh, max_dst_num_vertices_per_geometry);
+            result.insert(result.end(), geometries.begin(), geometries.end());
         }
         return result;
     }
 
-    // split imported assimp mesh into multiple geometries where each geometry is guaranteed to have #vertices less than user-specified max num vertices
+    // split imported assimp mesh into geometries whose indices fit the index format index_policy chooses for them
     void
     get_geometry_infos(std::vector<AiGeometryInfo> * geometries,
                        const unsigned int            src_mesh_index,
-                       const size_t                  max_dst_num_vertices_per_geometry) const
+                       const AiIndexPolicy &         index_policy) const
     {
         const aiMesh & src_mesh = *m_ai_scene->mMeshes[src_mesh_index];
 
+        // src mesh
+        aiVertexSizeT max_vindex      = std::numeric_limits<aiVertexSizeT>::min();
+        aiVertexSizeT min_vindex      = std::numeric_limits<aiVertexSizeT>::max();
+        aiFaceSizeT   num_dst_indices = 0;
+        for (aiFaceSizeT i_src_face = 0; i_src_face < src_mesh.mNumFaces; i_src_face++)
         {
-            // src mesh
-            aiVertexSizeT max_vindex      = std::numeric_limits<aiVertexSizeT>::min();
-            aiVertexSizeT min_vindex      = std::numeric_limits<aiVertexSizeT>::max();
-            aiFaceSizeT   num_dst_indices = 0;
-            for (aiFaceSizeT i_src_face = 0; i_src_face < src_mesh.mNumFaces; i_src_face++)
+            const aiFace & src_face = src_mesh.mFaces[i_src_face];
+            num_dst_indices += (src_face.mNumIndices - 2) * 3;
+            for (aiVertexSizeT i_index = 0; i_index < src_face.mNumIndices; i_index++)
             {
-                const aiFace & src_face = src_mesh.mFaces[i_src_face];
-                num_dst_indices += (src_face.mNumIndices - 2) * 3;
-                for (aiVertexSizeT i_index = 0; i_index < src_face.mNumIndices; i_index++)
-                {
-                    const aiVertexSizeT vindex = src_face.mIndices[i_index];
-                    max_vindex                 = std::max(vindex, max_vindex);
-                    min_vindex                 = std::min(vindex, min_vindex);
-                }
+                const aiVertexSizeT vindex = src_face.mIndices[i_index];
+                max_vindex                 = std::max(vindex, max_vindex);
+                min_vindex                 = std::min(vindex, min_vindex);
             }
+        }
+
+        // the whole mesh as one geometry
+        AiGeometryInfo whole_geometry;
+        whole_geometry.m_src_mesh_index            = static_cast<uint32_t>(src_mesh_index);
+        whole_geometry.m_src_faces_range.m_begin   = 0;
+        whole_geometry.m_src_faces_range.m_end     = src_mesh.mNumFaces;
+        whole_geometry.m_dst_num_indices           = num_dst_indices;
+        whole_geometry.m_dst_num_vertices          = max_vindex - min_vindex + 1;
+        whole_geometry.m_src_material_index        = src_mesh.mMaterialIndex;
+        whole_geometry.m_is_indices_reorder_needed = false;
+        if (whole_geometry.m_dst_num_vertices < index_policy.m_max_num_vertices_per_16bit_geometry)
+        {
+            geometries->push_back(whole_geometry);
+            return;
+        }
+
+        std::vector<AiGeometryInfo> split_geometries;
+        split_geometry_infos(&split_geometries, src_mesh_index, index_policy.m_max_num_vertices_per_16bit_geometry);
 
-            aiVertexSizeT num_vindices = max_vindex - min_vindex + 1;
-            if (num_vindices < max_dst_num_vertices_per_geometry)
+        if (index_policy.m_is_32bit_index_allowed)
+        {
+            whole_geometry.m_index_stride_in_words = 2;
+            size_t split_cost_in_bytes             = 0;
+            for (const AiGeometryInfo & split_geometry : split_geometries)
             {
-                AiGeometryInfo geometry;
-                geometry.m_src_mesh_index            = static_cast<uint32_t>(src_mesh_index);
-                geometry.m_src_faces_range.m_begin   = 0;
-                geometry.m_src_faces_range.m_end     = src_mesh.mNumFaces;
-                geometry.m_dst_num_indices           = num_dst_indices;
-                geometry.m_dst_num_vertices          = num_vindices;
-                geometry.m_src_material_index        = src_mesh.mMaterialIndex;
-                geometry.m_is_indices_reorder_needed = false;
-                geometries->push_back(geometry);
+                split_cost_in_bytes += index_policy.get_cost_in_bytes(split_geometry);
+            }
+            if (index_policy.get_cost_in_bytes(whole_geometry) <= split_cost_in_bytes)
+            {
+                geometries->push_back(whole_geometry);
                 return;
             }
         }
 
+        geometries->insert(geometries->end(), split_geometries.begin(), split_geometries.end());
+    }
+
+    // split imported assimp mesh into multiple geometries with 16 bit indices where each geometry is guaranteed to have
+    // #vertices less than max_dst_num_vertices_per_geometry
+    void
+    split_geometry_infos(std::vector<AiGeometryInfo> * geometries,
+                         const unsigned int            src_mesh_index,
+                         const size_t                  max_dst_num_vertices_per_geometry) const
+    {
+        const aiMesh & src_mesh = *m_ai_scene->mMeshes[src_mesh_index];
+
         // since max vertices that we support per geometry could be as low as MAX_UINT16 or
         // MAX_UINT8 but number of vertices and indices in mesh could be higher to avoid this we
         // have to split mesh indices and vertices into multiple groups create list of submesh info
-        size_t                  used_num_indices = 0;
-        std::set<aiVertexSizeT> used_ai_vertex_indices;
-        aiFaceSizeT             i_range_begin = 0;
+        //
+        // a vertex is used by the current geometry iff its stamp equals the current epoch.
+        // starting a new geometry only bumps the epoch instead of clearing the whole array.
+        std::vector<uint32_t> vertex_epochs(src_mesh.mNumVertices, 0);
+        uint32_t              epoch             = 1;
+        size_t                used_num_indices  = 0;
+        size_t                used_num_vertices = 0;
+        aiFaceSizeT           i_range_begin     = 0;
 
         for (aiFaceSizeT i_src_face = 0; i_src_face < src_mesh.mNumFaces;)
         {
             // check if we can push a new face into the current dst mesh
             // if we cannot, num_indices and num_vertices along with range will be recorded as the info for submesh
             const size_t num_indices_before_increment  = used_num_indices;
-            const size_t num_vertices_before_increment = used_ai_vertex_indices.size();
+            const size_t num_vertices_before_increment = used_num_vertices;
 
             // in src mesh, a single face could be a triangle fan
             // where in dst mesh, a single face is only a triangle
@@ -142,11 +345,16 @@ struct AiScene
             used_num_indices += static_cast<size_t>((src_face.mNumIndices - 2) * 3);
             for (unsigned int i_index = 0; i_index < src_face.mNumIndices; i_index++)
             {
-                used_ai_vertex_indices.insert(src_face.mIndices[i_index]);
+                uint32_t & vertex_epoch = vertex_epochs[src_face.mIndices[i_index]];
+                if (vertex_epoch != epoch)
+                {
+                    vertex_epoch = epoch;
+                    used_num_vertices++;
+                }
             }
 
             // if the increment fail, record num_indices and num_vertices and range as the info of a new submesh
-            const bool is_vertices_exceed = used_ai_vertex_indices.size() >= max_dst_num_vertices_per_geometry;
+            const bool is_vertices_exceed = used_num_vertices >= max_dst_num_vertices_per_geometry;
             if (is_vertices_exceed)
             {
                 // range
@@ -175,9 +383,10 @@ struct AiScene
 #endif
 
                 // update
-                i_range_begin    = i_range_end;
-                used_num_indices = 0;
-                used_ai_vertex_indices.clear();
+                i_range_begin     = i_range_end;
+                used_num_indices  = 0;
+                used_num_vertices = 0;
+                epoch++;
             }
             else
             {
@@ -191,7 +400,7 @@ struct AiScene
         geometry.m_src_mesh_index            = static_cast<uint32_t>(src_mesh_index);
         geometry.m_src_faces_range           = urange32_t(i_range_begin, src_mesh.mNumFaces);
         geometry.m_dst_num_indices           = used_num_indices;
-        geometry.m_dst_num_vertices          = used_ai_vertex_indices.size();
+        geometry.m_dst_num_vertices          = used_num_vertices;
         geometry.m_src_material_index        = src_mesh.mMaterialIndex;
         geometry.m_is_indices_reorder_needed = true;
         geometries->push_back(geometry);
@@ -208,10 +417,97 @@ struct AiScene
 #endif
     }
 
+    static float2
+    GetTexcoord(const aiMesh & ai_mesh, const aiVertexSizeT ai_vindex)
+    {
+        return float2(ai_mesh.mTextureCoords[0][ai_vindex].x, ai_mesh.mTextureCoords[0][ai_vindex].y);
+    }
+
+    // writes the shading normal of a vertex and keeps track of the error it was stored with. the texcoord is only
+    // added to the range of the geometry, it is written by WriteTexcoords once the range is known
+    static void
+    WriteCompactVertex(CompactVertex *          vertex,
+                       const aiMesh &           ai_mesh,
+                       const aiVertexSizeT      ai_vindex,
+                       AiGeometryQuantization * quantization,
+                       float2 *                 min_texcoord,
+                       float2 *                 max_texcoord)
+    {
+        const aiVector3D & ai_normal = ai_mesh.mNormals[ai_vindex];
+        float3             snormal(ai_normal.x, ai_normal.y, ai_normal.z);
+        if (dot(snormal, snormal) == 0.0f)
+        {
+            snormal.z = 1.0f;
+        }
+        vertex->set_snormal(snormal);
+
+        // atan2 rather than acos, which cannot resolve angles this small in single precision
+        const float3 decoded_snormal = vertex->get_snormal();
+        const float  snormal_error   = degrees(std::atan2(length(cross(snormal, decoded_snormal)), dot(snormal, decoded_snormal)));
+        quantization->m_max_snormal_error_in_degrees = std::max(quantization->m_max_snormal_error_in_degrees, snormal_error);
+
+        if (ai_mesh.HasTextureCoords(0))
+        {
+            const float2 texcoord = GetTexcoord(ai_mesh, ai_vindex);
+            *min_texcoord         = min(*min_texcoord, texcoord);
+            *max_texcoord         = max(*max_texcoord, texcoord);
+        }
+    }
+
+    // quantizes the texcoords of the geometry against the range of its own vertices and keeps track of the error
+    // get_src_vindex maps a dst vertex back to the ai mesh
+    template <typename GetSrcVindexFunc>
+    static void
+    WriteTexcoords(std::span<CompactVertex> * compact_vertices,
+                   const aiMesh &             ai_mesh,
+                   const size_t               num_dst_vertices,
+                   const float2               min_texcoord,
+                   const float2               max_texcoord,
+                   const GetSrcVindexFunc &   get_src_vindex,
+                   AiGeometryQuantization *   quantization)
+    {
+        if (!ai_mesh.HasTextureCoords(0) || num_dst_vertices == 0)
+        {
+            return;
+        }
+
+        quantization->m_texcoord_offset = min_texcoord;
+        quantization->m_texcoord_scale  = (max_texcoord - min_texcoord) / 65535.0f;
+        for (size_t dst_vindex = 0; dst_vindex < num_dst_vertices; dst_vindex++)
+        {
+            const float2    texcoord = GetTexcoord(ai_mesh, get_src_vindex(dst_vindex));
+            CompactVertex & vertex   = (*compact_vertices)[dst_vindex];
+            vertex.set_texcoord(texcoord, quantization->m_texcoord_offset, quantization->m_texcoord_scale);
+            const float2 texcoord_error =
+                abs(vertex.get_texcoord(quantization->m_texcoord_offset, quantization->m_texcoord_scale) - texcoord);
+            quantization->m_max_texcoord_error =
+                std::max(quantization->m_max_texcoord_error, std::max(texcoord_error.x, texcoord_error.y));
+        }
+    }
+
+    // a 16 bit index takes one word of indices, a 32 bit index two (see VertexIndexT)
+    static void
+    WriteIndex(std::span<VertexIndexT> * indices, const size_t i_index, const size_t index, const uint32_t index_stride_in_words)
+    {
+        if (index_stride_in_words == 1)
+        {
+            assert(index < std::numeric_limits<VertexIndexT>::max());
+            (*indices)[i_index] = static_cast<VertexIndexT>(index);
+        }
+        else
+        {
+            assert(index < std::numeric_limits<uint32_t>::max());
+            (*indices)[i_index * 2]     = static_cast<VertexIndexT>(index & 0xffff);
+            (*indices)[i_index * 2 + 1] = static_cast<VertexIndexT>(index >> 16);
+        }
+    }
+
     void
     write_geometry_info_reordered(std::span<float3> *        positions,
                                   std::span<CompactVertex> * compact_vertices,
                                   std::span<VertexIndexT> *  indices,
+                                  AiVertexRemapTable *       remap_table,
+                                  AiGeometryQuantization *   quantization,
                                   const AiGeometryInfo &     geometry_info) const
     {
         std::span<float3> &        rpositions = *positions;
@@ -220,7 +516,11 @@ struct AiScene
         const aiMesh &             ai_mesh = *m_ai_scene->mMeshes[geometry_info.m_src_mesh_index];
 
         // map from src vertex index in ai mesh to dst vertex index
-        std::map<aiVertexSizeT, size_t> ai_vindex_to_dst_vindex;
+        AiVertexRemapTable & ai_vindex_to_dst_vindex = *remap_table;
+        ai_vindex_to_dst_vindex.reset(ai_mesh.mNumVertices);
+        size_t num_dst_vertices = 0;
+        float2 min_texcoord(std::numeric_limits<float>::max());
+        float2 max_texcoord(std::numeric_limits<float>::lowest());
 
         // for each face in ai mesh
         const urange32_t face_range      = geometry_info.m_src_faces_range;
@@ -230,13 +530,11 @@ struct AiScene
             auto get_dst_vindex = [&](const aiVertexSizeT ai_vindex)
             {
                 // get dst_vindex
-                size_t     dst_vindex;
-                const auto map_result = ai_vindex_to_dst_vindex.find(ai_vindex);
-
-                if (map_result == ai_vindex_to_dst_vindex.end())
+                uint32_t dst_vindex;
+                if (!ai_vindex_to_dst_vindex.find(ai_vindex, &dst_vindex))
                 {
                     // this vertex does not exist in the position buffer before
-                    dst_vindex = ai_vindex_to_dst_vindex.size();
+                    dst_vindex = static_cast<uint32_t>(num_dst_vertices++);
 
                     // write new vertex position
                     const auto & ai_position = ai_mesh.mVertices[ai_vindex];
@@ -244,31 +542,14 @@ struct AiScene
                     rpositions[dst_vindex].y = ai_position.y;
                     rpositions[dst_vindex].z = ai_position.z;
 
-                    // write new shading normal
-                    const auto & ai_normal = ai_mesh.mNormals[ai_vindex];
-                    float3       snormal(ai_normal.x, ai_normal.y, ai_normal.z);
-                    if (dot(snormal, snormal) == 0.0f)
-                    {
-                        snormal.z = 1.0f;
-                    }
-                    rcvertices[dst_vindex].set_snormal(snormal);
-
-                    // write new texture coord
-                    if (ai_mesh.HasTextureCoords(0))
-                    {
-                        rcvertices[dst_vindex].m_texcoord.x = ai_mesh.mTextureCoords[0][ai_vindex].x;
-                        rcvertices[dst_vindex].m_texcoord.y = ai_mesh.mTextureCoords[0][ai_vindex].y;
-                    }
+                    // write new shading normal, extend the texcoord range
+                    WriteCompactVertex(&rcvertices[dst_vindex], ai_mesh, ai_vindex, quantization, &min_texcoord, &max_texcoord);
 
                     // map new index
-                    ai_vindex_to_dst_vindex[ai_vindex] = dst_vindex;
-                }
-                else
-                {
-                    dst_vindex = map_result->second;
+                    ai_vindex_to_dst_vindex.insert(ai_vindex, dst_vindex);
                 }
 
-                return dst_vindex;
+                return static_cast<size_t>(dst_vindex);
             };
 
             // we convert ai_indices into dst_indices
@@ -278,27 +559,32 @@ struct AiScene
             {
                 const size_t dst_vindex2 = get_dst_vindex(ai_mesh.mFaces[i_src_face].mIndices[i_index]);
 
-                rcindices[num_dst_indices + 0] = static_cast<VertexIndexT>(dst_vindex0);
-                rcindices[num_dst_indices + 1] = static_cast<VertexIndexT>(dst_vindex1);
-                rcindices[num_dst_indices + 2] = static_cast<VertexIndexT>(dst_vindex2);
+                WriteIndex(&rcindices, num_dst_indices + 0, dst_vindex0, geometry_info.m_index_stride_in_words);
+                WriteIndex(&rcindices, num_dst_indices + 1, dst_vindex1, geometry_info.m_index_stride_in_words);
+                WriteIndex(&rcindices, num_dst_indices + 2, dst_vindex2, geometry_info.m_index_stride_in_words);
                 num_dst_indices += 3;
 
-                assert(dst_vindex0 < std::numeric_limits<VertexIndexT>::max());
-                assert(dst_vindex1 < std::numeric_limits<VertexIndexT>::max());
-                assert(dst_vindex2 < std::numeric_limits<VertexIndexT>::max());
-
                 dst_vindex1 = dst_vindex2;
             }
         }
 
-        assert(ai_vindex_to_dst_vindex.size() == geometry_info.m_dst_num_vertices);
+        assert(num_dst_vertices == geometry_info.m_dst_num_vertices);
         assert(num_dst_indices == geometry_info.m_dst_num_indices);
+
+        WriteTexcoords(compact_vertices,
+                       ai_mesh,
+                       num_dst_vertices,
+                       min_texcoord,
+                       max_texcoord,
+                       [&](const size_t dst_vindex) { return ai_vindex_to_dst_vindex.m_src_vindices[dst_vindex]; },
+                       quantization);
     }
 
     void
     write_geometry_info_simple(std::span<float3> *        positions,
                                std::span<CompactVertex> * compact_vertices,
                                std::span<VertexIndexT> *  indices,
+                               AiGeometryQuantization *   quantization,
                                const AiGeometryInfo &     geometry_info) const
     {
         // make into reference, so we can use operator[] easily
@@ -309,6 +595,8 @@ struct AiScene
         const aiMesh &             ai_mesh = *m_ai_scene->mMeshes[geometry_info.m_src_mesh_index];
 
         // for each vertices
+        float2 min_texcoord(std::numeric_limits<float>::max());
+        float2 max_texcoord(std::numeric_limits<float>::lowest());
         for (aiVertexSizeT i_vertex = 0; i_vertex < ai_mesh.mNumVertices; i_vertex++)
         {
             // setup positions
@@ -317,24 +605,15 @@ struct AiScene
             rpositions[i_vertex].z = ai_mesh.mVertices[i_vertex].z;
 
             // setup compact information
-            CompactVertex & vertex = rcvertices[i_vertex];
-
-            // write new shading normal
-            const aiVector3D & ai_normal = ai_mesh.mNormals[i_vertex];
-            float3             snormal(ai_normal.x, ai_normal.y, ai_normal.z);
-            if (dot(snormal, snormal) == 0.0f)
-            {
-                snormal.z = 1.0f;
-            }
-            vertex.set_snormal(snormal);
-
-            // write texture coord
-            if (ai_mesh.HasTextureCoords(0))
-            {
-                vertex.m_texcoord.x = ai_mesh.mTextureCoords[0][i_vertex].x;
-                vertex.m_texcoord.y = ai_mesh.mTextureCoords[0][i_vertex].y;
-            }
+            WriteCompactVertex(&rcvertices[i_vertex], ai_mesh, i_vertex, quantization, &min_texcoord, &max_texcoord);
         }
+        WriteTexcoords(compact_vertices,
+                       ai_mesh,
+                       ai_mesh.mNumVertices,
+                       min_texcoord,
+                       max_texcoord,
+                       [](const size_t dst_vindex) { return static_cast<aiVertexSizeT>(dst_vindex); },
+                       quantization);
 
         // for each face in ai mesh
         size_t index_buffer_offset = 0;
@@ -348,33 +627,35 @@ struct AiScene
                 const unsigned int ai_index1 = ai_mesh.mFaces[i_face].mIndices[i_fan + 1];
                 const unsigned int ai_index2 = ai_mesh.mFaces[i_face].mIndices[i_fan + 2];
 
-                rcindices[index_buffer_offset + 0] = static_cast<uint16_t>(ai_index0);
-                rcindices[index_buffer_offset + 1] = static_cast<uint16_t>(ai_index1);
-                rcindices[index_buffer_offset + 2] = static_cast<uint16_t>(ai_index2);
+                WriteIndex(&rcindices, index_buffer_offset + 0, ai_index0, geometry_info.m_index_stride_in_words);
+                WriteIndex(&rcindices, index_buffer_offset + 1, ai_index1, geometry_info.m_index_stride_in_words);
+                WriteIndex(&rcindices, index_buffer_offset + 2, ai_index2, geometry_info.m_index_stride_in_words);
 
                 index_buffer_offset += 3;
-
-                assert(ai_index0 < std::numeric_limits<VertexIndexT>::max());
-                assert(ai_index1 < std::numeric_limits<VertexIndexT>::max());
-                assert(ai_index2 < std::numeric_limits<VertexIndexT>::max());
             }
         }
     }
 
     // write the aiScene's positions and indices into given positions and indices spans based on the given geometry_info
-    void
+    // remap_table is only used as a scratch space, it can be reused across calls but not shared across threads
+    // returns the texcoord range the geometry table needs to decode the compact vertices, the range of the geometry's
+    // own vertices
+    AiGeometryQuantization
     write_geometry_info(std::span<float3> *        positions,
                         std::span<CompactVertex> * compact_vertices,
                         std::span<VertexIndexT> *  indices,
+                        AiVertexRemapTable *       remap_table,
                         const AiGeometryInfo &     geometry_info) const
     {
+        AiGeometryQuantization quantization;
         if (geometry_info.m_is_indices_reorder_needed)
         {
-            write_geometry_info_reordered(positions, compact_vertices, indices, geometry_info);
+            write_geometry_info_reordered(positions, compact_vertices, indices, remap_table, &quantization, geometry_info);
         }
         else
         {
-            write_geometry_info_simple(positions, compact_vertices, indices, geometry_info);
+            write_geometry_info_simple(positions, compact_vertices, indices, &quantization, geometry_info);
         }
+        return quantization;
     }
 };
@@ -0,0 +1,324 @@
+#pragma once
+
+#include "core/hash.h"
+#include "core/logger.h"
+#include "core/mapped_file.h"
+#include "core/vmath.h"
+#include "pch/pch.h"
+#include "shaders/shared/compact_vertex.h"
+#include "shaders/shared/standard_emission.h"
+#include "shaders/shared/standard_material.h"
+#include "shaders/shared/types.h"
+
+#include <fstream>
+
+// .mortarscene is a binary dump of everything SceneResource::add_geometries produces from a source scene file.
+// The file is a header followed by sections, each section is a tightly packed array of POD.
+//
+// All indices stored in the cache are local to the scene:
+// - vertex / index base indices are relative to the scene's first vertex / index,
+// - material index is assimp's material index,
+// - texture ids inside materials / emissions are indices into the Textures section.
+
+enum class SceneCacheSection : uint32_t
+{
+    Dependencies = 0,
+    Positions,
+    CompactVertices,
+    Indices,
+    Geometries,
+    Materials,
+    Emissions,
+    Textures,
+    Strings,
+    TexturePayloads,
+    Count
+};
+
+struct SceneCacheSectionEntry
+{
+    uint64_t m_offset_in_bytes = 0;
+    uint64_t m_size_in_bytes   = 0;
+};
+
+struct SceneCacheHeader
+{
+    static constexpr uint64_t Magic = 0x454E435354524F4Dull; // "MORTSCNE"
+    // bump the version whenever the layout of anything written into the cache changes
+    static constexpr uint32_t Version = 4;
+
+    uint64_t m_magic   = Magic;
+    uint32_t m_version = Version;
+    // catch layout changes that come from compile-time settings rather than code changes
+    uint32_t m_sizeof_position       = sizeof(float3);
+    uint32_t m_sizeof_compact_vertex = sizeof(CompactVertex);
+    uint32_t m_sizeof_vertex_index   = sizeof(VertexIndexT);
+    uint32_t m_sizeof_material       = sizeof(StandardMaterial);
+    uint32_t m_sizeof_emission       = sizeof(StandardEmission);
+    std::array<SceneCacheSectionEntry, static_cast<size_t>(SceneCacheSection::Count)> m_sections = {};
+
+    bool
+    is_compatible() const
+    {
+        return m_magic == Magic && m_version == Version && m_sizeof_position == sizeof(float3) &&
+               m_sizeof_compact_vertex == sizeof(CompactVertex) && m_sizeof_vertex_index == sizeof(VertexIndexT) &&
+               m_sizeof_material == sizeof(StandardMaterial) && m_sizeof_emission == sizeof(StandardEmission);
+    }
+};
+
+// a source file (.obj, .mtl, textures) the cache was generated from
+struct SceneCacheDependency
+{
+    uint64_t m_path_offset = 0;
+    uint64_t m_path_length = 0;
+    uint64_t m_content_hash = 0;
+};
+
+struct SceneCacheGeometry
+{
+    uint32_t m_vbuf_base_index       = 0;
+    uint32_t m_ibuf_base_index       = 0;
+    uint32_t m_num_vertices          = 0;
+    uint32_t m_num_indices           = 0;
+    uint32_t m_src_material_index    = 0;
+    uint32_t m_is_emissive           = 0;
+    uint32_t m_index_stride_in_words = 1;
+    float2   m_texcoord_offset       = float2(0.0f);
+    float2   m_texcoord_scale        = float2(0.0f);
+};
+
+// baked texture, the payload is every mip level laid out as in TextureImage (no row pitch alignment)
+struct SceneCacheTexture
+{
+    uint64_t m_path_offset    = 0;
+    uint64_t m_path_length    = 0;
+    uint64_t m_payload_offset = 0;
+    uint64_t m_payload_size   = 0;
+    uint32_t m_width          = 0;
+    uint32_t m_height         = 0;
+    uint32_t m_format         = 0;
+    uint32_t m_num_levels     = 0;
+};
+
+struct SceneCache
+{
+    static constexpr size_t SectionAlignment = 16;
+
+    static std::filesystem::path
+    GetCachePath(const std::filesystem::path & cache_dir, const std::filesystem::path & src_path)
+    {
+        // different source files with the same name must not share a cache
+        Hash64 path_hash;
+        path_hash.add(std::filesystem::absolute(src_path).lexically_normal().string());
+        return cache_dir / (src_path.stem().string() + "_" + path_hash.to_hex_string() + ".mortarscene");
+    }
+};
+
+// builds every section in memory then writes the cache file at once
+struct SceneCacheWriter
+{
+    std::vector<SceneCacheDependency> m_dependencies;
+    std::vector<float3>               m_positions;
+    std::vector<CompactVertex>        m_compact_vertices;
+    std::vector<VertexIndexT>         m_indices;
+    std::vector<SceneCacheGeometry>   m_geometries;
+    std::vector<StandardMaterial>     m_materials;
+    std::vector<StandardEmission>     m_emissions;
+    std::vector<SceneCacheTexture>    m_textures;
+    std::vector<char>                 m_strings;
+    std::vector<std::byte>            m_texture_payloads;
+
+    // return false if dependency cannot be read, a cache without all dependencies can never be validated
+    bool
+    add_dependency(const std::filesystem::path & path)
+    {
+        const std::optional<uint64_t> hash = Hash64::File(path);
+        if (!hash.has_value())
+        {
+            return false;
+        }
+        SceneCacheDependency dependency;
+        std::tie(dependency.m_path_offset, dependency.m_path_length) = add_string(path.string());
+        dependency.m_content_hash                                    = hash.value();
+        m_dependencies.push_back(dependency);
+        return true;
+    }
+
+    void
+    add_texture(const std::filesystem::path &    path,
+                const uint32_t                   width,
+                const uint32_t                   height,
+                const uint32_t                   format,
+                const uint32_t                   num_levels,
+                const std::span<const std::byte> payload)
+    {
+        SceneCacheTexture texture;
+        std::tie(texture.m_path_offset, texture.m_path_length) = add_string(path.string());
+        texture.m_payload_offset = m_texture_payloads.size();
+        texture.m_payload_size   = payload.size();
+        texture.m_width          = width;
+        texture.m_height         = height;
+        texture.m_format         = format;
+        texture.m_num_levels     = num_levels;
+        m_texture_payloads.insert(m_texture_payloads.end(), payload.begin(), payload.end());
+        m_textures.push_back(texture);
+    }
+
+    // write into a temporary file then rename, so a crash never leaves a half written cache behind
+    bool
+    write(const std::filesystem::path & path) const
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+
+        SceneCacheHeader header;
+        uint64_t         offset = round_up(sizeof(SceneCacheHeader), SectionAlignment);
+        auto             place  = [&](const SceneCacheSection section, const size_t size_in_bytes)
+        {
+            header.m_sections[static_cast<size_t>(section)].m_offset_in_bytes = offset;
+            header.m_sections[static_cast<size_t>(section)].m_size_in_bytes   = size_in_bytes;
+            offset = round_up(offset + size_in_bytes, SectionAlignment);
+        };
+        place(SceneCacheSection::Dependencies, get_size_in_bytes(m_dependencies));
+        place(SceneCacheSection::Positions, get_size_in_bytes(m_positions));
+        place(SceneCacheSection::CompactVertices, get_size_in_bytes(m_compact_vertices));
+        place(SceneCacheSection::Indices, get_size_in_bytes(m_indices));
+        place(SceneCacheSection::Geometries, get_size_in_bytes(m_geometries));
+        place(SceneCacheSection::Materials, get_size_in_bytes(m_materials));
+        place(SceneCacheSection::Emissions, get_size_in_bytes(m_emissions));
+        place(SceneCacheSection::Textures, get_size_in_bytes(m_textures));
+        place(SceneCacheSection::Strings, get_size_in_bytes(m_strings));
+        place(SceneCacheSection::TexturePayloads, get_size_in_bytes(m_texture_payloads));
+
+        const std::filesystem::path tmp_path = path.string() + ".tmp";
+        {
+            std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!ofs.is_open())
+            {
+                Logger::Warn(__FUNCTION__, " cannot open ", tmp_path.string(), " for writing");
+                return false;
+            }
+
+            auto write_section = [&](const SceneCacheSection section, const void * data)
+            {
+                const SceneCacheSectionEntry & entry = header.m_sections[static_cast<size_t>(section)];
+                ofs.seekp(static_cast<std::streamoff>(entry.m_offset_in_bytes));
+                ofs.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(entry.m_size_in_bytes));
+            };
+            ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            write_section(SceneCacheSection::Dependencies, m_dependencies.data());
+            write_section(SceneCacheSection::Positions, m_positions.data());
+            write_section(SceneCacheSection::CompactVertices, m_compact_vertices.data());
+            write_section(SceneCacheSection::Indices, m_indices.data());
+            write_section(SceneCacheSection::Geometries, m_geometries.data());
+            write_section(SceneCacheSection::Materials, m_materials.data());
+            write_section(SceneCacheSection::Emissions, m_emissions.data());
+            write_section(SceneCacheSection::Textures, m_textures.data());
+            write_section(SceneCacheSection::Strings, m_strings.data());
+            write_section(SceneCacheSection::TexturePayloads, m_texture_payloads.data());
+            if (!ofs.good())
+            {
+                Logger::Warn(__FUNCTION__, " failed writing ", tmp_path.string());
+                ofs.close();
+                std::filesystem::remove(tmp_path, ec);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tmp_path, path, ec);
+        if (ec)
+        {
+            Logger::Warn(__FUNCTION__, " cannot rename ", tmp_path.string(), " to ", path.string(), " : ", ec.message());
+            std::filesystem::remove(tmp_path, ec);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::pair<uint64_t, uint64_t>
+    add_string(const std::string & str)
+    {
+        const uint64_t offset = m_strings.size();
+        m_strings.insert(m_strings.end(), str.begin(), str.end());
+        return { offset, str.size() };
+    }
+
+    template <typename T>
+    static size_t
+    get_size_in_bytes(const std::vector<T> & vec)
+    {
+        return vec.size() * sizeof(T);
+    }
+};
+
+// memory maps a cache file and hands out views into it
+// views are only valid as long as the reader is alive
+struct SceneCacheReader
+{
+    MappedFile               m_file;
+    const SceneCacheHeader * m_header = nullptr;
+
+    // return false if the file does not exist, is truncated or was written by an incompatible build
+    bool
+    open(const std::filesystem::path & path)
+    {
+        if (!m_file.open(path) || m_file.size() < sizeof(SceneCacheHeader))
+        {
+            return false;
+        }
+
+        m_header = reinterpret_cast<const SceneCacheHeader *>(m_file.data());
+        if (!m_header->is_compatible())
+        {
+            return false;
+        }
+
+        for (const SceneCacheSectionEntry & entry : m_header->m_sections)
+        {
+            if (entry.m_offset_in_bytes + entry.m_size_in_bytes > m_file.size())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // check that every source file is unchanged since the cache was written
+    bool
+    is_up_to_date() const
+    {
+        for (const SceneCacheDependency & dependency : get_section<SceneCacheDependency>(SceneCacheSection::Dependencies))
+        {
+            const std::optional<uint64_t> hash = Hash64::File(get_string(dependency.m_path_offset, dependency.m_path_length));
+            if (!hash.has_value() || hash.value() != dependency.m_content_hash)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename T>
+    std::span<const T>
+    get_section(const SceneCacheSection section) const
+    {
+        const SceneCacheSectionEntry & entry = m_header->m_sections[static_cast<size_t>(section)];
+        return std::span<const T>(reinterpret_cast<const T *>(m_file.data() + entry.m_offset_in_bytes),
+                                  entry.m_size_in_bytes / sizeof(T));
+    }
+
+    std::string_view
+    get_string(const uint64_t offset, const uint64_t length) const
+    {
+        const std::span<const char> strings = get_section<char>(SceneCacheSection::Strings);
+        return std::string_view(strings.data() + offset, length);
+    }
+
+    std::span<const std::byte>
+    get_texture_payload(const SceneCacheTexture & texture) const
+    {
+        const std::span<const std::byte> payloads = get_section<std::byte>(SceneCacheSection::TexturePayloads);
+        return payloads.subspan(texture.m_payload_offset, texture.m_payload_size);
+    }
+};
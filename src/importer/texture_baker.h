@@ -0,0 +1,679 @@
+#pragma once
+
+#include "core/hash.h"
+#include "core/logger.h"
+#include "core/mapped_file.h"
+#include "core/stopwatch.h"
+#include "core/thread_pool.h"
+#include "core/vmath.h"
+#include "engine_setting.h"
+#include "pch/pch.h"
+#include "rhi/common/rhi_enums.h"
+
+#include <fstream>
+
+// one mip level inside TextureImage::m_pixels
+struct TextureImageLevel
+{
+    int2   m_resolution        = int2(0, 0);
+    size_t m_offset_in_bytes   = 0;
+    // one row of pixels, or one row of 4x4 blocks for block compressed formats
+    size_t m_row_size_in_bytes = 0;
+    size_t m_num_rows          = 0;
+    size_t m_size_in_bytes     = 0;
+};
+
+// texture in host memory with its whole mip chain
+// levels are stored from the largest to the smallest one, rows are tightly packed
+struct TextureImage
+{
+    int2                   m_resolution = int2(0, 0);
+    Rhi::FormatEnum        m_format     = Rhi::FormatEnum::R8G8B8A8_UNorm_Srgb;
+    uint32_t               m_num_levels = 1;
+    std::vector<std::byte> m_pixels;
+
+    static uint32_t
+    GetNumMipLevels(const int2 resolution)
+    {
+        uint32_t num_levels = 1;
+        int      size       = std::max(resolution.x, resolution.y);
+        while (size > 1)
+        {
+            size /= 2;
+            num_levels++;
+        }
+        return num_levels;
+    }
+
+    static std::vector<TextureImageLevel>
+    GetLevels(const int2 resolution, const Rhi::FormatEnum format, const uint32_t num_levels)
+    {
+        std::vector<TextureImageLevel> levels(num_levels);
+        size_t                         offset_in_bytes = 0;
+        for (uint32_t i_level = 0; i_level < num_levels; i_level++)
+        {
+            TextureImageLevel & level = levels[i_level];
+            level.m_resolution        = int2(std::max(resolution.x >> i_level, 1), std::max(resolution.y >> i_level, 1));
+            level.m_offset_in_bytes   = offset_in_bytes;
+            if (EnumHelper::IsBlockCompressed(format))
+            {
+                level.m_row_size_in_bytes = div_ceil(level.m_resolution.x, 4) * EnumHelper::GetSizeInBytesPerBlock(format);
+                level.m_num_rows          = div_ceil(level.m_resolution.y, 4);
+            }
+            else
+            {
+                level.m_row_size_in_bytes = level.m_resolution.x * EnumHelper::GetSizeInBytesPerPixel(format);
+                level.m_num_rows          = level.m_resolution.y;
+            }
+            level.m_size_in_bytes = level.m_row_size_in_bytes * level.m_num_rows;
+            offset_in_bytes += level.m_size_in_bytes;
+        }
+        return levels;
+    }
+
+    std::vector<TextureImageLevel>
+    get_levels() const
+    {
+        return GetLevels(m_resolution, m_format, m_num_levels);
+    }
+
+    // texels of the whole mip chain, whatever the format
+    size_t
+    get_num_texels() const
+    {
+        size_t num_texels = 0;
+        for (const TextureImageLevel & level : get_levels())
+        {
+            num_texels += static_cast<size_t>(level.m_resolution.x) * static_cast<size_t>(level.m_resolution.y);
+        }
+        return num_texels;
+    }
+};
+
+// turns a source image (.png, .jpg, ...) into an upload ready TextureImage:
+// decode, generate the full mip chain and block compress it if possible.
+// results are cached on disk (EngineSetting::TextureCachePath) keyed by the source content, so each texture is
+// baked only once.
+//
+// compression:
+// - 1 channel                        -> BC4
+// - 4 channels without any alpha     -> BC1 (sRGB)
+// - 4 channels with alpha            -> stays R8G8B8A8 (there is no BC7 encoder yet)
+// - level 0 not a multiple of 4      -> stays uncompressed, d3d12 rejects such block compressed textures
+//
+// an image stb_image cannot decode is replaced by a small magenta (or white, single channel) fallback image.
+struct TextureBaker
+{
+    struct Header
+    {
+        static constexpr uint64_t Magic = 0x58455454524F4Dull; // "MORTTEX"
+        // bump the version whenever the baking output changes
+        static constexpr uint32_t Version = 2;
+
+        uint64_t m_magic         = Magic;
+        uint32_t m_version       = Version;
+        uint32_t m_width         = 0;
+        uint32_t m_height        = 0;
+        uint32_t m_format        = 0;
+        uint32_t m_num_levels    = 0;
+        uint32_t m_padding       = 0;
+        uint64_t m_size_in_bytes = 0;
+    };
+
+    // desired_channel is 1 (single channel, linear) or 3 / 4 (sRGB color)
+    static TextureImage
+    Bake(const std::filesystem::path & src_path, const size_t desired_channel)
+    {
+        const size_t num_channels           = desired_channel == 1 ? 1 : 4;
+        const bool   is_compression_enabled = EngineSetting::EnableTextureCompression;
+
+        // baked result only depends on the source content and the baking settings
+        const std::optional<uint64_t> content_hash = Hash64::File(src_path);
+        std::filesystem::path         cache_path;
+        if (content_hash.has_value())
+        {
+            Hash64 key;
+            key.add_pod(content_hash.value());
+            key.add_pod(num_channels);
+            key.add_pod(Header::Version);
+            key.add_pod(is_compression_enabled);
+            cache_path = EngineSetting::TextureCachePath() / (src_path.stem().string() + "_" + key.to_hex_string() + ".mortartex");
+
+            std::optional<TextureImage> cached = ReadCache(cache_path);
+            if (cached.has_value())
+            {
+                return std::move(cached.value());
+            }
+        }
+
+        std::optional<TextureImage> decoded = Decode(src_path, num_channels);
+        if (!decoded.has_value())
+        {
+            // not cached, so a fixed source is picked up next time
+            Logger::Warn(__FUNCTION__,
+                         " cannot decode ",
+                         src_path.string(),
+                         " : ",
+                         stbi_failure_reason(),
+                         ", using a fallback");
+            return ConstructFallbackImage(num_channels);
+        }
+
+        TextureImage image = std::move(decoded.value());
+        GenerateMipChain(&image);
+
+        if (is_compression_enabled)
+        {
+            StopWatch    stop_watch;
+            const size_t num_texels = image.get_num_texels();
+            if (Compress(&image))
+            {
+                const float time_in_sec = std::max(static_cast<float>(stop_watch.time_micro_sec()), 1.0f) / 1000000.0f;
+                Logger::Info(__FUNCTION__,
+                             " encoded ",
+                             src_path.string(),
+                             " (",
+                             image.m_resolution.x,
+                             "x",
+                             image.m_resolution.y,
+                             ", ",
+                             image.m_num_levels,
+                             " levels) at ",
+                             static_cast<float>(num_texels) / 1000000.0f / time_in_sec,
+                             " MTexel/s over the mip chain");
+            }
+        }
+
+        if (!cache_path.empty())
+        {
+            WriteCache(cache_path, image);
+        }
+        return image;
+    }
+
+    // stbi's vertical flip flag is global, it is set once by SceneResource
+    static std::optional<TextureImage>
+    Decode(const std::filesystem::path & path, const size_t num_channels)
+    {
+        const std::string filepath_str = path.string();
+
+        // Load Raw image
+        int2   resolution;
+        void * image =
+            stbi_load(filepath_str.c_str(), &resolution.x, &resolution.y, nullptr, static_cast<int>(num_channels));
+        if (image == nullptr)
+        {
+            return std::nullopt;
+        }
+        const std::byte * image_bytes = reinterpret_cast<const std::byte *>(image);
+
+        TextureImage result;
+        result.m_resolution = resolution;
+        result.m_format     = num_channels == 4 ? Rhi::FormatEnum::R8G8B8A8_UNorm_Srgb : Rhi::FormatEnum::R8_UNorm;
+        result.m_pixels.assign(image_bytes,
+                               image_bytes + static_cast<size_t>(resolution.x) * static_cast<size_t>(resolution.y) *
+                                                 num_channels);
+
+        // Free raw image
+        stbi_image_free(image);
+        return result;
+    }
+
+    // 4x4 so it is block aligned, with its mip chain so it looks like any other baked texture
+    static TextureImage
+    ConstructFallbackImage(const size_t num_channels)
+    {
+        const std::array<std::byte, 4> color = { std::byte(255), std::byte(0), std::byte(255), std::byte(255) };
+
+        TextureImage image;
+        image.m_resolution = int2(4, 4);
+        image.m_format     = num_channels == 4 ? Rhi::FormatEnum::R8G8B8A8_UNorm_Srgb : Rhi::FormatEnum::R8_UNorm;
+        image.m_pixels.resize(16 * num_channels);
+        for (size_t i_texel = 0; i_texel < 16; i_texel++)
+        {
+            for (size_t c = 0; c < num_channels; c++)
+            {
+                image.m_pixels[i_texel * num_channels + c] = num_channels == 4 ? color[c] : std::byte(255);
+            }
+        }
+        GenerateMipChain(&image);
+        return image;
+    }
+
+    // append every mip level below level 0 with a 2x2 box filter
+    // sRGB color channels are filtered in linear space, alpha and R8 are filtered as they are
+    static void
+    GenerateMipChain(TextureImage * image)
+    {
+        assert(image->m_num_levels == 1);
+        const bool   is_srgb      = image->m_format == Rhi::FormatEnum::R8G8B8A8_UNorm_Srgb;
+        const size_t num_channels = EnumHelper::GetSizeInBytesPerPixel(image->m_format);
+
+        image->m_num_levels                         = TextureImage::GetNumMipLevels(image->m_resolution);
+        const std::vector<TextureImageLevel> levels = image->get_levels();
+        image->m_pixels.resize(levels.back().m_offset_in_bytes + levels.back().m_size_in_bytes);
+
+        const std::array<float, 256> &   srgb_to_linear = GetSrgbToLinearTable();
+        const std::array<uint8_t, 4096> & linear_to_srgb = GetLinearToSrgbTable();
+
+        for (size_t i_level = 1; i_level < levels.size(); i_level++)
+        {
+            const TextureImageLevel & src_level = levels[i_level - 1];
+            const TextureImageLevel & dst_level = levels[i_level];
+            const uint8_t *           src = reinterpret_cast<const uint8_t *>(&image->m_pixels[src_level.m_offset_in_bytes]);
+            uint8_t * dst = reinterpret_cast<uint8_t *>(&image->m_pixels[dst_level.m_offset_in_bytes]);
+
+            ThreadPool::Get().parallel_for(
+                0,
+                static_cast<size_t>(dst_level.m_resolution.y),
+                [&](const size_t y)
+                {
+                    // odd sizes clamp the footprint at the border
+                    const size_t    src_y0 = std::min(y * 2, static_cast<size_t>(src_level.m_resolution.y - 1));
+                    const size_t    src_y1 = std::min(y * 2 + 1, static_cast<size_t>(src_level.m_resolution.y - 1));
+                    const uint8_t * row0   = src + src_y0 * src_level.m_row_size_in_bytes;
+                    const uint8_t * row1   = src + src_y1 * src_level.m_row_size_in_bytes;
+                    uint8_t *       dst_row = dst + y * dst_level.m_row_size_in_bytes;
+                    for (size_t x = 0; x < static_cast<size_t>(dst_level.m_resolution.x); x++)
+                    {
+                        const size_t src_x0 = std::min(x * 2, static_cast<size_t>(src_level.m_resolution.x - 1));
+                        const size_t src_x1 = std::min(x * 2 + 1, static_cast<size_t>(src_level.m_resolution.x - 1));
+                        for (size_t c = 0; c < num_channels; c++)
+                        {
+                            const uint8_t v00 = row0[src_x0 * num_channels + c];
+                            const uint8_t v01 = row0[src_x1 * num_channels + c];
+                            const uint8_t v10 = row1[src_x0 * num_channels + c];
+                            const uint8_t v11 = row1[src_x1 * num_channels + c];
+                            if (is_srgb && c < 3)
+                            {
+                                const float linear = (srgb_to_linear[v00] + srgb_to_linear[v01] + srgb_to_linear[v10] +
+                                                      srgb_to_linear[v11]) *
+                                                     0.25f;
+                                dst_row[x * num_channels + c] = linear_to_srgb[static_cast<size_t>(linear * 4095.0f + 0.5f)];
+                            }
+                            else
+                            {
+                                dst_row[x * num_channels + c] = static_cast<uint8_t>((v00 + v01 + v10 + v11 + 2) / 4);
+                            }
+                        }
+                    }
+                });
+        }
+    }
+
+    // block compress every level in place, return false if the format has no encoder or level 0 is not made of
+    // whole blocks. padding level 0 instead would move the texels the texture coordinates point at
+    static bool
+    Compress(TextureImage * image)
+    {
+        if (image->m_resolution.x % 4 != 0 || image->m_resolution.y % 4 != 0)
+        {
+            return false;
+        }
+
+        Rhi::FormatEnum dst_format;
+        if (image->m_format == Rhi::FormatEnum::R8_UNorm)
+        {
+            dst_format = Rhi::FormatEnum::BC4_UNorm;
+        }
+        else if (image->m_format == Rhi::FormatEnum::R8G8B8A8_UNorm_Srgb && IsOpaque(*image))
+        {
+            dst_format = Rhi::FormatEnum::BC1_UNorm_Srgb;
+        }
+        else
+        {
+            return false;
+        }
+
+        const size_t                         num_channels = EnumHelper::GetSizeInBytesPerPixel(image->m_format);
+        const std::vector<TextureImageLevel> src_levels   = image->get_levels();
+        const std::vector<TextureImageLevel> dst_levels =
+            TextureImage::GetLevels(image->m_resolution, dst_format, image->m_num_levels);
+        const size_t block_size_in_bytes = EnumHelper::GetSizeInBytesPerBlock(dst_format);
+
+        std::vector<std::byte> dst_pixels(dst_levels.back().m_offset_in_bytes + dst_levels.back().m_size_in_bytes);
+        for (size_t i_level = 0; i_level < src_levels.size(); i_level++)
+        {
+            const TextureImageLevel & src_level = src_levels[i_level];
+            const TextureImageLevel & dst_level = dst_levels[i_level];
+            const uint8_t * src = reinterpret_cast<const uint8_t *>(&image->m_pixels[src_level.m_offset_in_bytes]);
+            std::byte *     dst = &dst_pixels[dst_level.m_offset_in_bytes];
+
+            // one job per row of blocks
+            ThreadPool::Get().parallel_for(
+                0,
+                dst_level.m_num_rows,
+                [&](const size_t block_y)
+                {
+                    const size_t num_blocks_x = dst_level.m_row_size_in_bytes / block_size_in_bytes;
+                    for (size_t block_x = 0; block_x < num_blocks_x; block_x++)
+                    {
+                        // gather 4x4 texels, texels outside of the image repeat the border
+                        std::array<std::array<uint8_t, 4>, 16> texels;
+                        for (size_t i_texel = 0; i_texel < 16; i_texel++)
+                        {
+                            const size_t x = std::min(block_x * 4 + i_texel % 4,
+                                                      static_cast<size_t>(src_level.m_resolution.x - 1));
+                            const size_t y = std::min(block_y * 4 + i_texel / 4,
+                                                      static_cast<size_t>(src_level.m_resolution.y - 1));
+                            for (size_t c = 0; c < num_channels; c++)
+                            {
+                                texels[i_texel][c] = src[y * src_level.m_row_size_in_bytes + x * num_channels + c];
+                            }
+                        }
+
+                        std::byte * dst_block =
+                            dst + block_y * dst_level.m_row_size_in_bytes + block_x * block_size_in_bytes;
+                        if (dst_format == Rhi::FormatEnum::BC4_UNorm)
+                        {
+                            EncodeBc4Block(texels, dst_block);
+                        }
+                        else
+                        {
+                            EncodeBc1Block(texels, dst_block);
+                        }
+                    }
+                });
+        }
+
+        image->m_format = dst_format;
+        image->m_pixels = std::move(dst_pixels);
+        return true;
+    }
+
+    static bool
+    IsOpaque(const TextureImage & image)
+    {
+        const TextureImageLevel level0 = image.get_levels()[0];
+        for (size_t i = 3; i < level0.m_size_in_bytes; i += 4)
+        {
+            if (image.m_pixels[i] != std::byte(255))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // bounding box encoder: endpoints are the (inset) corners of the color bounding box along the diagonal
+    // which best follows the block's colors, every texel then picks the closest of the 4 palette colors
+    static void
+    EncodeBc1Block(const std::array<std::array<uint8_t, 4>, 16> & texels, std::byte * dst)
+    {
+        int3 min_color = int3(255, 255, 255);
+        int3 max_color = int3(0, 0, 0);
+        int3 sum_color = int3(0, 0, 0);
+        for (const std::array<uint8_t, 4> & texel : texels)
+        {
+            const int3 color = int3(texel[0], texel[1], texel[2]);
+            min_color        = min(min_color, color);
+            max_color        = max(max_color, color);
+            sum_color += color;
+        }
+
+        // flip red / blue of the diagonal if they are anti-correlated with green
+        int cov_rg = 0;
+        int cov_bg = 0;
+        for (const std::array<uint8_t, 4> & texel : texels)
+        {
+            const int3 d = int3(texel[0], texel[1], texel[2]) * 16 - sum_color;
+            cov_rg += d.x * d.y;
+            cov_bg += d.z * d.y;
+        }
+        if (cov_rg < 0)
+        {
+            std::swap(min_color.x, max_color.x);
+        }
+        if (cov_bg < 0)
+        {
+            std::swap(min_color.z, max_color.z);
+        }
+
+        // inset the bounding box, so the endpoints are not pulled by outliers
+        const int3 inset = (max_color - min_color) / 16;
+        max_color -= inset;
+        min_color += inset;
+
+        uint16_t color0 = EncodeRgb565(max_color);
+        uint16_t color1 = EncodeRgb565(min_color);
+        if (color0 < color1)
+        {
+            std::swap(color0, color1);
+        }
+
+        // color0 > color1 selects the 4 colors mode, color0 == color1 is a solid block
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            const int3                c0      = DecodeRgb565(color0);
+            const int3                c1      = DecodeRgb565(color1);
+            const std::array<int3, 4> palette = { c0, c1, (c0 * 2 + c1) / 3, (c0 + c1 * 2) / 3 };
+            for (size_t i_texel = 0; i_texel < 16; i_texel++)
+            {
+                const int3 color     = int3(texels[i_texel][0], texels[i_texel][1], texels[i_texel][2]);
+                uint32_t   best      = 0;
+                int        best_dist = std::numeric_limits<int>::max();
+                for (uint32_t i_palette = 0; i_palette < 4; i_palette++)
+                {
+                    const int3 d    = color - palette[i_palette];
+                    const int  dist = d.x * d.x + d.y * d.y + d.z * d.z;
+                    if (dist < best_dist)
+                    {
+                        best      = i_palette;
+                        best_dist = dist;
+                    }
+                }
+                indices |= best << (i_texel * 2);
+            }
+        }
+
+        std::memcpy(dst, &color0, sizeof(uint16_t));
+        std::memcpy(dst + 2, &color1, sizeof(uint16_t));
+        std::memcpy(dst + 4, &indices, sizeof(uint32_t));
+    }
+
+    // endpoints are min / max of the block in the 8 values mode
+    static void
+    EncodeBc4Block(const std::array<std::array<uint8_t, 4>, 16> & texels, std::byte * dst)
+    {
+        int min_value = 255;
+        int max_value = 0;
+        for (const std::array<uint8_t, 4> & texel : texels)
+        {
+            min_value = std::min(min_value, static_cast<int>(texel[0]));
+            max_value = std::max(max_value, static_cast<int>(texel[0]));
+        }
+
+        // value0 > value1 selects the 8 values mode
+        uint64_t indices = 0;
+        if (max_value != min_value)
+        {
+            std::array<int, 8> palette;
+            palette[0] = max_value;
+            palette[1] = min_value;
+            for (int i = 2; i < 8; i++)
+            {
+                palette[i] = ((8 - i) * max_value + (i - 1) * min_value) / 7;
+            }
+            for (size_t i_texel = 0; i_texel < 16; i_texel++)
+            {
+                uint64_t best      = 0;
+                int      best_dist = std::numeric_limits<int>::max();
+                for (uint64_t i_palette = 0; i_palette < 8; i_palette++)
+                {
+                    const int dist = std::abs(static_cast<int>(texels[i_texel][0]) - palette[i_palette]);
+                    if (dist < best_dist)
+                    {
+                        best      = i_palette;
+                        best_dist = dist;
+                    }
+                }
+                indices |= best << (i_texel * 3);
+            }
+        }
+
+        dst[0] = static_cast<std::byte>(max_value);
+        dst[1] = static_cast<std::byte>(min_value);
+        std::memcpy(dst + 2, &indices, 6);
+    }
+
+    // inverse of EncodeBc1Block in the 4 colors mode, a solid block decodes to color0
+    static void
+    DecodeBc1Block(const std::byte * src, std::array<std::array<uint8_t, 4>, 16> * texels)
+    {
+        uint16_t color0;
+        uint16_t color1;
+        uint32_t indices;
+        std::memcpy(&color0, src, sizeof(uint16_t));
+        std::memcpy(&color1, src + 2, sizeof(uint16_t));
+        std::memcpy(&indices, src + 4, sizeof(uint32_t));
+
+        const int3                c0      = DecodeRgb565(color0);
+        const int3                c1      = DecodeRgb565(color1);
+        const std::array<int3, 4> palette = { c0, c1, (c0 * 2 + c1) / 3, (c0 + c1 * 2) / 3 };
+        for (size_t i_texel = 0; i_texel < 16; i_texel++)
+        {
+            const int3 color      = palette[(indices >> (i_texel * 2)) & 3];
+            (*texels)[i_texel][0] = static_cast<uint8_t>(color.x);
+            (*texels)[i_texel][1] = static_cast<uint8_t>(color.y);
+            (*texels)[i_texel][2] = static_cast<uint8_t>(color.z);
+            (*texels)[i_texel][3] = 255;
+        }
+    }
+
+    // inverse of EncodeBc4Block in the 8 values mode, a solid block decodes to value0
+    static void
+    DecodeBc4Block(const std::byte * src, std::array<std::array<uint8_t, 4>, 16> * texels)
+    {
+        const int max_value = static_cast<int>(src[0]);
+        const int min_value = static_cast<int>(src[1]);
+        uint64_t  indices   = 0;
+        std::memcpy(&indices, src + 2, 6);
+
+        std::array<int, 8> palette;
+        palette[0] = max_value;
+        palette[1] = min_value;
+        for (int i = 2; i < 8; i++)
+        {
+            palette[i] = ((8 - i) * max_value + (i - 1) * min_value) / 7;
+        }
+        for (size_t i_texel = 0; i_texel < 16; i_texel++)
+        {
+            (*texels)[i_texel][0] = static_cast<uint8_t>(palette[(indices >> (i_texel * 3)) & 7]);
+        }
+    }
+
+private:
+    static uint16_t
+    EncodeRgb565(const int3 & color)
+    {
+        const uint16_t r = static_cast<uint16_t>((color.x * 31 + 127) / 255);
+        const uint16_t g = static_cast<uint16_t>((color.y * 63 + 127) / 255);
+        const uint16_t b = static_cast<uint16_t>((color.z * 31 + 127) / 255);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    static int3
+    DecodeRgb565(const uint16_t color)
+    {
+        const int r = (color >> 11) & 31;
+        const int g = (color >> 5) & 63;
+        const int b = color & 31;
+        return int3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+    }
+
+    static const std::array<float, 256> &
+    GetSrgbToLinearTable()
+    {
+        static const std::array<float, 256> table = []()
+        {
+            std::array<float, 256> result;
+            for (size_t i = 0; i < 256; i++)
+            {
+                const float v = static_cast<float>(i) / 255.0f;
+                result[i]     = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+            }
+            return result;
+        }();
+        return table;
+    }
+
+    static const std::array<uint8_t, 4096> &
+    GetLinearToSrgbTable()
+    {
+        static const std::array<uint8_t, 4096> table = []()
+        {
+            std::array<uint8_t, 4096> result;
+            for (size_t i = 0; i < 4096; i++)
+            {
+                const float v    = static_cast<float>(i) / 4095.0f;
+                const float srgb = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+                result[i]        = static_cast<uint8_t>(std::clamp(srgb * 255.0f + 0.5f, 0.0f, 255.0f));
+            }
+            return result;
+        }();
+        return table;
+    }
+
+    static std::optional<TextureImage>
+    ReadCache(const std::filesystem::path & path)
+    {
+        MappedFile file;
+        if (!file.open(path) || file.size() < sizeof(Header))
+        {
+            return std::nullopt;
+        }
+
+        Header header;
+        std::memcpy(&header, file.data(), sizeof(Header));
+        if (header.m_magic != Header::Magic || header.m_version != Header::Version ||
+            header.m_size_in_bytes != file.size() - sizeof(Header))
+        {
+            return std::nullopt;
+        }
+
+        TextureImage result;
+        result.m_resolution = int2(header.m_width, header.m_height);
+        result.m_format     = static_cast<Rhi::FormatEnum>(header.m_format);
+        result.m_num_levels = header.m_num_levels;
+        result.m_pixels.assign(file.data() + sizeof(Header), file.data() + file.size());
+        return result;
+    }
+
+    // write into a temporary file then rename, textures can be baked by several threads at the same time
+    static void
+    WriteCache(const std::filesystem::path & path, const TextureImage & image)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+
+        Header header;
+        header.m_width         = static_cast<uint32_t>(image.m_resolution.x);
+        header.m_height        = static_cast<uint32_t>(image.m_resolution.y);
+        header.m_format        = static_cast<uint32_t>(image.m_format);
+        header.m_num_levels    = image.m_num_levels;
+        header.m_size_in_bytes = image.m_pixels.size();
+
+        const std::filesystem::path tmp_path =
+            path.string() + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+        {
+            std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+            ofs.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+            ofs.write(reinterpret_cast<const char *>(image.m_pixels.data()),
+                      static_cast<std::streamsize>(image.m_pixels.size()));
+            if (!ofs.good())
+            {
+                Logger::Warn(__FUNCTION__, " failed writing ", tmp_path.string());
+                ofs.close();
+                std::filesystem::remove(tmp_path, ec);
+                return;
+            }
+        }
+
+        std::filesystem::rename(tmp_path, path, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tmp_path, ec);
+        }
+    }
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "benchmark_util.h"
+#include "core/logger.h"
+#include "core/thread_pool.h"
+#include "engine_setting.h"
+#include "importer/ai_mesh_importer.h"
+#include "pch/pch.h"
+#include "shaders/shared/bindless_table.h"
+#include "shaders/shared/compact_position.h"
+
+// splitting and writing a synthetic single mesh of about 5M vertices with 16 bit indices only, with 32 bit indices
+// only and with the index format AiIndexPolicy chooses, as SceneResource::add_geometries_from_source does
+struct IndexFormatBenchmark
+{
+    static void
+    Run()
+    {
+        aiScene ai_scene;
+        BenchmarkUtil::ConstructGridScene(&ai_scene, BenchmarkUtil::LargeGridSize);
+        AiScene scene;
+        scene.m_ai_scene = &ai_scene;
+        Logger::Info(__FUNCTION__,
+                     " grid mesh : ",
+                     ai_scene.mMeshes[0]->mNumVertices,
+                     " vertices, ",
+                     ai_scene.mMeshes[0]->mNumFaces,
+                     " triangles");
+
+        AiIndexPolicy index_policy;
+        index_policy.m_max_num_vertices_per_16bit_geometry = std::numeric_limits<VertexIndexT>::max();
+        index_policy.m_vertex_size_in_bytes                = sizeof(CompactPosition) + sizeof(CompactVertex);
+        index_policy.m_geometry_cost_in_bytes              = EngineSetting::GeometryCostInBytes;
+
+        index_policy.m_is_32bit_index_allowed = false;
+        RunPolicy("16 bit only", scene, index_policy);
+
+        // an expensive enough geometry always keeps the mesh whole
+        AiIndexPolicy whole_index_policy            = index_policy;
+        whole_index_policy.m_is_32bit_index_allowed = true;
+        whole_index_policy.m_geometry_cost_in_bytes = std::numeric_limits<uint32_t>::max();
+        RunPolicy("32 bit only", scene, whole_index_policy);
+
+        index_policy.m_is_32bit_index_allowed = true;
+        RunPolicy("chosen", scene, index_policy);
+    }
+
+private:
+    static void
+    RunPolicy(const std::string & name, const AiScene & scene, const AiIndexPolicy & index_policy)
+    {
+        std::vector<AiGeometryInfo> geometry_infos;
+        const float                 split_ms =
+            BenchmarkUtil::MeasureMilliSec([&]() { geometry_infos = scene.get_geometry_infos(index_policy); });
+
+        // laid out as in SceneResource::add_geometries_from_source
+        size_t              num_vertices    = 0;
+        size_t              num_index_words = 0;
+        size_t              num_triangles   = 0;
+        std::vector<size_t> vertices_base_indices(geometry_infos.size());
+        std::vector<size_t> index_words_base_indices(geometry_infos.size());
+        for (size_t i_geometry_info = 0; i_geometry_info < geometry_infos.size(); i_geometry_info++)
+        {
+            vertices_base_indices[i_geometry_info]    = num_vertices;
+            index_words_base_indices[i_geometry_info] = num_index_words;
+            num_vertices += round_up(geometry_infos[i_geometry_info].m_dst_num_vertices, static_cast<size_t>(32));
+            num_index_words += round_up(geometry_infos[i_geometry_info].get_dst_num_index_words(), static_cast<size_t>(32));
+            num_triangles += geometry_infos[i_geometry_info].m_dst_num_indices / 3;
+        }
+        assert(num_triangles == scene.m_ai_scene->mMeshes[0]->mNumFaces);
+
+        std::vector<float3>        positions(num_vertices);
+        std::vector<CompactVertex> compact_vertices(num_vertices);
+        std::vector<VertexIndexT>  index_words(num_index_words);
+        const float                write_ms = BenchmarkUtil::MeasureMilliSec(
+            [&]()
+            {
+                AiVertexRemapTablePool remap_table_pool;
+                ThreadPool::Get().parallel_for(
+                    0,
+                    geometry_infos.size(),
+                    [&](const size_t i_geometry_info)
+                    {
+                        std::unique_ptr<AiVertexRemapTable> remap_table = remap_table_pool.acquire();
+
+                        const AiGeometryInfo &   geometry_info = geometry_infos[i_geometry_info];
+                        std::span<float3>        span_positions(positions.begin() + vertices_base_indices[i_geometry_info],
+                                                         geometry_info.m_dst_num_vertices);
+                        std::span<CompactVertex> span_compact_vertices(compact_vertices.begin() +
+                                                                           vertices_base_indices[i_geometry_info],
+                                                                       geometry_info.m_dst_num_vertices);
+                        std::span<VertexIndexT>  span_index_words(index_words.begin() +
+                                                                     index_words_base_indices[i_geometry_info],
+                                                                 geometry_info.get_dst_num_index_words());
+                        scene.write_geometry_info(&span_positions,
+                                                  &span_compact_vertices,
+                                                  &span_index_words,
+                                                  remap_table.get(),
+                                                  geometry_info);
+                        remap_table_pool.release(std::move(remap_table));
+                    });
+            });
+
+        const size_t num_32bit_geometries =
+            std::count_if(geometry_infos.begin(),
+                          geometry_infos.end(),
+                          [](const AiGeometryInfo & geometry_info) { return geometry_info.m_index_stride_in_words == 2; });
+        const size_t num_bytes = num_vertices * index_policy.m_vertex_size_in_bytes +
+                                 num_index_words * sizeof(VertexIndexT) +
+                                 geometry_infos.size() * sizeof(GeometryTableEntry);
+        Logger::Info(__FUNCTION__,
+                     " ",
+                     name,
+                     " : ",
+                     geometry_infos.size(),
+                     " geometries (",
+                     num_32bit_geometries,
+                     " with 32 bit indices), ",
+                     num_vertices,
+                     " vertices, ",
+                     num_bytes / (1024 * 1024),
+                     " MiB of vertices, indices and geometry table entries, split in ",
+                     split_ms,
+                     " ms, written in ",
+                     write_ms,
+                     " ms");
+    }
+
+};
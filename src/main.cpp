@@ -1,4 +1,16 @@
 #include "mainloop.h"
+#include "bvh/bvh_benchmark.h"
+#include "index_format_benchmark.h"
+#include "pipeline_benchmark.h"
+#include "render/cpu_path_tracer.h"
+#include "render_benchmark.h"
+#include "scene_cache_benchmark.h"
+#include "scene_graph_benchmark.h"
+#include "split_benchmark.h"
+#include "texture_benchmark.h"
+#include "trace_benchmark.h"
+
+#include <charconv>
 
 extern "C"
 {
@@ -10,8 +22,179 @@ extern "C"
     __declspec(dllexport) extern const char * D3D12SDKPath = ".\\D3D12\\";
 }
 
+// render the demo scene on the cpu, no window or device is created
+int
+RunCpuReference()
+{
+    const int2 target_resolution(1920, 1080);
+
+    CpuScene                  scene;
+    const urange32_t          sponza_geometries  = scene.add_geometries("scenes/sponza/sponza.obj");
+    std::array<urange32_t, 1> ranges             = { sponza_geometries };
+    const size_t              sponza_instance_id = scene.add_base_instance(ranges);
+    scene.commit(MainLoop::ConstructDemoSceneDesc(sponza_instance_id));
+
+    // same camera MainLoop starts with
+    FpsCamera camera(float3(10.0f, 10.0f, 10.0f),
+                     float3(0.0f, 0.0f, 0.0f),
+                     float3(0.0f, 1.0f, 0.0f),
+                     radians(60.0f),
+                     static_cast<float>(target_resolution.x) / static_cast<float>(target_resolution.y));
+
+    CpuPathTracer path_tracer(target_resolution);
+    path_tracer.benchmark(scene, camera, 3);
+    CpuPathTracer::WritePfm("cpu_reference_diffuse_gi.pfm", target_resolution, path_tracer.m_demodulated_diffuse_gi);
+    CpuPathTracer::WritePfm("cpu_reference_shading_normal.pfm", target_resolution, path_tracer.m_gbuffer_shading_normal);
+    return 0;
+}
+
+// build and traversal timings of the sponza blas on the cpu
+int
+RunBvhBenchmark()
+{
+    CpuScene                  scene;
+    const urange32_t          sponza_geometries  = scene.add_geometries("scenes/sponza/sponza.obj");
+    std::array<urange32_t, 1> ranges             = { sponza_geometries };
+    const size_t              sponza_instance_id = scene.add_base_instance(ranges);
+    scene.commit(MainLoop::ConstructDemoSceneDesc(sponza_instance_id));
+
+    BvhBenchmark::Run("sponza", scene.m_base_instances[sponza_instance_id].m_blas.m_triangles);
+    return 0;
+}
+
+// transform propagation timings of a synthetic 1M node scene graph
+int
+RunSceneGraphBenchmark()
+{
+    SceneGraphBenchmark::Run();
+    return 0;
+}
+
+// cost of a trace scope in nanoseconds
+int
+RunTraceBenchmark()
+{
+    TraceBenchmark::Run();
+    return 0;
+}
+
+// memory and geometry count of a 5M vertex mesh with 16 bit, 32 bit and chosen index formats
+int
+RunIndexFormatBenchmark()
+{
+    IndexFormatBenchmark::Run();
+    return 0;
+}
+
+// serial std::set splitter against the epoch splitter, serial and parallel, on sponza and a 10M face mesh
 int
-main()
+RunSplitBenchmark()
+{
+    SplitBenchmark::Run();
+    return 0;
+}
+
+// bc1 and bc4 encoding throughput and error of a synthetic 2048 x 2048 texture
+int
+RunTextureBenchmark()
+{
+    TextureBenchmark::Run();
+    return 0;
+}
+
+// sponza imported from source against sponza read from the .mortarscene cache, uploads included
+int
+RunSceneCacheBenchmark(const bool is_debug)
+{
+    const size_t num_flights = 2;
+
+    Rhi::Entry          entry(is_debug);
+    Rhi::PhysicalDevice physical_device = entry.get_graphics_devices()[0];
+    Rhi::Device         device("benchmark_device", physical_device);
+
+    SceneCacheBenchmark::Run(device, num_flights, "scenes/sponza/sponza.obj");
+    return 0;
+}
+
+// path tracing pipeline rebuild with a cold and a warm shader cache, on one thread and on the thread pool
+int
+RunPipelineBenchmark(const bool is_debug)
+{
+    Rhi::Entry          entry(is_debug);
+    Rhi::PhysicalDevice physical_device = entry.get_graphics_devices()[0];
+    Rhi::Device         device("benchmark_device", physical_device);
+
+    PipelineBenchmark::Run(device);
+    return 0;
+}
+
+// a whole number of frames, nullopt if str is anything else
+std::optional<size_t>
+ParseNumFrames(const std::string_view & str)
+{
+    size_t num_frames            = 0;
+    const auto [end, error_code] = std::from_chars(str.data(), str.data() + str.size(), num_frames);
+    if (error_code != std::errc() || end != str.data() + str.size())
+    {
+        return std::nullopt;
+    }
+    return num_frames;
+}
+
+// headless gpu timings along a camera path, the flags after --benchmark override RenderBenchmark::Settings
+int
+RunRenderBenchmark(const int argc, char ** argv, const bool is_debug)
+{
+    RenderBenchmark::Settings settings;
+    for (int i_arg = 1; i_arg + 1 < argc; i_arg++)
+    {
+        const std::string_view arg = argv[i_arg];
+        if (arg == "--camera-path")
+        {
+            settings.m_camera_path = argv[++i_arg];
+        }
+        else if (arg == "--warm-up-frames" || arg == "--measured-frames")
+        {
+            const std::optional<size_t> num_frames = ParseNumFrames(argv[++i_arg]);
+            if (!num_frames.has_value())
+            {
+                Logger::Warn("usage : --benchmark [--camera-path <file>] [--warm-up-frames <count>] "
+                             "[--measured-frames <count>] [--output <file>], ",
+                             arg,
+                             " expects a whole number of frames but got \"",
+                             argv[i_arg],
+                             "\"");
+                return 1;
+            }
+            if (arg == "--warm-up-frames")
+            {
+                settings.m_num_warm_up_frames = num_frames.value();
+            }
+            else
+            {
+                settings.m_num_measured_frames = std::max(num_frames.value(), size_t(1));
+            }
+        }
+        else if (arg == "--output")
+        {
+            settings.m_output_path = argv[++i_arg];
+        }
+    }
+
+    const size_t num_flights = 2;
+
+    Rhi::Entry          entry(is_debug);
+    Rhi::PhysicalDevice physical_device = entry.get_graphics_devices()[0];
+    Rhi::Device         device("benchmark_device", physical_device);
+    ShaderBinaryManager shader_binary_manager("shadercache");
+
+    RenderBenchmark benchmark(device, num_flights, shader_binary_manager, settings);
+    benchmark.run();
+    return 0;
+}
+
+int
+main(int argc, char ** argv)
 {
 #ifdef NDEBUG
     constexpr bool is_debug = false;
@@ -19,6 +202,30 @@ main()
     constexpr bool is_debug = true;
 #endif
 
+    // headless modes, the first flag that names one runs it instead of the renderer
+    const std::array<std::pair<std::string_view, std::function<int()>>, 10> modes = {
+        { { "--cpu-reference", RunCpuReference },
+          { "--bvh-benchmark", RunBvhBenchmark },
+          { "--scene-graph-benchmark", RunSceneGraphBenchmark },
+          { "--index-format-benchmark", RunIndexFormatBenchmark },
+          { "--split-benchmark", RunSplitBenchmark },
+          { "--texture-benchmark", RunTextureBenchmark },
+          { "--trace-benchmark", RunTraceBenchmark },
+          { "--scene-cache-benchmark", [&]() { return RunSceneCacheBenchmark(is_debug); } },
+          { "--pipeline-benchmark", [&]() { return RunPipelineBenchmark(is_debug); } },
+          { "--benchmark", [&]() { return RunRenderBenchmark(argc, argv, is_debug); } } }
+    };
+    for (int i_arg = 1; i_arg < argc; i_arg++)
+    {
+        for (const auto & [flag, run_mode] : modes)
+        {
+            if (flag == argv[i_arg])
+            {
+                return run_mode();
+            }
+        }
+    }
+
     // setup dear imgui
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -2,6 +2,7 @@
 
 #include "core/camera.h"
 #include "core/gui_event_coordinator.h"
+#include "core/trace.h"
 #include "per_flight_resource.h"
 #include "per_swap_resource.h"
 #include "render/render_context.h"
@@ -30,7 +31,9 @@ struct MainLoop
 
     Renderer m_renderer;
 
-    bool m_is_reload_shader_needed = true;
+    bool m_is_reload_shader_needed = false;
+
+    TraceCapture m_trace_capture;
 
     MainLoop(Rhi::Device &         device,
              Window &              window,
@@ -43,7 +46,7 @@ struct MainLoop
       m_swapchain_resolution(window.get_resolution()),
       m_swapchain(swapchain),
       m_num_flights(num_flights),
-      m_scene_resource(device),
+      m_scene_resource(device, num_flights),
       m_shader_binary_manager(shader_binary_manager),
       m_per_flight_resources(construct_per_flight_resources("main_flight_resource", device, num_flights)),
       m_per_swap_resources(construct_per_swap_resources("main_swap_resources", device, swapchain)),
@@ -133,13 +136,17 @@ struct MainLoop
             return;
         }
 
+        // maps the gpu timestamps summarized this frame into the cpu clock of the trace
         const std::pair<uint64_t, uint64_t> cpu_gpu_time =
             m_device.get_sync_calibrate_cpu_gpu_time(Rhi::QueueType::Graphics);
 
         // wait for resource in this flight to be ready
         // after per_flight_resource finished waiting, then reset all resource
         PerFlightResource & per_flight_resource = m_per_flight_resources[i_flight];
-        per_flight_resource.wait();
+        {
+            TRACE_SCOPE("Wait for flight");
+            per_flight_resource.wait();
+        }
         per_flight_resource.reset();
 
         // get image index (which is also swap index)
@@ -166,7 +173,7 @@ struct MainLoop
                           per_flight_resource,
                           per_swap_resource,
                           m_staging_buffer_manager,
-                          m_imgui_render_pass,
+                          &m_imgui_render_pass,
                           m_shader_binary_manager,
                           i_flight,
                           m_swapchain.m_image_index,
@@ -175,7 +182,8 @@ struct MainLoop
                           m_camera,
                           reload_shader,
                           true,
-                          do_profile);
+                          do_profile,
+                          cpu_gpu_time);
 
         // mark imgui new frame
         // then draw imgui main dock
@@ -192,7 +200,10 @@ struct MainLoop
                         !m_gui_event_coordinator.is_gui_being_used());
 
         // loop the renderer
-        m_renderer.loop(ctx);
+        {
+            TRACE_SCOPE("Record");
+            m_renderer.loop(ctx);
+        }
         // profile(m_device, per_flight_resource);
         if (ctx.m_should_imgui_drawn)
         {
@@ -201,8 +212,12 @@ struct MainLoop
 
         // check if swapchain present success or not
         // swapchain in vulkan could fail due to resizing / minimizing
-        if (!m_swapchain.present(&per_flight_resource.m_image_presentable_semaphore) ||
-            any(notEqual(new_resolution, m_swapchain_resolution)))
+        bool is_presented = false;
+        {
+            TRACE_SCOPE("Present");
+            is_presented = m_swapchain.present(&per_flight_resource.m_image_presentable_semaphore);
+        }
+        if (!is_presented || any(notEqual(new_resolution, m_swapchain_resolution)))
         {
             // before we resize any resource
             // we must make sure that all the resource are not being used anymore
@@ -231,20 +246,18 @@ struct MainLoop
         m_window.update();
     }
 
+    // num_frames of zero traces until the application exits
     void
-    run()
+    begin_trace_capture(const size_t num_frames)
     {
-        // dirty stuffs here
-
-        size_t i_flight = 0;
-
-        const urange32_t sponza_geometries =
-            m_scene_resource.add_geometries("scenes/sponza/sponza.obj");
-        // m_scene_resource.add_geometries("tmp/Exterior/Exterior.obj", m_staging_buffer_manager);
-        std::array<urange32_t, 1> ranges             = { sponza_geometries };
-        size_t                    sponza_instance_id = m_scene_resource.add_base_instance(ranges);
-        // m_scene.add_render_object(&m_scene.m_scene_graph_root, "scenes/cube/cube.obj", m_staging_buffer_manager);
+        Trace::Get().set_track_name(GpuProfiler::TraceTrackId, "gpu graphics queue");
+        m_trace_capture.begin(EngineSetting::TracePath(), num_frames);
+    }
 
+    // grid of sponza instances, shared with the cpu reference renderer so both render the same scene
+    static SceneDesc
+    ConstructDemoSceneDesc(const size_t sponza_instance_id)
+    {
         SceneDesc scene_desc;
         for (size_t j = 0; j < 100; j++)
         {
@@ -257,14 +270,47 @@ struct MainLoop
                 scene_desc.m_instances.push_back(instance2);
             }
         }
-        m_scene_resource.commit(scene_desc, m_staging_buffer_manager);
+        return scene_desc;
+    }
+
+    void
+    run()
+    {
+        // dirty stuffs here
+
+        size_t i_flight = 0;
+
+        const urange32_t sponza_geometries =
+            m_scene_resource.add_geometries("scenes/sponza/sponza.obj");
+        // m_scene_resource.add_geometries("tmp/Exterior/Exterior.obj", m_staging_buffer_manager);
+        std::array<urange32_t, 1> ranges             = { sponza_geometries };
+        size_t                    sponza_instance_id = m_scene_resource.add_base_instance(ranges);
+        // m_scene.add_render_object(&m_scene.m_scene_graph_root, "scenes/cube/cube.obj", m_staging_buffer_manager);
+
+        m_scene_resource.commit(ConstructDemoSceneDesc(sponza_instance_id), m_staging_buffer_manager);
 
         // int2 salle = m_asset_manager.add_standard_object("salle_de_bain/salle_de_bain.obj");
 
+        if constexpr (EngineSetting::EnableContinuousTrace)
+        {
+            begin_trace_capture(0);
+        }
+
         m_window.m_stop_watch.reset();
         while (!m_window.should_close_window())
         {
-            loop(i_flight);
+            // a capture requested from the gui starts with the next frame
+            if (m_renderer.m_gpu_profiler_gui.m_is_trace_capture_requested && !m_trace_capture.is_capturing())
+            {
+                begin_trace_capture(EngineSetting::TraceCaptureNumFrames);
+            }
+            m_renderer.m_gpu_profiler_gui.m_is_trace_capture_requested = false;
+
+            {
+                TRACE_SCOPE("Frame");
+                loop(i_flight);
+            }
+            m_trace_capture.end_frame();
             i_flight = (i_flight + 1) % m_num_flights;
         }
 
@@ -72,6 +72,7 @@
     #include <imgui.h>
 
     // assimp
+    #include <assimp/DefaultIOSystem.h>
     #include <assimp/Importer.hpp>
     #include <assimp/postprocess.h>
     #include <assimp/scene.h>
@@ -80,17 +81,20 @@
     #include <stb_image.h>
 
     // std library
+    #include <algorithm>
     #include <array>
     #include <cassert>
     #include <chrono>
     #include <cstddef>
     #include <cstdint>
+    #include <deque>
     #include <filesystem>
     #include <functional>
     #include <iostream>
     #include <map>
     #include <mutex>
     #include <numeric>
+    #include <optional>
     #include <ostream>
     #include <set>
     #include <span>
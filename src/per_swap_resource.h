@@ -4,12 +4,36 @@
 
 struct PerSwapResource
 {
+    // an offscreen texture when rendering headless
     Rhi::Texture m_swapchain_texture;
     Rhi::Fence * m_swapchain_image_fence;
+    // state the texture is in between frames
+    Rhi::TextureStateEnum m_idle_state;
 
     PerSwapResource(const std::string & name, Rhi::Device & device, const Rhi::Swapchain & swapchain, const size_t i_image)
     : m_swapchain_texture(name + "_swapchain_texture", device, swapchain, i_image),
-      m_swapchain_image_fence(nullptr)
+      m_swapchain_image_fence(nullptr),
+      m_idle_state(Rhi::TextureStateEnum::Present)
     {
     }
-};
\ No newline at end of file
+
+    // stands in for a swapchain image, the result is left ready to be copied out
+    PerSwapResource(const std::string & name, Rhi::Device & device, const int2 resolution)
+    : m_swapchain_texture(name + "_offscreen_texture",
+                          device,
+                          Rhi::TextureCreateInfo(resolution.x,
+                                                 resolution.y,
+                                                 Rhi::FormatEnum::R8G8B8A8_UNorm,
+                                                 Rhi::TextureUsageEnum::ColorAttachment | Rhi::TextureUsageEnum::TransferSrc),
+                          Rhi::TextureStateEnum::TransferSrc),
+      m_swapchain_image_fence(nullptr),
+      m_idle_state(Rhi::TextureStateEnum::TransferSrc)
+    {
+    }
+
+    bool
+    is_presentable() const
+    {
+        return m_idle_state == Rhi::TextureStateEnum::Present;
+    }
+};
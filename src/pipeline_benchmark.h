@@ -0,0 +1,76 @@
+#pragma once
+
+#include "benchmark_util.h"
+#include "core/logger.h"
+#include "core/thread_pool.h"
+#include "pch/pch.h"
+#include "render/passes/path_tracing.h"
+#include "rhi/rhi.h"
+
+// rebuild time of the path tracing pipeline bundle (shaders, pipeline and shader table), with a cold and a warm
+// shader cache, with shaders compiled on a single thread and on the thread pool. the shader cache lives in a folder of
+// its own, so the cache of the renderer is left untouched.
+struct PipelineBenchmark
+{
+    static constexpr size_t NumIterations = 3;
+
+    static void
+    Run(const Rhi::Device & device)
+    {
+        const std::filesystem::path cache_folder = "shadercache_benchmark";
+
+        ThreadPool  single_thread_pool(0);
+        const float serial_cold_ms   = MeasureMilliSec(device, cache_folder, single_thread_pool, true);
+        const float serial_warm_ms   = MeasureMilliSec(device, cache_folder, single_thread_pool, false);
+        const float parallel_cold_ms = MeasureMilliSec(device, cache_folder, ThreadPool::Get(), true);
+        const float parallel_warm_ms = MeasureMilliSec(device, cache_folder, ThreadPool::Get(), false);
+
+        Logger::Info(__FUNCTION__,
+                     " cold cache : ",
+                     serial_cold_ms,
+                     " ms on 1 thread, ",
+                     parallel_cold_ms,
+                     " ms on ",
+                     ThreadPool::Get().get_num_threads(),
+                     " threads");
+        Logger::Info(__FUNCTION__,
+                     " warm cache : ",
+                     serial_warm_ms,
+                     " ms on 1 thread, ",
+                     parallel_warm_ms,
+                     " ms on ",
+                     ThreadPool::Get().get_num_threads(),
+                     " threads");
+
+        std::error_code error_code;
+        std::filesystem::remove_all(cache_folder, error_code);
+    }
+
+private:
+    // best of a few rebuilds, a cold rebuild empties the cache folder first
+    static float
+    MeasureMilliSec(const Rhi::Device &           device,
+                    const std::filesystem::path & cache_folder,
+                    ThreadPool &                  thread_pool,
+                    const bool                    is_cold)
+    {
+        std::optional<ShaderBinaryManager> shader_binary_manager;
+        return BenchmarkUtil::MeasureMilliSec(
+            [&]()
+            {
+                if (is_cold)
+                {
+                    std::error_code error_code;
+                    std::filesystem::remove_all(cache_folder, error_code);
+                }
+                shader_binary_manager.emplace(cache_folder, thread_pool);
+            },
+            [&]()
+            {
+                PathTracingPass::PipelineBundle pipeline_bundle(device,
+                                                                PathTracingPass::ConstructGetRayTracePipelineConfig(),
+                                                                shader_binary_manager.value());
+            },
+            NumIterations);
+    }
+};
@@ -0,0 +1,303 @@
+#pragma once
+
+#include "core/camera.h"
+#include "core/logger.h"
+#include "core/stopwatch.h"
+#include "core/thread_pool.h"
+#include "render/cpu_scene.h"
+#include "shaders/path_tracing_hit.h"
+#include "shaders/path_tracing_params.h"
+#include "shaders/rng/pcg.h"
+
+#include <bit>
+#include <fstream>
+
+// what ClosestHit of path_tracing.hlsl.h hands back through the payload and the gbuffers
+struct CpuPathTracingHit
+{
+    float  m_t;
+    float3 m_snormal;
+    float3 m_next_dir;
+};
+
+// headless cpu port of PathTracingPass, renders the same outputs from the same shader headers.
+// the image is split into tiles, every worker owns a contiguous range of tiles and steals from the others once its
+// own range is done. pixels are traced as 2x2 quads with one sse packet per quad.
+struct CpuPathTracer
+{
+    static constexpr uint32_t TileSize = 16;
+
+    // tiles owned by one worker, the owner and thieves take tiles from the same counter
+    struct alignas(64) TileQueue
+    {
+        std::atomic<uint32_t> m_next = 0;
+        uint32_t              m_end  = 0;
+    };
+
+    int2 m_resolution;
+
+    std::vector<float3> m_demodulated_diffuse_gi;
+    std::vector<float>  m_gbuffer_depth;
+    std::vector<float3> m_gbuffer_shading_normal;
+
+    // rays traced by the last render, primary and shadow rays
+    std::atomic<uint64_t> m_num_rays = 0;
+
+    CpuPathTracer(const int2 & resolution) : m_resolution(resolution)
+    {
+        const size_t num_pixels = static_cast<size_t>(resolution.x) * static_cast<size_t>(resolution.y);
+        m_demodulated_diffuse_gi.resize(num_pixels);
+        m_gbuffer_depth.resize(num_pixels);
+        m_gbuffer_shading_normal.resize(num_pixels);
+    }
+
+    // render one frame with every thread of the pool, return the time it took in milli seconds
+    float
+    render(const CpuScene & scene, FpsCamera & camera, ThreadPool & thread_pool)
+    {
+        StopWatch stop_watch;
+
+        CameraProperties    cam_props = camera.get_camera_props();
+        PathTracingCbParams params;
+        params.m_camera_inv_proj    = inverse(cam_props.m_proj);
+        params.m_camera_inv_view    = inverse(cam_props.m_view);
+        params.m_pixel_spread_angle = std::atan(2.0f * std::tan(camera.m_fov_y * 0.5f) / static_cast<float>(m_resolution.y));
+
+        std::fill(m_demodulated_diffuse_gi.begin(), m_demodulated_diffuse_gi.end(), float3(0.0f));
+        std::fill(m_gbuffer_depth.begin(), m_gbuffer_depth.end(), 0.0f);
+        std::fill(m_gbuffer_shading_normal.begin(), m_gbuffer_shading_normal.end(), float3(0.0f));
+        m_num_rays = 0;
+
+        // split tiles evenly between workers
+        const uint2    num_tiles       = uint2(div_ceil(m_resolution.x, TileSize), div_ceil(m_resolution.y, TileSize));
+        const uint32_t num_total_tiles = num_tiles.x * num_tiles.y;
+        const size_t   num_workers     = thread_pool.get_num_threads();
+        std::vector<TileQueue> tile_queues(num_workers);
+        for (size_t i_worker = 0; i_worker < num_workers; i_worker++)
+        {
+            tile_queues[i_worker].m_next = static_cast<uint32_t>(num_total_tiles * i_worker / num_workers);
+            tile_queues[i_worker].m_end  = static_cast<uint32_t>(num_total_tiles * (i_worker + 1) / num_workers);
+        }
+
+        thread_pool.parallel_for(0,
+                                 num_workers,
+                                 [&](const size_t i_worker)
+                                 {
+                                     uint64_t num_rays = 0;
+                                     // own queue first, then the other queues in order
+                                     for (size_t i_queue = 0; i_queue < num_workers; i_queue++)
+                                     {
+                                         TileQueue & queue = tile_queues[(i_worker + i_queue) % num_workers];
+                                         uint32_t    i_tile;
+                                         while ((i_tile = queue.m_next.fetch_add(1)) < queue.m_end)
+                                         {
+                                             const uint2 tile(i_tile % num_tiles.x, i_tile / num_tiles.x);
+                                             num_rays += render_tile(scene, params, tile * TileSize);
+                                         }
+                                     }
+                                     m_num_rays += num_rays;
+                                 });
+
+        return static_cast<float>(stop_watch.time_micro_sec()) / 1000.0f;
+    }
+
+    // render with 1, 2, 4, ... threads up to every hardware thread and report rays per second for each count
+    void
+    benchmark(const CpuScene & scene, FpsCamera & camera, const size_t num_iterations)
+    {
+        const size_t        num_hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        std::vector<size_t> thread_counts;
+        for (size_t num_threads = 1; num_threads < num_hardware_threads; num_threads *= 2)
+        {
+            thread_counts.push_back(num_threads);
+        }
+        thread_counts.push_back(num_hardware_threads);
+
+        for (const size_t num_threads : thread_counts)
+        {
+            // the calling thread takes part, so the pool gets one worker less
+            ThreadPool thread_pool(num_threads - 1);
+            float      best_time_in_ms = std::numeric_limits<float>::max();
+            for (size_t i_iteration = 0; i_iteration < num_iterations; i_iteration++)
+            {
+                best_time_in_ms = std::min(best_time_in_ms, render(scene, camera, thread_pool));
+            }
+            const double rays_per_sec = static_cast<double>(m_num_rays.load()) / (best_time_in_ms * 1e-3);
+            Logger::Info(__FUNCTION__,
+                         " ",
+                         num_threads,
+                         " threads : ",
+                         best_time_in_ms,
+                         " ms, ",
+                         rays_per_sec * 1e-6,
+                         " mrays/s");
+        }
+    }
+
+    // portable float map, readable by most image viewers and easy to diff in regression tests
+    static bool
+    WritePfm(const std::filesystem::path & path, const int2 & resolution, const std::span<const float3> & pixels)
+    {
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open())
+        {
+            Logger::Warn(__FUNCTION__, " cannot open ", path.string(), " for writing");
+            return false;
+        }
+
+        // negative scale means little endian, rows go from bottom to top
+        ofs << "PF\n" << resolution.x << " " << resolution.y << "\n-1.0\n";
+        for (int y = resolution.y - 1; y >= 0; y--)
+        {
+            ofs.write(reinterpret_cast<const char *>(&pixels[static_cast<size_t>(y) * resolution.x]),
+                      static_cast<std::streamsize>(sizeof(float3) * resolution.x));
+        }
+        return ofs.good();
+    }
+
+private:
+    // return number of rays traced
+    uint64_t
+    render_tile(const CpuScene & scene, const PathTracingCbParams & params, const uint2 & tile_origin)
+    {
+        uint64_t num_rays = 0;
+        for (uint32_t y = 0; y < TileSize; y += 2)
+        {
+            for (uint32_t x = 0; x < TileSize; x += 2)
+            {
+                num_rays += render_quad(scene, params, tile_origin + uint2(x, y));
+            }
+        }
+        return num_rays;
+    }
+
+    // RayGen of path_tracing.hlsl.h for the 4 pixels of a quad
+    uint64_t
+    render_quad(const CpuScene & scene, const PathTracingCbParams & params, const uint2 & quad_origin)
+    {
+        const uint2 resolution = uint2(m_resolution);
+
+        RayPacket4 packet;
+        float2     rnd2s[RayPacket4::NumLanes];
+        uint2      pixel_poses[RayPacket4::NumLanes];
+        int        active_bits = 0;
+        for (uint32_t lane = 0; lane < RayPacket4::NumLanes; lane++)
+        {
+            const uint2 pixel_pos = quad_origin + uint2(lane & 1, lane >> 1);
+            pixel_poses[lane]     = pixel_pos;
+            if (pixel_pos.x >= resolution.x || pixel_pos.y >= resolution.y)
+            {
+                packet.set_inactive(lane);
+                continue;
+            }
+            active_bits |= 1 << lane;
+
+            const uint   pixel_index      = pixel_pos.y * resolution.x + pixel_pos.x;
+            const float2 center_uv        = (float2(pixel_pos) + float2(0.5f)) / float2(resolution);
+            const float2 center_ndc_snorm = center_uv * 2.0f - 1.0f;
+
+            // camera parameters
+            const float3 origin   = float3(params.m_camera_inv_view * float4(0.0f, 0.0f, 0.0f, 1.0f));
+            const float3 lookat   = float3(params.m_camera_inv_proj * float4(center_ndc_snorm, 1.0f, 1.0f));
+            const float3 next_dir = normalize(float3(params.m_camera_inv_view * float4(lookat, 0.0f)));
+
+            // random number generator
+            PcgRng rng;
+            rng.init(0, pixel_index);
+            rnd2s[lane] = rng.next_float2();
+
+            packet.set_ray(lane, origin, next_dir, 0.1f, 100000.0f);
+        }
+        if (active_bits == 0)
+        {
+            return 0;
+        }
+
+        const __m128 active = _mm_castsi128_ps(_mm_setr_epi32(active_bits & 1 ? -1 : 0,
+                                                              active_bits & 2 ? -1 : 0,
+                                                              active_bits & 4 ? -1 : 0,
+                                                              active_bits & 8 ? -1 : 0));
+        HitPacket4   hit;
+        const int    hit_bits = _mm_movemask_ps(scene.intersect(packet, active, &hit));
+        uint64_t     num_rays = static_cast<uint64_t>(std::popcount(static_cast<uint32_t>(active_bits)));
+
+        // shadow rays start from the hit points toward the sampled directions
+        RayPacket4        shadow_packet;
+        CpuPathTracingHit hit_results[RayPacket4::NumLanes];
+        for (uint32_t lane = 0; lane < RayPacket4::NumLanes; lane++)
+        {
+            if ((hit_bits & (1 << lane)) == 0)
+            {
+                shadow_packet.set_inactive(lane);
+                continue;
+            }
+
+            const float3 origin    = packet.get_origin(lane);
+            const float3 direction = packet.get_direction(lane);
+            hit_results[lane]      = closest_hit(scene, hit, lane, packet.m_t_max[lane], direction, rnd2s[lane]);
+
+            const size_t pixel_index = pixel_poses[lane].y * resolution.x + pixel_poses[lane].x;
+            m_gbuffer_depth[pixel_index]          = hit_results[lane].m_t;
+            m_gbuffer_shading_normal[pixel_index] = hit_results[lane].m_snormal;
+
+            shadow_packet.set_ray(lane, hit_results[lane].m_t * direction + origin, hit_results[lane].m_next_dir, 0.1f, 100000.0f);
+        }
+        if (hit_bits == 0)
+        {
+            return num_rays;
+        }
+
+        const __m128 shadow_active = _mm_castsi128_ps(_mm_setr_epi32(hit_bits & 1 ? -1 : 0,
+                                                                     hit_bits & 2 ? -1 : 0,
+                                                                     hit_bits & 4 ? -1 : 0,
+                                                                     hit_bits & 8 ? -1 : 0));
+        const int occluded_bits = _mm_movemask_ps(scene.occluded(shadow_packet, shadow_active));
+        num_rays += static_cast<uint64_t>(std::popcount(static_cast<uint32_t>(hit_bits)));
+
+        for (uint32_t lane = 0; lane < RayPacket4::NumLanes; lane++)
+        {
+            if ((hit_bits & (1 << lane)) == 0)
+            {
+                continue;
+            }
+            const size_t pixel_index = pixel_poses[lane].y * resolution.x + pixel_poses[lane].x;
+            m_demodulated_diffuse_gi[pixel_index] =
+                (occluded_bits & (1 << lane)) ? float3(0.0f) : hit_results[lane].m_next_dir;
+        }
+        return num_rays;
+    }
+
+    // ClosestHit of path_tracing.hlsl.h, materials are not evaluated since textures are not sampled on the cpu
+    static CpuPathTracingHit
+    closest_hit(const CpuScene &   scene,
+                const HitPacket4 & hit,
+                const uint32_t     lane,
+                const float        t,
+                const float3 &     world_ray_direction,
+                const float2 &     rnd2)
+    {
+        const float2                   barycentric   = float2(hit.m_u[lane], hit.m_v[lane]);
+        const CpuScene::Instance &     instance      = scene.m_instances[hit.m_instance_index[lane]];
+        const CpuScene::BaseInstance & base_instance = scene.m_base_instances[instance.m_base_instance_id];
+        const BvhTriangle &            triangle      = base_instance.m_blas.m_triangles[hit.m_prim_index[lane]];
+
+        const uint32_t geometry_offset = base_instance.m_geometry_table_index_base + triangle.m_geometry_index;
+        const GeometryTableEntry & geometry_entry = scene.m_geometry_table[geometry_offset];
+
+        // index into subbuffer
+        const uint32_t index0 = scene.fetch_index(geometry_entry, triangle.m_prim_index * 3);
+        const uint32_t index1 = scene.fetch_index(geometry_entry, triangle.m_prim_index * 3 + 1);
+        const uint32_t index2 = scene.fetch_index(geometry_entry, triangle.m_prim_index * 3 + 2);
+
+        // shading normal
+        const CompactVertex cv0 = scene.m_compact_vertices[index0 + geometry_entry.m_vertex_base_index];
+        const CompactVertex cv1 = scene.m_compact_vertices[index1 + geometry_entry.m_vertex_base_index];
+        const CompactVertex cv2 = scene.m_compact_vertices[index2 + geometry_entry.m_vertex_base_index];
+
+        CpuPathTracingHit result;
+        result.m_t        = t;
+        result.m_snormal  = InterpolateShadingNormal(cv0, cv1, cv2, barycentric);
+        result.m_next_dir = SampleNextDirection(result.m_snormal, world_ray_direction, rnd2);
+        return result;
+    }
+};
@@ -0,0 +1,277 @@
+#pragma once
+
+#include "bvh/bvh.h"
+#include "bvh/bvh_triangle.h"
+#include "bvh/ray_packet.h"
+#include "core/logger.h"
+#include "core/stopwatch.h"
+#include "core/thread_pool.h"
+#include "engine_setting.h"
+#include "importer/scene_cache.h"
+#include "scene_resource.h"
+#include "shaders/shared/bindless_table.h"
+
+// host only counterpart of SceneResource for tracing rays on the cpu.
+// geometries come from the scene cache so no device is needed, and the two level bvh mirrors the gpu layout:
+// one blas per base instance, and a tlas over the instances of the SceneDesc.
+struct CpuScene
+{
+    struct BaseInstance
+    {
+        BvhTriangleMesh m_blas;
+        uint32_t        m_geometry_table_index_base = 0;
+    };
+
+    struct Instance
+    {
+        float4x4 m_object_to_world;
+        float4x4 m_world_to_object;
+        uint32_t m_base_instance_id;
+    };
+
+    std::vector<float3>             m_positions;
+    std::vector<CompactVertex>      m_compact_vertices;
+    std::vector<VertexIndexT>       m_indices;
+    std::vector<StandardMaterial>   m_materials;
+    std::vector<StandardEmission>   m_emissions;
+    std::vector<SceneGeometry>      m_geometries;
+    std::vector<SceneBaseInstance>  m_scene_base_instances;
+    std::vector<GeometryTableEntry> m_geometry_table;
+
+    std::vector<BaseInstance> m_base_instances;
+    std::vector<Instance>     m_instances;
+    Bvh                       m_tlas;
+
+    CpuScene()
+    {
+        // material 0 is black as in SceneResource
+        StandardMaterial black_material;
+        black_material.m_diffuse_tex_id   = black_material.encode_rgb(float3(0.0f, 0.0f, 0.0f));
+        black_material.m_specular_tex_id  = black_material.encode_rgb(float3(0.0f, 0.0f, 0.0f));
+        black_material.m_roughness_tex_id = black_material.encode_r(1.0f);
+        m_materials.push_back(black_material);
+    }
+
+    urange32_t
+    add_geometries(const std::filesystem::path & path)
+    {
+        StopWatch                   stop_watch;
+        const std::filesystem::path cache_path = SceneCache::GetCachePath(EngineSetting::SceneCachePath(), path);
+
+        SceneCacheReader cache;
+        if (!cache.open(cache_path) || !cache.is_up_to_date())
+        {
+            Logger::Error<true>(__FUNCTION__,
+                                " no up to date scene cache ",
+                                cache_path.string(),
+                                " for ",
+                                path.string(),
+                                ", open the scene once with the gpu renderer to write it");
+        }
+
+        // textures are not sampled on the cpu, texture ids inside materials are kept local to the cache
+        const size_t material_offset = m_materials.size();
+        const size_t emission_offset = m_emissions.size();
+        const std::span<const StandardMaterial> materials = cache.get_section<StandardMaterial>(SceneCacheSection::Materials);
+        const std::span<const StandardEmission> emissions = cache.get_section<StandardEmission>(SceneCacheSection::Emissions);
+        m_materials.insert(m_materials.end(), materials.begin(), materials.end());
+        m_emissions.insert(m_emissions.end(), emissions.begin(), emissions.end());
+
+        // base indices in the cache are local to the scene
+        const uint32_t vertex_offset = static_cast<uint32_t>(m_positions.size());
+        const uint32_t index_offset  = static_cast<uint32_t>(m_indices.size());
+        const std::span<const SceneCacheGeometry> cached_geometries =
+            cache.get_section<SceneCacheGeometry>(SceneCacheSection::Geometries);
+        const urange32_t geometries_range(static_cast<uint32_t>(m_geometries.size()),
+                                          static_cast<uint32_t>(m_geometries.size() + cached_geometries.size()));
+        for (const SceneCacheGeometry & cached_geometry : cached_geometries)
+        {
+            SceneGeometry geometry;
+            geometry.m_vbuf_base_index       = vertex_offset + cached_geometry.m_vbuf_base_index;
+            geometry.m_ibuf_base_index       = index_offset + cached_geometry.m_ibuf_base_index;
+            geometry.m_num_vertices          = cached_geometry.m_num_vertices;
+            geometry.m_num_indices           = cached_geometry.m_num_indices;
+            geometry.m_index_stride_in_words = cached_geometry.m_index_stride_in_words;
+            geometry.m_texcoord_offset       = cached_geometry.m_texcoord_offset;
+            geometry.m_texcoord_scale        = cached_geometry.m_texcoord_scale;
+            geometry.m_material_index        = static_cast<BufferSizeT>(material_offset + cached_geometry.m_src_material_index);
+            geometry.m_emission_index =
+                cached_geometry.m_is_emissive ? static_cast<BufferSizeT>(emission_offset + cached_geometry.m_src_material_index) : 0;
+            m_geometries.push_back(geometry);
+        }
+
+        const std::span<const float3>        positions = cache.get_section<float3>(SceneCacheSection::Positions);
+        const std::span<const CompactVertex> compact_vertices =
+            cache.get_section<CompactVertex>(SceneCacheSection::CompactVertices);
+        const std::span<const VertexIndexT> indices = cache.get_section<VertexIndexT>(SceneCacheSection::Indices);
+        m_positions.insert(m_positions.end(), positions.begin(), positions.end());
+        m_compact_vertices.insert(m_compact_vertices.end(), compact_vertices.begin(), compact_vertices.end());
+        m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+
+        Logger::Info(__FUNCTION__, " loaded ", path.string(), " from cache in ", stop_watch.time_milli_sec(), " ms");
+        return geometries_range;
+    }
+
+    size_t
+    add_base_instance(const std::span<urange32_t> & geometry_ranges)
+    {
+        SceneBaseInstance base_instance;
+        base_instance.m_geometry_id_ranges = std::vector<urange32_t>(geometry_ranges.begin(), geometry_ranges.end());
+        m_scene_base_instances.push_back(base_instance);
+        return m_scene_base_instances.size() - 1;
+    }
+
+    void
+    commit(const SceneDesc & scene_desc)
+    {
+        StopWatch stop_watch;
+
+        // geometry table, laid out as in SceneResource::commit
+        m_geometry_table.clear();
+        m_base_instances.clear();
+        m_base_instances.resize(m_scene_base_instances.size());
+        for (size_t i_binst = 0; i_binst < m_scene_base_instances.size(); i_binst++)
+        {
+            m_base_instances[i_binst].m_geometry_table_index_base = static_cast<uint32_t>(m_geometry_table.size());
+            for (const urange32_t & gid_range : m_scene_base_instances[i_binst].m_geometry_id_ranges)
+            {
+                for (uint32_t geometry_id = gid_range.m_begin; geometry_id < gid_range.m_end; geometry_id++)
+                {
+                    const SceneGeometry & geometry = m_geometries[geometry_id];
+                    GeometryTableEntry    entry;
+                    entry.m_vertex_base_index     = geometry.m_vbuf_base_index;
+                    entry.m_index_base_index      = geometry.m_ibuf_base_index;
+                    entry.m_material_index        = geometry.m_material_index;
+                    entry.m_emission_index        = geometry.m_emission_index;
+                    entry.m_index_stride_in_words = geometry.m_index_stride_in_words;
+                    entry.m_texcoord_offset       = geometry.m_texcoord_offset;
+                    entry.m_texcoord_scale        = geometry.m_texcoord_scale;
+                    m_geometry_table.push_back(entry);
+                }
+            }
+        }
+
+        // blas for all base instances
+        for (size_t i_binst = 0; i_binst < m_scene_base_instances.size(); i_binst++)
+        {
+            build_blas(i_binst);
+        }
+
+        // tlas over the world space bounds of all instances
+        m_instances.resize(scene_desc.m_instances.size());
+        std::vector<Aabb> instance_aabbs(scene_desc.m_instances.size());
+        ThreadPool::Get().parallel_for(0,
+                                       scene_desc.m_instances.size(),
+                                       [&](const size_t i_inst)
+                                       {
+                                           const SceneInstance & scene_instance = scene_desc.m_instances[i_inst];
+                                           Instance &            instance       = m_instances[i_inst];
+                                           instance.m_object_to_world  = scene_instance.m_transform;
+                                           instance.m_world_to_object  = inverse(scene_instance.m_transform);
+                                           instance.m_base_instance_id = scene_instance.m_base_instance_id;
+                                           instance_aabbs[i_inst] =
+                                               m_base_instances[instance.m_base_instance_id].m_blas.m_bvh.get_aabb().transform(
+                                                   scene_instance.m_transform);
+                                       });
+        m_tlas = Bvh::Build(instance_aabbs, 1);
+
+        Logger::Info(__FUNCTION__,
+                     " built ",
+                     m_base_instances.size(),
+                     " blas and a tlas over ",
+                     m_instances.size(),
+                     " instances in ",
+                     stop_watch.time_milli_sec(),
+                     " ms");
+    }
+
+    // closest hit of every active lane, packet.m_t_max of the lanes that hit is shrunk to the hit distance
+    __m128
+    intersect(RayPacket4 & packet, const __m128 active, HitPacket4 * hit) const
+    {
+        return trace<false>(packet, active, hit);
+    }
+
+    // lanes that hit anything within their [t_min, t_max], traversal of a lane stops at its first hit
+    __m128
+    occluded(RayPacket4 & packet, const __m128 active) const
+    {
+        return trace<true>(packet, active, nullptr);
+    }
+
+    // as FetchIndex in path_tracing.hlsl.h
+    uint32_t
+    fetch_index(const GeometryTableEntry & geometry_entry, const uint32_t i_index) const
+    {
+        const uint32_t word = geometry_entry.get_index_word(i_index);
+        if (geometry_entry.m_index_stride_in_words == 1)
+        {
+            return m_indices[word];
+        }
+        return uint32_t(m_indices[word]) | (uint32_t(m_indices[word + 1]) << 16);
+    }
+
+private:
+    void
+    build_blas(const size_t i_binst)
+    {
+        std::vector<BvhTriangle> triangles;
+        uint32_t                 geometry_index = 0;
+        for (const urange32_t & gid_range : m_scene_base_instances[i_binst].m_geometry_id_ranges)
+        {
+            for (uint32_t geometry_id = gid_range.m_begin; geometry_id < gid_range.m_end; geometry_id++, geometry_index++)
+            {
+                const SceneGeometry &               geometry  = m_geometries[geometry_id];
+                const std::span<const float3>       positions = std::span<const float3>(m_positions)
+                                                              .subspan(geometry.m_vbuf_base_index, geometry.m_num_vertices);
+                const std::span<const VertexIndexT> index_words =
+                    std::span<const VertexIndexT>(m_indices)
+                        .subspan(geometry.m_ibuf_base_index, geometry.m_num_indices * geometry.m_index_stride_in_words);
+                BvhTriangleMesh::AppendGeometry(&triangles, positions, index_words, geometry.m_index_stride_in_words, geometry_index);
+            }
+        }
+        m_base_instances[i_binst].m_blas = BvhTriangleMesh::Build(triangles);
+    }
+
+    template <bool IsAnyHit>
+    __m128
+    trace(RayPacket4 & packet, const __m128 active, HitPacket4 * hit) const
+    {
+        __m128 hit_mask = _mm_setzero_ps();
+        BvhPacket::Traverse(
+            m_tlas,
+            packet,
+            active,
+            [&](const BvhNode & tlas_leaf, __m128 tlas_active)
+            {
+                for (uint32_t i = tlas_leaf.m_first_index; i < tlas_leaf.m_first_index + tlas_leaf.m_num_prims; i++)
+                {
+                    const uint32_t       instance_index = m_tlas.m_prim_indices[i];
+                    const Instance &     instance       = m_instances[instance_index];
+                    const BaseInstance & base_instance  = m_base_instances[instance.m_base_instance_id];
+
+                    // trace the packet in object space of the instance
+                    RayPacket4   local_packet = packet.transform(instance.m_world_to_object);
+                    const __m128 local_hit_mask =
+                        base_instance.m_blas.intersect<IsAnyHit>(local_packet, tlas_active, hit, instance_index);
+                    hit_mask = _mm_or_ps(hit_mask, local_hit_mask);
+
+                    if constexpr (IsAnyHit)
+                    {
+                        tlas_active = _mm_andnot_ps(hit_mask, tlas_active);
+                        if (_mm_movemask_ps(tlas_active) == 0)
+                        {
+                            break;
+                        }
+                    }
+                    else
+                    {
+                        // t is invariant to the transform, so closer hits found in this instance cull the others
+                        _mm_store_ps(packet.m_t_max, _mm_load_ps(local_packet.m_t_max));
+                    }
+                }
+                return tlas_active;
+            });
+        return hit_mask;
+    }
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "core/logger.h"
+#include "core/thread_pool.h"
+#include "pch/pch.h"
+
+// owns an object built from shaders (a pipeline and whatever is derived from it) and rebuilds it on the thread
+// pool, so the frame loop never waits for dxc or for pipeline creation.
+// the rebuilt object is swapped in at a frame boundary by update(), the replaced one is kept alive until every
+// flight that may still reference it has retired.
+// T must expose m_shader_paths, the canonical paths of every shader file it was built from.
+template <typename T>
+struct HotReloadable
+{
+    using BuildFunc = std::function<std::unique_ptr<T>()>;
+
+    std::unique_ptr<T>                                 m_current;
+    std::future<std::unique_ptr<T>>                    m_pending;
+    // requested while another rebuild was running, it would otherwise miss the latest changes
+    BuildFunc                                          m_queued_build_func;
+    std::deque<std::pair<size_t, std::unique_ptr<T>>> m_retired;
+    // incremented by every swap, so state derived from the current object can tell when it is stale
+    size_t m_generation = 0;
+
+    HotReloadable(std::unique_ptr<T> && initial) : m_current(std::move(initial)) {}
+
+    ~HotReloadable() { wait(); }
+
+    const T &
+    get() const
+    {
+        return *m_current;
+    }
+
+    size_t
+    get_generation() const
+    {
+        return m_generation;
+    }
+
+    bool
+    depends_on_any(const std::span<const std::filesystem::path> & changed_paths) const
+    {
+        for (const std::filesystem::path & path : changed_paths)
+        {
+            if (m_current->m_shader_paths.contains(path))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void
+    rebuild_async(BuildFunc && build_func)
+    {
+        if (m_pending.valid())
+        {
+            m_queued_build_func = std::move(build_func);
+            return;
+        }
+        m_pending = ThreadPool::Get().submit(std::move(build_func));
+    }
+
+    // call once per frame before recording, frame_index must increase by one every frame
+    void
+    update(const size_t frame_index, const size_t num_flights)
+    {
+        // everything recorded before the swap has retired once every flight went around once
+        while (!m_retired.empty() && m_retired.front().first + num_flights <= frame_index)
+        {
+            m_retired.pop_front();
+        }
+
+        if (!m_pending.valid() || m_pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return;
+        }
+
+        try
+        {
+            std::unique_ptr<T> rebuilt = m_pending.get();
+            m_retired.emplace_back(frame_index, std::move(m_current));
+            m_current = std::move(rebuilt);
+            m_generation++;
+        }
+        catch (const std::exception & e)
+        {
+            // e.g. a shader that does not compile, keep rendering with the previous build
+            Logger::Warn(__FUNCTION__, " rebuild failed, keep using the previous one : ", e.what());
+        }
+
+        if (m_queued_build_func)
+        {
+            rebuild_async(std::exchange(m_queued_build_func, nullptr));
+        }
+    }
+
+    // wait for the running rebuild, a queued one is dropped since whatever it referenced may be about to change
+    void
+    wait()
+    {
+        m_queued_build_func = nullptr;
+        if (m_pending.valid())
+        {
+            m_pending.wait();
+        }
+    }
+
+    // wait for the running rebuild and drop its result along with a queued one, for when whatever they were built
+    // against changes. returns true if anything was dropped, the caller then requests a rebuild against the new state
+    bool
+    discard_pending()
+    {
+        const bool is_discarded = m_pending.valid() || m_queued_build_func;
+        wait();
+        m_pending = std::future<std::unique_ptr<T>>();
+        return is_discarded;
+    }
+};
@@ -1,25 +1,43 @@
 #pragma once
 
+#include "render/hot_reloadable.h"
 #include "render/shader_path.h"
 #include "rhi/rhi.h"
 #include "scene_resource.h"
 
 struct RenderToFramebufferPass
 {
-    Rhi::RasterPipeline m_raster_pipeline;
-    Rhi::Sampler        m_sampler;
+    // everything that has to be rebuilt when the shaders change
+    struct PipelineBundle
+    {
+        Rhi::RasterPipeline             m_raster_pipeline;
+        std::set<std::filesystem::path> m_shader_paths;
+
+        PipelineBundle(const Rhi::Device &              device,
+                       const ShaderBinaryManager &      shader_binary_manager,
+                       const Rhi::FramebufferBindings & fb)
+        : m_raster_pipeline("final_composite_pipeline", device, GetShaderSrcs(), shader_binary_manager, fb)
+        {
+            for (const Rhi::ShaderSrc & shader_src : GetShaderSrcs())
+            {
+                m_shader_paths.merge(ShaderBinaryManager::GetSourceTreePaths(shader_src));
+            }
+        }
+    };
+
+    HotReloadable<PipelineBundle> m_pipeline;
+    Rhi::Sampler                  m_sampler;
 
     RenderToFramebufferPass(const Rhi::Device &              device,
-                            ShaderBinaryManager &            shader_binary_manager,
+                            const ShaderBinaryManager &      shader_binary_manager,
                             const Rhi::FramebufferBindings & fb)
-    : m_sampler("render_to_framebuffer_sampler", device),
-      m_raster_pipeline("final_composite_pipeline", device, get_shader_srcs(), shader_binary_manager, fb)
+    : m_pipeline(std::make_unique<PipelineBundle>(device, shader_binary_manager, fb)),
+      m_sampler("render_to_framebuffer_sampler", device)
     {
-        // init_or_reload(device, shader_binary_manager, fb);
     }
 
-    std::array<Rhi::ShaderSrc, 2>
-    get_shader_srcs()
+    static std::array<Rhi::ShaderSrc, 2>
+    GetShaderSrcs()
     {
         std::array<Rhi::ShaderSrc, 2> srcs;
         srcs[0] =
@@ -29,11 +47,37 @@ struct RenderToFramebufferPass
         return srcs;
     }
 
+    // rebuild the pipeline in background if forced or if any of its shader files changed
+    // fb must stay unchanged until the rebuild is swapped in or discard_reload() returns
     void
-    init_or_reload([[maybe_unused]] const Rhi::Device &              device,
-                   [[maybe_unused]] ShaderBinaryManager &            shader_binary_manager,
-                   [[maybe_unused]] const Rhi::FramebufferBindings & fb)
+    hot_reload(const Rhi::Device &                           device,
+               const ShaderBinaryManager &                   shader_binary_manager,
+               const Rhi::FramebufferBindings &              fb,
+               const std::span<const std::filesystem::path> & changed_paths,
+               const bool                                    force,
+               const size_t                                  frame_index,
+               const size_t                                  num_flights)
     {
+        if (force || m_pipeline.depends_on_any(changed_paths))
+        {
+            reload(device, shader_binary_manager, fb);
+        }
+        m_pipeline.update(frame_index, num_flights);
+    }
+
+    void
+    reload(const Rhi::Device & device, const ShaderBinaryManager & shader_binary_manager, const Rhi::FramebufferBindings & fb)
+    {
+        m_pipeline.rebuild_async([&device, &shader_binary_manager, &fb]()
+                                 { return std::make_unique<PipelineBundle>(device, shader_binary_manager, fb); });
+    }
+
+    // call before fb changes, a rebuild against the old fb is dropped. returns true if one was, it has to be
+    // requested again with reload() once fb is up to date
+    bool
+    discard_reload()
+    {
+        return m_pipeline.discard_pending();
     }
 
     void
@@ -42,12 +86,14 @@ struct RenderToFramebufferPass
         // begin render pass
         cmd_buffer.begin_render_pass(fb);
 
+        const Rhi::RasterPipeline & raster_pipeline = m_pipeline.get().m_raster_pipeline;
+
         // draw result
-        cmd_buffer.bind_raster_pipeline(m_raster_pipeline);
+        cmd_buffer.bind_raster_pipeline(raster_pipeline);
 
         // setup descriptor set
         std::array<Rhi::DescriptorSet, 1> beauty_desc_sets = {
-            Rhi::DescriptorSet(ctx.m_device, m_raster_pipeline, ctx.m_per_flight_resource.m_descriptor_pool, 0)
+            Rhi::DescriptorSet(ctx.m_device, raster_pipeline, ctx.m_per_flight_resource.m_descriptor_pool, 0)
         };
         beauty_desc_sets[0].set_t_texture(0, tex).set_s_sampler(0, m_sampler).update();
 
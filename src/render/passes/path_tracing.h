@@ -1,5 +1,6 @@
 #pragma once
 
+#include "render/hot_reloadable.h"
 #include "render/shader_path.h"
 #include "rhi/rhi.h"
 #include "shaders/cpp_compatible.h"
@@ -7,25 +8,101 @@
 
 struct PathTracingPass
 {
-    Rhi::RayTracingPipeline    m_rt_pipeline;
-    Rhi::RayTracingShaderTable m_rt_sbt;
-    std::vector<Rhi::Buffer>   m_params_constant_buffers;
-    Rhi::Sampler               m_common_sampler;
-    size_t                     m_radiance_miss_shader_index;
-    size_t                     m_shadow_miss_shader_index;
+    // everything that has to be rebuilt when the shaders change
+    struct PipelineBundle
+    {
+        Rhi::RayTracingPipeline         m_rt_pipeline;
+        Rhi::RayTracingShaderTable      m_rt_sbt;
+        std::set<std::filesystem::path> m_shader_paths;
+
+        PipelineBundle(const Rhi::Device &                   device,
+                       const Rhi::RayTracingPipelineConfig & rt_config,
+                       const ShaderBinaryManager &           shader_binary_manager)
+        : m_rt_pipeline("path_tracing_pipeline",
+                        device,
+                        rt_config,
+                        shader_binary_manager,
+                        sizeof(PathTracingAttributes),
+                        std::max(sizeof(PathTracingPayload), sizeof(PathTracingShadowRayPayload)),
+                        1),
+          m_rt_sbt("path_tracing_sbt", device, m_rt_pipeline)
+        {
+            for (const Rhi::ShaderSrc & shader_src : rt_config.m_shader_srcs)
+            {
+                m_shader_paths.merge(ShaderBinaryManager::GetSourceTreePaths(shader_src));
+            }
+        }
+    };
+
+    // descriptor sets outlive frames, one pair per flight. they are written once and patched when the resources they
+    // point to change, which is safe since the previous frame of a flight has retired before it is recorded again.
+    // per frame data lives in the params constant buffer of the flight, whose binding never changes
+    struct FlightDescriptors
+    {
+        Rhi::DescriptorPool             m_descriptor_pool;
+        std::vector<Rhi::DescriptorSet> m_descriptor_sets;
+        size_t                          m_pipeline_generation  = 0;
+        uint64_t                        m_scene_version        = 0;
+        size_t                          m_num_written_textures = 0;
+
+        FlightDescriptors(const std::string & name, const Rhi::Device & device)
+        : m_descriptor_pool(name, device, NumDescriptorsPerFlight)
+        {
+        }
+    };
+
+    static constexpr uint32_t NumDescriptorsPerFlight = 1000;
+
+    HotReloadable<PipelineBundle>  m_pipeline;
+    std::vector<Rhi::Buffer>       m_params_constant_buffers;
+    Rhi::Sampler                   m_common_sampler;
+    size_t                         m_radiance_miss_shader_index;
+    size_t                         m_shadow_miss_shader_index;
+    std::vector<FlightDescriptors> m_flight_descriptors;
 
     PathTracingPass(const Rhi::Device & device, const ShaderBinaryManager & shader_binary_manager, const size_t num_flights)
-    : m_rt_pipeline("path_tracing_pipeline",
-                    device,
-                    ConstructGetRayTracePipelineConfig(),
-                    shader_binary_manager,
-                    sizeof(PathTracingAttributes),
-                    std::max(sizeof(PathTracingPayload), sizeof(PathTracingShadowRayPayload)),
-                    1),
-      m_rt_sbt("path_tracing_sbt", device, m_rt_pipeline),
+    : m_pipeline(std::make_unique<PipelineBundle>(device, ConstructGetRayTracePipelineConfig(), shader_binary_manager)),
       m_params_constant_buffers(ConstructParamsConstantBuffers(device, num_flights)),
       m_common_sampler("path_tracing_sampler", device)
     {
+        // sets keep a reference to their pool, so the vector must never reallocate
+        m_flight_descriptors.reserve(num_flights);
+        for (size_t i_flight = 0; i_flight < num_flights; i_flight++)
+        {
+            m_flight_descriptors.emplace_back("path_tracing_descriptor_pool_" + std::to_string(i_flight), device);
+        }
+    }
+
+    // the per flight textures are recreated, every flight is idle at this point
+    void
+    reset_descriptors()
+    {
+        for (FlightDescriptors & flight_descriptors : m_flight_descriptors)
+        {
+            flight_descriptors.m_descriptor_sets.clear();
+        }
+    }
+
+    // rebuild the pipeline in background if forced or if any of its shader files changed
+    void
+    hot_reload(const Rhi::Device &                           device,
+               const ShaderBinaryManager &                   shader_binary_manager,
+               const std::span<const std::filesystem::path> & changed_paths,
+               const bool                                    force,
+               const size_t                                  frame_index,
+               const size_t                                  num_flights)
+    {
+        if (force || m_pipeline.depends_on_any(changed_paths))
+        {
+            m_pipeline.rebuild_async(
+                [&device, &shader_binary_manager]()
+                {
+                    return std::make_unique<PipelineBundle>(device,
+                                                            ConstructGetRayTracePipelineConfig(),
+                                                            shader_binary_manager);
+                });
+        }
+        m_pipeline.update(frame_index, num_flights);
     }
 
     static Rhi::RayTracingPipelineConfig
@@ -93,49 +170,72 @@ struct PathTracingPass
            const Rhi::Texture &  diffuse_reflectance_texture,
            const Rhi::Texture &  specular_reflectance_texture,
            const Rhi::Texture &  specular_roughness_texture,
-           const uint2           target_resolution) const
+           const uint2           target_resolution)
     {
+        const Rhi::RayTracingPipeline &    rt_pipeline = m_pipeline.get().m_rt_pipeline;
+        const Rhi::RayTracingShaderTable & rt_sbt      = m_pipeline.get().m_rt_sbt;
+
         // Setup params for Path Tracing pass
         PathTracingCbParams cb_params;
         CameraProperties    cam_props              = ctx.m_fps_camera.get_camera_props();
         cb_params.m_camera_inv_proj                = inverse(cam_props.m_proj);
         cb_params.m_camera_inv_view                = inverse(cam_props.m_view);
+        cb_params.m_pixel_spread_angle =
+            std::atan(2.0f * std::tan(ctx.m_fps_camera.m_fov_y * 0.5f) / static_cast<float>(target_resolution.y));
         const Rhi::Buffer & params_constant_buffer = m_params_constant_buffers[ctx.m_flight_index];
         std::memcpy(params_constant_buffer.map(), &cb_params, sizeof(PathTracingCbParams));
         params_constant_buffer.unmap();
 
-        // setup descriptor spaces and bindings
-        std::array<Rhi::DescriptorSet, 2> descriptor_sets = {
-            Rhi::DescriptorSet(ctx.m_device, m_rt_pipeline, ctx.m_per_flight_resource.m_descriptor_pool, 0),
-            Rhi::DescriptorSet(ctx.m_device, m_rt_pipeline, ctx.m_per_flight_resource.m_descriptor_pool, 1)
-        };
-
-        PathTracingRegisters registers(descriptor_sets);
-        registers.u_params.set(params_constant_buffer);
-        registers.u_demodulated_diffuse_gi.set(demodulated_diffuse_gi);
-        registers.u_gbuffer_depth.set(gbuffer_depth);
-        registers.u_gbuffer_shading_normal.set(gbuffer_shading_normal);
-        registers.u_gbuffer_diffuse_reflectance.set(diffuse_reflectance_texture);
-        registers.u_gbuffer_specular_reflectance.set(specular_reflectance_texture);
-        registers.u_gbuffer_roughness.set(specular_roughness_texture);
-
-        registers.u_scene_bvh.set(ctx.m_scene_resource.m_rt_tlas);
-        registers.u_sampler.set(m_common_sampler);
-        registers.u_base_instance_table.set(ctx.m_scene_resource.m_d_base_instance_table);
-        registers.u_geometry_table.set(ctx.m_scene_resource.m_d_geometry_table);
-        registers.u_indices.set(ctx.m_scene_resource.m_d_ibuf);
-        registers.u_compact_vertices.set(ctx.m_scene_resource.m_d_vbuf_packed);
-        registers.u_materials.set(ctx.m_scene_resource.m_d_materials);
-        for (size_t i = 0; i < ctx.m_scene_resource.m_d_textures.size(); i++)
+        // descriptors are rewritten only when the pipeline, the scene or the frame textures changed, textures added
+        // to the scene since the last frame of this flight are patched in
+        FlightDescriptors &   flight_descriptors = m_flight_descriptors[ctx.m_flight_index];
+        const SceneResource & scene              = ctx.m_scene_resource;
+        if (flight_descriptors.m_descriptor_sets.empty() ||
+            flight_descriptors.m_pipeline_generation != m_pipeline.get_generation() ||
+            flight_descriptors.m_scene_version != scene.m_descriptor_version)
         {
-            registers.u_textures.set(ctx.m_scene_resource.m_d_textures[i], i);
+            flight_descriptors.m_descriptor_sets.clear();
+            flight_descriptors.m_descriptor_pool.reset();
+            flight_descriptors.m_descriptor_sets.reserve(2);
+            flight_descriptors.m_descriptor_sets.emplace_back(ctx.m_device, rt_pipeline, flight_descriptors.m_descriptor_pool, 0);
+            flight_descriptors.m_descriptor_sets.emplace_back(ctx.m_device, rt_pipeline, flight_descriptors.m_descriptor_pool, 1);
+            flight_descriptors.m_pipeline_generation  = m_pipeline.get_generation();
+            flight_descriptors.m_scene_version        = scene.m_descriptor_version;
+            flight_descriptors.m_num_written_textures = 0;
+
+            PathTracingRegisters registers(flight_descriptors.m_descriptor_sets);
+            registers.u_params.set(params_constant_buffer);
+            registers.u_demodulated_diffuse_gi.set(demodulated_diffuse_gi);
+            registers.u_gbuffer_depth.set(gbuffer_depth);
+            registers.u_gbuffer_shading_normal.set(gbuffer_shading_normal);
+            registers.u_gbuffer_diffuse_reflectance.set(diffuse_reflectance_texture);
+            registers.u_gbuffer_specular_reflectance.set(specular_reflectance_texture);
+            registers.u_gbuffer_roughness.set(specular_roughness_texture);
+
+            registers.u_scene_bvh.set(scene.get_tlas(ctx.m_flight_index));
+            registers.u_sampler.set(m_common_sampler);
+            registers.u_base_instance_table.set(scene.m_d_base_instance_table);
+            registers.u_geometry_table.set(scene.m_d_geometry_table);
+            registers.u_indices.set(scene.m_d_ibuf);
+            registers.u_compact_vertices.set(scene.m_d_vbuf_packed);
+            registers.u_positions.set(scene.m_d_vbuf_position);
+            registers.u_materials.set(scene.m_d_materials);
+            flight_descriptors.m_descriptor_sets[0].update();
         }
 
-        descriptor_sets[0].update();
-        descriptor_sets[1].update();
+        if (flight_descriptors.m_num_written_textures < scene.m_d_textures.size())
+        {
+            PathTracingRegisters registers(flight_descriptors.m_descriptor_sets);
+            for (size_t i = flight_descriptors.m_num_written_textures; i < scene.m_d_textures.size(); i++)
+            {
+                registers.u_textures.set(scene.m_d_textures[i], i);
+            }
+            flight_descriptors.m_num_written_textures = scene.m_d_textures.size();
+        }
+        flight_descriptors.m_descriptor_sets[1].update();
 
-        cmd_buffer.bind_ray_trace_pipeline(m_rt_pipeline);
-        cmd_buffer.bind_ray_trace_descriptor_set(descriptor_sets);
-        cmd_buffer.trace_rays(m_rt_sbt, target_resolution.x, target_resolution.y);
+        cmd_buffer.bind_ray_trace_pipeline(rt_pipeline);
+        cmd_buffer.bind_ray_trace_descriptor_set(flight_descriptors.m_descriptor_sets);
+        cmd_buffer.trace_rays(rt_sbt, target_resolution.x, target_resolution.y);
     }
 };
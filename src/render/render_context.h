@@ -12,7 +12,8 @@ struct RenderContext
     PerFlightResource &         m_per_flight_resource;
     PerSwapResource &           m_per_swap_resource;
     Rhi::StagingBufferManager & m_staging_buffer_manager;
-    Rhi::ImGuiRenderPass &      m_imgui_render_pass;
+    // null when rendering headless
+    Rhi::ImGuiRenderPass *      m_imgui_render_pass;
     ShaderBinaryManager &       m_shader_binary_manager;
     size_t                      m_flight_index;
     size_t                      m_image_index;
@@ -22,12 +23,14 @@ struct RenderContext
     bool                        m_is_shaders_dirty;
     bool                        m_should_imgui_drawn;
     bool                        m_do_profile;
+    // cpu and gpu timestamps of the graphics queue sampled together
+    std::pair<uint64_t, uint64_t> m_cpu_gpu_time;
 
     RenderContext(Rhi::Device &               device,
                   PerFlightResource &         per_flight_resource,
                   PerSwapResource &           per_swap_resource,
                   Rhi::StagingBufferManager & staging_buffer_manager,
-                  Rhi::ImGuiRenderPass &      imgui_render_pass,
+                  Rhi::ImGuiRenderPass *      imgui_render_pass,
                   ShaderBinaryManager &       shader_binary_manager,
                   size_t                      flight_index,
                   size_t                      image_index,
@@ -36,7 +39,8 @@ struct RenderContext
                   FpsCamera &                 fps_camera,
                   const bool                  is_shaders_dirty,
                   const bool                  should_imgui_drawn,
-                  const bool                  do_profile)
+                  const bool                  do_profile,
+                  const std::pair<uint64_t, uint64_t> & cpu_gpu_time)
     : m_device(device),
       m_per_flight_resource(per_flight_resource),
       m_per_swap_resource(per_swap_resource),
@@ -50,7 +54,8 @@ struct RenderContext
       m_fps_camera(fps_camera),
       m_is_shaders_dirty(is_shaders_dirty),
       m_should_imgui_drawn(should_imgui_drawn),
-      m_do_profile(do_profile)
+      m_do_profile(do_profile),
+      m_cpu_gpu_time(cpu_gpu_time)
     {
     }
 };
\ No newline at end of file
@@ -0,0 +1,360 @@
+#pragma once
+
+#include "core/logger.h"
+#include "gpu_profiler.h"
+#include "rhi/rhi.h"
+
+// passes declare the textures they use and the state they use them in, the barriers between passes are derived from
+// that. transient textures are declared once and only live within a frame: each one is used from its first to its
+// last pass, and transients whose lifetimes do not overlap are placed into the same aliasable memory. every flight
+// has its own memories and transients, so a frame never waits for the textures of the frame recorded before it.
+struct RenderGraph
+{
+    using TextureHandle = size_t;
+
+    static constexpr size_t InvalidIndex = std::numeric_limits<size_t>::max();
+
+    struct TextureUse
+    {
+        TextureHandle         m_handle;
+        Rhi::TextureStateEnum m_state;
+    };
+
+    struct Pass
+    {
+        std::string                                m_name;
+        std::vector<TextureUse>                    m_uses;
+        std::function<void(Rhi::CommandBuffer &)> m_execute;
+    };
+
+    struct TextureNode
+    {
+        std::string m_name;
+        // transients only
+        std::optional<Rhi::TextureCreateInfo> m_create_info;
+        Rhi::MemoryRequirement                m_memory_requirement;
+        size_t                                m_memory_index = InvalidIndex;
+        size_t                                m_first_pass   = InvalidIndex;
+        size_t                                m_last_pass    = InvalidIndex;
+        Rhi::TextureStateEnum                 m_first_state  = Rhi::TextureStateEnum::ReadWrite;
+        Rhi::TextureStateEnum                 m_last_state   = Rhi::TextureStateEnum::ReadWrite;
+        // the transient that used the memory before this one, possibly in the previous frame of the flight or itself
+        TextureHandle m_prev_occupant = InvalidIndex;
+        // imports only
+        const Rhi::Texture *  m_imported_texture = nullptr;
+        Rhi::TextureStateEnum m_post_state       = Rhi::TextureStateEnum::ReadWrite;
+        // while recording
+        Rhi::TextureStateEnum m_current_state = Rhi::TextureStateEnum::ReadWrite;
+
+        bool
+        is_transient() const
+        {
+            return m_create_info.has_value();
+        }
+
+        bool
+        overlaps(const TextureNode & node) const
+        {
+            return m_first_pass <= node.m_last_pass && node.m_first_pass <= m_last_pass;
+        }
+    };
+
+    struct MemoryBlock
+    {
+        Rhi::MemoryRequirement m_memory_requirement;
+        // ordered by first pass
+        std::vector<TextureHandle> m_handles;
+    };
+
+    Rhi::Device & m_device;
+    std::string   m_name;
+    size_t        m_num_flights;
+    // transients come first, imports of the current frame after them
+    std::vector<TextureNode>          m_textures;
+    size_t                            m_num_transients = 0;
+    std::vector<Pass>                 m_passes;
+    std::vector<MemoryBlock>          m_memory_blocks;
+    // per flight, indexed by memory block
+    std::vector<std::vector<Rhi::AliasableMemory>> m_memories;
+    // per flight, indexed by handle, transients only
+    std::vector<std::vector<std::optional<Rhi::Texture>>> m_transient_textures;
+    size_t                                                m_flight_index = 0;
+    bool                                                  m_is_compiled  = false;
+
+    RenderGraph(const std::string & name, Rhi::Device & device, const size_t num_flights)
+    : m_device(device), m_name(name), m_num_flights(num_flights)
+    {
+    }
+
+    // drops every transient, the device must be done with all of them
+    void
+    clear()
+    {
+        m_passes.clear();
+        m_transient_textures.clear();
+        m_memories.clear();
+        m_memory_blocks.clear();
+        m_textures.clear();
+        m_num_transients = 0;
+        m_is_compiled    = false;
+    }
+
+    // transients are declared once, before the first frame or after clear
+    TextureHandle
+    declare_texture(const std::string & name, const Rhi::TextureCreateInfo & create_info)
+    {
+        assert(m_textures.size() == m_num_transients);
+        TextureNode node;
+        node.m_name        = name;
+        node.m_create_info = create_info;
+        m_textures.push_back(node);
+        m_is_compiled = false;
+        return m_num_transients++;
+    }
+
+    // get_texture returns the transients of this flight until the next begin_frame
+    void
+    begin_frame(const size_t i_flight)
+    {
+        assert(i_flight < m_num_flights);
+        m_flight_index = i_flight;
+        m_passes.clear();
+        m_textures.resize(m_num_transients);
+    }
+
+    // a texture owned outside of the graph, in pre_state before the frame and left in post_state after it
+    TextureHandle
+    import_texture(const std::string &         name,
+                   const Rhi::Texture &        texture,
+                   const Rhi::TextureStateEnum pre_state,
+                   const Rhi::TextureStateEnum post_state)
+    {
+        TextureNode node;
+        node.m_name             = name;
+        node.m_imported_texture = &texture;
+        node.m_current_state    = pre_state;
+        node.m_post_state       = post_state;
+        m_textures.push_back(node);
+        return m_textures.size() - 1;
+    }
+
+    // passes run in the order they are added. the passes of a frame must use transients the same way every frame,
+    // lifetimes are only computed by compile
+    void
+    add_pass(const std::string &                               name,
+             const std::vector<TextureUse> &                   uses,
+             const std::function<void(Rhi::CommandBuffer &)> & execute)
+    {
+        Pass pass;
+        pass.m_name    = name;
+        pass.m_uses    = uses;
+        pass.m_execute = execute;
+        m_passes.push_back(std::move(pass));
+    }
+
+    const Rhi::Texture &
+    get_texture(const TextureHandle handle) const
+    {
+        const TextureNode & node = m_textures[handle];
+        if (node.is_transient())
+        {
+            assert(m_transient_textures[m_flight_index][handle].has_value());
+            return m_transient_textures[m_flight_index][handle].value();
+        }
+        return *node.m_imported_texture;
+    }
+
+    // computes lifetimes from the passes of this frame and creates the transients of every flight. returns true if
+    // they were (re)created, descriptors pointing to transients are stale then
+    bool
+    compile()
+    {
+        if (m_is_compiled)
+        {
+            return false;
+        }
+
+        // lifetimes
+        for (size_t i_pass = 0; i_pass < m_passes.size(); i_pass++)
+        {
+            for (const TextureUse & use : m_passes[i_pass].m_uses)
+            {
+                TextureNode & node = m_textures[use.m_handle];
+                if (!node.is_transient())
+                {
+                    continue;
+                }
+                if (node.m_first_pass == InvalidIndex)
+                {
+                    node.m_first_pass  = i_pass;
+                    node.m_first_state = use.m_state;
+                }
+                node.m_last_pass  = i_pass;
+                node.m_last_state = use.m_state;
+            }
+        }
+
+        // largest transients pick their memory first, a transient joins the first memory whose users it does not
+        // overlap with
+        std::vector<TextureHandle> sorted_handles;
+        for (TextureHandle handle = 0; handle < m_num_transients; handle++)
+        {
+            TextureNode & node = m_textures[handle];
+            if (node.m_first_pass == InvalidIndex)
+            {
+                Logger::Warn(__FUNCTION__, " ", m_name, " : ", node.m_name, " is not used by any pass");
+                continue;
+            }
+            node.m_memory_requirement = Rhi::Texture::GetMemoryRequirement(m_device, node.m_create_info.value());
+            sorted_handles.push_back(handle);
+        }
+        std::stable_sort(sorted_handles.begin(),
+                         sorted_handles.end(),
+                         [&](const TextureHandle a, const TextureHandle b)
+                         {
+                             return m_textures[a].m_memory_requirement.get_size_in_bytes() >
+                                    m_textures[b].m_memory_requirement.get_size_in_bytes();
+                         });
+
+        size_t num_dedicated_bytes = 0;
+        for (const TextureHandle handle : sorted_handles)
+        {
+            TextureNode & node = m_textures[handle];
+            num_dedicated_bytes += node.m_memory_requirement.get_size_in_bytes();
+            for (size_t i_block = 0; i_block < m_memory_blocks.size() && node.m_memory_index == InvalidIndex; i_block++)
+            {
+                MemoryBlock & block = m_memory_blocks[i_block];
+                if (!block.m_memory_requirement.is_compatible(node.m_memory_requirement) ||
+                    std::any_of(block.m_handles.begin(),
+                                block.m_handles.end(),
+                                [&](const TextureHandle other) { return m_textures[other].overlaps(node); }))
+                {
+                    continue;
+                }
+                block.m_memory_requirement = block.m_memory_requirement.merge(node.m_memory_requirement);
+                block.m_handles.push_back(handle);
+                node.m_memory_index = i_block;
+            }
+            if (node.m_memory_index == InvalidIndex)
+            {
+                node.m_memory_index = m_memory_blocks.size();
+                m_memory_blocks.push_back(MemoryBlock{ node.m_memory_requirement, { handle } });
+            }
+        }
+
+        for (MemoryBlock & block : m_memory_blocks)
+        {
+            std::sort(block.m_handles.begin(),
+                      block.m_handles.end(),
+                      [&](const TextureHandle a, const TextureHandle b)
+                      { return m_textures[a].m_first_pass < m_textures[b].m_first_pass; });
+            for (size_t i_handle = 0; i_handle < block.m_handles.size(); i_handle++)
+            {
+                TextureNode & node   = m_textures[block.m_handles[i_handle]];
+                node.m_prev_occupant = block.m_handles[(i_handle + block.m_handles.size() - 1) % block.m_handles.size()];
+                node.m_current_state = node.m_last_state;
+            }
+        }
+
+        // memories and the transients placed into them, for every flight. a transient is created in the state its
+        // last pass leaves it in, which is what the first frame expects
+        size_t num_allocated_bytes = 0;
+        m_memories.resize(m_num_flights);
+        m_transient_textures.resize(m_num_flights);
+        for (size_t i_flight = 0; i_flight < m_num_flights; i_flight++)
+        {
+            const std::string flight_name = m_name + "_flight" + std::to_string(i_flight);
+            m_memories[i_flight].reserve(m_memory_blocks.size());
+            m_transient_textures[i_flight].resize(m_num_transients);
+            for (size_t i_block = 0; i_block < m_memory_blocks.size(); i_block++)
+            {
+                const MemoryBlock &    block  = m_memory_blocks[i_block];
+                Rhi::AliasableMemory & memory = m_memories[i_flight].emplace_back(flight_name + "_memory_" +
+                                                                                      std::to_string(i_block),
+                                                                                  m_device,
+                                                                                  block.m_memory_requirement,
+                                                                                  Rhi::MemoryUsageEnum::GpuOnly);
+                num_allocated_bytes += memory.get_allocation_size_in_bytes();
+
+                for (const TextureHandle handle : block.m_handles)
+                {
+                    const TextureNode & node = m_textures[handle];
+                    assert(memory.can_support(node.m_memory_requirement));
+                    m_transient_textures[i_flight][handle].emplace(flight_name + "_" + node.m_name,
+                                                                   m_device,
+                                                                   node.m_create_info.value(),
+                                                                   node.m_last_state,
+                                                                   memory,
+                                                                   0);
+                }
+            }
+        }
+
+        // sizes of the allocations made above against one allocation per texture per flight, sized by the memory
+        // requirement the device reports for the texture, which is what the graph replaces
+        Logger::Info(__FUNCTION__,
+                     " ",
+                     m_name,
+                     " : ",
+                     sorted_handles.size(),
+                     " transients in ",
+                     m_memory_blocks.size(),
+                     " memories per flight, ",
+                     num_allocated_bytes / 1024,
+                     " KiB allocated for ",
+                     m_num_flights,
+                     " flights instead of ",
+                     num_dedicated_bytes * m_num_flights / 1024,
+                     " KiB with dedicated memory");
+
+        m_is_compiled = true;
+        return true;
+    }
+
+    void
+    execute(Rhi::CommandBuffer & cmd_buffer, GpuProfiler * gpu_profiler)
+    {
+        compile();
+
+        for (size_t i_pass = 0; i_pass < m_passes.size(); i_pass++)
+        {
+            const Pass & pass = m_passes[i_pass];
+            for (const TextureUse & use : pass.m_uses)
+            {
+                TextureNode & node = m_textures[use.m_handle];
+                assert(!node.is_transient() || (node.m_first_pass <= i_pass && i_pass <= node.m_last_pass));
+
+                // the first use of a transient waits for whatever used its memory last, in this frame or the
+                // previous frame of the flight, and discards the content
+                if (node.is_transient() && node.m_first_pass == i_pass && node.m_prev_occupant != use.m_handle)
+                {
+                    const TextureNode & prev_node = m_textures[node.m_prev_occupant];
+                    cmd_buffer.alias_texture(get_texture(node.m_prev_occupant),
+                                             prev_node.m_last_state,
+                                             get_texture(use.m_handle),
+                                             node.m_current_state,
+                                             use.m_state);
+                }
+                else if (node.m_current_state != use.m_state || use.m_state == Rhi::TextureStateEnum::ReadWrite)
+                {
+                    // writes of storage images are ordered even if the state stays the same
+                    cmd_buffer.transition_texture(get_texture(use.m_handle), node.m_current_state, use.m_state);
+                }
+                node.m_current_state = use.m_state;
+            }
+
+            GpuProfilingScope pass_scope(pass.m_name, cmd_buffer, gpu_profiler);
+            pass.m_execute(cmd_buffer);
+        }
+
+        // imports are handed back in the state the owner expects
+        for (size_t handle = m_num_transients; handle < m_textures.size(); handle++)
+        {
+            const TextureNode & node = m_textures[handle];
+            if (node.m_current_state != node.m_post_state)
+            {
+                cmd_buffer.transition_texture(*node.m_imported_texture, node.m_current_state, node.m_post_state);
+            }
+        }
+    }
+};
@@ -1,10 +1,13 @@
 #pragma once
 
+#include "core/file_watcher.h"
 #include "core/vmath.h"
+#include "engine_setting.h"
 #include "gpu_profiler.h"
 #include "passes/final_composite.h"
 #include "passes/path_tracing.h"
 #include "render_context.h"
+#include "render_graph.h"
 #include "rhi/rhi.h"
 #include "scene_resource.h"
 
@@ -14,72 +17,30 @@ struct Renderer
     {
         GpuProfiler m_gpu_profiler;
 
-        // GBuffer
-        Rhi::Texture m_depth_texture;
-        Rhi::Texture m_shading_normal_texture;
-        Rhi::Texture m_diffuse_reflectance_texture;
-        Rhi::Texture m_specular_reflectance_texture;
-        Rhi::Texture m_specular_roughness_texture;
-        Rhi::Texture m_diffuse_direct_result_texture;
-
         static constexpr uint32_t NumMaxProfilerMarkers = 500;
 
-        PerFlightRenderResource(const std::string & name, Rhi::Device & device, const int2 resolution)
-        : m_gpu_profiler(name + "_gpu_profiler", device, NumMaxProfilerMarkers),
-          m_depth_texture(name + "_gbuffer_depth_texture",
-                          device,
-                          Rhi::TextureCreateInfo(resolution.x,
-                                                 resolution.y,
-                                                 Rhi::FormatEnum::R32_SFloat,
-                                                 Rhi::TextureUsageEnum::StorageImage |
-                                                     Rhi::TextureUsageEnum::ColorAttachment),
-                          Rhi::TextureStateEnum::ReadWrite),
-          m_shading_normal_texture(name + "_gbuffer_normal_texture",
-                                   device,
-                                   Rhi::TextureCreateInfo(resolution.x,
-                                                          resolution.y,
-                                                          Rhi::FormatEnum::R16G16B16A16_SNorm,
-                                                          Rhi::TextureUsageEnum::StorageImage |
-                                                              Rhi::TextureUsageEnum::ColorAttachment),
-                                   Rhi::TextureStateEnum::ReadWrite),
-          m_diffuse_reflectance_texture(name + "_gbuffer_diffuse_reflectance_texture",
-                                        device,
-                                        Rhi::TextureCreateInfo(resolution.x,
-                                                               resolution.y,
-                                                               Rhi::FormatEnum::R11G11B10_UFloat,
-                                                               Rhi::TextureUsageEnum::StorageImage |
-                                                                   Rhi::TextureUsageEnum::ColorAttachment),
-                                        Rhi::TextureStateEnum::ReadWrite),
-          m_specular_reflectance_texture(name + "_gbuffer_specular_reflectance_texture",
-                                         device,
-                                         Rhi::TextureCreateInfo(resolution.x,
-                                                                resolution.y,
-                                                                Rhi::FormatEnum::R11G11B10_UFloat,
-                                                                Rhi::TextureUsageEnum::StorageImage |
-                                                                    Rhi::TextureUsageEnum::ColorAttachment),
-                                         Rhi::TextureStateEnum::ReadWrite),
-          m_specular_roughness_texture(name + "_gbuffer_roughness_texture",
-                                       device,
-                                       Rhi::TextureCreateInfo(resolution.x,
-                                                              resolution.y,
-                                                              Rhi::FormatEnum::R16_UNorm,
-                                                              Rhi::TextureUsageEnum::StorageImage |
-                                                                  Rhi::TextureUsageEnum::ColorAttachment),
-                                       Rhi::TextureStateEnum::ReadWrite),
-          m_diffuse_direct_result_texture(name + "_gbuffer_diffuse_direct_result_texture",
-                                          device,
-                                          Rhi::TextureCreateInfo(resolution.x,
-                                                                 resolution.y,
-                                                                 Rhi::FormatEnum::R11G11B10_UFloat,
-                                                                 Rhi::TextureUsageEnum::StorageImage |
-                                                                     Rhi::TextureUsageEnum::ColorAttachment),
-                                          Rhi::TextureStateEnum::ReadWrite)
+        PerFlightRenderResource(const std::string & name, Rhi::Device & device)
+        : m_gpu_profiler(name + "_gpu_profiler", device, NumMaxProfilerMarkers)
         {
         }
     };
 
+    // transient textures of the frame, owned by the render graph
+    struct FrameTextures
+    {
+        // GBuffer
+        RenderGraph::TextureHandle m_depth_texture;
+        RenderGraph::TextureHandle m_shading_normal_texture;
+        RenderGraph::TextureHandle m_diffuse_reflectance_texture;
+        RenderGraph::TextureHandle m_specular_reflectance_texture;
+        RenderGraph::TextureHandle m_specular_roughness_texture;
+        RenderGraph::TextureHandle m_diffuse_direct_result_texture;
+    };
+
     std::vector<Rhi::FramebufferBindings> m_raster_fbindings;
     std::vector<PerFlightRenderResource>  m_per_flight_resources;
+    RenderGraph                           m_render_graph;
+    FrameTextures                         m_frame_textures;
 
     GuiEventCoordinator & m_gui_event_coordinator;
     GpuProfilerGui        m_gpu_profiler_gui;
@@ -88,6 +49,10 @@ struct Renderer
     PathTracingPass             m_pass_path_tracing;
     RenderToFramebufferPass     m_pass_render_to_framebuffer;
 
+    // Shader hot reload
+    std::unique_ptr<FileWatcher> m_shader_file_watcher;
+    size_t                       m_frame_index = 0;
+
     Renderer(Rhi::Device &                               device,
              ShaderBinaryManager &                       shader_binary_manager,
              GuiEventCoordinator &                       gui_event_coordinator,
@@ -97,10 +62,18 @@ struct Renderer
     : m_raster_fbindings(ConstructFramebufferBinding(device, swapchain_attachment)),
       m_pass_path_tracing(device, shader_binary_manager, num_flights),
       m_pass_render_to_framebuffer(device, shader_binary_manager, m_raster_fbindings[0]),
-      m_per_flight_resources(ConstructPerFlightResource(device, resolution, num_flights)),
+      m_per_flight_resources(ConstructPerFlightResource(device, num_flights)),
+      m_render_graph("render_graph", device, num_flights),
+      m_frame_textures(DeclareFrameTextures(&m_render_graph, resolution)),
       m_gui_event_coordinator(gui_event_coordinator),
       m_gpu_profiler_gui(num_flights)
     {
+        if constexpr (EngineSetting::EnableShaderHotReload)
+        {
+            m_shader_file_watcher = std::make_unique<FileWatcher>(
+                BASE_SHADER_DIR,
+                std::chrono::milliseconds(static_cast<uint32_t>(EngineSetting::ShaderHotReloadIntervalInMs)));
+        }
     }
 
     static std::vector<Rhi::FramebufferBindings>
@@ -118,34 +91,90 @@ struct Renderer
     }
 
     static std::vector<PerFlightRenderResource>
-    ConstructPerFlightResource(Rhi::Device & device, const int2 resolution, const size_t num_flights)
+    ConstructPerFlightResource(Rhi::Device & device, const size_t num_flights)
     {
         std::vector<PerFlightRenderResource> result;
         result.reserve(num_flights);
         for (size_t i = 0; i < num_flights; i++)
         {
-            result.emplace_back("flight_" + std::to_string(i), device, resolution);
+            result.emplace_back("flight_" + std::to_string(i), device);
         }
         return result;
     }
 
+    static FrameTextures
+    DeclareFrameTextures(RenderGraph * render_graph, const int2 resolution)
+    {
+        const auto declare = [&](const std::string & name, const Rhi::FormatEnum format)
+        {
+            return render_graph->declare_texture(name,
+                                                 Rhi::TextureCreateInfo(resolution.x,
+                                                                        resolution.y,
+                                                                        format,
+                                                                        Rhi::TextureUsageEnum::StorageImage |
+                                                                            Rhi::TextureUsageEnum::ColorAttachment));
+        };
+
+        FrameTextures result;
+        result.m_depth_texture                 = declare("gbuffer_depth_texture", Rhi::FormatEnum::R32_SFloat);
+        result.m_shading_normal_texture        = declare("gbuffer_normal_texture", Rhi::FormatEnum::R16G16B16A16_SNorm);
+        result.m_diffuse_reflectance_texture   = declare("gbuffer_diffuse_reflectance_texture", Rhi::FormatEnum::R11G11B10_UFloat);
+        result.m_specular_reflectance_texture  = declare("gbuffer_specular_reflectance_texture", Rhi::FormatEnum::R11G11B10_UFloat);
+        result.m_specular_roughness_texture    = declare("gbuffer_roughness_texture", Rhi::FormatEnum::R16_UNorm);
+        result.m_diffuse_direct_result_texture = declare("gbuffer_diffuse_direct_result_texture", Rhi::FormatEnum::R11G11B10_UFloat);
+        return result;
+    }
+
     void
     resize(Rhi::Device &                                 device,
            const int2                                    resolution,
            ShaderBinaryManager &                         shader_binary_manager,
            const std::span<const Rhi::Texture * const> & swapchain_attachments,
-           const size_t                                  num_flights)
+           [[maybe_unused]] const size_t                 num_flights)
     {
-        m_raster_fbindings     = ConstructFramebufferBinding(device, swapchain_attachments);
-        m_per_flight_resources = ConstructPerFlightResource(device, resolution, num_flights);
-        m_pass_render_to_framebuffer.init_or_reload(device, shader_binary_manager, m_raster_fbindings[0]);
+        // a rebuild in flight references the framebuffer bindings, its result would not match the new ones
+        const bool is_reload_discarded = m_pass_render_to_framebuffer.discard_reload();
+        m_raster_fbindings             = ConstructFramebufferBinding(device, swapchain_attachments);
+        if (is_reload_discarded)
+        {
+            m_pass_render_to_framebuffer.reload(device, shader_binary_manager, m_raster_fbindings);
+        }
+
+        // transients are recreated at the new resolution by the next frame
+        m_render_graph.clear();
+        m_frame_textures = DeclareFrameTextures(&m_render_graph, resolution);
+        m_pass_path_tracing.reset_descriptors();
     }
 
     void
     loop(const RenderContext & ctx)
     {
         // Display the gui for params and human readable data
-        m_gpu_profiler_gui.draw_gui(m_gui_event_coordinator);
+        if (ctx.m_should_imgui_drawn)
+        {
+            m_gpu_profiler_gui.draw_gui(m_gui_event_coordinator);
+        }
+
+        // Rebuild pipelines whose shaders changed in background, finished rebuilds are swapped in here
+        {
+            const std::vector<std::filesystem::path> changed_shader_paths =
+                m_shader_file_watcher ? m_shader_file_watcher->take_changed_paths() : std::vector<std::filesystem::path>();
+            const size_t num_flights = m_per_flight_resources.size();
+            m_pass_path_tracing.hot_reload(ctx.m_device,
+                                           ctx.m_shader_binary_manager,
+                                           changed_shader_paths,
+                                           ctx.m_is_shaders_dirty,
+                                           m_frame_index,
+                                           num_flights);
+            m_pass_render_to_framebuffer.hot_reload(ctx.m_device,
+                                                    ctx.m_shader_binary_manager,
+                                                    m_raster_fbindings[0],
+                                                    changed_shader_paths,
+                                                    ctx.m_is_shaders_dirty,
+                                                    m_frame_index,
+                                                    num_flights);
+            m_frame_index++;
+        }
 
         PerFlightRenderResource & per_flight_render_resource = m_per_flight_resources[ctx.m_flight_index];
 
@@ -155,73 +184,108 @@ struct Renderer
             // Summarize the information recorded in the gpu profiler
             gpu_profiler = &per_flight_render_resource.m_gpu_profiler;
             gpu_profiler->summarize();
+            if (Trace::Get().is_active())
+            {
+                gpu_profiler->write_trace(CpuGpuClockCalibration(ctx.m_cpu_gpu_time, gpu_profiler->m_ns_from_timestamp));
+            }
 
             // Show the result of gpu profiler in a human readable format
             m_gpu_profiler_gui.update(gpu_profiler->m_profiling_intervals, gpu_profiler->m_ns_from_timestamp);
+            m_gpu_profiler_gui.update_upload_statistics(ctx.m_scene_resource.m_staging_ring.get_statistics());
 
             // Reset gpu profiler
             gpu_profiler->reset();
         }
 
+        m_render_graph.begin_frame(ctx.m_flight_index);
+
         // Begin recording command buffer for rendering
         Rhi::CommandBuffer cmd_buffer =
             ctx.m_per_flight_resource.m_graphics_command_pool.get_command_buffer();
         cmd_buffer.begin();
 
+        // Refit or rebuild the tlas for instances that moved, on the compute queue so it overlaps with the previous
+        // frame, which is still being rendered
+        ctx.m_scene_resource.update_tlas(ctx.m_per_flight_resource.m_compute_command_pool, &cmd_buffer, ctx.m_flight_index);
+
         {
             GpuProfilingScope rendering("Rendering", cmd_buffer, gpu_profiler);
 
-            // Direct Light & GI Pass
+            // Take over geometry and textures uploaded on the transfer queue since the last frame
             {
-                GpuProfilingScope direct_light_scope("Path Tracing", cmd_buffer, gpu_profiler);
-                m_pass_path_tracing.render(cmd_buffer,
-                                           ctx,
-                                           per_flight_render_resource.m_diffuse_direct_result_texture,
-                                           per_flight_render_resource.m_depth_texture,
-                                           per_flight_render_resource.m_shading_normal_texture,
-                                           per_flight_render_resource.m_diffuse_reflectance_texture,
-                                           per_flight_render_resource.m_specular_reflectance_texture,
-                                           per_flight_render_resource.m_specular_roughness_texture,
-                                           ctx.m_resolution);
+                GpuProfilingScope acquire_scope("Acquire uploads", cmd_buffer, gpu_profiler);
+                ctx.m_scene_resource.acquire_uploads(&cmd_buffer);
             }
 
-            // Transition
-            {
-                GpuProfilingScope transit_scope("Transit present to color attachment", cmd_buffer, gpu_profiler);
-                cmd_buffer.transition_texture(ctx.m_per_swap_resource.m_swapchain_texture,
-                                              Rhi::TextureStateEnum::Present,
-                                              Rhi::TextureStateEnum::ColorAttachment);
-            }
+            // Passes declare the textures they use, the render graph places the barriers between them
+            const FrameTextures &            textures = m_frame_textures;
+            const RenderGraph::TextureHandle swapchain_texture =
+                m_render_graph.import_texture("swapchain_texture",
+                                              ctx.m_per_swap_resource.m_swapchain_texture,
+                                              ctx.m_per_swap_resource.m_idle_state,
+                                              ctx.m_per_swap_resource.m_idle_state);
+
+            // Direct Light & GI Pass
+            m_render_graph.add_pass("Path Tracing",
+                                    { { textures.m_diffuse_direct_result_texture, Rhi::TextureStateEnum::ReadWrite },
+                                      { textures.m_depth_texture, Rhi::TextureStateEnum::ReadWrite },
+                                      { textures.m_shading_normal_texture, Rhi::TextureStateEnum::ReadWrite },
+                                      { textures.m_diffuse_reflectance_texture, Rhi::TextureStateEnum::ReadWrite },
+                                      { textures.m_specular_reflectance_texture, Rhi::TextureStateEnum::ReadWrite },
+                                      { textures.m_specular_roughness_texture, Rhi::TextureStateEnum::ReadWrite } },
+                                    [&](Rhi::CommandBuffer & pass_cmd_buffer)
+                                    {
+                                        m_pass_path_tracing.render(pass_cmd_buffer,
+                                                                   ctx,
+                                                                   m_render_graph.get_texture(textures.m_diffuse_direct_result_texture),
+                                                                   m_render_graph.get_texture(textures.m_depth_texture),
+                                                                   m_render_graph.get_texture(textures.m_shading_normal_texture),
+                                                                   m_render_graph.get_texture(textures.m_diffuse_reflectance_texture),
+                                                                   m_render_graph.get_texture(textures.m_specular_reflectance_texture),
+                                                                   m_render_graph.get_texture(textures.m_specular_roughness_texture),
+                                                                   ctx.m_resolution);
+                                    });
 
             // Run final pass
-            {
-                GpuProfilingScope render_to_framebuffer_scope("Render rtresult to framebuffer", cmd_buffer, gpu_profiler);
-                m_pass_render_to_framebuffer.run(cmd_buffer,
-                                                 ctx,
-                                                 per_flight_render_resource.m_diffuse_direct_result_texture,
-                                                 m_raster_fbindings[ctx.m_image_index]);
-            }
+            m_render_graph.add_pass("Render rtresult to framebuffer",
+                                    { { textures.m_diffuse_direct_result_texture, Rhi::TextureStateEnum::ReadOnly },
+                                      { swapchain_texture, Rhi::TextureStateEnum::ColorAttachment } },
+                                    [&](Rhi::CommandBuffer & pass_cmd_buffer)
+                                    {
+                                        m_pass_render_to_framebuffer.run(pass_cmd_buffer,
+                                                                         ctx,
+                                                                         m_render_graph.get_texture(textures.m_diffuse_direct_result_texture),
+                                                                         m_raster_fbindings[ctx.m_image_index]);
+                                    });
 
             // Render imgui onto swapchain
             if (ctx.m_should_imgui_drawn)
             {
-                GpuProfilingScope imgui_scope("Imgui", cmd_buffer, gpu_profiler);
-                cmd_buffer.render_imgui(ctx.m_imgui_render_pass, ctx.m_image_index);
+                m_render_graph.add_pass("Imgui",
+                                        { { swapchain_texture, Rhi::TextureStateEnum::ColorAttachment } },
+                                        [&](Rhi::CommandBuffer & pass_cmd_buffer)
+                                        { pass_cmd_buffer.render_imgui(*ctx.m_imgui_render_pass, ctx.m_image_index); });
             }
 
-            // Transition
+            // Transients are created by the first frame, the descriptors of every flight point to the old ones then
+            if (m_render_graph.compile())
             {
-                GpuProfilingScope transit_scope("Transit swapchain for present", cmd_buffer, gpu_profiler);
-                cmd_buffer.transition_texture(ctx.m_per_swap_resource.m_swapchain_texture,
-                                              Rhi::TextureStateEnum::ColorAttachment,
-                                              Rhi::TextureStateEnum::Present);
+                m_pass_path_tracing.reset_descriptors();
             }
+            m_render_graph.execute(cmd_buffer, gpu_profiler);
         }
 
-        // End recording
+        // End recording, an offscreen target is neither acquired nor presented
         cmd_buffer.end();
-        cmd_buffer.submit(&ctx.m_per_flight_resource.m_flight_fence,
-                          &ctx.m_per_flight_resource.m_image_ready_semaphore,
-                          &ctx.m_per_flight_resource.m_image_presentable_semaphore);
+        if (ctx.m_per_swap_resource.is_presentable())
+        {
+            cmd_buffer.submit(&ctx.m_per_flight_resource.m_flight_fence,
+                              &ctx.m_per_flight_resource.m_image_ready_semaphore,
+                              &ctx.m_per_flight_resource.m_image_presentable_semaphore);
+        }
+        else
+        {
+            cmd_buffer.submit(&ctx.m_per_flight_resource.m_flight_fence);
+        }
     }
 };
\ No newline at end of file
@@ -0,0 +1,260 @@
+#pragma once
+
+#include "core/camera.h"
+#include "core/gui_event_coordinator.h"
+#include "core/json.h"
+#include "core/logger.h"
+#include "core/stopwatch.h"
+#include "mainloop.h"
+#include "pch/pch.h"
+
+// renders the demo scene into offscreen targets while a camera path is replayed, then writes the cpu frame times and
+// the gpu time of every profiling scope as json. no window or swapchain is created, so it also runs on a software
+// implementation such as lavapipe
+struct RenderBenchmark
+{
+    struct Settings
+    {
+        std::filesystem::path m_camera_path         = "scenes/sponza/benchmark_camera_path.txt";
+        std::filesystem::path m_output_path         = "benchmark.json";
+        size_t                m_num_warm_up_frames  = 60;
+        size_t                m_num_measured_frames = 300;
+        int2                  m_resolution          = int2(1920, 1080);
+    };
+
+    struct Percentiles
+    {
+        float m_mean = 0.0f;
+        float m_p50  = 0.0f;
+        float m_p95  = 0.0f;
+        float m_p99  = 0.0f;
+    };
+
+    Rhi::Device &                  m_device;
+    ShaderBinaryManager &          m_shader_binary_manager;
+    Settings                       m_settings;
+    size_t                         m_num_flights;
+    GuiEventCoordinator            m_gui_event_coordinator;
+    Rhi::StagingBufferManager      m_staging_buffer_manager;
+    std::vector<PerFlightResource> m_per_flight_resources;
+    // one offscreen target per flight, standing in for the swapchain images
+    std::vector<PerSwapResource> m_per_swap_resources;
+    SceneResource                m_scene_resource;
+    FpsCamera                    m_camera;
+    Renderer                     m_renderer;
+
+    RenderBenchmark(Rhi::Device &         device,
+                    const size_t          num_flights,
+                    ShaderBinaryManager & shader_binary_manager,
+                    const Settings &      settings)
+    : m_device(device),
+      m_shader_binary_manager(shader_binary_manager),
+      m_settings(settings),
+      m_num_flights(num_flights),
+      m_staging_buffer_manager("benchmark_staging_buffer_manager", device),
+      m_per_flight_resources(MainLoop::construct_per_flight_resources("benchmark_flight_resource", device, num_flights)),
+      m_per_swap_resources(ConstructOffscreenResources("benchmark_swap_resources", device, num_flights, settings.m_resolution)),
+      m_scene_resource(device, num_flights),
+      m_camera(float3(10.0f, 10.0f, 10.0f),
+               float3(0.0f, 0.0f, 0.0f),
+               float3(0.0f, 1.0f, 0.0f),
+               radians(60.0f),
+               static_cast<float>(settings.m_resolution.x) / static_cast<float>(settings.m_resolution.y)),
+      m_renderer(device,
+                 shader_binary_manager,
+                 m_gui_event_coordinator,
+                 MainLoop::get_swapchain_textures(m_per_swap_resources),
+                 settings.m_resolution,
+                 num_flights)
+    {
+    }
+
+    static std::vector<PerSwapResource>
+    ConstructOffscreenResources(const std::string & name, Rhi::Device & device, const size_t num_images, const int2 resolution)
+    {
+        std::vector<PerSwapResource> result;
+        result.reserve(num_images);
+        for (size_t i_image = 0; i_image < num_images; i_image++)
+        {
+            result.emplace_back(name + "_offscreen" + std::to_string(i_image), device, resolution);
+        }
+        return result;
+    }
+
+    // nearest rank percentiles
+    static Percentiles
+    ComputePercentiles(std::vector<float> samples)
+    {
+        Percentiles result;
+        if (samples.empty())
+        {
+            return result;
+        }
+        std::sort(samples.begin(), samples.end());
+        const auto percentile = [&](const float p)
+        {
+            const size_t rank = static_cast<size_t>(std::ceil(p / 100.0f * static_cast<float>(samples.size())));
+            return samples[std::clamp(rank, size_t(1), samples.size()) - 1];
+        };
+        result.m_mean = std::accumulate(samples.begin(), samples.end(), 0.0f) / static_cast<float>(samples.size());
+        result.m_p50  = percentile(50.0f);
+        result.m_p95  = percentile(95.0f);
+        result.m_p99  = percentile(99.0f);
+        return result;
+    }
+
+    // the warm-up frames stay on the first keyframe, the measured frames go along the whole path. the gpu times of a
+    // frame are read back when its flight comes around again, so num_flights more frames are rendered after the
+    // measured ones to collect them
+    void
+    run()
+    {
+        assert(m_settings.m_num_measured_frames > 0);
+        const CameraPath camera_path = CameraPath::Load(m_settings.m_camera_path);
+
+        const urange32_t          sponza_geometries  = m_scene_resource.add_geometries("scenes/sponza/sponza.obj");
+        std::array<urange32_t, 1> ranges             = { sponza_geometries };
+        const size_t              sponza_instance_id = m_scene_resource.add_base_instance(ranges);
+        m_scene_resource.commit(MainLoop::ConstructDemoSceneDesc(sponza_instance_id), m_staging_buffer_manager);
+
+        const size_t num_warm_up_frames  = m_settings.m_num_warm_up_frames;
+        const size_t num_measured_frames = m_settings.m_num_measured_frames;
+        const size_t num_frames          = num_warm_up_frames + num_measured_frames + m_num_flights;
+        Logger::Info(__FUNCTION__,
+                     " ",
+                     num_warm_up_frames,
+                     " warm-up and ",
+                     num_measured_frames,
+                     " measured frames at ",
+                     m_settings.m_resolution.x,
+                     "x",
+                     m_settings.m_resolution.y);
+
+        std::vector<float>                        cpu_frame_ms;
+        std::vector<float>                        cpu_record_ms;
+        std::map<std::string, std::vector<float>> gpu_ms_of_scopes;
+        StopWatch                                 frame_stop_watch;
+        for (size_t i_frame = 0; i_frame < num_frames; i_frame++)
+        {
+            // a frame lasts until the next one begins, waiting for its flight included
+            const float frame_ms = static_cast<float>(frame_stop_watch.time_micro_sec()) / 1000.0f;
+            frame_stop_watch.reset();
+            if (i_frame > num_warm_up_frames && i_frame <= num_warm_up_frames + num_measured_frames)
+            {
+                cpu_frame_ms.push_back(frame_ms);
+            }
+
+            const size_t        i_flight            = i_frame % m_num_flights;
+            PerFlightResource & per_flight_resource = m_per_flight_resources[i_flight];
+            per_flight_resource.wait();
+            per_flight_resource.reset();
+
+            const size_t i_path_frame = std::clamp(i_frame, num_warm_up_frames, num_warm_up_frames + num_measured_frames - 1) -
+                                        num_warm_up_frames;
+            camera_path.apply(&m_camera,
+                              static_cast<float>(i_path_frame) /
+                                  static_cast<float>(std::max(num_measured_frames, size_t(2)) - 1));
+
+            RenderContext ctx(m_device,
+                              per_flight_resource,
+                              m_per_swap_resources[i_flight],
+                              m_staging_buffer_manager,
+                              nullptr,
+                              m_shader_binary_manager,
+                              i_flight,
+                              i_flight,
+                              m_settings.m_resolution,
+                              m_scene_resource,
+                              m_camera,
+                              false,
+                              false,
+                              true,
+                              std::make_pair(uint64_t(0), uint64_t(0)));
+
+            StopWatch record_stop_watch;
+            m_renderer.loop(ctx);
+            if (i_frame >= num_warm_up_frames && i_frame < num_warm_up_frames + num_measured_frames)
+            {
+                cpu_record_ms.push_back(static_cast<float>(record_stop_watch.time_micro_sec()) / 1000.0f);
+            }
+
+            // summarized by this frame, recorded num_flights frames ago. scopes recorded more than once in a frame
+            // are summed up
+            if (i_frame >= num_warm_up_frames + m_num_flights)
+            {
+                const float ms_from_timestamp = m_renderer.m_gpu_profiler_gui.m_ns_from_timestamp / 1000000.0f;
+                std::map<std::string, float> gpu_ms_of_frame;
+                for (const GpuProfilingInterval & interval : m_renderer.m_gpu_profiler_gui.get_latest_profiling_intervals())
+                {
+                    if (interval.m_end_timestamp != std::numeric_limits<uint64_t>::max())
+                    {
+                        gpu_ms_of_frame[interval.m_name] +=
+                            static_cast<float>(interval.m_end_timestamp - interval.m_begin_timestamp) * ms_from_timestamp;
+                    }
+                }
+                for (const auto & [name, ms] : gpu_ms_of_frame)
+                {
+                    gpu_ms_of_scopes[name].push_back(ms);
+                }
+            }
+        }
+
+        // wait until all resource are not used
+        for (PerFlightResource & per_flight_resource : m_per_flight_resources)
+        {
+            per_flight_resource.wait();
+        }
+
+        write_json(ComputePercentiles(cpu_frame_ms), ComputePercentiles(cpu_record_ms), gpu_ms_of_scopes);
+    }
+
+private:
+    void
+    write_json(const Percentiles &                               cpu_frame_ms,
+               const Percentiles &                               cpu_record_ms,
+               const std::map<std::string, std::vector<float>> & gpu_ms_of_scopes) const
+    {
+        const auto write_percentiles = [](std::ostream & stream, const Percentiles & percentiles)
+        {
+            stream << "{\"mean\":" << percentiles.m_mean << ",\"p50\":" << percentiles.m_p50 << ",\"p95\":"
+                   << percentiles.m_p95 << ",\"p99\":" << percentiles.m_p99 << "}";
+        };
+
+        std::ofstream stream(m_settings.m_output_path, std::ios::trunc);
+        if (!stream.is_open())
+        {
+            Logger::Error<true>(__FUNCTION__, " cannot open ", m_settings.m_output_path.string());
+        }
+        stream << "{\n";
+        stream << "\"resolution\":[" << m_settings.m_resolution.x << "," << m_settings.m_resolution.y << "],\n";
+        stream << "\"num_warm_up_frames\":" << m_settings.m_num_warm_up_frames << ",\n";
+        stream << "\"num_measured_frames\":" << m_settings.m_num_measured_frames << ",\n";
+        stream << "\"cpu_frame_ms\":";
+        write_percentiles(stream, cpu_frame_ms);
+        stream << ",\n\"cpu_record_ms\":";
+        write_percentiles(stream, cpu_record_ms);
+        stream << ",\n\"gpu_ms\":{";
+        bool need_comma = false;
+        for (const auto & [name, samples] : gpu_ms_of_scopes)
+        {
+            const Percentiles percentiles = ComputePercentiles(samples);
+            stream << (need_comma ? ",\n" : "\n");
+            Json::WriteString(stream, name);
+            stream << ":";
+            write_percentiles(stream, percentiles);
+            need_comma = true;
+            Logger::Info(__FUNCTION__, " gpu ", name, " : p50 ", percentiles.m_p50, " ms, p99 ", percentiles.m_p99, " ms");
+        }
+        stream << "\n}\n}\n";
+
+        Logger::Info(__FUNCTION__,
+                     " cpu frame : p50 ",
+                     cpu_frame_ms.m_p50,
+                     " ms, p95 ",
+                     cpu_frame_ms.m_p95,
+                     " ms, p99 ",
+                     cpu_frame_ms.m_p99,
+                     " ms, written to ",
+                     m_settings.m_output_path.string());
+    }
+};
@@ -145,7 +145,9 @@ enum class FormatEnum
     R32_UInt,
     R8G8B8A8_UNorm_Srgb,
     R8G8B8A8_UNorm,
-    R8_UNorm
+    R8_UNorm,
+    BC1_UNorm_Srgb,
+    BC4_UNorm
 };
 
 enum class IndexType
@@ -168,6 +170,8 @@ GetSizeInBytes(const FormatEnum & format_enum)
         return sizeof(float) * 3;
     case FormatEnum::R32G32B32A32_SFloat:
         return sizeof(float) * 4;
+    case FormatEnum::R16G16B16A16_SNorm:
+        return sizeof(int16_t) * 4;
     default:
         assert(false); // unhandled case
         return 0;
@@ -328,6 +332,48 @@ struct EnumHelper
             return 0;
         }
     }
+
+    template <typename FormatEnum>
+    static bool
+    IsBlockCompressed(FormatEnum texture_type)
+    {
+        return texture_type == FormatEnum::BC1_UNorm_Srgb || texture_type == FormatEnum::BC4_UNorm;
+    }
+
+    // size of one 4x4 block of a block compressed format
+    template <typename FormatEnum>
+    static size_t
+    GetSizeInBytesPerBlock(FormatEnum texture_type)
+    {
+        switch (texture_type)
+        {
+        case FormatEnum::BC1_UNorm_Srgb:
+        case FormatEnum::BC4_UNorm:
+            return 8;
+        default:
+            Logger::Critical<true>(__FUNCTION__, " found unhandled texture type ", static_cast<int>(texture_type));
+            return 0;
+        }
+    }
+
+    template <typename FormatEnum>
+    static size_t
+    GetNumChannels(FormatEnum texture_type)
+    {
+        switch (texture_type)
+        {
+        case FormatEnum::R8_UNorm:
+        case FormatEnum::BC4_UNorm:
+            return 1;
+        case FormatEnum::R8G8B8A8_UNorm:
+        case FormatEnum::R8G8B8A8_UNorm_Srgb:
+        case FormatEnum::BC1_UNorm_Srgb:
+            return 4;
+        default:
+            Logger::Critical<true>(__FUNCTION__, " found unhandled texture type ", static_cast<int>(texture_type));
+            return 0;
+        }
+    }
 };
 
 #ifdef USE_DXA
@@ -396,9 +442,10 @@ namespace VKA_NAME
 {
 enum class QueryType : uint32_t
 {
-    Occlusion          = VK_QUERY_TYPE_OCCLUSION,
-    PipelineStatistics = VK_QUERY_TYPE_PIPELINE_STATISTICS,
-    Timestamp          = VK_QUERY_TYPE_TIMESTAMP
+    Occlusion                          = VK_QUERY_TYPE_OCCLUSION,
+    PipelineStatistics                 = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+    Timestamp                          = VK_QUERY_TYPE_TIMESTAMP,
+    AccelerationStructureCompactedSize = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR
 };
 }
 #endif
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "dxa_aliasable_memory.h"
 #include "dxa_buffer.h"
 #include "dxa_command_buffer.h"
 #include "dxa_command_pool.h"
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "dxa_common.h"
+#ifdef USE_DXA
+
+    #include "dxa_device.h"
+
+namespace DXA_NAME
+{
+struct MemoryRequirement
+{
+    D3D12_RESOURCE_ALLOCATION_INFO m_dx_allocation_info = { 0, 0 };
+    // heaps of resource heap tier 1 only hold one category of resources
+    D3D12_HEAP_FLAGS m_dx_heap_flags = D3D12_HEAP_FLAG_NONE;
+
+    bool
+    can_support(const MemoryRequirement & requirement) const
+    {
+        if (m_dx_allocation_info.Alignment < requirement.m_dx_allocation_info.Alignment)
+        {
+            return false;
+        }
+        if (m_dx_allocation_info.Alignment % requirement.m_dx_allocation_info.Alignment > 0)
+        {
+            return false;
+        }
+        if (m_dx_allocation_info.SizeInBytes < requirement.m_dx_allocation_info.SizeInBytes)
+        {
+            return false;
+        }
+        return is_compatible(requirement);
+    }
+
+    // a requirement every resource matching either of the two can be bound to
+    MemoryRequirement
+    merge(const MemoryRequirement & requirement) const
+    {
+        MemoryRequirement result;
+        result.m_dx_allocation_info.SizeInBytes =
+            std::max(m_dx_allocation_info.SizeInBytes, requirement.m_dx_allocation_info.SizeInBytes);
+        result.m_dx_allocation_info.Alignment =
+            std::max(m_dx_allocation_info.Alignment, requirement.m_dx_allocation_info.Alignment);
+        result.m_dx_heap_flags = m_dx_heap_flags;
+        return result;
+    }
+
+    bool
+    is_compatible(const MemoryRequirement & requirement) const
+    {
+        return m_dx_heap_flags == requirement.m_dx_heap_flags;
+    }
+
+    size_t
+    get_size_in_bytes() const
+    {
+        return static_cast<size_t>(m_dx_allocation_info.SizeInBytes);
+    }
+};
+
+struct AliasableMemory
+{
+    D3D12MAHandle<D3D12MA::Allocation> m_allocation;
+    MemoryRequirement                  m_memory_requirement;
+    std::string                        m_name;
+
+    AliasableMemory(const std::string &       name,
+                    const Device &            device,
+                    const MemoryRequirement & memory_requirement,
+                    const MemoryUsageEnum     memory_usage)
+    : m_allocation(ConstructAllocation(device, memory_requirement, memory_usage)),
+      m_memory_requirement(memory_requirement),
+      m_name(name)
+    {
+    }
+
+    static D3D12MAHandle<D3D12MA::Allocation>
+    ConstructAllocation(const Device & device, const MemoryRequirement & memory_requirement, const MemoryUsageEnum memory_usage)
+    {
+        assert(memory_usage == MemoryUsageEnum::GpuOnly);
+
+        D3D12MA::ALLOCATION_DESC alloc_desc = {};
+        alloc_desc.HeapType                 = D3D12_HEAP_TYPE_DEFAULT;
+        alloc_desc.ExtraHeapFlags           = memory_requirement.m_dx_heap_flags;
+
+        D3D12MA::Allocation * allocation = nullptr;
+        DXCK(device.m_d3d12ma->AllocateMemory(&alloc_desc, &memory_requirement.m_dx_allocation_info, &allocation));
+        return D3D12MAHandle<D3D12MA::Allocation>(allocation);
+    }
+
+    bool
+    can_support(const MemoryRequirement & requirement) const
+    {
+        return m_memory_requirement.can_support(requirement);
+    }
+
+    // size of the allocation d3d12ma made, which may be larger than the requirement
+    size_t
+    get_allocation_size_in_bytes() const
+    {
+        return static_cast<size_t>(m_allocation->GetSize());
+    }
+};
+} // namespace DXA_NAME
+#endif
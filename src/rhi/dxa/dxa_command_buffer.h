@@ -22,6 +22,12 @@ namespace DXA_NAME
 {
 struct CommandBuffer
 {
+    struct TimelineSemaphorePoint
+    {
+        ID3D12Fence * m_dx_fence;
+        uint64_t      m_value;
+    };
+
     // allocator holds the memory
     // command list is the interface
     // while command list can be reused, reusing makes designing the api quite difficult.
@@ -32,6 +38,8 @@ struct CommandBuffer
     // TODO:: avoid std::list
     std::list<std::vector<D3D12_VERTEX_BUFFER_VIEW>> m_bound_vertex_buffer_views;
     ID3D12RootSignature *                            m_dx_root_signature = nullptr;
+    std::vector<TimelineSemaphorePoint>              m_timeline_waits;
+    std::vector<TimelineSemaphorePoint>              m_timeline_signals;
 
     CommandBuffer() {}
 
@@ -246,12 +254,16 @@ struct CommandBuffer
                            const uint3     dst_offset,
                            const Buffer &  src_buffer,
                            const size_t    src_offset_in_bytes,
-                           const size_t    row_pitch_in_bytes)
+                           const size_t    row_pitch_in_bytes,
+                           const uint32_t  mip_level = 0)
     {
+        // footprint of block compressed formats is in whole 4x4 blocks
+        const bool is_block_compressed = dst_texture.m_dx_format == DXGI_FORMAT_BC1_UNORM_SRGB ||
+                                         dst_texture.m_dx_format == DXGI_FORMAT_BC4_UNORM;
         D3D12_SUBRESOURCE_FOOTPRINT pitched_desc{};
         pitched_desc.Format   = dst_texture.m_dx_format;
-        pitched_desc.Width    = dst_size.x;
-        pitched_desc.Height   = dst_size.y;
+        pitched_desc.Width    = is_block_compressed ? (dst_size.x + 3) & ~3u : dst_size.x;
+        pitched_desc.Height   = is_block_compressed ? (dst_size.y + 3) & ~3u : dst_size.y;
         pitched_desc.Depth    = dst_size.z;
         pitched_desc.RowPitch = row_pitch_in_bytes;
 
@@ -259,7 +271,7 @@ struct CommandBuffer
         placed_texture.Offset    = src_offset_in_bytes;
         placed_texture.Footprint = pitched_desc;
 
-        CD3DX12_TEXTURE_COPY_LOCATION dst(dst_texture.m_dx_resource, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION dst(dst_texture.m_dx_resource, mip_level);
         CD3DX12_TEXTURE_COPY_LOCATION src(src_buffer.m_allocation->GetResource(), placed_texture);
 
         m_dx_command_list->CopyTextureRegion(&dst, dst_offset.x, dst_offset.y, dst_offset.z, &src, nullptr);
@@ -354,6 +366,20 @@ struct CommandBuffer
         ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), m_dx_command_list.Get());
     }
 
+    // the next submit waits on the device until semaphore reaches value
+    void
+    wait_timeline_semaphore(const TimelineSemaphore & semaphore, const uint64_t value)
+    {
+        m_timeline_waits.push_back({ semaphore.m_dx_fence.Get(), value });
+    }
+
+    // the next submit sets semaphore to value once its commands have finished
+    void
+    signal_timeline_semaphore(const TimelineSemaphore & semaphore, const uint64_t value)
+    {
+        m_timeline_signals.push_back({ semaphore.m_dx_fence.Get(), value });
+    }
+
     void
     submit(Fence * fence, Semaphore * semaphore_wait = nullptr, Semaphore * semaphore_signal = nullptr)
     {
@@ -362,7 +388,17 @@ struct CommandBuffer
         {
             DXCK(m_dx_command_queue->Wait(semaphore_wait->m_dx_fence.Get(), semaphore_wait->m_expected_fence_value));
         }
+        for (const TimelineSemaphorePoint & timeline_wait : m_timeline_waits)
+        {
+            DXCK(m_dx_command_queue->Wait(timeline_wait.m_dx_fence, timeline_wait.m_value));
+        }
         m_dx_command_queue->ExecuteCommandLists(_countof(command_lists), command_lists);
+        for (const TimelineSemaphorePoint & timeline_signal : m_timeline_signals)
+        {
+            DXCK(m_dx_command_queue->Signal(timeline_signal.m_dx_fence, timeline_signal.m_value));
+        }
+        m_timeline_waits.clear();
+        m_timeline_signals.clear();
         if (fence)
         {
             // make sure the fence is not in the signaled state
@@ -376,6 +412,43 @@ struct CommandBuffer
         }
     }
 
+    // d3d12 has no queue family ownership, a buffer written on the copy queue decays to the common state and is
+    // promoted implicitly on the queue reading it. kept for parity with vka
+    void
+    transfer_buffer_ownership([[maybe_unused]] const Device &  device,
+                              [[maybe_unused]] const Buffer &  buffer,
+                              [[maybe_unused]] const size_t    offset_in_bytes,
+                              [[maybe_unused]] const size_t    size_in_bytes,
+                              [[maybe_unused]] const QueueType src_queue_type,
+                              [[maybe_unused]] const QueueType dst_queue_type,
+                              [[maybe_unused]] const bool      is_release)
+    {
+    }
+
+    // same for textures, copy queues cannot transition into shader resource states so the texture is promoted from
+    // the common state by its first read
+    void
+    transfer_texture_ownership([[maybe_unused]] const Device &         device,
+                               [[maybe_unused]] const Texture &        texture,
+                               [[maybe_unused]] const TextureStateEnum pre_enum,
+                               [[maybe_unused]] const TextureStateEnum post_enum,
+                               [[maybe_unused]] const QueueType        src_queue_type,
+                               [[maybe_unused]] const QueueType        dst_queue_type,
+                               [[maybe_unused]] const bool             is_release)
+    {
+    }
+
+    // rebuild or refit of a tlas from instances the host wrote into instance_buffer before submitting this buffer
+    void
+    build_tlas(RayTracingTlas & tlas,
+               const Buffer &   instance_buffer,
+               const size_t     offset_in_bytes,
+               const uint32_t   num_instances,
+               const bool       is_refit)
+    {
+        tlas.record_build(m_dx_command_list.Get(), instance_buffer, offset_in_bytes, num_instances, is_refit);
+    }
+
     void
     trace_rays(const RayTracingShaderTable & shader_table,
                const size_t                  width  = 1,
@@ -405,6 +478,19 @@ struct CommandBuffer
     void
     transition_texture(const Texture & texture, const TextureStateEnum pre_enum, const TextureStateEnum post_enum)
     {
+        // a transition needs different states, accesses within one state only need to be ordered for uavs
+        if (pre_enum == post_enum)
+        {
+            if (pre_enum == TextureStateEnum::ReadWrite)
+            {
+                D3D12_RESOURCE_BARRIER barrier{};
+                barrier.Type          = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+                barrier.UAV.pResource = texture.m_dx_resource;
+                m_dx_command_list->ResourceBarrier(1, &barrier);
+            }
+            return;
+        }
+
         D3D12_RESOURCE_BARRIER barrier{};
         barrier.Transition.pResource   = texture.m_dx_resource;
         barrier.Transition.StateBefore = GetD3D12_RESOURCE_STATES(pre_enum);
@@ -413,6 +499,29 @@ struct CommandBuffer
         m_dx_command_list->ResourceBarrier(1, &barrier);
     }
 
+    // next_texture starts using memory that prev_texture last used in prev_state, next_texture was last left in
+    // next_pre_state. the content of next_texture is discarded
+    void
+    alias_texture(const Texture &                         prev_texture,
+                  [[maybe_unused]] const TextureStateEnum prev_enum,
+                  const Texture &                         next_texture,
+                  const TextureStateEnum                  next_pre_enum,
+                  const TextureStateEnum                  next_post_enum)
+    {
+        D3D12_RESOURCE_BARRIER barrier{};
+        barrier.Type                     = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+        barrier.Aliasing.pResourceBefore = prev_texture.m_dx_resource;
+        barrier.Aliasing.pResourceAfter  = next_texture.m_dx_resource;
+        m_dx_command_list->ResourceBarrier(1, &barrier);
+        transition_texture(next_texture, next_pre_enum, next_post_enum);
+
+        // render target and uav textures must be initialized after they are aliased in
+        if (next_post_enum == TextureStateEnum::ColorAttachment || next_post_enum == TextureStateEnum::ReadWrite)
+        {
+            m_dx_command_list->DiscardResource(next_texture.m_dx_resource, nullptr);
+        }
+    }
+
     void
     update_push_constant(const void * data, const size_t size_in_bytes)
     {
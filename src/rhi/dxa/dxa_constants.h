@@ -91,6 +91,10 @@ GetDXGI_FORMAT(const Rhi::FormatEnum format)
         return DXGI_FORMAT_R8G8B8A8_UNORM;
     case Rhi::FormatEnum::R8_UNorm:
         return DXGI_FORMAT_R8_UNORM;
+    case Rhi::FormatEnum::BC1_UNorm_Srgb:
+        return DXGI_FORMAT_BC1_UNORM_SRGB;
+    case Rhi::FormatEnum::BC4_UNorm:
+        return DXGI_FORMAT_BC4_UNORM;
     default:
         assert(false && "Program should not reach this line");
         return DXGI_FORMAT_UNKNOWN;
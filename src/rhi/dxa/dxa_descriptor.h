@@ -258,7 +258,7 @@ struct DescriptorSet
         srv_desc.Shader4ComponentMapping         = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
         srv_desc.Format                          = GetColorFormat(texture.m_dx_format);
         srv_desc.ViewDimension                   = D3D12_SRV_DIMENSION_TEXTURE2D;
-        srv_desc.Texture2D.MipLevels             = 1;
+        srv_desc.Texture2D.MipLevels             = static_cast<UINT>(-1);
         std::optional<DescriptorHandle> handle =
             request_handle(D3D_SIT_TEXTURE, m_descriptor_pool.m_cbv_srv_uav_heap, binding, i_texture);
         if (handle.has_value())
@@ -150,6 +150,13 @@ struct Device
         return D3D12_TEXTURE_DATA_PITCH_ALIGNMENT;
     }
 
+    // alignment of the buffer offset when copying from buffer to texture
+    uint32_t
+    get_data_placement_alignment() const
+    {
+        return D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+    }
+
     inline bool
     enable_debug() const
     {
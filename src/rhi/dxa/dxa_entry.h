@@ -25,7 +25,10 @@ struct Entry
 
     Entry() {}
 
-    Entry([[maybe_unused]] const Window & window, const bool debug) : m_debug(debug)
+    // dx12 needs no surface to create a device, the window only matters to the swapchain
+    Entry([[maybe_unused]] const Window & window, const bool debug) : Entry(debug) {}
+
+    Entry(const bool debug) : m_debug(debug)
     {
         UINT factory_flags = 0;
         if (debug)
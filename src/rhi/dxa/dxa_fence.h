@@ -53,6 +53,13 @@ struct Fence
         }
     }
 
+    // non blocking wait
+    bool
+    is_signaled() const
+    {
+        return m_dx_fence->GetCompletedValue() >= m_expected_fence_value;
+    }
+
     void
     reset()
     {
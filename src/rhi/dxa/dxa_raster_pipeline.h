@@ -32,7 +32,7 @@ struct RasterPipeline
     RasterPipeline(const std::string &                          name,
                    const Device &                               device,
                    const std::span<const DXA_NAME::ShaderSrc> & shader_srcs,
-                   ShaderBinaryManager &                        shader_binary_manager,
+                   const ShaderBinaryManager &                  shader_binary_manager,
                    const FramebufferBindings &                  framebuffer_bindings)
     : RasterPipeline(name, device, shader_srcs, shader_binary_manager, nullptr, framebuffer_bindings)
     {
@@ -41,7 +41,7 @@ struct RasterPipeline
     RasterPipeline(const std::string &                          name,
                    const Device &                               device,
                    const std::span<const DXA_NAME::ShaderSrc> & shader_srcs,
-                   ShaderBinaryManager &                        shader_manager,
+                   const ShaderBinaryManager &                  shader_manager,
                    const ComPtr<ID3D12RootSignature> &          root_signature,
                    const FramebufferBindings &                  framebuffer_bindings)
     : m_dx_root_signature(root_signature),
@@ -55,16 +55,17 @@ struct RasterPipeline
     init(const std::string &                          name,
          const Device &                               device,
          const std::span<const DXA_NAME::ShaderSrc> & shader_srcs,
-         ShaderBinaryManager &                        shader_manager,
+         const ShaderBinaryManager &                  shader_manager,
          const FramebufferBindings &                  framebuffer_binding)
     {
         // compile all shader srcs
         std::vector<std::pair<ComPtr<IDxcBlob>, ShaderStageEnum>> shader_blobs(shader_srcs.size());
         {
-            HlslDxcCompiler hlsl_dxil_compiler;
+            HlslDxcCompiler                           hlsl_dxil_compiler;
+            const std::vector<std::vector<std::byte>> dxil_codes = shader_manager.get_cached_shaders(shader_srcs, false);
             for (size_t i = 0; i < shader_srcs.size(); i++)
             {
-                shader_blobs[i].first  = hlsl_dxil_compiler.compile_as_dxil(shader_srcs[i]);
+                shader_blobs[i].first  = hlsl_dxil_compiler.create_blob(dxil_codes[i]);
                 shader_blobs[i].second = shader_srcs[i].m_shader_stage;
             }
         }
@@ -47,11 +47,14 @@ struct RayTracingGeometryDesc
         return *this;
     }
 
+    // row-major 3x4 matrix applied to the vertices before the build, offset_in_bytes must be a multiple of 16
     RayTracingGeometryDesc &
     set_transform_matrix4x3(const Buffer & buffer, const size_t offset_in_bytes)
     {
+        assert(offset_in_bytes % D3D12_RAYTRACING_TRANSFORM3X4_BYTE_ALIGNMENT == 0);
         m_geometry_desc.Triangles.Transform3x4 =
             buffer.m_allocation->GetResource()->GetGPUVirtualAddress() + offset_in_bytes;
+        return *this;
     }
 };
 
@@ -62,20 +65,65 @@ struct RayTracingBlas
     Buffer m_blas_buffer;
 
     RayTracingBlas() {}
+};
+
+// builds many blases into a single command list.
+// builds are grouped so the scratch memory of a group fits in MaxScratchSizeInBytes, every group sub-allocates the
+// same scratch buffer and only waits on the previous group before reusing it.
+// NonDeformable blases are built compactable and can be shrunk by compact() once the build has been executed.
+struct RayTracingBlasBatch
+{
+    static constexpr size_t MaxScratchSizeInBytes = 256 * 1024 * 1024; // 256 MB
+
+    struct PendingBuild
+    {
+        std::vector<RayTracingGeometryDesc>                  m_geometry_descs;
+        D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS m_inputs                = {};
+        D3D12_GPU_VIRTUAL_ADDRESS                            m_dst_address           = 0;
+        size_t                                               m_scratch_size_in_bytes = 0;
+    };
+
+    struct CompactableBlas
+    {
+        RayTracingBlas * m_blas;
+        std::string      m_name;
+    };
+
+    std::vector<PendingBuild>    m_pending_builds;
+    Buffer                       m_scratch_buffer;
+    std::vector<CompactableBlas> m_compactable_blases;
+    // compacted sizes are emitted into the postbuild buffer and copied into the readback buffer
+    Buffer m_postbuild_info_buffer;
+    Buffer m_postbuild_info_readback_buffer;
+    // uncompacted blases are still read by the recorded compaction copies, they die with the batch
+    std::vector<RayTracingBlas> m_retired_blases;
 
-    RayTracingBlas(const std::string &                       name,
-                   const Device &                            device,
-                   const std::span<RayTracingGeometryDesc> & geometry_descs,
-                   const RayTracingBuildHint                 hint,
-                   StagingBufferManager *                    resource_loader)
+    RayTracingBlasBatch() {}
+
+    // creates the blas and its storage, the build is recorded by build().
+    // blas must stay at the same address until compact() is done with it.
+    void
+    add(RayTracingBlas *                                blas,
+        const std::string &                             name,
+        const Device &                                  device,
+        const std::span<const RayTracingGeometryDesc> & geometry_descs,
+        const RayTracingBuildHint                       hint)
     {
+        PendingBuild pending_build;
+        pending_build.m_geometry_descs = std::vector<RayTracingGeometryDesc>(geometry_descs.begin(), geometry_descs.end());
+
         // setup input building blas
-        D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS bottom_level_inputs = {};
+        D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS & bottom_level_inputs = pending_build.m_inputs;
         bottom_level_inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
         bottom_level_inputs.Flags = static_cast<D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS>(hint);
+        const bool is_compactable = hint == RayTracingBuildHint::NonDeformable;
+        if (is_compactable)
+        {
+            bottom_level_inputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION;
+        }
         bottom_level_inputs.pGeometryDescs =
-            reinterpret_cast<D3D12_RAYTRACING_GEOMETRY_DESC *>(geometry_descs.data());
-        bottom_level_inputs.NumDescs = static_cast<UINT>(geometry_descs.size());
+            reinterpret_cast<const D3D12_RAYTRACING_GEOMETRY_DESC *>(pending_build.m_geometry_descs.data());
+        bottom_level_inputs.NumDescs = static_cast<UINT>(pending_build.m_geometry_descs.size());
         bottom_level_inputs.Type     = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
 
         // get prebuild information
@@ -88,30 +136,191 @@ struct RayTracingBlas
         }
 
         // setup blas buffer
-        m_blas_buffer = Buffer(name + "_buffer",
-                               device,
-                               BufferUsageEnum::RayTracingAccelStructBuffer,
-                               MemoryUsageEnum::GpuOnly,
-                               bottom_level_prebuild_info.ResultDataMaxSizeInBytes);
+        blas->m_blas_buffer = Buffer(name + "_buffer",
+                                     device,
+                                     BufferUsageEnum::RayTracingAccelStructBuffer,
+                                     MemoryUsageEnum::GpuOnly,
+                                     bottom_level_prebuild_info.ResultDataMaxSizeInBytes);
+
+        pending_build.m_dst_address = blas->m_blas_buffer.m_allocation->GetResource()->GetGPUVirtualAddress();
+        pending_build.m_scratch_size_in_bytes = bottom_level_prebuild_info.ScratchDataSizeInBytes;
+        m_pending_builds.push_back(std::move(pending_build));
+
+        if (is_compactable)
+        {
+            m_compactable_blases.push_back({ blas, name });
+        }
+    }
+
+    // records all pending builds, the batch must outlive the submission of resource_loader's command list
+    void
+    build(const std::string & name, const Device & device, StagingBufferManager * resource_loader)
+    {
+        if (m_pending_builds.empty())
+        {
+            return;
+        }
+
+        constexpr size_t scratch_alignment = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT;
+
+        // split builds into groups, a build bigger than the budget gets a group of its own
+        std::vector<size_t> group_ends;
+        std::vector<size_t> scratch_offsets(m_pending_builds.size());
+        size_t              group_scratch_size = 0;
+        size_t              scratch_size       = 0;
+        for (size_t i_build = 0; i_build < m_pending_builds.size(); i_build++)
+        {
+            const size_t size = round_up(m_pending_builds[i_build].m_scratch_size_in_bytes, scratch_alignment);
+            if (group_scratch_size > 0 && group_scratch_size + size > MaxScratchSizeInBytes)
+            {
+                group_ends.push_back(i_build);
+                group_scratch_size = 0;
+            }
+            scratch_offsets[i_build] = group_scratch_size;
+            group_scratch_size += size;
+            scratch_size = std::max(scratch_size, group_scratch_size);
+        }
+        group_ends.push_back(m_pending_builds.size());
+
+        // committed resources are aligned to 64KB so offsets aligned to the build alignment stay aligned
+        m_scratch_buffer = Buffer(name + "_scratch_buffer",
+                                  device,
+                                  BufferUsageEnum::StorageBuffer,
+                                  MemoryUsageEnum::GpuOnly,
+                                  scratch_size);
+        const D3D12_GPU_VIRTUAL_ADDRESS scratch_address =
+            m_scratch_buffer.m_allocation->GetResource()->GetGPUVirtualAddress();
+
+        ID3D12GraphicsCommandList4 * command_list = resource_loader->m_dx_command_list.Get();
+        CD3DX12_RESOURCE_BARRIER     scratch_barrier =
+            CD3DX12_RESOURCE_BARRIER::UAV(m_scratch_buffer.m_allocation->GetResource());
+        size_t group_begin = 0;
+        for (const size_t group_end : group_ends)
+        {
+            // the previous group has to finish with the scratch memory before this group reuses it
+            if (group_begin > 0)
+            {
+                command_list->ResourceBarrier(1, &scratch_barrier);
+            }
 
-        auto * scratch_buffer =
-            resource_loader->get_scratch_buffer(bottom_level_prebuild_info.ResultDataMaxSizeInBytes);
+            for (size_t i_build = group_begin; i_build < group_end; i_build++)
+            {
+                const PendingBuild & pending_build = m_pending_builds[i_build];
+                D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC blas_build_desc = {};
+                blas_build_desc.Inputs                           = pending_build.m_inputs;
+                blas_build_desc.ScratchAccelerationStructureData = scratch_address + scratch_offsets[i_build];
+                blas_build_desc.DestAccelerationStructureData    = pending_build.m_dst_address;
+                command_list->BuildRaytracingAccelerationStructure(&blas_build_desc, 0, nullptr);
+            }
+            group_begin = group_end;
+        }
+
+        // blases are read by the tlas build or the postbuild info recorded after this
+        CD3DX12_RESOURCE_BARRIER uav_barrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+        command_list->ResourceBarrier(1, &uav_barrier);
+
+        if (!m_compactable_blases.empty())
+        {
+            using CompactedSizeDesc = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC;
+            const size_t postbuild_info_size = m_compactable_blases.size() * sizeof(CompactedSizeDesc);
+            m_postbuild_info_buffer          = Buffer(name + "_postbuild_info_buffer",
+                                             device,
+                                             BufferUsageEnum::StorageBuffer,
+                                             MemoryUsageEnum::GpuOnly,
+                                             postbuild_info_size);
+            m_postbuild_info_readback_buffer = Buffer(name + "_postbuild_info_readback_buffer",
+                                                      device,
+                                                      BufferUsageEnum::TransferDst,
+                                                      MemoryUsageEnum::GpuToCpu,
+                                                      postbuild_info_size);
+
+            std::vector<D3D12_GPU_VIRTUAL_ADDRESS> blas_addresses(m_compactable_blases.size());
+            for (size_t i = 0; i < m_compactable_blases.size(); i++)
+            {
+                blas_addresses[i] =
+                    m_compactable_blases[i].m_blas->m_blas_buffer.m_allocation->GetResource()->GetGPUVirtualAddress();
+            }
+            D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC postbuild_info_desc = {};
+            postbuild_info_desc.DestBuffer = m_postbuild_info_buffer.m_allocation->GetResource()->GetGPUVirtualAddress();
+            postbuild_info_desc.InfoType = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE;
+            command_list->EmitRaytracingAccelerationStructurePostbuildInfo(&postbuild_info_desc,
+                                                                           static_cast<UINT>(blas_addresses.size()),
+                                                                           blas_addresses.data());
+
+            CD3DX12_RESOURCE_BARRIER copy_barrier =
+                CD3DX12_RESOURCE_BARRIER::Transition(m_postbuild_info_buffer.m_allocation->GetResource(),
+                                                     D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                                                     D3D12_RESOURCE_STATE_COPY_SOURCE);
+            command_list->ResourceBarrier(1, &copy_barrier);
+            command_list->CopyResource(m_postbuild_info_readback_buffer.m_allocation->GetResource(),
+                                       m_postbuild_info_buffer.m_allocation->GetResource());
+        }
+
+        Logger::Info(__FUNCTION__,
+                     " recorded ",
+                     m_pending_builds.size(),
+                     " blas builds in ",
+                     group_ends.size(),
+                     " groups with ",
+                     scratch_size / (1024 * 1024),
+                     " MB scratch memory");
+        m_pending_builds.clear();
+    }
+
+    // copies every compactable blas into a right sized one, the submission recorded by build() must have completed.
+    // returns the number of bytes reclaimed once the batch, which keeps the uncompacted blases, is destroyed.
+    size_t
+    compact(const Device & device, StagingBufferManager * resource_loader)
+    {
+        if (m_compactable_blases.empty())
+        {
+            return 0;
+        }
+
+        using CompactedSizeDesc = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC;
+        std::vector<CompactedSizeDesc> compacted_sizes(m_compactable_blases.size());
+        std::memcpy(compacted_sizes.data(),
+                    m_postbuild_info_readback_buffer.map(),
+                    compacted_sizes.size() * sizeof(CompactedSizeDesc));
+        m_postbuild_info_readback_buffer.unmap();
 
-        // Bottom Level Acceleration Structure desc
-        D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC blas_build_desc = {};
+        ID3D12GraphicsCommandList4 * command_list   = resource_loader->m_dx_command_list.Get();
+        size_t                       original_size  = 0;
+        size_t                       compacted_size = 0;
+        for (size_t i = 0; i < m_compactable_blases.size(); i++)
         {
-            blas_build_desc.Inputs = bottom_level_inputs;
-            blas_build_desc.ScratchAccelerationStructureData =
-                scratch_buffer->m_allocation->GetResource()->GetGPUVirtualAddress();
-            blas_build_desc.DestAccelerationStructureData =
-                m_blas_buffer.m_allocation->GetResource()->GetGPUVirtualAddress();
+            RayTracingBlas & blas = *m_compactable_blases[i].m_blas;
+            RayTracingBlas   compacted_blas;
+            compacted_blas.m_blas_buffer = Buffer(m_compactable_blases[i].m_name + "_compacted_buffer",
+                                                  device,
+                                                  BufferUsageEnum::RayTracingAccelStructBuffer,
+                                                  MemoryUsageEnum::GpuOnly,
+                                                  compacted_sizes[i].CompactedSizeInBytes);
+            command_list->CopyRaytracingAccelerationStructure(
+                compacted_blas.m_blas_buffer.m_allocation->GetResource()->GetGPUVirtualAddress(),
+                blas.m_blas_buffer.m_allocation->GetResource()->GetGPUVirtualAddress(),
+                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_COMPACT);
+
+            original_size += blas.m_blas_buffer.m_size_in_bytes;
+            compacted_size += compacted_blas.m_blas_buffer.m_size_in_bytes;
+            m_retired_blases.push_back(std::move(blas));
+            blas = std::move(compacted_blas);
         }
 
-        // create command list and record commands
-        resource_loader->m_dx_command_list->BuildRaytracingAccelerationStructure(&blas_build_desc, 0, nullptr);
-        CD3DX12_RESOURCE_BARRIER uav_barrier =
-            CD3DX12_RESOURCE_BARRIER::UAV(m_blas_buffer.m_allocation->GetResource());
-        resource_loader->m_dx_command_list->ResourceBarrier(1, &uav_barrier);
+        // compacted blases are read by the tlas build recorded after this
+        CD3DX12_RESOURCE_BARRIER uav_barrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+        command_list->ResourceBarrier(1, &uav_barrier);
+
+        Logger::Info(__FUNCTION__,
+                     " compacted ",
+                     m_compactable_blases.size(),
+                     " blases from ",
+                     original_size / 1024,
+                     " KB to ",
+                     compacted_size / 1024,
+                     " KB");
+        m_compactable_blases.clear();
+        return original_size - compacted_size;
     }
 };
 
@@ -136,44 +345,23 @@ struct RayTracingInstance
         m_instance_desc.InstanceID                          = instance_id;
     }
 };
+static_assert(sizeof(RayTracingInstance) == sizeof(D3D12_RAYTRACING_INSTANCE_DESC));
 
+// tlas that can be rebuilt or refit in place on a frame command buffer.
+// instances are read from a caller owned buffer so the caller decides how it is written and double buffered.
 struct RayTracingTlas
 {
-    Buffer m_tlas_buffer;
-    Buffer m_instance_desc_buffer;
+    Buffer   m_tlas_buffer;
+    Buffer   m_scratch_buffer;
+    uint32_t m_max_num_instances = 0;
 
     RayTracingTlas() {}
 
-    RayTracingTlas(const std::string &                         name,
-                   const Device &                              device,
-                   const std::span<const RayTracingInstance> & instances,
-                   StagingBufferManager *                      temp_resource_manager)
+    RayTracingTlas(const std::string & name, const Device & device, const uint32_t max_num_instances)
+    : m_max_num_instances(max_num_instances)
     {
-        // copy description of instance into the buffer
-        const std::string instance_buffer_name = name.empty() ? "" : name + "_instance_buffer";
-        m_instance_desc_buffer                 = Buffer(instance_buffer_name,
-                                        device,
-                                        BufferUsageEnum::Common,
-                                        MemoryUsageEnum::CpuOnly,
-                                        sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instances.size());
-        std::byte * instance_dst = reinterpret_cast<std::byte *>(m_instance_desc_buffer.map());
-        for (size_t i = 0; i < instances.size(); i++)
-        {
-            size_t offset = i * sizeof(D3D12_RAYTRACING_INSTANCE_DESC);
-            std::memcpy(instance_dst + offset, &instances[i].m_instance_desc, sizeof(D3D12_RAYTRACING_INSTANCE_DESC));
-        }
-        m_instance_desc_buffer.unmap();
-
-        // create top level inputs
-        D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS top_level_inputs = {};
-        top_level_inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-        top_level_inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
-        top_level_inputs.InstanceDescs =
-            m_instance_desc_buffer.m_allocation->GetResource()->GetGPUVirtualAddress();
-        top_level_inputs.NumDescs = static_cast<UINT>(instances.size());
-        top_level_inputs.Type     = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
-
-        // tlas input info
+        // tlas input info for the largest instance count
+        D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS top_level_inputs = get_inputs(0, max_num_instances, false);
         D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO top_level_prebuild_info = {};
         device.m_dx_device->GetRaytracingAccelerationStructurePrebuildInfo(&top_level_inputs, &top_level_prebuild_info);
         if (top_level_prebuild_info.ResultDataMaxSizeInBytes <= 0)
@@ -181,9 +369,6 @@ struct RayTracingTlas
             Logger::Critical<true>(__FUNCTION__ " toplevel's ResultDataMaxSizeInBytes <= 0");
         }
 
-        auto * scratch_buffer =
-            temp_resource_manager->get_scratch_buffer(top_level_prebuild_info.ResultDataMaxSizeInBytes);
-
         const std::string accel_buffer_name = name.empty() ? "" : name + "_accel_buffer";
         m_tlas_buffer                       = Buffer(accel_buffer_name,
                                device,
@@ -191,16 +376,65 @@ struct RayTracingTlas
                                MemoryUsageEnum::GpuOnly,
                                top_level_prebuild_info.ResultDataMaxSizeInBytes);
 
-        // tlas desc
+        // scratch is kept for rebuilds and refits
+        const std::string scratch_buffer_name = name.empty() ? "" : name + "_scratch_buffer";
+        m_scratch_buffer                      = Buffer(scratch_buffer_name,
+                                  device,
+                                  BufferUsageEnum::StorageBuffer,
+                                  MemoryUsageEnum::GpuOnly,
+                                  std::max(top_level_prebuild_info.ScratchDataSizeInBytes,
+                                           top_level_prebuild_info.UpdateScratchDataSizeInBytes));
+    }
+
+    // records a rebuild (or a refit if is_refit) from num_instances RayTracingInstance at instance_buffer + offset.
+    // instances must have been written by the host before the submission, see CommandBuffer::build_tlas.
+    void
+    record_build(ID3D12GraphicsCommandList4 * command_list,
+                 const Buffer &               instance_buffer,
+                 const size_t                 offset_in_bytes,
+                 const uint32_t               num_instances,
+                 const bool                   is_refit)
+    {
+        assert(num_instances <= m_max_num_instances);
+
+        // an earlier build on this queue must be done with the tlas before it is overwritten, rays traced on other
+        // queues are ordered through fences
+        CD3DX12_RESOURCE_BARRIER pre_barrier = CD3DX12_RESOURCE_BARRIER::UAV(m_tlas_buffer.m_allocation->GetResource());
+        command_list->ResourceBarrier(1, &pre_barrier);
+
+        const D3D12_GPU_VIRTUAL_ADDRESS tlas_address = m_tlas_buffer.m_allocation->GetResource()->GetGPUVirtualAddress();
         D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC tlas_build_desc = {};
-        tlas_build_desc.Inputs                                             = top_level_inputs;
-        tlas_build_desc.DestAccelerationStructureData =
-            m_tlas_buffer.m_allocation->GetResource()->GetGPUVirtualAddress();
+        tlas_build_desc.Inputs = get_inputs(instance_buffer.m_allocation->GetResource()->GetGPUVirtualAddress() + offset_in_bytes,
+                                            num_instances,
+                                            is_refit);
+        tlas_build_desc.DestAccelerationStructureData   = tlas_address;
+        tlas_build_desc.SourceAccelerationStructureData = is_refit ? tlas_address : 0;
         tlas_build_desc.ScratchAccelerationStructureData =
-            scratch_buffer->m_allocation->GetResource()->GetGPUVirtualAddress();
+            m_scratch_buffer.m_allocation->GetResource()->GetGPUVirtualAddress();
+        command_list->BuildRaytracingAccelerationStructure(&tlas_build_desc, 0, nullptr);
+
+        // work after this on the same queue sees the new tlas
+        CD3DX12_RESOURCE_BARRIER post_barrier = CD3DX12_RESOURCE_BARRIER::UAV(m_tlas_buffer.m_allocation->GetResource());
+        command_list->ResourceBarrier(1, &post_barrier);
+    }
 
-        // create commandlist and record the commands
-        temp_resource_manager->m_dx_command_list->BuildRaytracingAccelerationStructure(&tlas_build_desc, 0, nullptr);
+private:
+    static D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS
+    get_inputs(const D3D12_GPU_VIRTUAL_ADDRESS instance_address, const uint32_t num_instances, const bool is_refit)
+    {
+        // refit needs ALLOW_UPDATE on every build, including the first one
+        D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS top_level_inputs = {};
+        top_level_inputs.DescsLayout   = D3D12_ELEMENTS_LAYOUT_ARRAY;
+        top_level_inputs.Flags         = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE |
+                                 D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE;
+        if (is_refit)
+        {
+            top_level_inputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+        }
+        top_level_inputs.InstanceDescs = instance_address;
+        top_level_inputs.NumDescs      = num_instances;
+        top_level_inputs.Type          = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+        return top_level_inputs;
     }
 };
 } // namespace DXA_NAME
@@ -7,7 +7,9 @@
     #include "dxil_reflection.h"
     #include "pch/pch.h"
     #include "rhi/common/rhi_shader_src.h"
+    #include "core/stopwatch.h"
     #include "rhi/shadercompiler/hlsldxccompiler.h"
+    #include "rhi/shadercompiler/shader_binary_manager.h"
 
 namespace DXA_NAME
 {
@@ -112,9 +114,20 @@ struct RayTracingPipeline
                        const size_t                     payload_size,
                        const size_t                     recursion_depth)
     {
+        StopWatch       stop_watch;
         HlslDxcCompiler hlsl_dxil_compiler;
         DxilReflection  dxil_reflector;
 
+        // compile all shader srcs, the blobs are used both for the pso and for reflection
+        const std::vector<std::vector<std::byte>> dxil_codes =
+            shader_binary_manager.get_cached_shaders(rt_lib.m_shader_srcs, false);
+        std::vector<ComPtr<IDxcBlob>> dxc_blobs(dxil_codes.size());
+        for (size_t i = 0; i < dxil_codes.size(); i++)
+        {
+            dxc_blobs[i] = hlsl_dxil_compiler.create_blob(dxil_codes[i]);
+        }
+        const long long shader_time_ms = stop_watch.time_milli_sec();
+
         std::vector<ShaderEntry> shader_entries(rt_lib.m_shader_srcs.size());
         for (size_t i = 0; i < rt_lib.m_shader_srcs.size(); i++)
         {
@@ -157,10 +170,7 @@ struct RayTracingPipeline
             const size_t      unique_id      = i;
             const std::string renamed_symbol = shader_src.m_entry + "_" + std::to_string(unique_id);
 
-            // compile shader blob
-            ComPtr<IDxcBlob> dxc_blob = hlsl_dxil_compiler.compile_as_dxil(rt_lib.m_shader_srcs[i]);
-
-            entry.m_compiled_shader_blob = dxc_blob;
+            entry.m_compiled_shader_blob = dxc_blobs[i];
             // entry.m_num_root_parameters  = root_signature_desc.NumParameters;
             // entry.m_local_root_signature = root_signature;
             entry.m_num_root_parameters  = 0;
@@ -224,11 +234,8 @@ struct RayTracingPipeline
                 rt_lib.m_shader_srcs.size());
             for (size_t i_shader = 0; i_shader < shaders.size(); i_shader++)
             {
-                // TODO:: avoid compiling the shader TWICE!
-                // assert(false);
-                const auto & shader_src  = rt_lib.m_shader_srcs[i_shader];
-                shaders[i_shader].first  = hlsl_dxil_compiler.compile_as_dxil(shader_src);
-                shaders[i_shader].second = shader_src.m_shader_stage;
+                shaders[i_shader].first  = dxc_blobs[i_shader];
+                shaders[i_shader].second = rt_lib.m_shader_srcs[i_shader].m_shader_stage;
             }
 
             // reflecting as root parameters
@@ -261,6 +268,15 @@ struct RayTracingPipeline
 
         init_pso(device, rt_lib, shader_entries, hit_group_records, attribute_size, payload_size, recursion_depth, name);
         device.name_dx_object(m_dx_rt_pso, name + "_pso");
+
+        Logger::Info(__FUNCTION__,
+                     " ",
+                     name,
+                     " built in ",
+                     stop_watch.time_milli_sec(),
+                     " ms (shaders ",
+                     shader_time_ms,
+                     " ms)");
     }
 
     void
@@ -43,5 +43,59 @@ struct Semaphore
         device.name_dx_object(m_dx_fence, name);
     }
 };
+
+// payload is a 64 bit value that only grows, queues wait for or signal values of it through CommandBuffer
+struct TimelineSemaphore
+{
+    ComPtr<ID3D12Fence>                                        m_dx_fence = nullptr;
+    UniquePtrHandle<HANDLE, Semaphore::SemaphoreHandleDeleter> m_fence_handle;
+
+    TimelineSemaphore() {}
+
+    TimelineSemaphore(const std::string & name, const Device & device)
+    {
+        // create fence
+        DXCK(device.m_dx_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_dx_fence)));
+
+        // create fence handle
+        *m_fence_handle = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (!m_fence_handle.get())
+        {
+            Logger::Critical<true>("cannot create fence handle");
+        }
+
+        // name fence
+        device.name_dx_object(m_dx_fence, name);
+    }
+
+    uint64_t
+    get_completed_value() const
+    {
+        return m_dx_fence->GetCompletedValue();
+    }
+
+    // duration is in nanoseconds as in vka, the event wait rounds it up to whole milliseconds
+    void
+    wait(const uint64_t value, const std::chrono::nanoseconds duration = std::chrono::nanoseconds::max())
+    {
+        if (m_dx_fence->GetCompletedValue() < value)
+        {
+            DXCK(m_dx_fence->SetEventOnCompletion(value, *m_fence_handle));
+            ::WaitForSingleObjectEx(*m_fence_handle, GetMilliSec(duration), FALSE);
+        }
+    }
+
+private:
+    static DWORD
+    GetMilliSec(const std::chrono::nanoseconds duration)
+    {
+        if (duration == std::chrono::nanoseconds::max())
+        {
+            return INFINITE;
+        }
+        const int64_t ms = std::chrono::ceil<std::chrono::milliseconds>(duration).count();
+        return static_cast<DWORD>(std::clamp(ms, int64_t(0), static_cast<int64_t>(INFINITE - 1)));
+    }
+};
 } // namespace DXA_NAME
 #endif
@@ -3,6 +3,7 @@
 #include "dxa_common.h"
 #ifdef USE_DXA
 
+    #include "dxa_aliasable_memory.h"
     #include "dxa_device.h"
     #include "dxa_swapchain.h"
 
@@ -15,6 +16,8 @@ struct Texture
     D3D12MAHandle<D3D12MA::Allocation> m_allocation            = nullptr;
     ID3D12Resource *                   m_dx_resource           = nullptr;
     D3D12_CPU_DESCRIPTOR_HANDLE        m_dx_dsv_rtv_cpu_handle = { 0 };
+    // set when the memory is owned by an aliasable memory rather than m_allocation
+    ComPtr<ID3D12Resource> m_dx_aliasing_resource = nullptr;
 
     Texture() {}
 
@@ -39,6 +42,41 @@ struct Texture
         device.name_dx_object(m_dx_resource, name);
     }
 
+    Texture(const std::string &       name,
+            Device &                  device,
+            const TextureCreateInfo & create_info,
+            const TextureStateEnum &  state,
+            const AliasableMemory &   memory,
+            const size_t              offset_into_memory_in_bytes)
+    : m_resolution(int3(create_info.m_width, create_info.m_height, create_info.m_depth)),
+      m_dx_format(GetDXGI_FORMAT(create_info.m_format))
+    {
+        const D3D12_RESOURCE_DESC resource_desc = GetD3D12_RESOURCE_DESC(create_info);
+        DXCK(device.m_d3d12ma->CreateAliasingResource(memory.m_allocation.get(),
+                                                      offset_into_memory_in_bytes,
+                                                      &resource_desc,
+                                                      GetD3D12_RESOURCE_STATES(state),
+                                                      nullptr,
+                                                      IID_PPV_ARGS(&m_dx_aliasing_resource)));
+        m_dx_resource = m_dx_aliasing_resource.Get();
+        m_dx_dsv_rtv_cpu_handle =
+            ConstructInitRtvOrDsv(device, create_info.m_texture_usage, create_info.m_format, m_dx_resource);
+        device.name_dx_object(m_dx_resource, name);
+    }
+
+    static MemoryRequirement
+    GetMemoryRequirement(const Device & device, const TextureCreateInfo & create_info)
+    {
+        const D3D12_RESOURCE_DESC resource_desc = GetD3D12_RESOURCE_DESC(create_info);
+        MemoryRequirement         result;
+        result.m_dx_allocation_info = device.m_dx_device->GetResourceAllocationInfo(0, 1, &resource_desc);
+        result.m_dx_heap_flags      = HasFlag(create_info.m_texture_usage, TextureUsageEnum::ColorAttachment) ||
+                                          HasFlag(create_info.m_texture_usage, TextureUsageEnum::DepthAttachment)
+                                          ? D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES
+                                          : D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+        return result;
+    }
+
     static D3D12_RESOURCE_DESC
     GetD3D12_RESOURCE_DESC(const TextureCreateInfo & create_info)
     {
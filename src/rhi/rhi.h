@@ -2,3 +2,4 @@
 
 #include "rhi/vka/vka.h"
 #include "rhi/dxa/dxa.h"
+#include "rhi/rhi_staging_ring.h"
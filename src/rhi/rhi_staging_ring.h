@@ -0,0 +1,272 @@
+#pragma once
+
+#include "core/stopwatch.h"
+#include "core/vmath.h"
+#include "rhi/dxa/dxa.h"
+#include "rhi/vka/vka.h"
+
+namespace Rhi
+{
+// upload heap: one persistently mapped buffer that is sub-allocated linearly in ring order.
+// copies out of the ring are recorded into its open command buffer on the transfer queue, flush submits that buffer and
+// signals the next value of the ring timeline semaphore. the space a batch used is retired once the timeline reaches
+// its value, and other queues wait on that value on the device. the cpu only waits when the ring is full.
+// every batch records into a command pool of its own, which is reset and reused once the batch is retired, so
+// continuous streaming keeps as many command buffers alive as there are batches in flight.
+struct StagingRing
+{
+    static constexpr size_t DefaultAlignment = 16;
+
+    struct Allocation
+    {
+        const Buffer * m_buffer          = nullptr;
+        std::byte *    m_mapped          = nullptr;
+        size_t         m_offset_in_bytes = 0;
+        size_t         m_size_in_bytes   = 0;
+    };
+
+    struct InFlightBatch
+    {
+        std::unique_ptr<CommandPool> m_cmd_pool;
+        uint64_t                     m_timeline_value = 0;
+        // ring position right after the last allocation of the batch
+        uint64_t  m_end              = 0;
+        size_t    m_size_in_bytes    = 0;
+        long long m_submit_micro_sec = 0;
+    };
+
+    // measured on the host between submit and the first time a batch is seen retired, so the bandwidth is a lower
+    // bound of what the queue achieves
+    struct Statistics
+    {
+        size_t m_num_bytes      = 0;
+        size_t m_num_batches    = 0;
+        float  m_busy_milli_sec = 0.0f;
+
+        float
+        get_bandwidth_in_mb_per_sec() const
+        {
+            return m_busy_milli_sec > 0.0f ? static_cast<float>(m_num_bytes) / (m_busy_milli_sec * 1000.0f) : 0.0f;
+        }
+    };
+
+    const Device & m_device;
+    std::string    m_name;
+    QueueType      m_queue_type;
+    Buffer         m_buffer;
+    std::byte *    m_mapped        = nullptr;
+    size_t         m_size_in_bytes = 0;
+    // positions only grow, a position modulo m_size_in_bytes is the offset into m_buffer.
+    // [m_tail, m_head) is in use by the open batch and the batches in flight
+    uint64_t                  m_head = 0;
+    uint64_t                  m_tail = 0;
+    std::deque<InFlightBatch> m_in_flight_batches;
+    TimelineSemaphore         m_timeline;
+    uint64_t                  m_last_signaled_value = 0;
+    // pool of the open batch and pools of retired batches, ready to be reused
+    std::unique_ptr<CommandPool>              m_open_cmd_pool;
+    std::vector<std::unique_ptr<CommandPool>> m_free_cmd_pools;
+    size_t                                    m_num_cmd_pools = 0;
+    CommandBuffer             m_cmd_buffer;
+    bool                      m_is_recording          = false;
+    size_t                    m_open_size_in_bytes    = 0;
+    StopWatch                 m_stop_watch;
+    long long                 m_last_retire_micro_sec = 0;
+    Statistics                m_statistics;
+
+    StagingRing(const std::string & name, const Device & device, const size_t size_in_bytes, const QueueType queue_type = QueueType::Transfer)
+    : m_device(device),
+      m_name(name),
+      m_queue_type(queue_type),
+      m_buffer(name, device, BufferUsageEnum::TransferSrc, MemoryUsageEnum::CpuOnly, size_in_bytes),
+      m_size_in_bytes(size_in_bytes),
+      m_timeline(name + "_timeline", device)
+    {
+        m_mapped = reinterpret_cast<std::byte *>(m_buffer.map());
+    }
+
+    ~StagingRing()
+    {
+        wait_idle();
+        m_buffer.unmap();
+    }
+
+    StagingRing(const StagingRing &) = delete;
+    StagingRing &
+    operator=(const StagingRing &) = delete;
+
+    // an allocation never wraps around the end of the buffer. it may flush the open batch, so fetch the command
+    // buffer with get_command_buffer after allocating
+    Allocation
+    allocate(const size_t size_in_bytes, const size_t alignment = DefaultAlignment)
+    {
+        assert(size_in_bytes <= m_size_in_bytes);
+
+        uint64_t begin = round_up(m_head, static_cast<uint64_t>(alignment));
+        if (begin % m_size_in_bytes + size_in_bytes > m_size_in_bytes)
+        {
+            begin = round_up(begin, static_cast<uint64_t>(m_size_in_bytes));
+        }
+        const uint64_t end = begin + size_in_bytes;
+
+        // ring is full, wait for the oldest batches. the open batch may be what is in the way so it goes first
+        retire_signaled();
+        while (end - m_tail > m_size_in_bytes)
+        {
+            if (m_in_flight_batches.empty())
+            {
+                flush();
+            }
+            if (m_in_flight_batches.empty())
+            {
+                m_tail = begin;
+                break;
+            }
+            retire_oldest();
+        }
+
+        begin_recording();
+        m_head = end;
+        m_open_size_in_bytes += size_in_bytes;
+
+        Allocation allocation;
+        allocation.m_buffer          = &m_buffer;
+        allocation.m_offset_in_bytes = static_cast<size_t>(begin % m_size_in_bytes);
+        allocation.m_mapped          = m_mapped + allocation.m_offset_in_bytes;
+        allocation.m_size_in_bytes   = size_in_bytes;
+        return allocation;
+    }
+
+    CommandBuffer &
+    get_command_buffer()
+    {
+        begin_recording();
+        return m_cmd_buffer;
+    }
+
+    // uploads bigger than half of the ring are split, so one chunk is copied on the host while the previous one is
+    // copied on the device
+    void
+    upload_buffer(const Buffer & dst_buffer, const size_t dst_offset_in_bytes, const void * data, const size_t size_in_bytes)
+    {
+        const std::byte * src            = reinterpret_cast<const std::byte *>(data);
+        const size_t      max_chunk_size = m_size_in_bytes / 2;
+        for (size_t offset = 0; offset < size_in_bytes; offset += max_chunk_size)
+        {
+            const size_t chunk_size = std::min(size_in_bytes - offset, max_chunk_size);
+            Allocation   allocation = allocate(chunk_size);
+            std::memcpy(allocation.m_mapped, src + offset, chunk_size);
+            get_command_buffer().copy_buffer_to_buffer(dst_buffer,
+                                                       dst_offset_in_bytes + offset,
+                                                       *allocation.m_buffer,
+                                                       allocation.m_offset_in_bytes,
+                                                       chunk_size);
+        }
+    }
+
+    template <typename T>
+    void
+    upload_buffer(const Buffer & dst_buffer, const size_t dst_offset_in_bytes, const std::span<const T> & data)
+    {
+        upload_buffer(dst_buffer, dst_offset_in_bytes, data.data(), data.size_bytes());
+    }
+
+    // submits the open batch without waiting. returns the timeline value that is signaled once everything recorded
+    // so far is done, a queue reading the uploads waits on it
+    uint64_t
+    flush()
+    {
+        if (!m_is_recording)
+        {
+            return m_last_signaled_value;
+        }
+        m_cmd_buffer.end();
+
+        InFlightBatch batch;
+        batch.m_cmd_pool         = std::move(m_open_cmd_pool);
+        batch.m_timeline_value   = ++m_last_signaled_value;
+        batch.m_end              = m_head;
+        batch.m_size_in_bytes    = m_open_size_in_bytes;
+        batch.m_submit_micro_sec = m_stop_watch.time_micro_sec();
+        m_cmd_buffer.signal_timeline_semaphore(m_timeline, batch.m_timeline_value);
+        m_cmd_buffer.submit(nullptr);
+        m_in_flight_batches.push_back(std::move(batch));
+        m_is_recording       = false;
+        m_open_size_in_bytes = 0;
+        return m_last_signaled_value;
+    }
+
+    // submits the open batch and waits on the host until the device is done with every batch
+    void
+    wait_idle()
+    {
+        flush();
+        while (!m_in_flight_batches.empty())
+        {
+            retire_oldest();
+        }
+    }
+
+    // retires the batches the device is done with, cheap enough to be polled every frame
+    void
+    retire_signaled()
+    {
+        const uint64_t completed_value = m_timeline.get_completed_value();
+        while (!m_in_flight_batches.empty() && m_in_flight_batches.front().m_timeline_value <= completed_value)
+        {
+            retire_oldest();
+        }
+    }
+
+    const Statistics &
+    get_statistics() const
+    {
+        return m_statistics;
+    }
+
+private:
+    void
+    begin_recording()
+    {
+        if (!m_is_recording)
+        {
+            if (m_free_cmd_pools.empty())
+            {
+                m_open_cmd_pool = std::make_unique<CommandPool>(m_name + "_cmd_pool_" + std::to_string(m_num_cmd_pools++),
+                                                                m_device,
+                                                                m_queue_type);
+            }
+            else
+            {
+                m_open_cmd_pool = std::move(m_free_cmd_pools.back());
+                m_free_cmd_pools.pop_back();
+            }
+            m_cmd_buffer = m_open_cmd_pool->get_command_buffer();
+            m_cmd_buffer.begin();
+            m_is_recording = true;
+        }
+    }
+
+    void
+    retire_oldest()
+    {
+        InFlightBatch batch = std::move(m_in_flight_batches.front());
+        m_in_flight_batches.pop_front();
+        m_timeline.wait(batch.m_timeline_value);
+        m_tail = batch.m_end;
+
+        // batches run back to back on the queue, so a batch is busy from its submit or the retirement of the
+        // previous one, whichever is later
+        const long long retire_micro_sec = m_stop_watch.time_micro_sec();
+        const long long begin_micro_sec  = std::max(batch.m_submit_micro_sec, m_last_retire_micro_sec);
+        m_statistics.m_num_bytes += batch.m_size_in_bytes;
+        m_statistics.m_num_batches++;
+        m_statistics.m_busy_milli_sec += static_cast<float>(retire_micro_sec - begin_micro_sec) / 1000.0f;
+        m_last_retire_micro_sec = retire_micro_sec;
+
+        // the command buffer of the batch has finished executing
+        batch.m_cmd_pool->reset();
+        m_free_cmd_pools.push_back(std::move(batch.m_cmd_pool));
+    }
+};
+} // namespace Rhi
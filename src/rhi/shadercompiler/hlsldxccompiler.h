@@ -2,6 +2,7 @@
 
 #include "pch/pch.h"
 
+#include "core/hash.h"
 #include "core/logger.h"
 #include "core/vmath.h"
 #include "rhi/common/rhi_enums.h"
@@ -39,6 +40,38 @@ struct HlslDxcCompiler
         }
     }
 
+    // identifies the dxc build, binaries compiled by another dxc must not be reused
+    uint64_t
+    get_compiler_hash() const
+    {
+        Hash64 hash;
+
+        ComPtr<IDxcVersionInfo> version_info;
+        if (SUCCEEDED(m_compiler.As(&version_info)))
+        {
+            UINT32 major = 0;
+            UINT32 minor = 0;
+            version_info->GetVersion(&major, &minor);
+            hash.add_pod(major);
+            hash.add_pod(minor);
+        }
+
+        ComPtr<IDxcVersionInfo2> version_info2;
+        if (SUCCEEDED(m_compiler.As(&version_info2)))
+        {
+            UINT32 commit_count = 0;
+            char * commit_hash  = nullptr;
+            if (SUCCEEDED(version_info2->GetCommitInfo(&commit_count, &commit_hash)) && commit_hash)
+            {
+                hash.add_pod(commit_count);
+                hash.add(std::string_view(commit_hash));
+                CoTaskMemFree(commit_hash);
+            }
+        }
+
+        return hash.get();
+    }
+
     struct TargetProfile
     {
         const wchar_t * m_target_profile_str;
@@ -120,20 +153,25 @@ struct HlslDxcCompiler
         return &arguments;
     }
 
-    template <typename ShaderStageEnum>
+    // IDxcCompiler instances must not be used from several threads at once, every thread lazily creates its own
+    static const HlslDxcCompiler &
+    GetForThisThread()
+    {
+        thread_local HlslDxcCompiler compiler;
+        return compiler;
+    }
+
+    // dxc preprocess, the result does not depend on entry point or target profile, so every entry point of one
+    // file with the same defines can be compiled from it
     ComPtr<IDxcBlob>
-    dxc_compile(const std::string &                  shader_name,
-                const std::string &                  shader_string,
-                const std::string &                  shader_access_point,
-                const ShaderStageEnum                shader_stage,
-                const std::filesystem::path &        path,
-                const std::span<const std::string> & defines,
-                const bool                           as_spirv) const
+    dxc_preprocess(const std::string &                  shader_string,
+                   const std::filesystem::path &        path,
+                   const std::span<const std::string> & defines,
+                   const bool                           as_spirv) const
     {
         HRESULT hr;
 
         // name of dxc must be path so includer knows relative path
-        std::wstring wshader_name(shader_name.begin(), shader_name.end());
         std::wstring wshader_path = path.wstring();
 
         // create blob from shader string
@@ -149,54 +187,88 @@ struct HlslDxcCompiler
         }
 
         // create include handler
-        ComPtr<IDxcIncludeHandler> includer;
-        hr = m_utils->CreateDefaultIncludeHandler(includer.GetAddressOf());
+        ComPtr<IDxcIncludeHandler> includer = create_include_handler(path);
+
+        std::vector<std::wstring>    wdefines;
+        const std::vector<DxcDefine> dxc_defines = get_dxc_defines(defines, &wdefines);
+        std::vector<LPCWSTR> * arguments =
+            as_spirv ? get_compiling_argument<true>() : get_compiling_argument<false>();
+
+        ComPtr<IDxcBlob>            preprocessed_source_blob;
+        ComPtr<IDxcOperationResult> preprocess_result;
+        hr = m_compiler->Preprocess(source_blob.Get(),
+                                    wshader_path.c_str(),
+                                    arguments->data(),
+                                    static_cast<UINT32>(arguments->size()),
+                                    dxc_defines.data(),
+                                    static_cast<UINT32>(dxc_defines.size()),
+                                    includer.Get(),
+                                    &preprocess_result);
+
+        // check if succeed
+        if (SUCCEEDED(hr)) preprocess_result->GetStatus(&hr);
+
+        // handle compilation fail
+        if (FAILED(hr) || preprocess_result == nullptr)
+        {
+            if (preprocess_result)
+            {
+                ComPtr<IDxcBlobEncoding> error_blob;
+                HRESULT                  hr2 = preprocess_result->GetErrorBuffer(&error_blob);
+                if (SUCCEEDED(hr2) && error_blob)
+                {
+                    Logger::Error<true>(__FUNCTION__,
+                                        " compilation failed with errors caused by",
+                                        path.string(),
+                                        "\n",
+                                        (const char *)error_blob->GetBufferPointer());
+                }
+                else
+                {
+                    Logger::Error<true>(
+                        __FUNCTION__ " preprocessing error creation fail 0 caused by",
+                        path.string());
+                }
+            }
+            else
+            {
+                Logger::Error<true>(
+                    __FUNCTION__ " preprocessing error creation fail 1 caused by",
+                    path.string());
+            }
+        }
+        hr = preprocess_result->GetResult(&preprocessed_source_blob);
         if (FAILED(hr))
         {
             Logger::Error<true>(
-                __FUNCTION__ " failed to create default includer header caused by : " + path.string());
+                __FUNCTION__ " failed to create preprocessed code blob caused by",
+                path.string());
         }
 
-        // convert string of defines into string of wide strings
-        std::vector<std::wstring> wdefines;
-        wdefines.reserve(defines.size());
-        for (size_t i = 0; i < defines.size(); i++)
-        {
-            wdefines.emplace_back(defines[i].begin(), defines[i].end());
-        }
+        return preprocessed_source_blob;
+    }
 
-        // plug wide strings into dxc
-        std::vector<DxcDefine> dxc_defines;
-        dxc_defines.reserve(wdefines.size() + 2);
-        for (size_t i = 0; i < wdefines.size(); i++)
-        {
-            DxcDefine dxcdefine;
-            dxcdefine.Name  = wdefines[i].c_str();
-            dxcdefine.Value = nullptr;
-            dxc_defines.push_back(dxcdefine);
-        }
+    // dxc compile a source returned by dxc_preprocess (possibly from another thread's compiler)
+    template <typename ShaderStageEnum>
+    ComPtr<IDxcBlob>
+    dxc_compile_preprocessed(IDxcBlob *                           preprocessed_source_blob,
+                             const std::string &                  shader_name,
+                             const std::string &                  shader_access_point,
+                             const ShaderStageEnum                shader_stage,
+                             const std::filesystem::path &        path,
+                             const std::span<const std::string> & defines,
+                             const bool                           as_spirv) const
+    {
+        HRESULT hr;
 
-        // default dxc defines
-        DxcDefine dxc_preprocessor;
-        dxc_preprocessor.Name  = L"__dxc";
-        dxc_preprocessor.Value = nullptr;
-        dxc_defines.push_back(dxc_preprocessor);
+        std::wstring wshader_name(shader_name.begin(), shader_name.end());
 
-        DxcDefine hlsl_preprocessor;
-        hlsl_preprocessor.Name  = L"__hlsl";
-        hlsl_preprocessor.Value = nullptr;
-        dxc_defines.push_back(hlsl_preprocessor);
+        ComPtr<IDxcIncludeHandler> includer = create_include_handler(path);
 
-        // populate arguments (dxc command-line arguments)
-        std::vector<LPCWSTR> * arguments;
-        if (as_spirv)
-        {
-            arguments = get_compiling_argument<true>();
-        }
-        else
-        {
-            arguments = get_compiling_argument<false>();
-        }
+        std::vector<std::wstring>    wdefines;
+        const std::vector<DxcDefine> dxc_defines = get_dxc_defines(defines, &wdefines);
+        std::vector<LPCWSTR> * arguments =
+            as_spirv ? get_compiling_argument<true>() : get_compiling_argument<false>();
 
         TargetProfile target_profile = GetTargetProfile(shader_stage);
         std::wstring  wshader_access_point;
@@ -205,117 +277,98 @@ struct HlslDxcCompiler
             wshader_access_point = std::wstring(shader_access_point.begin(), shader_access_point.end());
         }
 
-        // dxc preprocess
-        ComPtr<IDxcBlob> preprocessed_source_blob;
+        ComPtr<IDxcBlob>            code_result;
+        ComPtr<IDxcOperationResult> compilation_result;
+        hr = m_compiler->Compile(preprocessed_source_blob,
+                                 wshader_name.c_str(),
+                                 wshader_access_point.c_str(),
+                                 target_profile.m_target_profile_str,
+                                 arguments->data(),
+                                 static_cast<UINT32>(arguments->size()),
+                                 dxc_defines.data(),
+                                 static_cast<UINT32>(dxc_defines.size()),
+                                 includer.Get(),
+                                 &compilation_result);
+
+        // check if succeed
+        if (SUCCEEDED(hr)) compilation_result->GetStatus(&hr);
+
+        // handle compilation fail
+        if (FAILED(hr) || compilation_result == nullptr)
         {
-            ComPtr<IDxcOperationResult> preprocess_result;
-            hr = m_compiler->Preprocess(source_blob.Get(),
-                                        wshader_path.c_str(),
-                                        arguments->data(),
-                                        static_cast<UINT32>(arguments->size()),
-                                        dxc_defines.data(),
-                                        static_cast<UINT32>(dxc_defines.size()),
-                                        includer.Get(),
-                                        &preprocess_result);
-
-            // check if succeed
-            if (SUCCEEDED(hr)) preprocess_result->GetStatus(&hr);
-
-            // handle compilation fail
-            if (FAILED(hr) || preprocess_result == nullptr)
+            if (compilation_result)
             {
-                if (preprocess_result)
+                ComPtr<IDxcBlobEncoding> error_blob;
+                HRESULT                  hr2 = compilation_result->GetErrorBuffer(&error_blob);
+                if (SUCCEEDED(hr2) && error_blob)
                 {
-                    ComPtr<IDxcBlobEncoding> error_blob;
-                    HRESULT                  hr2 = preprocess_result->GetErrorBuffer(&error_blob);
-                    if (SUCCEEDED(hr2) && error_blob)
-                    {
-                        Logger::Error<true>(__FUNCTION__,
-                                            " compilation failed with errors caused by",
-                                            path.string(),
-                                            "\n",
-                                            (const char *)error_blob->GetBufferPointer());
-                    }
-                    else
-                    {
-                        Logger::Error<true>(
-                            __FUNCTION__ " preprocessing error creation fail 0 caused by",
-                            path.string());
-                    }
+                    Logger::Error<true>(__FUNCTION__,
+                                        " compilation failed with errors caused by",
+                                        path.string(),
+                                        "\n",
+                                        (const char *)error_blob->GetBufferPointer());
                 }
                 else
                 {
                     Logger::Error<true>(
-                        __FUNCTION__ " preprocessing error creation fail 1 caused by",
+                        __FUNCTION__ " compilation error creation fail 0 caused by",
                         path.string());
                 }
             }
-            hr = preprocess_result->GetResult(&preprocessed_source_blob);
-            if (FAILED(hr))
+            else
             {
-                Logger::Error<true>(
-                    __FUNCTION__ " failed to create preprocessed code blob caused by",
-                    path.string());
+                Logger::Error<true>(__FUNCTION__ " compilation error creation fail 1 caused by",
+                                    path.string());
             }
         }
 
-        // dxc compile
-        ComPtr<IDxcBlob> code_result;
+        hr = compilation_result->GetResult(&code_result);
+        if (FAILED(hr))
         {
-            ComPtr<IDxcOperationResult> compilation_result;
-
-
-            hr = m_compiler->Compile(preprocessed_source_blob.Get(),
-                                     wshader_name.c_str(),
-                                     wshader_access_point.c_str(),
-                                     target_profile.m_target_profile_str,
-                                     arguments->data(),
-                                     static_cast<UINT32>(arguments->size()),
-                                     dxc_defines.data(),
-                                     static_cast<UINT32>(dxc_defines.size()),
-                                     includer.Get(),
-                                     &compilation_result);
+            Logger::Error<true>(__FUNCTION__ " failed to create code result blob caused by", path.string());
+        }
 
-            // check if succeed
-            if (SUCCEEDED(hr)) compilation_result->GetStatus(&hr);
+        if (as_spirv)
+        {
+            assert(code_result->GetBufferSize() % 4 == 0);
+        }
+        return code_result;
+    }
 
-            // handle compilation fail
-            if (FAILED(hr) || compilation_result == nullptr)
-            {
-                if (compilation_result)
-                {
-                    ComPtr<IDxcBlobEncoding> error_blob;
-                    HRESULT                  hr2 = compilation_result->GetErrorBuffer(&error_blob);
-                    if (SUCCEEDED(hr2) && error_blob)
-                    {
-                        Logger::Error<true>(__FUNCTION__,
-                                            " compilation failed with errors caused by",
-                                            path.string(),
-                                            "\n",
-                                            (const char *)error_blob->GetBufferPointer());
-                    }
-                    else
-                    {
-                        Logger::Error<true>(
-                            __FUNCTION__ " compilation error creation fail 0 caused by",
-                            path.string());
-                    }
-                }
-                else
-                {
-                    Logger::Error<true>(__FUNCTION__ " compilation error creation fail 1 caused by",
-                                        path.string());
-                }
-            }
+    template <typename ShaderStageEnum>
+    ComPtr<IDxcBlob>
+    dxc_compile(const std::string &                  shader_name,
+                const std::string &                  shader_string,
+                const std::string &                  shader_access_point,
+                const ShaderStageEnum                shader_stage,
+                const std::filesystem::path &        path,
+                const std::span<const std::string> & defines,
+                const bool                           as_spirv) const
+    {
+        ComPtr<IDxcBlob> preprocessed_source_blob = dxc_preprocess(shader_string, path, defines, as_spirv);
+        return dxc_compile_preprocessed(preprocessed_source_blob.Get(),
+                                        shader_name,
+                                        shader_access_point,
+                                        shader_stage,
+                                        path,
+                                        defines,
+                                        as_spirv);
+    }
 
-            hr = compilation_result->GetResult(&code_result);
-            if (FAILED(hr))
-            {
-                Logger::Error<true>(__FUNCTION__ " failed to create code result blob caused by", path.string());
-            }
+    // wrap a binary (e.g. loaded from the shader cache) into a blob for the d3d12 side
+    ComPtr<IDxcBlob>
+    create_blob(const std::span<const std::byte> binary) const
+    {
+        ComPtr<IDxcBlobEncoding> blob;
+        HRESULT                  hr = m_utils->CreateBlob(binary.data(),
+                                         static_cast<UINT32>(binary.size()),
+                                         DXC_CP_ACP,
+                                         blob.GetAddressOf());
+        if (FAILED(hr))
+        {
+            Logger::Error<true>(__FUNCTION__ " failed to create blob");
         }
-
-        return code_result;
+        return blob;
     }
 
     ComPtr<IDxcBlob>
@@ -336,14 +389,63 @@ struct HlslDxcCompiler
     {
         Logger::Info(__FUNCTION__ " compiling spirv from path : " + shader_src.m_file_path.string());
 
-        ComPtr<IDxcBlob> blob = dxc_compile(shader_src.m_file_path.string(),
-                                            shader_src.source(),
-                                            shader_src.m_entry,
-                                            shader_src.m_shader_stage,
-                                            shader_src.m_file_path,
-                                            shader_src.m_defines,
-                                            true);
-        assert(blob->GetBufferSize() % 4 == 0);
-        return blob;
+        return dxc_compile(shader_src.m_file_path.string(),
+                           shader_src.source(),
+                           shader_src.m_entry,
+                           shader_src.m_shader_stage,
+                           shader_src.m_file_path,
+                           shader_src.m_defines,
+                           true);
+    }
+
+private:
+    ComPtr<IDxcIncludeHandler>
+    create_include_handler(const std::filesystem::path & path) const
+    {
+        ComPtr<IDxcIncludeHandler> includer;
+        HRESULT                    hr = m_utils->CreateDefaultIncludeHandler(includer.GetAddressOf());
+        if (FAILED(hr))
+        {
+            Logger::Error<true>(
+                __FUNCTION__ " failed to create default includer header caused by : " + path.string());
+        }
+        return includer;
+    }
+
+    // wdefines owns the strings the returned defines point to
+    static std::vector<DxcDefine>
+    get_dxc_defines(const std::span<const std::string> & defines, std::vector<std::wstring> * wdefines)
+    {
+        // convert string of defines into string of wide strings
+        wdefines->clear();
+        wdefines->reserve(defines.size());
+        for (size_t i = 0; i < defines.size(); i++)
+        {
+            wdefines->emplace_back(defines[i].begin(), defines[i].end());
+        }
+
+        // plug wide strings into dxc
+        std::vector<DxcDefine> dxc_defines;
+        dxc_defines.reserve(wdefines->size() + 2);
+        for (size_t i = 0; i < wdefines->size(); i++)
+        {
+            DxcDefine dxcdefine;
+            dxcdefine.Name  = (*wdefines)[i].c_str();
+            dxcdefine.Value = nullptr;
+            dxc_defines.push_back(dxcdefine);
+        }
+
+        // default dxc defines
+        DxcDefine dxc_preprocessor;
+        dxc_preprocessor.Name  = L"__dxc";
+        dxc_preprocessor.Value = nullptr;
+        dxc_defines.push_back(dxc_preprocessor);
+
+        DxcDefine hlsl_preprocessor;
+        hlsl_preprocessor.Name  = L"__hlsl";
+        hlsl_preprocessor.Value = nullptr;
+        dxc_defines.push_back(hlsl_preprocessor);
+
+        return dxc_defines;
     }
 };
@@ -2,6 +2,10 @@
 
 #include "pch/pch.h"
 
+#include "core/hash.h"
+#include "core/logger.h"
+#include "core/stopwatch.h"
+#include "core/thread_pool.h"
 #include "rhi/common/rhi_enums.h"
 #include "rhi/common/rhi_shader_src.h"
 #include "rhi/shadercompiler/hlsldxccompiler.h"
@@ -39,6 +43,11 @@ struct ShaderBinaryHandle
 
 // Shader Binary Manager responsibles for caching shaders.
 // It initializes, hotreloads, recompiles the shaders on demand.
+//
+// Compiled shaders are cached on disk, keyed by everything the binary depends on:
+// the content of the source file and of every file it includes, the defines, the entry point,
+// the target profile, the compiling arguments and the dxc build.
+// A warm cache never touches dxc.
 struct ShaderBinaryManager
 {
     template <typename T>
@@ -48,86 +57,370 @@ struct ShaderBinaryManager
 
     struct ShaderCacheFileHeader
     {
-        uint32_t m_version;
-        uint32_t m_compiled_shader_size;
-        uint64_t m_src_last_modified_time;
-    };
+        static constexpr uint64_t Magic = 0x5244485354524F4Dull; // "MORTSHDR"
+        // bump the version whenever the layout of the cache file changes
+        static constexpr uint32_t Version = 1;
 
-    struct ShaderCacheFileBody
-    {
-        std::vector<std::byte> m_data;
+        uint64_t m_magic                = Magic;
+        uint32_t m_version              = Version;
+        uint32_t m_padding              = 0;
+        uint64_t m_compiler_hash        = 0;
+        // two independent 64 bits hashes of the key, so a stale binary is practically never picked up
+        uint64_t m_key_hash0            = 0;
+        uint64_t m_key_hash1            = 0;
+        uint64_t m_compiled_shader_size = 0;
     };
 
-    struct ShaderCacheFile
+    struct ShaderCacheKey
     {
-        ShaderCacheFileHeader m_header;
-        ShaderCacheFileBody   m_body;
+        uint64_t m_hash0 = 0;
+        uint64_t m_hash1 = 0;
     };
 
     std::filesystem::path m_cache_folder;
+    uint64_t              m_compiler_hash = 0;
+    // runs the cache reads, preprocesses and compiles of get_cached_shaders
+    ThreadPool &          m_thread_pool;
 
-    ShaderBinaryManager(const std::filesystem::path & cache_folder) : m_cache_folder(cache_folder)
+    ShaderBinaryManager(const std::filesystem::path & cache_folder, ThreadPool & thread_pool = ThreadPool::Get())
+    : m_cache_folder(cache_folder), m_compiler_hash(m_hlsl_compiler.get_compiler_hash()), m_thread_pool(thread_pool)
     {
+        std::error_code ec;
+        std::filesystem::create_directories(m_cache_folder, ec);
     }
 
     // ShaderBlob
     std::vector<std::byte>
-    get_cached_shader(const Rhi::ShaderSrc & shader_src) const
+    get_cached_shader(const Rhi::ShaderSrc & shader_src, const bool as_spirv = true) const
+    {
+        return std::move(get_cached_shaders(std::span<const Rhi::ShaderSrc>(&shader_src, 1), as_spirv)[0]);
+    }
+
+    // ShaderBlobs of every shader src of a pipeline, in the same order as shader_srcs
+    // - srcs sharing a cache key (every entry point of a library) are loaded or compiled once,
+    // - srcs of the same file with the same defines share one dxc preprocess,
+    // - the remaining cache reads and dxc invocations run on the thread pool, one dxc instance per thread.
+    std::vector<std::vector<std::byte>>
+    get_cached_shaders(const std::span<const Rhi::ShaderSrc> shader_srcs, const bool as_spirv = true) const
     {
-        // no filepath, compile directly from shader src
-        if (shader_src.m_file_path.empty())
+        StopWatch stop_watch;
+
+        struct ShaderJob
         {
-            ComPtr<IDxcBlob> dxc_blob = m_hlsl_compiler.compile_as_spirv(shader_src);
-            return to_byte_vector(*dxc_blob.Get());
+            size_t                        m_src_index = 0;
+            std::optional<ShaderCacheKey> m_key;
+            size_t                        m_preprocess_index = 0;
+            bool                          m_is_cached        = false;
+            std::vector<std::byte>        m_binary;
+        };
+
+        // hash every source tree, srcs without file path or with unreadable sources are always compiled
+        std::vector<std::optional<ShaderCacheKey>> keys(shader_srcs.size());
+        m_thread_pool.parallel_for(0,
+                                   shader_srcs.size(),
+                                   [&](const size_t i_src)
+                                   {
+                                       if (!shader_srcs[i_src].m_file_path.empty())
+                                       {
+                                           keys[i_src] = get_shader_cache_key(shader_srcs[i_src], as_spirv);
+                                       }
+                                   });
+
+        // dedup srcs which end up in the same binary
+        std::vector<ShaderJob>                          jobs;
+        std::vector<size_t>                             job_indices(shader_srcs.size());
+        std::map<std::pair<uint64_t, uint64_t>, size_t> job_index_by_key;
+        for (size_t i_src = 0; i_src < shader_srcs.size(); i_src++)
+        {
+            if (keys[i_src].has_value())
+            {
+                const std::pair<uint64_t, uint64_t> key_pair = { keys[i_src]->m_hash0, keys[i_src]->m_hash1 };
+                const auto                          found    = job_index_by_key.find(key_pair);
+                if (found != job_index_by_key.end())
+                {
+                    job_indices[i_src] = found->second;
+                    continue;
+                }
+                job_index_by_key[key_pair] = jobs.size();
+            }
+            job_indices[i_src] = jobs.size();
+            ShaderJob & job    = jobs.emplace_back();
+            job.m_src_index    = i_src;
+            job.m_key          = keys[i_src];
         }
 
-        // check source write time
-        const uint64_t src_modified_time = static_cast<uint64_t>(
-            std::filesystem::last_write_time(shader_src.m_file_path).time_since_epoch().count());
+        // load whatever is already in the cache
+        m_thread_pool.parallel_for(0,
+                                   jobs.size(),
+                                   [&](const size_t i_job)
+                                   {
+                                       ShaderJob & job = jobs[i_job];
+                                       if (job.m_key.has_value())
+                                       {
+                                           std::optional<std::vector<std::byte>> binary =
+                                               read_cache_file(job.m_key.value());
+                                           if (binary.has_value())
+                                           {
+                                               job.m_binary    = std::move(binary.value());
+                                               job.m_is_cached = true;
+                                           }
+                                       }
+                                   });
 
-        // get shader blob
-        const std::filesystem::path cached_file_path = get_shader_cache_path(shader_src);
-        std::ifstream               ifs(cached_file_path, std::ios::binary);
-        if (ifs.is_open() && false)
+        // group the misses by file and defines, each group is preprocessed once
+        std::vector<size_t> preprocess_src_indices;
         {
-            // read header and body
-            const ShaderCacheFileHeader header = read_header(ifs);
-            if (header.m_src_last_modified_time == src_modified_time)
+            std::map<std::pair<std::filesystem::path, std::vector<std::string>>, size_t> preprocess_index_by_input;
+            for (ShaderJob & job : jobs)
             {
-                const ShaderCacheFileBody body = read_body(header, ifs);
-                return body.m_data;
+                if (job.m_is_cached)
+                {
+                    continue;
+                }
+                const Rhi::ShaderSrc & shader_src = shader_srcs[job.m_src_index];
+                const auto             input      = std::make_pair(shader_src.m_file_path, shader_src.m_defines);
+                const auto             found      = preprocess_index_by_input.find(input);
+                if (found != preprocess_index_by_input.end())
+                {
+                    job.m_preprocess_index = found->second;
+                    continue;
+                }
+                job.m_preprocess_index           = preprocess_src_indices.size();
+                preprocess_index_by_input[input] = preprocess_src_indices.size();
+                preprocess_src_indices.push_back(job.m_src_index);
             }
         }
 
-        // cached dxc blob is invalid.
-        // we have to recompile and rewrite the cache
-        ComPtr<IDxcBlob> dxc_blob = m_hlsl_compiler.compile_as_spirv(shader_src);
+        std::vector<ComPtr<IDxcBlob>> preprocessed_blobs(preprocess_src_indices.size());
+        m_thread_pool.parallel_for(0,
+                                   preprocess_src_indices.size(),
+                                   [&](const size_t i_preprocess)
+                                   {
+                                       const Rhi::ShaderSrc & shader_src =
+                                           shader_srcs[preprocess_src_indices[i_preprocess]];
+                                       preprocessed_blobs[i_preprocess] =
+                                           HlslDxcCompiler::GetForThisThread().dxc_preprocess(shader_src.source(),
+                                                                                              shader_src.m_file_path,
+                                                                                              shader_src.m_defines,
+                                                                                              as_spirv);
+                                   });
+
+        // compile the misses and refresh the cache
+        std::atomic<size_t> num_compiled_jobs = 0;
+        m_thread_pool.parallel_for(0,
+                                   jobs.size(),
+                                   [&](const size_t i_job)
+                                   {
+                                       ShaderJob & job = jobs[i_job];
+                                       if (job.m_is_cached)
+                                       {
+                                           return;
+                                       }
 
-        // write header and body
-        std::ofstream ofs(cached_file_path, std::ios::binary);
-        write_header(ofs, src_modified_time, dxc_blob.Get());
-        write_body(ofs, dxc_blob.Get());
+                                       const Rhi::ShaderSrc & shader_src = shader_srcs[job.m_src_index];
+                                       Logger::Info(__FUNCTION__,
+                                                    " compiling ",
+                                                    as_spirv ? "spirv" : "dxil",
+                                                    " from path : ",
+                                                    shader_src.m_file_path.string());
+                                       ComPtr<IDxcBlob> dxc_blob =
+                                           HlslDxcCompiler::GetForThisThread().dxc_compile_preprocessed(
+                                               preprocessed_blobs[job.m_preprocess_index].Get(),
+                                               shader_src.m_file_path.string(),
+                                               shader_src.m_entry,
+                                               shader_src.m_shader_stage,
+                                               shader_src.m_file_path,
+                                               shader_src.m_defines,
+                                               as_spirv);
+                                       if (job.m_key.has_value())
+                                       {
+                                           write_cache_file(get_shader_cache_path(job.m_key.value()),
+                                                            job.m_key.value(),
+                                                            *dxc_blob.Get());
+                                       }
+                                       job.m_binary = to_byte_vector(*dxc_blob.Get());
+                                       num_compiled_jobs++;
+                                   });
 
-        return to_byte_vector(*dxc_blob.Get());
+        std::vector<std::vector<std::byte>> result(shader_srcs.size());
+        for (size_t i_src = 0; i_src < shader_srcs.size(); i_src++)
+        {
+            result[i_src] = jobs[job_indices[i_src]].m_binary;
+        }
+
+        if (num_compiled_jobs.load() > 0)
+        {
+            Logger::Info(__FUNCTION__,
+                         " compiled ",
+                         num_compiled_jobs.load(),
+                         " of ",
+                         jobs.size(),
+                         " shader binaries for ",
+                         shader_srcs.size(),
+                         " shader srcs in ",
+                         stop_watch.time_milli_sec(),
+                         " ms");
+        }
+        return result;
+    }
+
+    // canonical paths of the source file and every file it includes, used to find which pipelines a changed file affects
+    static std::set<std::filesystem::path>
+    GetSourceTreePaths(const Rhi::ShaderSrc & shader_src)
+    {
+        std::set<std::filesystem::path> visited_paths;
+        if (!shader_src.m_file_path.empty())
+        {
+            auto ignore = [](const std::string_view &) {};
+            add_source_tree(shader_src.m_file_path, shader_src.m_file_path.parent_path(), ignore, &visited_paths);
+        }
+        return visited_paths;
     }
 
 private:
-    std::filesystem::path
-    get_shader_cache_path(const Rhi::ShaderSrc & shader_src) const
+    std::optional<ShaderCacheKey>
+    get_shader_cache_key(const Rhi::ShaderSrc & shader_src, const bool as_spirv) const
     {
-        std::string val = shader_src.m_file_path.string();
-        if (!HlslDxcCompiler::GetTargetProfile(shader_src.m_shader_stage).m_is_lib)
+        Hash64 hash0;
+        Hash64 hash1(0x6C62272E07BB0142ull);
+        auto   add = [&](const std::string_view & str)
+        {
+            hash0.add(str);
+            hash1.add(str);
+        };
+
+        // source and everything it includes
+        std::set<std::filesystem::path> visited_paths;
+        if (!add_source_tree(shader_src.m_file_path, shader_src.m_file_path.parent_path(), add, &visited_paths))
         {
-            val += "_" + shader_src.m_entry;
+            return std::nullopt;
         }
-        val += "_";
+
+        // defines, entry point and target profile
         for (const std::string & define : shader_src.m_defines)
         {
-            val += define;
+            add(define);
+        }
+        // libraries contain every entry point, so all entries share one binary
+        const HlslDxcCompiler::TargetProfile target_profile = HlslDxcCompiler::GetTargetProfile(shader_src.m_shader_stage);
+        if (!target_profile.m_is_lib)
+        {
+            add(shader_src.m_entry);
+        }
+        add(to_utf8(target_profile.m_target_profile_str));
+
+        // compiling arguments
+        const std::vector<LPCWSTR> * arguments =
+            as_spirv ? HlslDxcCompiler::get_compiling_argument<true>() : HlslDxcCompiler::get_compiling_argument<false>();
+        for (const LPCWSTR argument : *arguments)
+        {
+            add(to_utf8(argument));
+        }
+
+        ShaderCacheKey result;
+        result.m_hash0 = hash0.get();
+        result.m_hash1 = hash1.get();
+        return result;
+    }
+
+    // hash the content of path and, recursively, of every file it includes
+    // includes are resolved like dxc's default include handler does, relative to the including file first then
+    // relative to the root shader. includes which cannot be found are skipped (e.g. c++ only includes in
+    // "#ifndef __hlsl" blocks), dxc reports them if they are really needed.
+    template <typename AddFunc>
+    static bool
+    add_source_tree(const std::filesystem::path &     path,
+                    const std::filesystem::path &     root_dir,
+                    AddFunc &                         add,
+                    std::set<std::filesystem::path> * visited_paths)
+    {
+        const std::filesystem::path canonical_path = std::filesystem::weakly_canonical(path);
+        if (!visited_paths->insert(canonical_path).second)
+        {
+            return true;
+        }
+
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs.is_open())
+        {
+            return false;
+        }
+        std::stringstream buffer;
+        buffer << ifs.rdbuf();
+        const std::string source = buffer.str();
+        add(source);
+
+        std::istringstream iss(source);
+        std::string        line;
+        while (std::getline(iss, line))
+        {
+            const std::optional<std::string> include_name = get_include_name(line);
+            if (!include_name.has_value())
+            {
+                continue;
+            }
+
+            for (const std::filesystem::path & dir : { path.parent_path(), root_dir })
+            {
+                const std::filesystem::path include_path = dir / include_name.value();
+                if (std::filesystem::exists(include_path))
+                {
+                    if (!add_source_tree(include_path, root_dir, add, visited_paths))
+                    {
+                        return false;
+                    }
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    // return the file name of '#include "name"' or '#include <name>'
+    static std::optional<std::string>
+    get_include_name(const std::string & line)
+    {
+        size_t pos = line.find_first_not_of(" \t");
+        if (pos == std::string::npos || line[pos] != '#')
+        {
+            return std::nullopt;
         }
-        const size_t unique_id = std::hash<std::string>()(val);
+        pos = line.find_first_not_of(" \t", pos + 1);
+        if (pos == std::string::npos || line.compare(pos, 7, "include") != 0)
+        {
+            return std::nullopt;
+        }
+        pos = line.find_first_of("\"<", pos + 7);
+        if (pos == std::string::npos)
+        {
+            return std::nullopt;
+        }
+        const size_t end = line.find_first_of(line[pos] == '"' ? "\"" : ">", pos + 1);
+        if (end == std::string::npos)
+        {
+            return std::nullopt;
+        }
+        return line.substr(pos + 1, end - pos - 1);
+    }
 
-        return m_cache_folder / (std::to_string(unique_id) + ".shaderbin");
+    static std::string
+    to_utf8(const wchar_t * wstr)
+    {
+        // compiling arguments and profiles are plain ascii
+        std::string result;
+        for (const wchar_t * c = wstr; *c != 0; c++)
+        {
+            result.push_back(static_cast<char>(*c));
+        }
+        return result;
+    }
+
+    std::filesystem::path
+    get_shader_cache_path(const ShaderCacheKey & key) const
+    {
+        std::ostringstream oss;
+        oss << std::hex << std::setw(16) << std::setfill('0') << key.m_hash0;
+        return m_cache_folder / (oss.str() + ".shaderbin");
     }
 
     std::vector<std::byte>
@@ -139,47 +432,86 @@ private:
         return result;
     }
 
-    ShaderCacheFileHeader
+    // return nullopt if the cache file is missing, stale or truncated
+    std::optional<std::vector<std::byte>>
+    read_cache_file(const ShaderCacheKey & key) const
+    {
+        std::ifstream ifs(get_shader_cache_path(key), std::ios::binary);
+        if (!ifs.is_open())
+        {
+            return std::nullopt;
+        }
+
+        // read header and body
+        const std::optional<ShaderCacheFileHeader> header = read_header(ifs);
+        if (!header.has_value() || header->m_compiler_hash != m_compiler_hash || header->m_key_hash0 != key.m_hash0 ||
+            header->m_key_hash1 != key.m_hash1)
+        {
+            return std::nullopt;
+        }
+        return read_body(header.value(), ifs);
+    }
+
+    std::optional<ShaderCacheFileHeader>
     read_header(std::ifstream & ifs) const
     {
         assert(ifs.is_open());
         ShaderCacheFileHeader result;
-        ifs.read(reinterpret_cast<char *>(&result.m_version), sizeof(result.m_version))
-            .read(reinterpret_cast<char *>(&result.m_src_last_modified_time), sizeof(result.m_src_last_modified_time))
-            .read(reinterpret_cast<char *>(&result.m_compiled_shader_size), sizeof(result.m_compiled_shader_size));
+        ifs.read(reinterpret_cast<char *>(&result), sizeof(ShaderCacheFileHeader));
+        if (!ifs.good() || result.m_magic != ShaderCacheFileHeader::Magic ||
+            result.m_version != ShaderCacheFileHeader::Version)
+        {
+            return std::nullopt;
+        }
         return result;
     }
 
-    ShaderCacheFileBody
+    std::optional<std::vector<std::byte>>
     read_body(const ShaderCacheFileHeader & header, std::ifstream & ifs) const
     {
         assert(ifs.is_open());
-        ShaderCacheFileBody result;
-        result.m_data.resize(header.m_compiled_shader_size);
-        ifs.read(reinterpret_cast<char *>(result.m_data.data()), result.m_data.size());
+        std::vector<std::byte> result(header.m_compiled_shader_size);
+        ifs.read(reinterpret_cast<char *>(result.data()), static_cast<std::streamsize>(result.size()));
+        if (!ifs.good())
+        {
+            return std::nullopt;
+        }
         return result;
     }
 
+    // write into a temporary file then rename, so a crash or a concurrent writer never leaves a half written
+    // cache file behind
     void
-    write_header(std::ofstream & ofs, const uint64_t src_modified_time, IDxcBlob * blob) const
+    write_cache_file(const std::filesystem::path & path, const ShaderCacheKey & key, IDxcBlob & blob) const
     {
-        assert(ofs.is_open());
         ShaderCacheFileHeader header;
-        header.m_version                = 0;
-        header.m_compiled_shader_size   = static_cast<uint32_t>(blob->GetBufferSize());
-        header.m_src_last_modified_time = src_modified_time;
-        ofs.write(reinterpret_cast<char *>(&header.m_version), sizeof(header.m_version))
-            .write(reinterpret_cast<char *>(&header.m_src_last_modified_time), sizeof(header.m_src_last_modified_time))
-            .write(reinterpret_cast<char *>(&header.m_compiled_shader_size),
-                   sizeof(header.m_compiled_shader_size));
-    }
+        header.m_compiler_hash        = m_compiler_hash;
+        header.m_key_hash0            = key.m_hash0;
+        header.m_key_hash1            = key.m_hash1;
+        header.m_compiled_shader_size = static_cast<uint64_t>(blob.GetBufferSize());
 
-    void
-    write_body(std::ofstream & ofs, IDxcBlob * blob) const
-    {
-        assert(ofs.is_open());
-        ShaderCacheFileBody result;
-        result.m_data.resize(blob->GetBufferSize());
-        ofs.write(reinterpret_cast<char *>(blob->GetBufferPointer()), result.m_data.size());
+        std::error_code             ec;
+        const std::filesystem::path tmp_path =
+            path.string() + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+        {
+            std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+            ofs.write(reinterpret_cast<const char *>(&header), sizeof(ShaderCacheFileHeader));
+            ofs.write(reinterpret_cast<const char *>(blob.GetBufferPointer()),
+                      static_cast<std::streamsize>(blob.GetBufferSize()));
+            if (!ofs.good())
+            {
+                Logger::Warn(__FUNCTION__, " failed writing ", tmp_path.string());
+                ofs.close();
+                std::filesystem::remove(tmp_path, ec);
+                return;
+            }
+        }
+
+        std::filesystem::rename(tmp_path, path, ec);
+        if (ec)
+        {
+            Logger::Warn(__FUNCTION__, " cannot rename ", tmp_path.string(), " to ", path.string(), " : ", ec.message());
+            std::filesystem::remove(tmp_path, ec);
+        }
     }
 };
\ No newline at end of file
@@ -13,6 +13,32 @@ struct MemoryRequirement
 {
     vk::MemoryRequirements m_vk_requirements;
 
+    // a requirement every resource matching either of the two can be bound to
+    MemoryRequirement
+    merge(const MemoryRequirement & requirement) const
+    {
+        MemoryRequirement result;
+        result.m_vk_requirements.size = std::max(m_vk_requirements.size, requirement.m_vk_requirements.size);
+        result.m_vk_requirements.alignment =
+            std::max(m_vk_requirements.alignment, requirement.m_vk_requirements.alignment);
+        result.m_vk_requirements.memoryTypeBits =
+            m_vk_requirements.memoryTypeBits & requirement.m_vk_requirements.memoryTypeBits;
+        return result;
+    }
+
+    // only resources of compatible memory types can share memory
+    bool
+    is_compatible(const MemoryRequirement & requirement) const
+    {
+        return (m_vk_requirements.memoryTypeBits & requirement.m_vk_requirements.memoryTypeBits) != 0;
+    }
+
+    size_t
+    get_size_in_bytes() const
+    {
+        return static_cast<size_t>(m_vk_requirements.size);
+    }
+
     bool
     can_support(const MemoryRequirement & requirement) const
     {
@@ -64,10 +90,10 @@ struct AliasableMemory
                     const Device &            device,
                     const MemoryRequirement & memory_requirement,
                     const MemoryUsageEnum     memory_usage)
-    : m_name(name),
+    : m_vma_memory_bundle(ConstructMemoryBundle(device, memory_requirement, memory_usage)),
       m_device(device),
       m_memory_requirement(memory_requirement),
-      m_vma_memory_bundle(ConstructMemoryBundle(device, memory_requirement, memory_usage))
+      m_name(name)
     {
     }
 
@@ -77,10 +103,12 @@ struct AliasableMemory
         VmaAllocationCreateInfo alloc_ci = {};
         alloc_ci.usage                   = static_cast<VmaMemoryUsage>(memory_usage);
 
-        VkMemoryRequirements m_vk_requirements = memory_requirement.m_vk_requirements;
-        VmaAllocation        vma_allocation;
+        VkMemoryRequirements vk_requirements = memory_requirement.m_vk_requirements;
+        VmaMemoryBundle      bundle;
         VmaAllocationInfo    vma_alloc_info;
-        vmaAllocateMemory(device.m_vma_allocator.get(), &m_vk_requirements, &alloc_ci, &vma_allocation, &vma_alloc_info);
+        bundle.m_vma_allocator = device.m_vma_allocator.get();
+        VKCK(vmaAllocateMemory(bundle.m_vma_allocator, &vk_requirements, &alloc_ci, &bundle.m_vma_allocation, &vma_alloc_info));
+        return bundle;
     }
 
     bool
@@ -88,6 +116,15 @@ struct AliasableMemory
     {
         return m_memory_requirement.can_support(requirement);
     }
+
+    // size of the allocation vma made, which may be larger than the requirement
+    size_t
+    get_allocation_size_in_bytes() const
+    {
+        VmaAllocationInfo vma_alloc_info;
+        vmaGetAllocationInfo(m_vma_memory_bundle->m_vma_allocator, m_vma_memory_bundle->m_vma_allocation, &vma_alloc_info);
+        return static_cast<size_t>(vma_alloc_info.size);
+    }
 };
 }; // namespace VKA_NAME
 #endif
\ No newline at end of file
@@ -46,6 +46,17 @@ struct Buffer
         vk::BufferCreateInfo buffer_ci_tmp;
         buffer_ci_tmp.setSize(buffer_size_in_bytes == 0 ? 32 : buffer_size_in_bytes);
         buffer_ci_tmp.setUsage(GetVkBufferUsageFlags(buffer_usage) | vk::BufferUsageFlagBits::eShaderDeviceAddress);
+
+        // acceleration structures are built on the compute queue and traced on the graphics queue, concurrent sharing
+        // saves an ownership transfer in both directions every frame
+        const std::array<uint32_t, 2> accel_family_indices = { device.m_family_indices.m_graphics,
+                                                               device.m_family_indices.m_compute };
+        if (Rhi::HasFlag(buffer_usage, Rhi::BufferUsageEnum::RayTracingAccelStructBuffer) &&
+            accel_family_indices[0] != accel_family_indices[1])
+        {
+            buffer_ci_tmp.setSharingMode(vk::SharingMode::eConcurrent);
+            buffer_ci_tmp.setQueueFamilyIndices(accel_family_indices);
+        }
         VkBufferCreateInfo      buffer_ci    = buffer_ci_tmp;
         VmaAllocationCreateInfo vma_alloc_ci = {};
         vma_alloc_ci.usage                   = GetVmaMemoryUsage(memory_usage);
@@ -50,9 +50,17 @@ static_assert(sizeof(vk::BufferCopy) == sizeof(BufferCopyInfo),
 
 struct CommandBuffer
 {
-    vk::Queue                m_vk_queue                         = {};
-    vk::CommandBuffer        m_vk_command_buffer                = {};
-    std::vector<QueryPool *> m_query_pools_reset_by_this_buffer = {};
+    struct TimelineSemaphorePoint
+    {
+        vk::Semaphore m_vk_semaphore;
+        uint64_t      m_value;
+    };
+
+    vk::Queue                           m_vk_queue                         = {};
+    vk::CommandBuffer                   m_vk_command_buffer                = {};
+    std::vector<QueryPool *>            m_query_pools_reset_by_this_buffer = {};
+    std::vector<TimelineSemaphorePoint> m_timeline_waits                   = {};
+    std::vector<TimelineSemaphorePoint> m_timeline_signals                 = {};
 
     CommandBuffer() {}
 
@@ -165,19 +173,22 @@ struct CommandBuffer
                            const uint3     dst_offset,
                            const Buffer &  src_buffer,
                            const size_t    src_offset_in_bytes,
-                           [[maybe_unused]] const size_t    row_pitch_in_bytes)
+                           [[maybe_unused]] const size_t    row_pitch_in_bytes,
+                           const uint32_t  mip_level = 0)
     {
         // copy
+        // row length / image height of 0 means tightly packed, which also works for block compressed formats
+        // whose row length must be a multiple of the block width
         vk::BufferImageCopy copy_region = {};
         copy_region.setBufferOffset(src_offset_in_bytes);
-        copy_region.setBufferImageHeight(dst_size.y);
-        copy_region.setBufferRowLength(dst_size.x);
+        copy_region.setBufferImageHeight(0);
+        copy_region.setBufferRowLength(0);
         copy_region.setImageExtent(vk::Extent3D(dst_size.x, dst_size.y, dst_size.z));
         copy_region.setImageOffset(vk::Offset3D(dst_offset.x, dst_offset.y, dst_offset.z));
         copy_region.imageSubresource.setAspectMask(vk::ImageAspectFlagBits::eColor);
         copy_region.imageSubresource.setBaseArrayLayer(0);
         copy_region.imageSubresource.setLayerCount(1);
-        copy_region.imageSubresource.setMipLevel(0);
+        copy_region.imageSubresource.setMipLevel(mip_level);
         m_vk_command_buffer.copyBufferToImage(src_buffer.get_vk_buffer(),
                                               dst_texture.get_vk_image(),
                                               vk::ImageLayout::eTransferDstOptimal,
@@ -224,6 +235,9 @@ struct CommandBuffer
             return vk::PipelineStageFlagBits::eEarlyFragmentTests;
         case vk::ImageLayout::eShaderReadOnlyOptimal:
             return vk::PipelineStageFlagBits::eFragmentShader;
+        case vk::ImageLayout::eGeneral:
+            // storage images are written by compute, ray tracing and fragment shaders alike
+            return vk::PipelineStageFlagBits::eAllCommands;
         case vk::ImageLayout::ePreinitialized:
             return vk::PipelineStageFlagBits::eHost;
         case vk::ImageLayout::eUndefined:
@@ -250,6 +264,8 @@ struct CommandBuffer
             return vk::AccessFlagBits::eDepthStencilAttachmentWrite;
         case vk::ImageLayout::eShaderReadOnlyOptimal:
             return vk::AccessFlagBits::eShaderRead;
+        case vk::ImageLayout::eGeneral:
+            return vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
         default:
             return vk::AccessFlags();
         }
@@ -272,24 +288,68 @@ struct CommandBuffer
         m_vk_command_buffer.endRenderPass();
     }
 
+    // the next submit waits on the device until semaphore reaches value
+    void
+    wait_timeline_semaphore(const TimelineSemaphore & semaphore, const uint64_t value)
+    {
+        m_timeline_waits.push_back({ semaphore.m_vk_semaphore.get(), value });
+    }
+
+    // the next submit sets semaphore to value once its commands have finished
+    void
+    signal_timeline_semaphore(const TimelineSemaphore & semaphore, const uint64_t value)
+    {
+        m_timeline_signals.push_back({ semaphore.m_vk_semaphore.get(), value });
+    }
+
     void
     submit(Fence * fence, const Semaphore * semaphore_to_wait = nullptr, const Semaphore * semaphore_to_signal = nullptr)
     {
-        vk::SubmitInfo         submit_info    = {};
-        vk::PipelineStageFlags dst_stage_mask = vk::PipelineStageFlagBits::eBottomOfPipe;
+        // binary semaphores first, their timeline values are ignored
+        std::vector<vk::Semaphore>          wait_semaphores;
+        std::vector<uint64_t>               wait_values;
+        std::vector<vk::PipelineStageFlags> wait_stage_masks;
+        std::vector<vk::Semaphore>          signal_semaphores;
+        std::vector<uint64_t>               signal_values;
         if (semaphore_to_wait != nullptr)
         {
-            submit_info.setPWaitSemaphores(&semaphore_to_wait->m_vk_semaphore.get());
-            submit_info.setWaitSemaphoreCount(1u);
-            submit_info.setPWaitDstStageMask(&dst_stage_mask);
+            wait_semaphores.push_back(semaphore_to_wait->m_vk_semaphore.get());
+            wait_values.push_back(0);
+            wait_stage_masks.push_back(vk::PipelineStageFlagBits::eBottomOfPipe);
+        }
+        for (const TimelineSemaphorePoint & timeline_wait : m_timeline_waits)
+        {
+            wait_semaphores.push_back(timeline_wait.m_vk_semaphore);
+            wait_values.push_back(timeline_wait.m_value);
+            wait_stage_masks.push_back(vk::PipelineStageFlagBits::eAllCommands);
         }
         if (semaphore_to_signal != nullptr)
         {
-            submit_info.setPSignalSemaphores(&semaphore_to_signal->m_vk_semaphore.get());
-            submit_info.setSignalSemaphoreCount(1u);
+            signal_semaphores.push_back(semaphore_to_signal->m_vk_semaphore.get());
+            signal_values.push_back(0);
+        }
+        for (const TimelineSemaphorePoint & timeline_signal : m_timeline_signals)
+        {
+            signal_semaphores.push_back(timeline_signal.m_vk_semaphore);
+            signal_values.push_back(timeline_signal.m_value);
         }
+
+        vk::TimelineSemaphoreSubmitInfo timeline_submit_info = {};
+        timeline_submit_info.setWaitSemaphoreValues(wait_values);
+        timeline_submit_info.setSignalSemaphoreValues(signal_values);
+
+        vk::SubmitInfo submit_info = {};
+        submit_info.setWaitSemaphores(wait_semaphores);
+        submit_info.setWaitDstStageMask(wait_stage_masks);
+        submit_info.setSignalSemaphores(signal_semaphores);
         submit_info.setPCommandBuffers(&m_vk_command_buffer);
         submit_info.setCommandBufferCount(1);
+        if (!m_timeline_waits.empty() || !m_timeline_signals.empty())
+        {
+            submit_info.setPNext(&timeline_submit_info);
+        }
+        m_timeline_waits.clear();
+        m_timeline_signals.clear();
 
         if (fence)
         {
@@ -321,7 +381,7 @@ struct CommandBuffer
         img_mem_barrier.setImage(texture.get_vk_image());
         img_mem_barrier.subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
         img_mem_barrier.subresourceRange.setBaseMipLevel(0);
-        img_mem_barrier.subresourceRange.setLevelCount(1);
+        img_mem_barrier.subresourceRange.setLevelCount(VK_REMAINING_MIP_LEVELS);
         img_mem_barrier.subresourceRange.setBaseArrayLayer(0);
         img_mem_barrier.subresourceRange.setLayerCount(1);
         img_mem_barrier.setSrcAccessMask(src_access_mask);
@@ -335,6 +395,140 @@ struct CommandBuffer
                                             { img_mem_barrier });
     }
 
+    // next_texture starts using memory that prev_texture last used in prev_state, next_texture was last left in
+    // next_pre_state. the content of next_texture is discarded, the barrier only waits for prev_texture to be done
+    // with the memory
+    void
+    alias_texture(const Texture &                         prev_texture,
+                  const TextureStateEnum                  prev_enum,
+                  const Texture &                         next_texture,
+                  [[maybe_unused]] const TextureStateEnum next_pre_enum,
+                  const TextureStateEnum                  next_post_enum)
+    {
+        const vk::ImageLayout prev_vk_image_layout = GetVkImageLayout(prev_enum);
+        const vk::ImageLayout next_vk_image_layout = GetVkImageLayout(next_post_enum);
+
+        vk::ImageMemoryBarrier img_mem_barrier;
+        img_mem_barrier.setOldLayout(vk::ImageLayout::eUndefined);
+        img_mem_barrier.setNewLayout(next_vk_image_layout);
+        img_mem_barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+        img_mem_barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+        img_mem_barrier.setImage(next_texture.get_vk_image());
+        img_mem_barrier.subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+        img_mem_barrier.subresourceRange.setBaseMipLevel(0);
+        img_mem_barrier.subresourceRange.setLevelCount(VK_REMAINING_MIP_LEVELS);
+        img_mem_barrier.subresourceRange.setBaseArrayLayer(0);
+        img_mem_barrier.subresourceRange.setLayerCount(1);
+        img_mem_barrier.setSrcAccessMask(access_flags_for_layout(prev_vk_image_layout));
+        img_mem_barrier.setDstAccessMask(access_flags_for_layout(next_vk_image_layout));
+
+        m_vk_command_buffer.pipelineBarrier(pipeline_stage_flags(prev_vk_image_layout),
+                                            pipeline_stage_flags(next_vk_image_layout),
+                                            vk::DependencyFlagBits(0),
+                                            nullptr,
+                                            nullptr,
+                                            { img_mem_barrier });
+    }
+
+    // queue family ownership transfer of a buffer range written by copies on src_queue_type and read on
+    // dst_queue_type. it is recorded twice with the same arguments: with is_release on src_queue_type, then without
+    // it on dst_queue_type in a submit that waits for the release. the acquire is recorded within one family too, so
+    // later submits on dst_queue_type are ordered after that wait
+    void
+    transfer_buffer_ownership(const Device &  device,
+                              const Buffer &  buffer,
+                              const size_t    offset_in_bytes,
+                              const size_t    size_in_bytes,
+                              const QueueType src_queue_type,
+                              const QueueType dst_queue_type,
+                              const bool      is_release)
+    {
+        const uint32_t src_family_index = device.get_queue_family_index(src_queue_type);
+        const uint32_t dst_family_index = device.get_queue_family_index(dst_queue_type);
+        const bool     is_same_family   = src_family_index == dst_family_index;
+        if (is_same_family && is_release)
+        {
+            return;
+        }
+
+        vk::BufferMemoryBarrier buffer_barrier;
+        buffer_barrier.setSrcAccessMask(is_release ? vk::AccessFlagBits::eTransferWrite : vk::AccessFlags());
+        buffer_barrier.setDstAccessMask(is_release ? vk::AccessFlags() : vk::AccessFlagBits::eMemoryRead);
+        buffer_barrier.setSrcQueueFamilyIndex(is_same_family ? VK_QUEUE_FAMILY_IGNORED : src_family_index);
+        buffer_barrier.setDstQueueFamilyIndex(is_same_family ? VK_QUEUE_FAMILY_IGNORED : dst_family_index);
+        buffer_barrier.setBuffer(buffer.get_vk_buffer());
+        buffer_barrier.setOffset(offset_in_bytes);
+        buffer_barrier.setSize(size_in_bytes);
+        m_vk_command_buffer.pipelineBarrier(is_release ? vk::PipelineStageFlagBits::eTransfer : vk::PipelineStageFlagBits::eAllCommands,
+                                            is_release ? vk::PipelineStageFlagBits::eBottomOfPipe : vk::PipelineStageFlagBits::eAllCommands,
+                                            vk::DependencyFlagBits(0),
+                                            nullptr,
+                                            { buffer_barrier },
+                                            nullptr);
+    }
+
+    // same as transfer_buffer_ownership for a texture, which also moves from pre_enum to post_enum.
+    // within one family the release does the layout transition and the acquire only orders later submits
+    void
+    transfer_texture_ownership(const Device &         device,
+                               const Texture &        texture,
+                               const TextureStateEnum pre_enum,
+                               const TextureStateEnum post_enum,
+                               const QueueType        src_queue_type,
+                               const QueueType        dst_queue_type,
+                               const bool             is_release)
+    {
+        const uint32_t src_family_index = device.get_queue_family_index(src_queue_type);
+        const uint32_t dst_family_index = device.get_queue_family_index(dst_queue_type);
+        const bool     is_same_family   = src_family_index == dst_family_index;
+
+        const vk::ImageLayout new_vk_image_layout = GetVkImageLayout(post_enum);
+        const vk::ImageLayout old_vk_image_layout =
+            is_same_family && !is_release ? new_vk_image_layout : GetVkImageLayout(pre_enum);
+
+        vk::ImageMemoryBarrier img_mem_barrier;
+        img_mem_barrier.setOldLayout(old_vk_image_layout);
+        img_mem_barrier.setNewLayout(new_vk_image_layout);
+        img_mem_barrier.setSrcQueueFamilyIndex(is_same_family ? VK_QUEUE_FAMILY_IGNORED : src_family_index);
+        img_mem_barrier.setDstQueueFamilyIndex(is_same_family ? VK_QUEUE_FAMILY_IGNORED : dst_family_index);
+        img_mem_barrier.setImage(texture.get_vk_image());
+        img_mem_barrier.subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
+        img_mem_barrier.subresourceRange.setBaseMipLevel(0);
+        img_mem_barrier.subresourceRange.setLevelCount(VK_REMAINING_MIP_LEVELS);
+        img_mem_barrier.subresourceRange.setBaseArrayLayer(0);
+        img_mem_barrier.subresourceRange.setLayerCount(1);
+        img_mem_barrier.setSrcAccessMask(is_release ? access_flags_for_layout(old_vk_image_layout) : vk::AccessFlags());
+        img_mem_barrier.setDstAccessMask(is_release && !is_same_family ? vk::AccessFlags()
+                                                                       : access_flags_for_layout(new_vk_image_layout));
+
+        // stages of the other family may not exist on this queue
+        vk::PipelineStageFlags src_pipeline_stage_flags = vk::PipelineStageFlagBits::eAllCommands;
+        vk::PipelineStageFlags dst_pipeline_stage_flags = vk::PipelineStageFlagBits::eAllCommands;
+        if (is_release)
+        {
+            src_pipeline_stage_flags = pipeline_stage_flags(old_vk_image_layout);
+            dst_pipeline_stage_flags = is_same_family ? vk::PipelineStageFlagBits::eAllCommands
+                                                      : vk::PipelineStageFlagBits::eBottomOfPipe;
+        }
+        m_vk_command_buffer.pipelineBarrier(src_pipeline_stage_flags,
+                                            dst_pipeline_stage_flags,
+                                            vk::DependencyFlagBits(0),
+                                            nullptr,
+                                            nullptr,
+                                            { img_mem_barrier });
+    }
+
+    // rebuild or refit of a tlas from instances the host wrote into instance_buffer before submitting this buffer
+    void
+    build_tlas(RayTracingTlas & tlas,
+               const Buffer &   instance_buffer,
+               const size_t     offset_in_bytes,
+               const uint32_t   num_instances,
+               const bool       is_refit)
+    {
+        tlas.record_build(m_vk_command_buffer, instance_buffer, offset_in_bytes, num_instances, is_refit);
+    }
+
     void
     trace_rays(const RayTracingShaderTable & table,
                const uint32_t                width  = 1,
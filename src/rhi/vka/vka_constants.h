@@ -135,6 +135,10 @@ GetVkFormat(const Rhi::FormatEnum format_enum)
         return vk::Format::eR8G8B8A8Srgb;
     case Rhi::FormatEnum::R8_UNorm:
         return vk::Format::eR8Unorm;
+    case Rhi::FormatEnum::BC1_UNorm_Srgb:
+        return vk::Format::eBc1RgbaSrgbBlock;
+    case Rhi::FormatEnum::BC4_UNorm:
+        return vk::Format::eBc4UnormBlock;
     case Rhi::FormatEnum::R10G10B10A2_UNorm:
         return vk::Format::eA2R10G10B10UnormPack32;
     case Rhi::FormatEnum::R11G11B10_UFloat:
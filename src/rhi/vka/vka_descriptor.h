@@ -23,12 +23,13 @@ struct DescriptorSet
     vk::DescriptorSet  m_vk_descriptor_set;
     vk::PipelineLayout m_vk_pipeline_layout;
 
-    // TODO:: avoid std::list
-    std::list<vk::DescriptorBufferInfo>                       m_descriptor_buffer_infos;
-    std::list<vk::DescriptorImageInfo>                        m_descriptor_image_infos;
-    std::list<vk::WriteDescriptorSetAccelerationStructureKHR> m_descriptor_accel_infos;
+    // writes refer to their info by index until update, so the info vectors are free to grow in between
+    std::vector<vk::DescriptorBufferInfo>                       m_descriptor_buffer_infos;
+    std::vector<vk::DescriptorImageInfo>                        m_descriptor_image_infos;
+    std::vector<vk::WriteDescriptorSetAccelerationStructureKHR> m_descriptor_accel_infos;
 
     std::vector<vk::WriteDescriptorSet> m_write_descriptor_set;
+    std::vector<size_t>                 m_write_info_indices;
 
     DescriptorSet(const Device &         device,
                   const RasterPipeline & pipeline,
@@ -88,8 +89,8 @@ struct DescriptorSet
         write_descriptor_set.setDescriptorType(vk::DescriptorType::eAccelerationStructureKHR);
         write_descriptor_set.setPBufferInfo(nullptr);
         write_descriptor_set.setPImageInfo(nullptr);
-        write_descriptor_set.setPNext(&m_descriptor_accel_infos.back());
         m_write_descriptor_set.push_back(write_descriptor_set);
+        m_write_info_indices.push_back(m_descriptor_accel_infos.size() - 1);
 
         return *this;
     }
@@ -109,8 +110,8 @@ struct DescriptorSet
         write_descriptor.setDstArrayElement(static_cast<uint32_t>(i_element));
         write_descriptor.setDescriptorCount(1);
         write_descriptor.setDescriptorType(vk::DescriptorType::eUniformBuffer);
-        write_descriptor.setPBufferInfo(&m_descriptor_buffer_infos.back());
         m_write_descriptor_set.push_back(write_descriptor);
+        m_write_info_indices.push_back(m_descriptor_buffer_infos.size() - 1);
         return *this;
     }
 
@@ -141,8 +142,8 @@ struct DescriptorSet
         write_descriptor.setDstArrayElement(static_cast<uint32_t>(i_element));
         write_descriptor.setDescriptorCount(1);
         write_descriptor.setDescriptorType(vk::DescriptorType::eStorageBuffer);
-        write_descriptor.setPBufferInfo(&m_descriptor_buffer_infos.back());
         m_write_descriptor_set.push_back(write_descriptor);
+        m_write_info_indices.push_back(m_descriptor_buffer_infos.size() - 1);
         return *this;
     }
 
@@ -166,8 +167,8 @@ struct DescriptorSet
         write_descriptor.setDstArrayElement(static_cast<uint32_t>(i_element));
         write_descriptor.setDescriptorCount(1);
         write_descriptor.setDescriptorType(vk::DescriptorType::eStorageBuffer);
-        write_descriptor.setPBufferInfo(&m_descriptor_buffer_infos.back());
         m_write_descriptor_set.push_back(write_descriptor);
+        m_write_info_indices.push_back(m_descriptor_buffer_infos.size() - 1);
         return *this;
     }
 
@@ -185,9 +186,8 @@ struct DescriptorSet
         write_descriptor.setDstArrayElement(static_cast<uint32_t>(i_texture));
         write_descriptor.setDescriptorCount(1);
         write_descriptor.setDescriptorType(vk::DescriptorType::eSampledImage);
-        write_descriptor.setPBufferInfo(nullptr);
-        write_descriptor.setPImageInfo(&m_descriptor_image_infos.back());
         m_write_descriptor_set.push_back(write_descriptor);
+        m_write_info_indices.push_back(m_descriptor_image_infos.size() - 1);
         return *this;
     }
 
@@ -205,9 +205,8 @@ struct DescriptorSet
         write_descriptor.setDstArrayElement(static_cast<uint32_t>(i_element));
         write_descriptor.setDescriptorCount(1);
         write_descriptor.setDescriptorType(vk::DescriptorType::eStorageImage);
-        write_descriptor.setPBufferInfo(nullptr);
-        write_descriptor.setPImageInfo(&m_descriptor_image_infos.back());
         m_write_descriptor_set.push_back(write_descriptor);
+        m_write_info_indices.push_back(m_descriptor_image_infos.size() - 1);
         return *this;
     }
 
@@ -231,9 +230,8 @@ struct DescriptorSet
         write_descriptor.setDstArrayElement(static_cast<uint32_t>(i_element));
         write_descriptor.setDescriptorCount(1);
         write_descriptor.setDescriptorType(vk::DescriptorType::eStorageBuffer);
-        write_descriptor.setPBufferInfo(&m_descriptor_buffer_infos.back());
-        write_descriptor.setPImageInfo(nullptr);
         m_write_descriptor_set.push_back(write_descriptor);
+        m_write_info_indices.push_back(m_descriptor_buffer_infos.size() - 1);
         return *this;
     }
 
@@ -250,21 +248,39 @@ struct DescriptorSet
         write_descriptor.setDstArrayElement(0);
         write_descriptor.setDescriptorCount(1);
         write_descriptor.setDescriptorType(vk::DescriptorType::eSampler);
-        write_descriptor.setPBufferInfo(nullptr);
-        write_descriptor.setPImageInfo(&m_descriptor_image_infos.back());
         m_write_descriptor_set.push_back(write_descriptor);
+        m_write_info_indices.push_back(m_descriptor_image_infos.size() - 1);
         return *this;
     }
 
     void
     update()
     {
+        for (size_t i_write = 0; i_write < m_write_descriptor_set.size(); i_write++)
+        {
+            vk::WriteDescriptorSet & write_descriptor = m_write_descriptor_set[i_write];
+            const size_t             info_index       = m_write_info_indices[i_write];
+            switch (write_descriptor.descriptorType)
+            {
+            case vk::DescriptorType::eAccelerationStructureKHR:
+                write_descriptor.setPNext(&m_descriptor_accel_infos[info_index]);
+                break;
+            case vk::DescriptorType::eUniformBuffer:
+            case vk::DescriptorType::eStorageBuffer:
+                write_descriptor.setPBufferInfo(&m_descriptor_buffer_infos[info_index]);
+                break;
+            default:
+                write_descriptor.setPImageInfo(&m_descriptor_image_infos[info_index]);
+                break;
+            }
+        }
         m_device.m_vk_ldevice->updateDescriptorSets(m_write_descriptor_set, nullptr);
 
         m_descriptor_buffer_infos.clear();
         m_descriptor_image_infos.clear();
         m_descriptor_accel_infos.clear();
         m_write_descriptor_set.clear();
+        m_write_info_indices.clear();
     }
 };
 } // namespace VKA_NAME
@@ -16,7 +16,7 @@ struct DescriptorPool
 
     DescriptorPool(const std::string & name, const Device & device, const uint32_t num_descriptors) : m_device(device)
     {
-        std::array<vk::DescriptorPoolSize, 5> pool_sizes;
+        std::array<vk::DescriptorPoolSize, 6> pool_sizes;
         pool_sizes[0].setDescriptorCount(num_descriptors);
         pool_sizes[0].setType(vk::DescriptorType::eUniformBuffer);
         pool_sizes[1].setDescriptorCount(num_descriptors);
@@ -27,6 +27,8 @@ struct DescriptorPool
         pool_sizes[3].setType(vk::DescriptorType::eSampler);
         pool_sizes[4].setDescriptorCount(num_descriptors);
         pool_sizes[4].setType(vk::DescriptorType::eStorageImage);
+        pool_sizes[5].setDescriptorCount(num_descriptors);
+        pool_sizes[5].setType(vk::DescriptorType::eSampledImage);
 
         vk::DescriptorPoolCreateInfo pool_ci;
         pool_ci.setPoolSizes(pool_sizes);
@@ -96,7 +96,8 @@ struct Device
         }
 
         // find queues
-        m_family_indices = explore_queue_family(m_vk_pdevice, physical_device.m_vk_surface);
+        m_family_indices = explore_queue_family(m_vk_pdevice,
+                                                m_vk_surface ? std::optional<vk::SurfaceKHR>(m_vk_surface) : std::nullopt);
         const auto queue_family_indices = { m_family_indices.m_graphics,
                                             m_family_indices.m_present,
                                             m_family_indices.m_compute,
@@ -331,6 +332,14 @@ struct Device
         return 1;
     }
 
+    // alignment of the buffer offset when copying from buffer to texture
+    size_t
+    get_data_placement_alignment() const
+    {
+        // bufferOffset must be a multiple of the texel block size and of 4 on transfer-only queues
+        return 16;
+    }
+
 private:
     bool m_debug = false;
 
@@ -405,6 +414,7 @@ private:
         device_vulkan12_features.setUniformAndStorageBuffer8BitAccess(VK_TRUE);
         device_vulkan12_features.setShaderFloat16(VK_TRUE);
         device_vulkan12_features.setHostQueryReset(VK_TRUE);
+        device_vulkan12_features.setTimelineSemaphore(VK_TRUE);
         device_vulkan12_features.setRuntimeDescriptorArray(VK_TRUE);
         device_vulkan12_features.setDescriptorBindingPartiallyBound(VK_TRUE);
         device_vulkan12_features.setPNext(&feature_16bit_storage);
@@ -34,6 +34,11 @@ struct PhysicalDevice
       m_vk_api_made_version(vk_api_made_version),
       m_enable_debug(enable_debug)
     {
+        // a headless device has nothing to present to
+        if (!surface)
+        {
+            m_device_extensions.clear();
+        }
     }
 };
 
@@ -51,55 +56,16 @@ struct Entry
 
     Entry() {}
 
-    Entry(const Window & window, const bool debug) : m_debug(debug)
+    // no surface is created, devices of a headless entry only render offscreen
+    Entry(const bool debug) : m_debug(debug)
     {
-        std::vector<const char *> glfw_extensions = GlfwHandler::Inst().query_glfw_extensions();
-        std::vector<const char *> instance_extensions;
-        std::vector<const char *> instance_layers;
-
-        // request validation layer
-        if (debug)
-        {
-            instance_layers.push_back("VK_LAYER_KHRONOS_validation");
-        }
-
-        // request debug marker
-        if (debug)
-        {
-            instance_extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-            instance_extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
-            instance_extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
-        }
-
-        instance_extensions.insert(instance_extensions.end(),
-                                   glfw_extensions.begin(),
-                                   glfw_extensions.end());
-
-        // dynamic vulkan loader
-        vk::DynamicLoader dl;
-        vkGetInstanceProcAddr =
-            dl.getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr");
-        VULKAN_HPP_DEFAULT_DISPATCHER.init(vkGetInstanceProcAddr);
-
-        // make sure validation layer and debug extension are available
-        check_instance_extensions_support(instance_extensions);
-        check_instance_layers_support(instance_layers);
-
-        // vk version
-        m_vk_api_version      = DefaultApiVersion;
-        m_vk_api_made_version = VK_MAKE_VERSION(digit<uint32_t>(m_vk_api_version, 2),
-                                                digit<uint32_t>(m_vk_api_version, 1),
-                                                digit<uint32_t>(m_vk_api_version, 0));
-
-        assert(m_vk_api_version > 0);
-        assert(m_vk_api_made_version > 0);
+        init_instance({});
+        Logger::Info(__FUNCTION__, " headless, no surface created");
+    }
 
-        m_vk_instance = create_instance("vka_engine_name", "vka_app_name", instance_extensions, instance_layers);
-        if (!m_vk_instance)
-        {
-            Logger::Error<true>(__FUNCTION__, " ", "cannot create vk instance");
-        }
-        VULKAN_HPP_DEFAULT_DISPATCHER.init(m_vk_instance.get());
+    Entry(const Window & window, const bool debug) : m_debug(debug)
+    {
+        init_instance(GlfwHandler::Inst().query_glfw_extensions());
 
         // create surface
         VkSurfaceKHR vksurface;
@@ -165,6 +131,57 @@ struct Entry
     }
 
 private:
+    void
+    init_instance(const std::vector<const char *> & window_extensions)
+    {
+        std::vector<const char *> instance_extensions;
+        std::vector<const char *> instance_layers;
+
+        // request validation layer
+        if (m_debug)
+        {
+            instance_layers.push_back("VK_LAYER_KHRONOS_validation");
+        }
+
+        // request debug marker
+        if (m_debug)
+        {
+            instance_extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+            instance_extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+            instance_extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        }
+
+        instance_extensions.insert(instance_extensions.end(),
+                                   window_extensions.begin(),
+                                   window_extensions.end());
+
+        // dynamic vulkan loader
+        vk::DynamicLoader dl;
+        vkGetInstanceProcAddr =
+            dl.getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr");
+        VULKAN_HPP_DEFAULT_DISPATCHER.init(vkGetInstanceProcAddr);
+
+        // make sure validation layer and debug extension are available
+        check_instance_extensions_support(instance_extensions);
+        check_instance_layers_support(instance_layers);
+
+        // vk version
+        m_vk_api_version      = DefaultApiVersion;
+        m_vk_api_made_version = VK_MAKE_VERSION(digit<uint32_t>(m_vk_api_version, 2),
+                                                digit<uint32_t>(m_vk_api_version, 1),
+                                                digit<uint32_t>(m_vk_api_version, 0));
+
+        assert(m_vk_api_version > 0);
+        assert(m_vk_api_made_version > 0);
+
+        m_vk_instance = create_instance("vka_engine_name", "vka_app_name", instance_extensions, instance_layers);
+        if (!m_vk_instance)
+        {
+            Logger::Error<true>(__FUNCTION__, " ", "cannot create vk instance");
+        }
+        VULKAN_HPP_DEFAULT_DISPATCHER.init(m_vk_instance.get());
+    }
+
     void
     check_instance_layers_support(const std::vector<const char *> layers)
     {
@@ -36,6 +36,13 @@ struct Fence
                                                   static_cast<uint64_t>(duration.count())));
     }
 
+    // non blocking wait
+    bool
+    is_signaled() const
+    {
+        return m_device.m_vk_ldevice->getFenceStatus(m_vk_fence.get()) == vk::Result::eSuccess;
+    }
+
     void
     reset()
     {
@@ -97,11 +97,7 @@ struct RasterPipeline
                    const FramebufferBindings &        framebuffer_bindings)
     {
         // compile all shader srcs
-        std::vector<std::vector<std::byte>> spirv_codes(shader_srcs.size());
-        for (size_t i = 0; i < shader_srcs.size(); i++)
-        {
-            spirv_codes[i] = shader_binary_manager.get_cached_shader(shader_srcs[i]);
-        }
+        std::vector<std::vector<std::byte>> spirv_codes = shader_binary_manager.get_cached_shaders(shader_srcs);
 
         // reflection
         SpirvReflector     spirv_reflector;
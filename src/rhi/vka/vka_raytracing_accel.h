@@ -8,6 +8,8 @@
     #include "vka_common.h"
     #include "vka_constants.h"
     #include "vka_device.h"
+    #include "vka_query_pool.h"
+    #include "vka_stagingbuffermanager.h"
 
 namespace VKA_NAME
 {
@@ -53,10 +55,13 @@ struct RayTracingGeometryDesc
         return *this;
     }
 
+    // row-major 3x4 matrix applied to the vertices before the build, offset_in_bytes must be a multiple of 16
     RayTracingGeometryDesc &
     set_transform_matrix4x3(const Buffer & buffer, const size_t offset_in_bytes)
     {
+        assert(offset_in_bytes % 16 == 0);
         m_geometry_trimesh_desc.setTransformData(buffer.m_device_address + offset_in_bytes);
+        return *this;
     }
 };
 
@@ -66,40 +71,79 @@ struct RayTracingBlas
     vk::UniqueAccelerationStructureKHR m_vk_accel_struct;
 
     RayTracingBlas() {}
+};
+
+// builds many blases with as few buildAccelerationStructuresKHR calls as possible.
+// builds are grouped so the scratch memory of a group fits in MaxScratchSizeInBytes, every group sub-allocates the
+// same scratch buffer, and all groups are recorded into a single command buffer.
+// NonDeformable blases are built compactable and can be shrunk by compact() once the build has been executed.
+struct RayTracingBlasBatch
+{
+    static constexpr vk::DeviceSize MaxScratchSizeInBytes = 256 * 1024 * 1024; // 256 MB
+
+    struct PendingBuild
+    {
+        std::vector<vk::AccelerationStructureGeometryKHR>       m_geometries;
+        std::vector<vk::AccelerationStructureBuildRangeInfoKHR> m_build_ranges;
+        vk::AccelerationStructureBuildGeometryInfoKHR           m_build_info;
+        vk::DeviceSize                                          m_scratch_size_in_bytes = 0;
+    };
 
-    RayTracingBlas(const std::string &                             name,
-                   const Device &                                  device,
-                   const std::span<const RayTracingGeometryDesc> & geometry_descs,
-                   const RayTracingBuildHint                       hint,
-                   StagingBufferManager * buf_manager // TODO:: get rid of staging buffer manager
-    )
+    struct CompactableBlas
     {
-        std::vector<vk::AccelerationStructureGeometryDataKHR> tri_geometry_datas(geometry_descs.size());
-        std::vector<vk::AccelerationStructureGeometryKHR>     geometries(geometry_descs.size());
-        std::vector<vk::AccelerationStructureBuildRangeInfoKHR> build_ranges(geometry_descs.size());
+        RayTracingBlas * m_blas;
+        std::string      m_name;
+    };
+
+    std::vector<PendingBuild>    m_pending_builds;
+    Buffer                       m_scratch_buffer;
+    std::vector<CompactableBlas> m_compactable_blases;
+    std::unique_ptr<QueryPool>   m_compacted_size_query_pool;
+    // uncompacted blases are still read by the recorded compaction copies, they die with the batch
+    std::vector<RayTracingBlas> m_retired_blases;
+
+    RayTracingBlasBatch() {}
+
+    // creates the blas and its storage, the build is recorded by build().
+    // blas must stay at the same address until compact() is done with it.
+    void
+    add(RayTracingBlas *                                blas,
+        const std::string &                             name,
+        const Device &                                  device,
+        const std::span<const RayTracingGeometryDesc> & geometry_descs,
+        const RayTracingBuildHint                       hint)
+    {
+        PendingBuild pending_build;
+        pending_build.m_geometries.resize(geometry_descs.size());
+        pending_build.m_build_ranges.resize(geometry_descs.size());
         std::vector<uint32_t> max_primitive_counts(geometry_descs.size());
         for (size_t i = 0; i < geometry_descs.size(); i++)
         {
-            auto & geometry_data = tri_geometry_datas[i];
+            vk::AccelerationStructureGeometryDataKHR geometry_data;
             geometry_data.setTriangles(geometry_descs[i].m_geometry_trimesh_desc);
 
-            auto & geometry = geometries[i];
+            auto & geometry = pending_build.m_geometries[i];
             geometry.setGeometry(geometry_data);
             geometry.setGeometryType(vk::GeometryTypeKHR::eTriangles);
             geometry.setFlags(geometry_descs[i].m_geometry_flag);
 
-            build_ranges[i]         = geometry_descs[i].m_build_range;
-            max_primitive_counts[i] = geometry_descs[i].m_build_range.primitiveCount;
+            pending_build.m_build_ranges[i] = geometry_descs[i].m_build_range;
+            max_primitive_counts[i]         = geometry_descs[i].m_build_range.primitiveCount;
         }
 
         vk::BuildAccelerationStructureFlagsKHR build_flags(
             static_cast<VkBuildAccelerationStructureFlagBitsKHR>(hint));
+        const bool is_compactable = hint == RayTracingBuildHint::NonDeformable;
+        if (is_compactable)
+        {
+            build_flags |= vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction;
+        }
 
-        vk::AccelerationStructureBuildGeometryInfoKHR build_info;
+        vk::AccelerationStructureBuildGeometryInfoKHR & build_info = pending_build.m_build_info;
         build_info.setMode(vk::BuildAccelerationStructureModeKHR::eBuild);
         build_info.setFlags(build_flags);
-        build_info.setPGeometries(geometries.data());
-        build_info.setGeometryCount(static_cast<uint32_t>(geometries.size()));
+        build_info.setPGeometries(pending_build.m_geometries.data());
+        build_info.setGeometryCount(static_cast<uint32_t>(pending_build.m_geometries.size()));
         build_info.setType(vk::AccelerationStructureTypeKHR::eBottomLevel);
 
         // get size requirement
@@ -108,38 +152,206 @@ struct RayTracingBlas
                                                                        build_info,
                                                                        max_primitive_counts);
 
-        const vk::DeviceSize required_scratch_size = size_info.buildScratchSize;
-        const vk::DeviceSize required_buffer_size  = size_info.accelerationStructureSize;
+        *blas = CreateBlas(name, device, size_info.accelerationStructureSize);
+        build_info.setDstAccelerationStructure(blas->m_vk_accel_struct.get());
+        pending_build.m_scratch_size_in_bytes = size_info.buildScratchSize;
+        m_pending_builds.push_back(std::move(pending_build));
+
+        if (is_compactable)
+        {
+            m_compactable_blases.push_back({ blas, name });
+        }
+    }
+
+    // records all pending builds, the batch must outlive the submission of buf_manager's command buffer
+    void
+    build(const std::string & name, const Device & device, StagingBufferManager * buf_manager)
+    {
+        if (m_pending_builds.empty())
+        {
+            return;
+        }
+
+        const vk::DeviceSize scratch_alignment =
+            device.m_vk_pdevice
+                .getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceAccelerationStructurePropertiesKHR>()
+                .get<vk::PhysicalDeviceAccelerationStructurePropertiesKHR>()
+                .minAccelerationStructureScratchOffsetAlignment;
+
+        // split builds into groups, a build bigger than the budget gets a group of its own
+        std::vector<size_t>         group_ends;
+        std::vector<vk::DeviceSize> scratch_offsets(m_pending_builds.size());
+        vk::DeviceSize              group_scratch_size = 0;
+        vk::DeviceSize              scratch_size       = 0;
+        for (size_t i_build = 0; i_build < m_pending_builds.size(); i_build++)
+        {
+            const vk::DeviceSize size = round_up(m_pending_builds[i_build].m_scratch_size_in_bytes, scratch_alignment);
+            if (group_scratch_size > 0 && group_scratch_size + size > MaxScratchSizeInBytes)
+            {
+                group_ends.push_back(i_build);
+                group_scratch_size = 0;
+            }
+            scratch_offsets[i_build] = group_scratch_size;
+            group_scratch_size += size;
+            scratch_size = std::max(scratch_size, group_scratch_size);
+        }
+        group_ends.push_back(m_pending_builds.size());
+
+        // one extra alignment so the base address can be aligned up
+        m_scratch_buffer = Buffer(name + "_scratch_buffer",
+                                  device,
+                                  BufferUsageEnum::StorageBuffer,
+                                  MemoryUsageEnum::GpuOnly,
+                                  scratch_size + scratch_alignment);
+        const vk::DeviceAddress scratch_address = round_up(m_scratch_buffer.m_device_address, scratch_alignment);
+
+        vk::CommandBuffer & cmd_buffer = buf_manager->m_vk_command_buffer;
+        vk::MemoryBarrier   barrier(vk::AccessFlagBits::eAccelerationStructureWriteKHR,
+                                  vk::AccessFlagBits::eAccelerationStructureReadKHR |
+                                      vk::AccessFlagBits::eAccelerationStructureWriteKHR);
+        size_t group_begin = 0;
+        for (const size_t group_end : group_ends)
+        {
+            // the previous group has to finish with the scratch memory before this group reuses it
+            if (group_begin > 0)
+            {
+                cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                                           vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                                           vk::DependencyFlags(),
+                                           { barrier },
+                                           {},
+                                           {});
+            }
+
+            std::vector<vk::AccelerationStructureBuildGeometryInfoKHR>    build_infos;
+            std::vector<const vk::AccelerationStructureBuildRangeInfoKHR *> build_ranges;
+            for (size_t i_build = group_begin; i_build < group_end; i_build++)
+            {
+                PendingBuild & pending_build = m_pending_builds[i_build];
+                pending_build.m_build_info.setPGeometries(pending_build.m_geometries.data());
+                pending_build.m_build_info.setScratchData(scratch_address + scratch_offsets[i_build]);
+                build_infos.push_back(pending_build.m_build_info);
+                build_ranges.push_back(pending_build.m_build_ranges.data());
+            }
+            cmd_buffer.buildAccelerationStructuresKHR(build_infos, build_ranges);
+            group_begin = group_end;
+        }
+
+        // blases are read by the tlas build or the compacted size queries recorded after this
+        cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                                   vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                                   vk::DependencyFlags(),
+                                   { barrier },
+                                   {},
+                                   {});
+
+        if (!m_compactable_blases.empty())
+        {
+            std::vector<vk::AccelerationStructureKHR> accel_structs(m_compactable_blases.size());
+            for (size_t i = 0; i < m_compactable_blases.size(); i++)
+            {
+                accel_structs[i] = m_compactable_blases[i].m_blas->m_vk_accel_struct.get();
+            }
+            m_compacted_size_query_pool = std::make_unique<QueryPool>(name + "_compacted_size_query_pool",
+                                                                      device,
+                                                                      QueryType::AccelerationStructureCompactedSize,
+                                                                      static_cast<uint32_t>(accel_structs.size()));
+            cmd_buffer.writeAccelerationStructuresPropertiesKHR(accel_structs,
+                                                                vk::QueryType::eAccelerationStructureCompactedSizeKHR,
+                                                                m_compacted_size_query_pool->m_vk_query_pool.get(),
+                                                                0);
+        }
+
+        Logger::Info(__FUNCTION__,
+                     " recorded ",
+                     m_pending_builds.size(),
+                     " blas builds in ",
+                     group_ends.size(),
+                     " calls with ",
+                     scratch_size / (1024 * 1024),
+                     " MB scratch memory");
+        m_pending_builds.clear();
+    }
+
+    // copies every compactable blas into a right sized one, the submission recorded by build() must have completed.
+    // returns the number of bytes reclaimed once the batch, which keeps the uncompacted blases, is destroyed.
+    size_t
+    compact(const Device & device, StagingBufferManager * buf_manager)
+    {
+        if (m_compactable_blases.empty())
+        {
+            return 0;
+        }
+
+        const std::vector<uint64_t> compacted_sizes =
+            m_compacted_size_query_pool->get_query_result(static_cast<uint32_t>(m_compactable_blases.size()));
+
+        vk::CommandBuffer & cmd_buffer     = buf_manager->m_vk_command_buffer;
+        size_t              original_size  = 0;
+        size_t              compacted_size = 0;
+        for (size_t i = 0; i < m_compactable_blases.size(); i++)
+        {
+            RayTracingBlas & blas = *m_compactable_blases[i].m_blas;
+            RayTracingBlas   compacted_blas =
+                CreateBlas(m_compactable_blases[i].m_name + "_compacted", device, compacted_sizes[i]);
+
+            vk::CopyAccelerationStructureInfoKHR copy_info;
+            copy_info.setSrc(blas.m_vk_accel_struct.get());
+            copy_info.setDst(compacted_blas.m_vk_accel_struct.get());
+            copy_info.setMode(vk::CopyAccelerationStructureModeKHR::eCompact);
+            cmd_buffer.copyAccelerationStructureKHR(copy_info);
+
+            original_size += blas.m_accel_buffer.m_size_in_bytes;
+            compacted_size += compacted_blas.m_accel_buffer.m_size_in_bytes;
+            m_retired_blases.push_back(std::move(blas));
+            blas = std::move(compacted_blas);
+        }
 
+        // compacted blases are read by the tlas build recorded after this
+        vk::MemoryBarrier barrier(vk::AccessFlagBits::eAccelerationStructureWriteKHR,
+                                  vk::AccessFlagBits::eAccelerationStructureReadKHR);
+        cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                                   vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                                   vk::DependencyFlags(),
+                                   { barrier },
+                                   {},
+                                   {});
+
+        Logger::Info(__FUNCTION__,
+                     " compacted ",
+                     m_compactable_blases.size(),
+                     " blases from ",
+                     original_size / 1024,
+                     " KB to ",
+                     compacted_size / 1024,
+                     " KB");
+        m_compactable_blases.clear();
+        m_compacted_size_query_pool.reset();
+        return original_size - compacted_size;
+    }
+
+private:
+    static RayTracingBlas
+    CreateBlas(const std::string & name, const Device & device, const vk::DeviceSize size_in_bytes)
+    {
         // create buffer for storing blas
-        vk::BufferCreateInfo buffer_ci_tmp;
-        buffer_ci_tmp.setSize(required_buffer_size);
-        buffer_ci_tmp.setUsage(vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR);
-        VkBufferCreateInfo      buffer_ci    = buffer_ci_tmp;
-        VmaAllocationCreateInfo vma_alloc_ci = {};
-        vma_alloc_ci.usage                   = VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY;
-
-        m_accel_buffer = Buffer(name + "_buffer",
-                                device,
-                                BufferUsageEnum::RayTracingAccelStructBuffer,
-                                MemoryUsageEnum::GpuOnly,
-                                required_buffer_size);
+        RayTracingBlas blas;
+        blas.m_accel_buffer = Buffer(name + "_buffer",
+                                     device,
+                                     BufferUsageEnum::RayTracingAccelStructBuffer,
+                                     MemoryUsageEnum::GpuOnly,
+                                     size_in_bytes);
 
         // create acceleration structure
         vk::AccelerationStructureCreateInfoKHR accel_ci = {};
-        accel_ci.setBuffer(static_cast<vk::Buffer>(m_accel_buffer.m_vma_buffer_bundle->m_vk_buffer));
+        accel_ci.setBuffer(static_cast<vk::Buffer>(blas.m_accel_buffer.m_vma_buffer_bundle->m_vk_buffer));
         accel_ci.setType(vk::AccelerationStructureTypeKHR::eBottomLevel);
-        accel_ci.setSize(required_buffer_size);
-        m_vk_accel_struct = device.m_vk_ldevice->createAccelerationStructureKHRUnique(accel_ci);
-
-        auto * scratch_buffer = buf_manager->get_scratch_buffer(required_scratch_size);
-        build_info.setDstAccelerationStructure(m_vk_accel_struct.get());
-        build_info.setScratchData(scratch_buffer->m_vk_device_address);
-
-        buf_manager->m_vk_command_buffer.buildAccelerationStructuresKHR({ build_info },
-                                                                        { build_ranges.data() });
-
-        // TODO:: do compaction if Flag is ePreferFastTrace
+        accel_ci.setSize(size_in_bytes);
+        blas.m_vk_accel_struct = device.m_vk_ldevice->createAccelerationStructureKHRUnique(accel_ci);
+        device.name_vkhpp_object<vk::AccelerationStructureKHR, vk::AccelerationStructureKHR::CType>(
+            blas.m_vk_accel_struct.get(),
+            name);
+        return blas;
     }
 };
 
@@ -164,102 +376,129 @@ struct RayTracingInstance
         m_vk_instance.setInstanceCustomIndex(instance_id);
     }
 };
+static_assert(sizeof(RayTracingInstance) == sizeof(vk::AccelerationStructureInstanceKHR));
 
+// tlas that can be rebuilt or refit in place on a frame command buffer.
+// instances are read from a caller owned buffer so the caller decides how it is written and double buffered.
 struct RayTracingTlas
 {
-    Buffer                             m_instance_buffer;
     Buffer                             m_accel_buffer;
+    Buffer                             m_scratch_buffer;
     vk::UniqueAccelerationStructureKHR m_vk_accel_struct;
+    vk::DeviceAddress                  m_scratch_address   = 0;
+    uint32_t                           m_max_num_instances = 0;
 
     RayTracingTlas() {}
 
-    RayTracingTlas(const std::string &                         name,
-                   const Device &                              device,
-                   const std::span<const RayTracingInstance> & instances,
-                   StagingBufferManager *                      buf_manager)
+    RayTracingTlas(const std::string & name, const Device & device, const uint32_t max_num_instances)
+    : m_max_num_instances(max_num_instances)
     {
-        m_instance_buffer = Buffer(name + "_instance_buffer",
-                                   device,
-                                   BufferUsageEnum::TransferSrc | BufferUsageEnum::RayTracingAccelStructBufferInput,
-                                   MemoryUsageEnum::CpuOnly,
-                                   sizeof(vk::AccelerationStructureInstanceKHR) * instances.size());
-
-        std::byte * instance_dst = reinterpret_cast<std::byte *>(m_instance_buffer.map());
-        for (size_t i = 0; i < instances.size(); i++)
-        {
-            size_t offset = i * sizeof(vk::AccelerationStructureInstanceKHR);
-            std::memcpy(instance_dst + offset, &instances[i].m_vk_instance, sizeof(vk::AccelerationStructureInstanceKHR));
-        }
-        m_instance_buffer.unmap();
+        vk::AccelerationStructureGeometryKHR          geometry;
+        vk::AccelerationStructureBuildGeometryInfoKHR build_info =
+            get_build_info(&geometry, 0, vk::BuildAccelerationStructureModeKHR::eBuild);
 
-        vk::AccelerationStructureGeometryInstancesDataKHR geometry_instance_data;
-        geometry_instance_data.setArrayOfPointers(VK_FALSE);
-        geometry_instance_data.setData(m_instance_buffer.m_device_address);
-
-        vk::AccelerationStructureGeometryKHR geometry;
-        geometry.setGeometryType(vk::GeometryTypeKHR::eInstances);
-        geometry.setGeometry(geometry_instance_data);
-
-        // geometry info
-        vk::AccelerationStructureBuildGeometryInfoKHR build_info;
-        build_info.setMode(vk::BuildAccelerationStructureModeKHR::eBuild);
-        build_info.setFlags(vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace);
-        build_info.setPGeometries(&geometry);
-        build_info.setGeometryCount(1);
-        build_info.setType(vk::AccelerationStructureTypeKHR::eTopLevel);
-
-        // get size requirement
+        // get size requirement for the largest instance count
         vk::AccelerationStructureBuildSizesInfoKHR size_info =
-            device.m_vk_ldevice->getAccelerationStructureBuildSizesKHR(
-                vk::AccelerationStructureBuildTypeKHR::eDevice,
-                build_info,
-                { static_cast<uint32_t>(instances.size()) });
-
-        const vk::DeviceSize required_scratch_size = size_info.buildScratchSize;
-        const vk::DeviceSize required_buffer_size  = size_info.accelerationStructureSize;
+            device.m_vk_ldevice->getAccelerationStructureBuildSizesKHR(vk::AccelerationStructureBuildTypeKHR::eDevice,
+                                                                       build_info,
+                                                                       { max_num_instances });
 
         // create buffer for storing tlas
-        vk::BufferCreateInfo buffer_ci_tmp;
-        buffer_ci_tmp.setSize(required_buffer_size);
-        buffer_ci_tmp.setUsage(vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR);
-        VkBufferCreateInfo      buffer_ci    = buffer_ci_tmp;
-        VmaAllocationCreateInfo vma_alloc_ci = {};
-        vma_alloc_ci.usage                   = VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY;
-
         m_accel_buffer = Buffer(name + "_accel_buffer",
                                 device,
                                 BufferUsageEnum::RayTracingAccelStructBuffer,
                                 MemoryUsageEnum::GpuOnly,
-                                required_buffer_size);
+                                size_info.accelerationStructureSize);
 
         // create acceleration structure
         vk::AccelerationStructureCreateInfoKHR accel_ci = {};
         accel_ci.setBuffer(static_cast<vk::Buffer>(m_accel_buffer.m_vma_buffer_bundle->m_vk_buffer));
         accel_ci.setType(vk::AccelerationStructureTypeKHR::eTopLevel);
-        accel_ci.setSize(required_buffer_size);
+        accel_ci.setSize(size_info.accelerationStructureSize);
         m_vk_accel_struct = device.m_vk_ldevice->createAccelerationStructureKHRUnique(accel_ci);
         device.name_vkhpp_object<vk::AccelerationStructureKHR, vk::AccelerationStructureKHR::CType>(
             m_vk_accel_struct.get(),
             name);
 
-        auto * scratch_buffer = buf_manager->get_scratch_buffer(required_scratch_size);
+        // scratch is kept for rebuilds and refits, with one extra alignment so the base address can be aligned up
+        const vk::DeviceSize scratch_alignment =
+            device.m_vk_pdevice
+                .getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceAccelerationStructurePropertiesKHR>()
+                .get<vk::PhysicalDeviceAccelerationStructurePropertiesKHR>()
+                .minAccelerationStructureScratchOffsetAlignment;
+        m_scratch_buffer  = Buffer(name + "_scratch_buffer",
+                                  device,
+                                  BufferUsageEnum::StorageBuffer,
+                                  MemoryUsageEnum::GpuOnly,
+                                  std::max(size_info.buildScratchSize, size_info.updateScratchSize) + scratch_alignment);
+        m_scratch_address = round_up(m_scratch_buffer.m_device_address, scratch_alignment);
+    }
+
+    // records a rebuild (or a refit if is_refit) from num_instances RayTracingInstance at instance_buffer + offset.
+    // instances must have been written by the host before the submission, see CommandBuffer::build_tlas.
+    void
+    record_build(const vk::CommandBuffer cmd_buffer,
+                 const Buffer &          instance_buffer,
+                 const size_t            offset_in_bytes,
+                 const uint32_t          num_instances,
+                 const bool              is_refit)
+    {
+        assert(num_instances <= m_max_num_instances);
+
+        vk::AccelerationStructureGeometryKHR          geometry;
+        vk::AccelerationStructureBuildGeometryInfoKHR build_info =
+            get_build_info(&geometry,
+                           instance_buffer.m_device_address + offset_in_bytes,
+                           is_refit ? vk::BuildAccelerationStructureModeKHR::eUpdate
+                                    : vk::BuildAccelerationStructureModeKHR::eBuild);
+        if (is_refit)
+        {
+            build_info.setSrcAccelerationStructure(m_vk_accel_struct.get());
+        }
         build_info.setDstAccelerationStructure(m_vk_accel_struct.get());
-        build_info.setScratchData(scratch_buffer->m_vk_device_address);
+        build_info.setScratchData(m_scratch_address);
 
         vk::AccelerationStructureBuildRangeInfoKHR build_range = {};
-        build_range.setPrimitiveCount(static_cast<uint32_t>(instances.size()));
-
-        // make sure that instance_buffer is completely written before we proceed further.
-        vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite,
-                                  vk::AccessFlagBits::eAccelerationStructureWriteKHR);
-        buf_manager->m_vk_command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
-                                                         vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
-                                                         vk::DependencyFlags(),
-                                                         { barrier },
-                                                         {},
-                                                         {});
-
-        buf_manager->m_vk_command_buffer.buildAccelerationStructuresKHR({ build_info }, { &build_range });
+        build_range.setPrimitiveCount(num_instances);
+
+        // builds are recorded on the compute queue, which has no ray tracing stage. rays traced with the tlas on
+        // other queues are ordered through semaphores, only an earlier build on this queue has to be waited for
+        vk::MemoryBarrier pre_barrier(vk::AccessFlagBits::eAccelerationStructureReadKHR |
+                                          vk::AccessFlagBits::eAccelerationStructureWriteKHR,
+                                      vk::AccessFlagBits::eAccelerationStructureReadKHR |
+                                          vk::AccessFlagBits::eAccelerationStructureWriteKHR);
+        cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                                   vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                                   vk::DependencyFlags(),
+                                   { pre_barrier },
+                                   {},
+                                   {});
+
+        cmd_buffer.buildAccelerationStructuresKHR({ build_info }, { &build_range });
+    }
+
+private:
+    static vk::AccelerationStructureBuildGeometryInfoKHR
+    get_build_info(vk::AccelerationStructureGeometryKHR *      geometry,
+                   const vk::DeviceAddress                     instance_address,
+                   const vk::BuildAccelerationStructureModeKHR mode)
+    {
+        vk::AccelerationStructureGeometryInstancesDataKHR geometry_instance_data;
+        geometry_instance_data.setArrayOfPointers(VK_FALSE);
+        geometry_instance_data.setData(instance_address);
+
+        geometry->setGeometryType(vk::GeometryTypeKHR::eInstances);
+        geometry->setGeometry(geometry_instance_data);
+
+        // refit needs AllowUpdate on every build, including the first one
+        vk::AccelerationStructureBuildGeometryInfoKHR build_info;
+        build_info.setMode(mode);
+        build_info.setFlags(vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace |
+                            vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate);
+        build_info.setPGeometries(geometry);
+        build_info.setGeometryCount(1);
+        build_info.setType(vk::AccelerationStructureTypeKHR::eTopLevel);
+        return build_info;
     }
 };
 } // namespace VKA_NAME
@@ -4,7 +4,8 @@
 
 #ifdef USE_VKA
 
-    #include "../shadercompiler/hlsldxccompiler.h"
+    #include "../shadercompiler/shader_binary_manager.h"
+    #include "core/stopwatch.h"
     #include "rhi/common/rhi_shader_src.h"
     #include "spirv_reflection.h"
     #include "vka_common.h"
@@ -82,15 +83,14 @@ struct RayTracingPipeline
       m_num_hit_groups(rt_lib.m_hit_groups.size()),
       m_rt_lib(rt_lib)
     {
+        StopWatch stop_watch;
+
         // compile all shader srcs
-        HlslDxcCompiler                     hlsl_compiler;
-        std::vector<std::vector<std::byte>> spirv_codes(rt_lib.m_shader_srcs.size());
+        std::vector<std::vector<std::byte>> spirv_codes = shader_binary_manager.get_cached_shaders(rt_lib.m_shader_srcs);
+        const long long                     shader_time_ms = stop_watch.time_milli_sec();
         std::vector<vk::UniqueShaderModule> shader_module(rt_lib.m_shader_srcs.size());
         for (size_t i = 0; i < rt_lib.m_shader_srcs.size(); i++)
         {
-            // spirv code
-            spirv_codes[i] = shader_binary_manager.get_cached_shader(rt_lib.m_shader_srcs[i]);
-
             // create shader module
             vk::ShaderModuleCreateInfo shader_module_ci;
             shader_module_ci.setPCode(reinterpret_cast<uint32_t *>(spirv_codes[i].data()));
@@ -198,6 +198,15 @@ struct RayTracingPipeline
         VKCK(result.result);
         m_vk_pipeline = std::move(result.value);
         device.name_vkhpp_object<vk::Pipeline, vk::Pipeline::CType>(m_vk_pipeline.get(), name);
+
+        Logger::Info(__FUNCTION__,
+                     " ",
+                     name,
+                     " built in ",
+                     stop_watch.time_milli_sec(),
+                     " ms (shaders ",
+                     shader_time_ms,
+                     " ms)");
     }
 };
 
@@ -30,7 +30,7 @@ struct Sampler
         sampler_ci.setMipmapMode(vk::SamplerMipmapMode::eLinear);
         sampler_ci.setMipLodBias(0.0f);
         sampler_ci.setMinLod(0.0f);
-        sampler_ci.setMaxLod(0.0f);
+        sampler_ci.setMaxLod(VK_LOD_CLAMP_NONE);
         m_vk_sampler = device.m_vk_ldevice->createSamplerUnique(sampler_ci);
         device.name_vkhpp_object<vk::Sampler, vk::Sampler::CType>(m_vk_sampler.get(), name);
     }
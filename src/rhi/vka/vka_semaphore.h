@@ -22,5 +22,41 @@ struct Semaphore
         device.name_vkhpp_object<vk::Semaphore, vk::Semaphore::CType>(m_vk_semaphore.get(), name);
     }
 };
+
+// payload is a 64 bit value that only grows, queues wait for or signal values of it through CommandBuffer
+struct TimelineSemaphore
+{
+    vk::UniqueSemaphore m_vk_semaphore;
+    const Device *      m_device = nullptr;
+
+    TimelineSemaphore() {}
+
+    TimelineSemaphore(const std::string & name, const Device & device) : m_device(&device)
+    {
+        vk::SemaphoreTypeCreateInfo semaphore_type_ci = {};
+        semaphore_type_ci.setSemaphoreType(vk::SemaphoreType::eTimeline);
+        semaphore_type_ci.setInitialValue(0);
+        vk::SemaphoreCreateInfo semaphore_ci = {};
+        semaphore_ci.setPNext(&semaphore_type_ci);
+        m_vk_semaphore = device.m_vk_ldevice->createSemaphoreUnique(semaphore_ci);
+        device.name_vkhpp_object<vk::Semaphore, vk::Semaphore::CType>(m_vk_semaphore.get(), name);
+    }
+
+    uint64_t
+    get_completed_value() const
+    {
+        return m_device->m_vk_ldevice->getSemaphoreCounterValue(m_vk_semaphore.get());
+    }
+
+    void
+    wait(const uint64_t value, const std::chrono::nanoseconds duration = std::chrono::nanoseconds::max())
+    {
+        vk::SemaphoreWaitInfo wait_info = {};
+        wait_info.setSemaphoreCount(1);
+        wait_info.setPSemaphores(&m_vk_semaphore.get());
+        wait_info.setPValues(&value);
+        VKCK(m_device->m_vk_ldevice->waitSemaphores(wait_info, static_cast<uint64_t>(duration.count())));
+    }
+};
 } // namespace VKA_NAME
 #endif
\ No newline at end of file
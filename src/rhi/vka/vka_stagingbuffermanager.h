@@ -11,15 +11,6 @@ namespace VKA_NAME
 {
 struct StagingBufferManager
 {
-    struct StagingBuffer
-    {
-        VmaAllocator      m_vma_allocator;
-        VmaAllocation     m_vma_allocation;
-        VmaAllocationInfo m_vma_alloc_info;
-        VkBuffer          m_vk_buffer;
-        bool              m_is_available;
-    };
-
     struct ScratchBuffer
     {
         VmaAllocator      m_vma_allocator;
@@ -30,16 +21,6 @@ struct StagingBufferManager
         bool              m_is_available;
     };
 
-    struct StagingBufferDeleter
-    {
-        StagingBufferDeleter() {}
-        void
-        operator()(StagingBuffer bundle)
-        {
-            vmaDestroyBuffer(bundle.m_vma_allocator, bundle.m_vk_buffer, bundle.m_vma_allocation);
-        }
-    };
-
     struct ScratchBufferDeleter
     {
         ScratchBufferDeleter() {}
@@ -50,13 +31,12 @@ struct StagingBufferManager
         }
     };
 
-    std::list<UniqueVarHandle<StagingBuffer, StagingBufferDeleter>> m_staging_buffers;
     std::list<UniqueVarHandle<ScratchBuffer, ScratchBufferDeleter>> m_scratch_buffers;
     vk::UniqueCommandPool                                           m_vk_command_pool;
     vk::CommandBuffer                                               m_vk_command_buffer;
     std::string                                                     m_name;
     const Device &                                                  m_device;
-    static constexpr DeviceSizeT DefaultStagingBufferSize = 100 * 1024 * 1024; // 100 MB
+    static constexpr DeviceSizeT DefaultScratchBufferSize = 100 * 1024 * 1024; // 100 MB
 
     StagingBufferManager(const std::string & name, const Device & device)
     : m_device(device), m_name(name)
@@ -115,100 +95,49 @@ struct StagingBufferManager
         cmd_buf_begin_info.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
         m_vk_command_buffer.begin(cmd_buf_begin_info);
 
-        for (auto & staging_buffer : m_staging_buffers)
-        {
-            staging_buffer->m_is_available = true;
-        }
-
         for (auto & scratch_buffer : m_scratch_buffers)
         {
             scratch_buffer->m_is_available = true;
         }
     }
 
-    StagingBuffer *
-    get_staging_buffer(const DeviceSizeT required_size_in_bytes)
-    {
-        // find available staging buffer inthe list and return
-        for (auto & staging_buffer : m_staging_buffers)
-        {
-            if (staging_buffer->m_is_available && required_size_in_bytes < DefaultStagingBufferSize)
-            {
-                staging_buffer->m_is_available = false;
-                return &staging_buffer.get();
-            }
-        }
-
-        assert(required_size_in_bytes < DefaultStagingBufferSize);
-
-        // buffer create info
-        vk::BufferCreateInfo buffer_ci_tmp;
-        buffer_ci_tmp.setSize(DefaultStagingBufferSize);
-        buffer_ci_tmp.setUsage(vk::BufferUsageFlagBits::eTransferSrc);
-        VkBufferCreateInfo      buffer_ci    = buffer_ci_tmp;
-        VmaAllocationCreateInfo vma_alloc_ci = {};
-        vma_alloc_ci.usage                   = VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_ONLY;
-
-        // create new staging buffer and return
-        VkBuffer          vma_vk_buffer;
-        VmaAllocation     vma_allocation;
-        VmaAllocationInfo vma_alloc_info;
-        VKCK(vmaCreateBuffer(*m_device.m_vma_allocator, &buffer_ci, &vma_alloc_ci, &vma_vk_buffer, &vma_allocation, &vma_alloc_info));
-        m_device.name_vkhpp_object<vk::Buffer, vk::Buffer::CType>(vk::Buffer(vma_vk_buffer),
-                                                                  m_name + "_staging_buffer");
-
-        // staging buffer
-        StagingBuffer staging_buffer;
-        staging_buffer.m_vma_allocator  = m_device.m_vma_allocator.get();
-        staging_buffer.m_vma_allocation = vma_allocation;
-        staging_buffer.m_vma_alloc_info = vma_alloc_info;
-        staging_buffer.m_is_available   = false;
-        staging_buffer.m_vk_buffer      = vma_vk_buffer;
-
-        m_staging_buffers.emplace_back(staging_buffer);
-
-        assert(m_staging_buffers.size() < 5);
-
-        return &m_staging_buffers.back().get();
-    }
-
     ScratchBuffer *
     get_scratch_buffer(const DeviceSizeT required_size_in_bytes)
     {
         // find available scratch buffer inthe list and reutrn
         for (auto & scratch_buffer : m_scratch_buffers)
         {
-            if (scratch_buffer->m_is_available && required_size_in_bytes < DefaultStagingBufferSize)
+            if (scratch_buffer->m_is_available && required_size_in_bytes < DefaultScratchBufferSize)
             {
                 scratch_buffer->m_is_available = false;
                 return &scratch_buffer.get();
             }
         }
 
-        assert(required_size_in_bytes < DefaultStagingBufferSize);
+        assert(required_size_in_bytes < DefaultScratchBufferSize);
 
         // buffer create info
         vk::BufferCreateInfo buffer_ci_tmp;
-        buffer_ci_tmp.setSize(DefaultStagingBufferSize);
+        buffer_ci_tmp.setSize(DefaultScratchBufferSize);
         buffer_ci_tmp.setUsage(vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress);
         VkBufferCreateInfo      buffer_ci    = buffer_ci_tmp;
         VmaAllocationCreateInfo vma_alloc_ci = {};
         vma_alloc_ci.usage                   = VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY;
 
-        // create new staging buffer and return
+        // create new scratch buffer and return
         VkBuffer          vma_vk_buffer;
         VmaAllocation     vma_allocation;
         VmaAllocationInfo vma_alloc_info;
         VKCK(vmaCreateBuffer(*m_device.m_vma_allocator, &buffer_ci, &vma_alloc_ci, &vma_vk_buffer, &vma_allocation, &vma_alloc_info));
         m_device.name_vkhpp_object<vk::Buffer, vk::Buffer::CType>(vk::Buffer(vma_vk_buffer),
-                                                                  m_name + "_staging_buffer");
+                                                                  m_name + "_scratch_buffer");
 
         // get device address
         vk::BufferDeviceAddressInfo device_address_info;
         device_address_info.setBuffer(vk::Buffer(vma_vk_buffer));
         VkDeviceAddress device_address = m_device.m_vk_ldevice->getBufferAddress(device_address_info);
 
-        // staging buffer
+        // scratch buffer
         ScratchBuffer scratch_buffer;
         scratch_buffer.m_vma_allocator     = m_device.m_vma_allocator.get();
         scratch_buffer.m_vma_allocation    = vma_allocation;
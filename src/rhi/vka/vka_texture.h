@@ -43,6 +43,7 @@ struct Texture
     using UniqueVmaBundle = UniqueVarHandle<VmaImageBundle, VmaImageBundleDeleter>;
 
     int3           m_resolution;
+    uint32_t       m_mip_levels = 1;
     const Device & m_device;
     // Stores three different type of data depends on how we construct it
     std::variant<UniqueVmaBundle, vk::Image, vk::UniqueImage> m_image_variant;
@@ -128,6 +129,7 @@ struct Texture
         // Set values
         m_image_variant = vma_bundle;
         m_vk_format     = GetVkFormat(create_info.m_format);
+        m_mip_levels    = create_info.m_mip_levels;
         m_vk_image_view = create_image_view(device.m_vk_ldevice.get(), _vk_image, m_vk_format);
         m_resolution    = int3(create_info.m_width, create_info.m_height, create_info.m_depth);
 
@@ -157,8 +159,8 @@ struct Texture
         // Setup image create info
         VkImageCreateInfo image_ci = GetVkImageCreateInfo(create_info);
 
-        // Create image
-        m_image_variant = device.m_vk_ldevice->createImage(image_ci);
+        // Create image, its memory is owned by the aliasable memory
+        m_image_variant = device.m_vk_ldevice->createImageUnique(image_ci);
 
         // Bind memory
         vmaBindImageMemory2(memory.m_vma_memory_bundle->m_vma_allocator,
@@ -169,6 +171,7 @@ struct Texture
 
         // Set values
         m_vk_format     = GetVkFormat(create_info.m_format);
+        m_mip_levels    = create_info.m_mip_levels;
         m_vk_image_view = create_image_view(device.m_vk_ldevice.get(),
                                             std::get<vk::UniqueImage>(m_image_variant).get(),
                                             m_vk_format);
@@ -192,6 +195,16 @@ struct Texture
         }
     }
 
+    // requirement of a texture created with create_info, the image is only created to be queried
+    static MemoryRequirement
+    GetMemoryRequirement(const Device & device, const Rhi::TextureCreateInfo & create_info)
+    {
+        vk::UniqueImage   image = device.m_vk_ldevice->createImageUnique(GetVkImageCreateInfo(create_info));
+        MemoryRequirement result;
+        result.m_vk_requirements = device.m_vk_ldevice->getImageMemoryRequirements(image.get());
+        return result;
+    }
+
     static vk::ImageCreateInfo
     GetVkImageCreateInfo(const Rhi::TextureCreateInfo & create_info)
     {
@@ -297,7 +310,7 @@ struct Texture
         image_view_ci.components.setA(vk::ComponentSwizzle::eIdentity);
         image_view_ci.subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
         image_view_ci.subresourceRange.setBaseMipLevel(0);
-        image_view_ci.subresourceRange.setLevelCount(1);
+        image_view_ci.subresourceRange.setLevelCount(m_mip_levels);
         image_view_ci.subresourceRange.setBaseArrayLayer(0);
         image_view_ci.subresourceRange.setLayerCount(1);
         return device.createImageViewUnique(image_view_ci);
@@ -369,7 +382,7 @@ struct Texture
             img_mem_barrier.setImage(vk_image);
             img_mem_barrier.subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor);
             img_mem_barrier.subresourceRange.setBaseMipLevel(0);
-            img_mem_barrier.subresourceRange.setLevelCount(1);
+            img_mem_barrier.subresourceRange.setLevelCount(VK_REMAINING_MIP_LEVELS);
             img_mem_barrier.subresourceRange.setBaseArrayLayer(0);
             img_mem_barrier.subresourceRange.setLayerCount(1);
             img_mem_barrier.setSrcAccessMask(src_access_mask);
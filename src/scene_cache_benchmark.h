@@ -0,0 +1,65 @@
+#pragma once
+
+#include "benchmark_util.h"
+#include "core/logger.h"
+#include "engine_setting.h"
+#include "importer/scene_cache.h"
+#include "pch/pch.h"
+#include "rhi/rhi.h"
+#include "scene_resource.h"
+
+// SceneResource::add_geometries from source (assimp, stb_image and the cache write) against the same call reading the
+// .mortarscene cache. every run starts from an empty scene resource and waits for its uploads, so both sides include
+// the copies to the device.
+struct SceneCacheBenchmark
+{
+    static constexpr size_t NumIterations = 3;
+
+    static void
+    Run(Rhi::Device & device, const size_t num_flights, const std::filesystem::path & path)
+    {
+        const std::filesystem::path cache_path = SceneCache::GetCachePath(EngineSetting::SceneCachePath(), path);
+
+        std::optional<SceneResource> scene_resource;
+        const auto                   add_geometries = [&]()
+        {
+            scene_resource->add_geometries(path);
+            scene_resource->m_staging_ring.wait_idle();
+        };
+
+        // removing the cache before every run sends add_geometries down the import path
+        const float cold_ms = BenchmarkUtil::MeasureMilliSec(
+            [&]()
+            {
+                std::error_code error_code;
+                std::filesystem::remove(cache_path, error_code);
+                scene_resource.emplace(device, num_flights);
+            },
+            add_geometries,
+            NumIterations);
+
+        std::error_code error_code;
+        const uintmax_t cache_size_in_bytes = std::filesystem::file_size(cache_path, error_code);
+        if (error_code)
+        {
+            Logger::Warn(__FUNCTION__, " no cache was written to ", cache_path.string(), ", warm runs import again");
+        }
+
+        const float warm_ms = BenchmarkUtil::MeasureMilliSec([&]() { scene_resource.emplace(device, num_flights); },
+                                                             add_geometries,
+                                                             NumIterations);
+
+        Logger::Info(__FUNCTION__,
+                     " ",
+                     path.string(),
+                     " : ",
+                     cold_ms,
+                     " ms from source, ",
+                     warm_ms,
+                     " ms from a ",
+                     error_code ? 0 : cache_size_in_bytes / 1024,
+                     " KiB cache, ",
+                     warm_ms > 0.0f ? cold_ms / warm_ms : 0.0f,
+                     "x");
+    }
+};
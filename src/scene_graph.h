@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core/thread_pool.h"
 #include "pch/pch.h"
 #include "rhi/rhi.h"
 
@@ -23,14 +24,14 @@ struct SceneGraphLeaf
     float4x4 m_total_transform;
 };
 
-struct SceneGraphNode
+// authoring tree of a scene graph. it only describes the hierarchy, FlatSceneGraph::Flatten turns it into the flat
+// storage that is updated and traversed through SceneGraphNode
+struct SceneGraphNodeDesc
 {
-    SceneGraphNode * m_parent                                        = nullptr;
-    float4x4         m_transform                                     = glm::identity<float4x4>();
-    bool             m_is_dirty                                      = true;
-    std::variant<SceneGraphLeaf, std::vector<SceneGraphNode>> m_info = {};
+    float4x4                                                      m_transform = glm::identity<float4x4>();
+    std::variant<SceneGraphLeaf, std::vector<SceneGraphNodeDesc>> m_info      = {};
 
-    SceneGraphNode(const bool as_leaf)
+    SceneGraphNodeDesc(const bool as_leaf)
     {
         if (as_leaf)
         {
@@ -38,100 +39,333 @@ struct SceneGraphNode
         }
         else
         {
-            m_info = std::vector<SceneGraphNode>();
+            m_info = std::vector<SceneGraphNodeDesc>();
         }
     }
 
-    SceneGraphNode() : SceneGraphNode(false) {}
+    SceneGraphNodeDesc() : SceneGraphNodeDesc(false) {}
 
     bool
     is_leaf() const
     {
         return m_info.index() == 0;
     }
+};
 
-    void
-    traverse(const std::function<void(const SceneGraphLeaf &)> & func) const
+// scene graph flattened breadth first into structure of arrays. children of a node are contiguous, and so are the
+// nodes of one depth (a level), which come after their parent level. transforms are propagated level by level with
+// each level updated in parallel. leaves are numbered depth first, so the leaves of a subtree are contiguous and are
+// visited in the order of a recursive traversal.
+struct FlatSceneGraph
+{
+    static constexpr uint32_t InvalidIndex       = std::numeric_limits<uint32_t>::max();
+    static constexpr size_t   MinNumNodesPerTask = 4096;
+
+    // per node
+    std::vector<uint32_t> m_parent_indices;
+    std::vector<uint32_t> m_first_child_indices;
+    std::vector<uint32_t> m_num_children;
+    // InvalidIndex for inner nodes
+    std::vector<uint32_t> m_leaf_indices;
+    // leaves of the subtree of a node
+    std::vector<urange32_t> m_leaf_ranges;
+    std::vector<float4x4> m_local_transforms;
+    std::vector<float4x4> m_world_transforms;
+    // bytes rather than bits so nodes of a level can be written in parallel
+    std::vector<uint8_t> m_is_dirty;
+
+    // nodes of level i are [m_level_begins[i], m_level_begins[i + 1])
+    std::vector<uint32_t> m_level_begins;
+
+    // per leaf, in depth first order
+    std::vector<SceneGraphLeaf> m_leaves;
+    std::vector<uint32_t>       m_leaf_node_indices;
+
+    // levels above the shallowest dirty node are clean and skipped
+    uint32_t m_first_dirty_level = InvalidIndex;
+
+    static FlatSceneGraph
+    Flatten(const SceneGraphNodeDesc & root)
     {
-        if (is_leaf())
+        FlatSceneGraph result;
+
+        std::vector<const SceneGraphNodeDesc *> nodes = { &root };
+        result.m_parent_indices.push_back(InvalidIndex);
+        result.m_level_begins.push_back(0);
+        size_t level_end = 1;
+        for (size_t i_node = 0; i_node < nodes.size(); i_node++)
         {
-            const SceneGraphLeaf & leaf_info = std::get<0>(m_info);
-            func(leaf_info);
-            return;
+            // children of the whole previous level have been queued by now
+            if (i_node == level_end)
+            {
+                result.m_level_begins.push_back(static_cast<uint32_t>(i_node));
+                level_end = nodes.size();
+            }
+
+            const SceneGraphNodeDesc & node = *nodes[i_node];
+            result.m_local_transforms.push_back(node.m_transform);
+            result.m_first_child_indices.push_back(static_cast<uint32_t>(nodes.size()));
+            if (node.is_leaf())
+            {
+                result.m_num_children.push_back(0);
+            }
+            else
+            {
+                const std::vector<SceneGraphNodeDesc> & childs = std::get<1>(node.m_info);
+                for (const SceneGraphNodeDesc & child : childs)
+                {
+                    nodes.push_back(&child);
+                    result.m_parent_indices.push_back(static_cast<uint32_t>(i_node));
+                }
+                result.m_num_children.push_back(static_cast<uint32_t>(childs.size()));
+            }
         }
-        else
+        result.m_level_begins.push_back(static_cast<uint32_t>(nodes.size()));
+
+        // number leaves depth first, a node is pushed a second time to close its leaf range once its subtree is done
+        result.m_leaf_indices.assign(nodes.size(), InvalidIndex);
+        result.m_leaf_ranges.resize(nodes.size());
+        std::vector<std::pair<uint32_t, bool>> stack = { { 0, false } };
+        while (!stack.empty())
         {
-            const std::vector<SceneGraphNode> & childs = std::get<1>(m_info);
-            for (size_t i = 0; i < childs.size(); i++)
+            const auto [node_index, is_subtree_done] = stack.back();
+            stack.pop_back();
+            const uint32_t num_leaves = static_cast<uint32_t>(result.m_leaves.size());
+            if (is_subtree_done)
             {
-                childs[i].traverse(func);
+                result.m_leaf_ranges[node_index].m_end = num_leaves;
+                continue;
+            }
+
+            result.m_leaf_ranges[node_index].m_begin = num_leaves;
+            if (nodes[node_index]->is_leaf())
+            {
+                result.m_leaf_indices[node_index] = num_leaves;
+                result.m_leaves.push_back(std::get<0>(nodes[node_index]->m_info));
+                result.m_leaf_node_indices.push_back(node_index);
+                result.m_leaf_ranges[node_index].m_end = num_leaves + 1;
+                continue;
+            }
+
+            stack.push_back({ node_index, true });
+            const uint32_t first_child_index = result.m_first_child_indices[node_index];
+            for (uint32_t i_child = result.m_num_children[node_index]; i_child > 0; i_child--)
+            {
+                stack.push_back({ first_child_index + i_child - 1, false });
             }
-            return;
         }
+
+        // everything is computed by the first update
+        result.m_world_transforms.resize(nodes.size());
+        result.m_is_dirty.assign(nodes.size(), 1);
+        result.m_first_dirty_level = 0;
+        return result;
     }
 
+    size_t
+    size() const
+    {
+        return m_parent_indices.size();
+    }
+
+    bool
+    is_leaf(const uint32_t node_index) const
+    {
+        return m_leaf_indices[node_index] != InvalidIndex;
+    }
+
+    uint32_t
+    get_level(const uint32_t node_index) const
+    {
+        return static_cast<uint32_t>(std::upper_bound(m_level_begins.begin(), m_level_begins.end(), node_index) -
+                                     m_level_begins.begin() - 1);
+    }
+
+    void
+    set_transform(const uint32_t node_index, const float4x4 & transform)
+    {
+        m_local_transforms[node_index] = transform;
+        set_dirty(node_index);
+    }
+
+    // the subtree of the node is recomputed by the next update
+    void
+    set_dirty(const uint32_t node_index)
+    {
+        m_is_dirty[node_index] = 1;
+        m_first_dirty_level    = std::min(m_first_dirty_level, get_level(node_index));
+    }
+
+    // recomputes every world transform
+    void
+    update_transform(ThreadPool & thread_pool = ThreadPool::Get())
+    {
+        m_is_dirty[0]       = 1;
+        m_first_dirty_level = 0;
+        update_dirty_transforms([](const SceneGraphLeaf &) {}, thread_pool);
+    }
+
+    // recomputes world transforms of dirty nodes and their subtrees. func is called, on this thread, for every
+    // instance leaf whose total transform changed. dirty flags are cleared.
+    template <typename Func>
     void
-    traverse(const std::function<void(SceneGraphLeaf &)> & func)
+    update_dirty_transforms(Func && func, ThreadPool & thread_pool = ThreadPool::Get())
     {
-        if (is_leaf())
+        if (m_first_dirty_level == InvalidIndex)
         {
-            SceneGraphLeaf & leaf_info = std::get<0>(m_info);
-            func(leaf_info);
             return;
         }
-        else
+
+        // a parent level is complete before its children read it, clean nodes only pay for a flag test
+        for (size_t level = m_first_dirty_level; level + 1 < m_level_begins.size(); level++)
+        {
+            thread_pool.parallel_for(m_level_begins[level],
+                                     m_level_begins[level + 1],
+                                     [&](const size_t i_node)
+                                     {
+                                         const uint32_t parent_index = m_parent_indices[i_node];
+                                         if (parent_index == InvalidIndex)
+                                         {
+                                             m_world_transforms[i_node] = m_local_transforms[i_node];
+                                             return;
+                                         }
+                                         m_is_dirty[i_node] |= m_is_dirty[parent_index];
+                                         if (m_is_dirty[i_node])
+                                         {
+                                             m_world_transforms[i_node] =
+                                                 m_local_transforms[i_node] * m_world_transforms[parent_index];
+                                         }
+                                     },
+                                     MinNumNodesPerTask);
+        }
+
+        // leaves are tested in depth first order, so func sees instances in the order of a recursive traversal
+        const uint32_t first_dirty_node = m_level_begins[m_first_dirty_level];
+        for (size_t i_leaf = 0; i_leaf < m_leaves.size(); i_leaf++)
         {
-            std::vector<SceneGraphNode> & childs = std::get<1>(m_info);
-            for (size_t i = 0; i < childs.size(); i++)
+            const uint32_t node_index = m_leaf_node_indices[i_leaf];
+            if (m_is_dirty[node_index])
             {
-                childs[i].traverse(func);
+                SceneGraphLeaf & leaf  = m_leaves[i_leaf];
+                leaf.m_total_transform = m_world_transforms[node_index];
+                if (leaf.m_is_instance)
+                {
+                    func(static_cast<const SceneGraphLeaf &>(leaf));
+                }
             }
-            return;
         }
+
+        std::fill(m_is_dirty.begin() + first_dirty_node, m_is_dirty.end(), uint8_t(0));
+        m_first_dirty_level = InvalidIndex;
     }
 
+    // leaves are visited depth first
+    template <typename Func>
     void
-    update_transform(const float4x4 & current_transform = glm::identity<float4x4>())
+    traverse(Func && func) const
     {
-        const float4x4 transform = m_transform * current_transform;
-        if (is_leaf())
+        for (const SceneGraphLeaf & leaf : m_leaves)
         {
-            SceneGraphLeaf & leaf_info  = std::get<0>(m_info);
-            leaf_info.m_total_transform = transform;
-            return;
+            func(leaf);
         }
-        else
+    }
+
+    template <typename Func>
+    void
+    traverse(Func && func)
+    {
+        for (SceneGraphLeaf & leaf : m_leaves)
         {
-            std::vector<SceneGraphNode> & childs = std::get<1>(m_info);
-            for (size_t i = 0; i < childs.size(); i++)
-            {
-                childs[i].update_transform(transform);
-            }
-            return;
+            func(leaf);
         }
     }
 
+    template <typename Func>
+    size_t
+    get_num_leaves(Func && func) const
+    {
+        return static_cast<size_t>(std::count_if(m_leaves.begin(), m_leaves.end(), func));
+    }
+};
+
+// thin view of a node of a FlatSceneGraph, addressed by its flat node index. it stays valid as long as the graph is not
+// flattened again.
+struct SceneGraphNode
+{
+    FlatSceneGraph * m_graph      = nullptr;
+    uint32_t         m_node_index = 0;
+
+    // the root by default
+    SceneGraphNode(FlatSceneGraph * graph, const uint32_t node_index = 0) : m_graph(graph), m_node_index(node_index) {}
+
+    bool
+    is_leaf() const
+    {
+        return m_graph->is_leaf(m_node_index);
+    }
+
     size_t
-    get_num_leaves(const std::function<bool(const SceneGraphLeaf &)> & func) const
+    get_num_children() const
+    {
+        return m_graph->m_num_children[m_node_index];
+    }
+
+    SceneGraphNode
+    get_child(const size_t i_child) const
     {
-        if (is_leaf())
+        assert(i_child < get_num_children());
+        return SceneGraphNode(m_graph, m_graph->m_first_child_indices[m_node_index] + static_cast<uint32_t>(i_child));
+    }
+
+    const float4x4 &
+    get_transform() const
+    {
+        return m_graph->m_local_transforms[m_node_index];
+    }
+
+    void
+    set_transform(const float4x4 & transform)
+    {
+        m_graph->set_transform(m_node_index, transform);
+    }
+
+    // recomputes the total transforms of the leaves under this node, along with any other dirty subtree
+    void
+    update_transform()
+    {
+        m_graph->set_dirty(m_node_index);
+        m_graph->update_dirty_transforms([](const SceneGraphLeaf &) {});
+    }
+
+    template <typename Func>
+    void
+    traverse(Func && func) const
+    {
+        const urange32_t leaf_range = m_graph->m_leaf_ranges[m_node_index];
+        for (uint32_t i_leaf = leaf_range.m_begin; i_leaf < leaf_range.m_end; i_leaf++)
         {
-            const SceneGraphLeaf & leaf_info = std::get<0>(m_info);
-            if (func(leaf_info))
-            {
-                return 1;
-            }
-            return 0;
+            func(static_cast<const SceneGraphLeaf &>(m_graph->m_leaves[i_leaf]));
         }
-        else
+    }
+
+    template <typename Func>
+    void
+    traverse(Func && func)
+    {
+        const urange32_t leaf_range = m_graph->m_leaf_ranges[m_node_index];
+        for (uint32_t i_leaf = leaf_range.m_begin; i_leaf < leaf_range.m_end; i_leaf++)
         {
-            const std::vector<SceneGraphNode> & childs = std::get<1>(m_info);
-            size_t                              sum    = 0;
-            for (size_t i = 0; i < childs.size(); i++)
-            {
-                sum += childs[i].get_num_leaves(func);
-            }
-            return sum;
+            func(m_graph->m_leaves[i_leaf]);
         }
     }
+
+    template <typename Func>
+    size_t
+    get_num_leaves(Func && func) const
+    {
+        const urange32_t leaf_range = m_graph->m_leaf_ranges[m_node_index];
+        return static_cast<size_t>(std::count_if(m_graph->m_leaves.begin() + leaf_range.m_begin,
+                                                 m_graph->m_leaves.begin() + leaf_range.m_end,
+                                                 func));
+    }
 };
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "benchmark_util.h"
+#include "core/logger.h"
+#include "core/stopwatch.h"
+#include "core/thread_pool.h"
+#include "pch/pch.h"
+#include "scene_graph.h"
+
+#include <random>
+
+// transform propagation timings of the flattened scene graph against the recursive tree it replaced, over a large
+// synthetic hierarchy. the recursive tree is kept here as a reference, it is walked through std::function as it was
+struct SceneGraphBenchmark
+{
+    static constexpr uint32_t BranchingFactor = 10;
+    // 1 + 10 + ... + 10^6 = 1111111 nodes, the last level are instance leaves
+    static constexpr uint32_t NumLevels  = 7;
+    static constexpr float    DirtyRatio = 0.01f;
+
+    static void
+    Run()
+    {
+        uint32_t           num_leaves = 0;
+        SceneGraphNodeDesc root       = ConstructNode(0, &num_leaves);
+
+        StopWatch      flatten_stop_watch;
+        FlatSceneGraph graph      = FlatSceneGraph::Flatten(root);
+        const float    flatten_ms = static_cast<float>(flatten_stop_watch.time_micro_sec()) / 1000.0f;
+        Logger::Info(__FUNCTION__,
+                     " ",
+                     graph.size(),
+                     " nodes, ",
+                     num_leaves,
+                     " leaves, ",
+                     graph.m_level_begins.size() - 1,
+                     " levels, flattened in ",
+                     flatten_ms,
+                     " ms");
+
+        // full updates
+        ThreadPool  single_thread_pool(0);
+        const float recursive_ms =
+            BenchmarkUtil::MeasureMilliSec([&]() { RecursiveUpdateTransform(&root, glm::identity<float4x4>()); });
+        const float single_thread_ms = BenchmarkUtil::MeasureMilliSec([&]() { graph.update_transform(single_thread_pool); });
+        const float multi_thread_ms  = BenchmarkUtil::MeasureMilliSec([&]() { graph.update_transform(); });
+        Logger::Info(__FUNCTION__,
+                     " full update : ",
+                     recursive_ms,
+                     " ms recursive, ",
+                     single_thread_ms,
+                     " ms flat on 1 thread, ",
+                     multi_thread_ms,
+                     " ms flat on ",
+                     ThreadPool::Get().get_num_threads(),
+                     " threads");
+
+        // both graphs must agree on the transforms and on the order leaves are visited in, through the node view
+        std::vector<const SceneGraphLeaf *> recursive_leaves;
+        RecursiveTraverse(root, [&](const SceneGraphLeaf & leaf) { recursive_leaves.push_back(&leaf); });
+        const SceneGraphNode graph_root(&graph);
+        float                max_error            = 0.0f;
+        size_t               num_reordered_leaves = 0;
+        size_t               i_leaf               = 0;
+        graph_root.traverse(
+            [&](const SceneGraphLeaf & leaf)
+            {
+                const SceneGraphLeaf & recursive_leaf = *recursive_leaves[i_leaf++];
+                if (leaf.m_instance_id != recursive_leaf.m_instance_id)
+                {
+                    num_reordered_leaves++;
+                }
+                for (int i = 0; i < 4; i++)
+                {
+                    const float4 diff = abs(leaf.m_total_transform[i] - recursive_leaf.m_total_transform[i]);
+                    max_error         = std::max(max_error, std::max(std::max(diff.x, diff.y), std::max(diff.z, diff.w)));
+                }
+            });
+        if (max_error > 1e-3f || num_reordered_leaves > 0 || i_leaf != recursive_leaves.size())
+        {
+            Logger::Warn(__FUNCTION__,
+                         " flat and recursive transforms differ by ",
+                         max_error,
+                         ", ",
+                         num_reordered_leaves,
+                         " leaves visited out of order, ",
+                         i_leaf,
+                         " leaves visited instead of ",
+                         recursive_leaves.size());
+        }
+
+        // leaf counts of every subtree below the root
+        const auto is_instance             = [](const SceneGraphLeaf & leaf) { return leaf.m_is_instance; };
+        size_t     num_miscounted_subtrees = 0;
+        for (size_t i_child = 0; i_child < graph_root.get_num_children(); i_child++)
+        {
+            const size_t num_recursive_leaves = RecursiveGetNumLeaves(std::get<1>(root.m_info)[i_child], is_instance);
+            if (graph_root.get_child(i_child).get_num_leaves(is_instance) != num_recursive_leaves)
+            {
+                num_miscounted_subtrees++;
+            }
+        }
+        if (num_miscounted_subtrees > 0)
+        {
+            Logger::Warn(__FUNCTION__, " ", num_miscounted_subtrees, " subtrees count leaves other than the recursive tree");
+        }
+
+        // sparse updates, random nodes of any level move every iteration
+        std::mt19937                            rng(0);
+        std::uniform_int_distribution<uint32_t> node_distribution(0, static_cast<uint32_t>(graph.size() - 1));
+        const size_t num_dirty_nodes = static_cast<size_t>(static_cast<float>(graph.size()) * DirtyRatio);
+        size_t       num_updated_instances = 0;
+        size_t       i_iteration           = 0;
+        const float  dirty_ms              = BenchmarkUtil::MeasureMilliSec(
+            [&]()
+            {
+                for (size_t i_dirty = 0; i_dirty < num_dirty_nodes; i_dirty++)
+                {
+                    const uint32_t node_index = node_distribution(rng);
+                    graph.set_transform(node_index, GetLocalTransform(node_index + i_iteration));
+                }
+                i_iteration++;
+            },
+            [&]()
+            {
+                num_updated_instances = 0;
+                graph.update_dirty_transforms([&](const SceneGraphLeaf &) { num_updated_instances++; });
+            },
+            BenchmarkUtil::NumIterations);
+        Logger::Info(__FUNCTION__,
+                     " dirty update of ",
+                     num_dirty_nodes,
+                     " random nodes : ",
+                     dirty_ms,
+                     " ms, ",
+                     num_updated_instances,
+                     " instances changed in the last iteration");
+
+        // leaf iteration
+        size_t      num_recursive_instances = 0;
+        size_t      num_flat_instances      = 0;
+        const float recursive_traverse_ms   = BenchmarkUtil::MeasureMilliSec(
+            [&]() { num_recursive_instances = RecursiveGetNumLeaves(root, [](const SceneGraphLeaf & leaf) { return leaf.m_is_instance; }); });
+        const float flat_traverse_ms = BenchmarkUtil::MeasureMilliSec(
+            [&]() { num_flat_instances = graph.get_num_leaves([](const SceneGraphLeaf & leaf) { return leaf.m_is_instance; }); });
+        Logger::Info(__FUNCTION__,
+                     " leaf count : ",
+                     recursive_traverse_ms,
+                     " ms recursive, ",
+                     flat_traverse_ms,
+                     " ms flat, ",
+                     num_recursive_instances,
+                     " and ",
+                     num_flat_instances,
+                     " instances");
+    }
+
+private:
+    // small rotation and offset so errors accumulate down the hierarchy as in a real scene
+    static float4x4
+    GetLocalTransform(const size_t seed)
+    {
+        const float angle = static_cast<float>(seed % 17) * 0.01f;
+        return glm::translate(glm::rotate(glm::identity<float4x4>(), angle, float3(0.0f, 1.0f, 0.0f)),
+                              float3(static_cast<float>(seed % 7) * 0.1f, 0.0f, 0.0f));
+    }
+
+    static void
+    RecursiveUpdateTransform(SceneGraphNodeDesc * node, const float4x4 & current_transform)
+    {
+        const float4x4 transform = node->m_transform * current_transform;
+        if (node->is_leaf())
+        {
+            std::get<0>(node->m_info).m_total_transform = transform;
+            return;
+        }
+        for (SceneGraphNodeDesc & child : std::get<1>(node->m_info))
+        {
+            RecursiveUpdateTransform(&child, transform);
+        }
+    }
+
+    static void
+    RecursiveTraverse(const SceneGraphNodeDesc & node, const std::function<void(const SceneGraphLeaf &)> & func)
+    {
+        if (node.is_leaf())
+        {
+            func(std::get<0>(node.m_info));
+            return;
+        }
+        for (const SceneGraphNodeDesc & child : std::get<1>(node.m_info))
+        {
+            RecursiveTraverse(child, func);
+        }
+    }
+
+    static size_t
+    RecursiveGetNumLeaves(const SceneGraphNodeDesc & node, const std::function<bool(const SceneGraphLeaf &)> & func)
+    {
+        if (node.is_leaf())
+        {
+            return func(std::get<0>(node.m_info)) ? 1 : 0;
+        }
+        size_t sum = 0;
+        for (const SceneGraphNodeDesc & child : std::get<1>(node.m_info))
+        {
+            sum += RecursiveGetNumLeaves(child, func);
+        }
+        return sum;
+    }
+
+    static SceneGraphNodeDesc
+    ConstructNode(const uint32_t level, uint32_t * num_leaves)
+    {
+        if (level + 1 == NumLevels)
+        {
+            SceneGraphNodeDesc node(true);
+            SceneGraphLeaf & leaf = std::get<0>(node.m_info);
+            leaf.m_is_instance    = true;
+            leaf.m_instance_id    = (*num_leaves)++;
+            node.m_transform      = GetLocalTransform(leaf.m_instance_id);
+            return node;
+        }
+
+        SceneGraphNodeDesc                node(false);
+        std::vector<SceneGraphNodeDesc> & childs = std::get<1>(node.m_info);
+        childs.reserve(BranchingFactor);
+        for (uint32_t i_child = 0; i_child < BranchingFactor; i_child++)
+        {
+            childs.push_back(ConstructNode(level + 1, num_leaves));
+        }
+        node.m_transform = GetLocalTransform(level * BranchingFactor + *num_leaves);
+        return node;
+    }
+};
@@ -5,10 +5,15 @@
 
 #include "core/camera.h"
 #include "core/ste/stevector.h"
+#include "core/stopwatch.h"
+#include "core/thread_pool.h"
 #include "engine_setting.h"
 #include "importer/ai_mesh_importer.h"
+#include "importer/scene_cache.h"
+#include "importer/texture_baker.h"
 #include "rhi/rhi.h"
 #include "shaders/shared/bindless_table.h"
+#include "shaders/shared/compact_position.h"
 #include "shaders/shared/compact_vertex.h"
 #include "shaders/shared/standard_emission.h"
 #include "shaders/shared/standard_material.h"
@@ -28,7 +33,31 @@ struct SceneGeometry
     BufferSizeT m_num_indices   = 0;
     BufferSizeT m_material_index  = 0;
     BufferSizeT m_emission_index  = 0;
+    // imported geometries are static, nothing refits their blas, so they are built for fast trace and compacted
     bool        m_is_updatable  = false;
+    // 1 for 16 bit indices, 2 for 32 bit indices (see VertexIndexT)
+    uint32_t m_index_stride_in_words = 1;
+    // texcoord range the compact vertices are quantized against
+    float2 m_texcoord_offset = float2(0.0f);
+    float2 m_texcoord_scale  = float2(0.0f);
+    // bounding box the positions are quantized against, only used with COMPACT_POSITION_QUANTIZED
+    float3 m_position_offset = float3(0.0f);
+    float3 m_position_scale  = float3(0.0f);
+};
+
+// row-major 3x4 matrix, the layout both apis read geometry transforms of blas builds in
+using BlasGeometryTransform = std::array<float, 12>;
+
+// texture requested through add_texture, waiting for flush_pending_textures
+struct PendingTexture
+{
+    std::filesystem::path m_path;
+    size_t                m_desired_channel = 0;
+    // baked pixels of all mip levels (laid out as in TextureImage), empty until the texture is baked
+    std::span<const std::byte> m_decoded_pixels;
+    int2                       m_resolution = int2(0, 0);
+    Rhi::FormatEnum            m_format     = Rhi::FormatEnum::R8G8B8A8_UNorm_Srgb;
+    uint32_t                   m_num_levels = 1;
 };
 
 struct SceneBaseInstance
@@ -52,11 +81,33 @@ struct SceneResource
 {
     Rhi::Device & m_device;
 
-    // command pool
-    Rhi::CommandPool m_transfer_cmd_pool;
+    // upload heap shared by geometry, texture and table uploads, its copies run on the transfer queue
+    Rhi::StagingRing m_staging_ring;
+
+    // resources written by the staging ring change queue with a release on the transfer queue and an acquire on the
+    // graphics queue, which waits on the device for the ring timeline to reach m_timeline_value
+    struct UploadedBufferRange
+    {
+        const Rhi::Buffer * m_buffer          = nullptr;
+        size_t              m_offset_in_bytes = 0;
+        size_t              m_size_in_bytes   = 0;
+    };
+    struct UploadHandoff
+    {
+        std::vector<UploadedBufferRange> m_buffer_ranges;
+        std::vector<size_t>              m_texture_ids;
+        uint64_t                         m_timeline_value = 0;
+    };
+    UploadHandoff    m_unreleased_uploads;
+    UploadHandoff    m_unacquired_uploads;
+    Rhi::CommandPool m_graphics_cmd_pool;
+
+    // the fourth snorm16 of a quantized position is padding, blas builds do not take three component snorm16
+    static constexpr Rhi::FormatEnum m_vbuf_position_type =
+        COMPACT_POSITION_QUANTIZED ? Rhi::FormatEnum::R16G16B16A16_SNorm : Rhi::GetVertexType<float3>();
 
-    static constexpr Rhi::IndexType  m_ibuf_index_type    = Rhi::GetIndexType<VertexIndexT>();
-    static constexpr Rhi::FormatEnum m_vbuf_position_type = Rhi::GetVertexType<float3>();
+    // texture rows copied into the staging ring by one task
+    static constexpr size_t MinNumTextureRowsPerTask = 64;
 
     // device position, packed and index information
     Rhi::Buffer m_d_vbuf_position = {};
@@ -64,6 +115,9 @@ struct SceneResource
     Rhi::Buffer m_d_ibuf          = {};
     size_t      m_num_vertices    = 0;
     size_t      m_num_indices     = 0;
+    // dequantization of the positions of every geometry, indexed by geometry id. only used with
+    // COMPACT_POSITION_QUANTIZED
+    Rhi::Buffer m_d_blas_geometry_transforms = {};
 
     // device & host textures and materials
     std::vector<Rhi::Texture> m_d_textures;
@@ -77,6 +131,14 @@ struct SceneResource
     std::vector<StandardEmission> m_h_emissions;
 
     std::map<std::filesystem::path, size_t> m_texture_id_from_path;
+    std::vector<std::filesystem::path>      m_texture_paths;
+    std::vector<size_t>                     m_texture_num_channels;
+
+    // if set, flush_pending_textures hands decoded images over instead of freeing them
+    std::map<size_t, TextureImage> * m_decoded_texture_sink = nullptr;
+
+    // textures that have an id but are not decoded / uploaded yet
+    std::vector<PendingTexture> m_pending_textures;
 
     // device & host lookup table for geometry & instance
     // look up offset into geometry table based on instance index
@@ -87,19 +149,46 @@ struct SceneResource
 
     // device & host blas (requires update)
     std::vector<Rhi::RayTracingBlas> m_rt_blases;
-    Rhi::RayTracingTlas              m_rt_tlas;
+
+    // tlas instances, the transforms follow the instance leaves of m_scene_graph
+    std::vector<SceneInstance>           m_instances;
+    std::vector<Rhi::RayTracingInstance> m_rt_instances;
+
+    // one tlas per flight, built on the compute queue while the previous flight is still ray traced on the graphics
+    // queue. instances are persistently mapped with one region per flight, so the host never writes a region the gpu
+    // may read. changed instances are queued for every flight and written when that flight updates its tlas.
+    struct FlightTlas
+    {
+        Rhi::RayTracingTlas   m_tlas;
+        std::vector<uint32_t> m_pending_instance_ids;
+        std::vector<bool>     m_is_pending;
+        bool                  m_is_built                  = false;
+        size_t                m_num_refit_instance_writes = 0;
+    };
+    Rhi::Buffer               m_d_rt_instances;
+    Rhi::RayTracingInstance * m_mapped_rt_instances = nullptr;
+    std::vector<FlightTlas>   m_flight_tlases;
+    // signaled by tlas builds on the compute queue, waited on by the graphics queue
+    Rhi::TimelineSemaphore m_tlas_timeline;
+    uint64_t               m_tlas_timeline_value = 0;
+    // bumped whenever a resource bound by persistent descriptors is recreated
+    uint64_t m_descriptor_version = 0;
 
     // camera
     FpsCamera m_camera;
 
     // scene graph
-    SceneGraphNode                 m_scene_graph_root = SceneGraphNode(false);
+    FlatSceneGraph                 m_scene_graph;
+    std::vector<uint32_t>          m_instance_node_indices;
     std::vector<SceneGeometry>     m_geometries;
     std::vector<SceneBaseInstance> m_base_instances;
 
-    SceneResource(Rhi::Device & device)
+    SceneResource(Rhi::Device & device, const size_t num_flights)
     : m_device(device),
-      m_transfer_cmd_pool("scene_resource_transfer_cmd_pool", device, Rhi::QueueType::Transfer)
+      m_staging_ring("scene_staging_ring", device, static_cast<size_t>(EngineSetting::StagingRingSizeInBytes)),
+      m_graphics_cmd_pool("scene_graphics_cmd_pool", device, Rhi::QueueType::Graphics),
+      m_flight_tlases(num_flights),
+      m_tlas_timeline("scene_tlas_timeline", device)
     {
         // index buffer vertex buffer
         m_d_vbuf_position = Rhi::Buffer("scene_m_d_vbuf_position",
@@ -108,7 +197,7 @@ struct SceneResource
                                             Rhi::BufferUsageEnum::VertexBuffer |
                                             Rhi::BufferUsageEnum::RayTracingAccelStructBufferInput,
                                         Rhi::MemoryUsageEnum::GpuOnly,
-                                        sizeof(float3) * EngineSetting::MaxNumVertices);
+                                        sizeof(CompactPosition) * EngineSetting::MaxNumVertices);
         m_d_vbuf_packed   = Rhi::Buffer("scene_m_d_vbuf_packed",
                                       m_device,
                                       Rhi::BufferUsageEnum::TransferDst | Rhi::BufferUsageEnum::StorageBuffer |
@@ -121,7 +210,16 @@ struct SceneResource
                                    Rhi::BufferUsageEnum::IndexBuffer |
                                    Rhi::BufferUsageEnum::RayTracingAccelStructBufferInput,
                                Rhi::MemoryUsageEnum::GpuOnly,
-                               Rhi::GetSizeInBytes(m_ibuf_index_type) * EngineSetting::MaxNumIndices);
+                               sizeof(VertexIndexT) * EngineSetting::MaxNumIndices);
+        if constexpr (COMPACT_POSITION_QUANTIZED)
+        {
+            m_d_blas_geometry_transforms =
+                Rhi::Buffer("scene_m_d_blas_geometry_transforms",
+                            m_device,
+                            Rhi::BufferUsageEnum::TransferDst | Rhi::BufferUsageEnum::RayTracingAccelStructBufferInput,
+                            Rhi::MemoryUsageEnum::GpuOnly,
+                            sizeof(BlasGeometryTransform) * EngineSetting::MaxNumGeometryTableEntry);
+        }
 
         // materials
         m_d_materials = Rhi::Buffer("scene_m_d_materials",
@@ -152,16 +250,84 @@ struct SceneResource
                         sizeof(GeometryTableEntry) * EngineSetting::MaxNumGeometryTableEntry);
 
         m_h_materials.push_back(get_standard_black_material());
+
+        // stb_image's flip flag is global, set it once here rather than from the decoding threads
+        stbi_set_flip_vertically_on_load(true);
+    }
+
+    ~SceneResource()
+    {
+        // copies into the buffers and textures below may still be in flight, frames acquiring them are waited for by
+        // the main loop
+        m_staging_ring.wait_idle();
+        m_tlas_timeline.wait(m_tlas_timeline_value);
+        if (m_mapped_rt_instances != nullptr)
+        {
+            m_d_rt_instances.unmap();
+        }
     }
 
     urange32_t
     add_geometries(const std::filesystem::path & path)
     {
-        std::optional<AiScene>      ai_scene = AiScene::ReadScene(path);
-        std::vector<AiGeometryInfo> geometry_infos =
-            ai_scene->get_geometry_infos(std::numeric_limits<VertexIndexT>::max());
+        StopWatch                   load_stop_watch;
+        const std::filesystem::path cache_path =
+            SceneCache::GetCachePath(EngineSetting::SceneCachePath(), path);
+
+        // warm path, everything is already decoded in the cache
+        std::optional<urange32_t> cached_geometries_range = add_geometries_from_cache(cache_path);
+        if (cached_geometries_range.has_value())
+        {
+            Logger::Info(__FUNCTION__,
+                         " loaded ",
+                         path.string(),
+                         " from cache ",
+                         cache_path.string(),
+                         " in ",
+                         load_stop_watch.time_milli_sec(),
+                         " ms");
+            return cached_geometries_range.value();
+        }
+
+        // cold path, import through assimp then write the cache for the next run
+        const urange32_t geometries_range = add_geometries_from_source(path, cache_path);
+        Logger::Info(__FUNCTION__, " loaded ", path.string(), " from source in ", load_stop_watch.time_milli_sec(), " ms");
+        return geometries_range;
+    }
+
+    urange32_t
+    add_geometries_from_source(const std::filesystem::path & path, const std::filesystem::path & cache_path)
+    {
+        std::optional<AiScene> ai_scene = AiScene::ReadScene(path);
+        StopWatch              split_stop_watch;
+
+        // a geometry costs its compact positions and compact vertices on the device
+        AiIndexPolicy index_policy;
+        index_policy.m_max_num_vertices_per_16bit_geometry = std::numeric_limits<VertexIndexT>::max();
+        index_policy.m_is_32bit_index_allowed              = EngineSetting::Enable32BitIndices;
+        index_policy.m_vertex_size_in_bytes                = sizeof(CompactPosition) + sizeof(CompactVertex);
+        index_policy.m_geometry_cost_in_bytes              = EngineSetting::GeometryCostInBytes;
+
+        std::vector<AiGeometryInfo> geometry_infos = ai_scene->get_geometry_infos(index_policy);
+        const size_t                num_32bit_geometries =
+            std::count_if(geometry_infos.begin(),
+                          geometry_infos.end(),
+                          [](const AiGeometryInfo & geometry_info) { return geometry_info.m_index_stride_in_words == 2; });
+        Logger::Info(__FUNCTION__,
+                     " split ",
+                     path.string(),
+                     " into ",
+                     geometry_infos.size(),
+                     " geometries (",
+                     num_32bit_geometries,
+                     " with 32 bit indices) in ",
+                     split_stop_watch.time_milli_sec(),
+                     " ms");
 
         // load all materials (and necessary textures)
+        // decoded textures are kept around so they can be written into the cache
+        std::map<size_t, TextureImage> decoded_textures;
+        m_decoded_texture_sink       = &decoded_textures;
         const size_t material_offset = m_h_materials.size();
         const size_t emission_offset = m_h_emissions.size();
         for (size_t i_mat = 0; i_mat < ai_scene->m_ai_scene->mNumMaterials; i_mat++)
@@ -173,6 +339,8 @@ struct SceneResource
             m_h_materials.push_back(mat);
             m_h_emissions.push_back(emission);
         }
+        flush_pending_textures();
+        m_decoded_texture_sink = nullptr;
 
         // prepare information host vertex buffers allocation and index buffer
         size_t                num_total_vertices = 0;
@@ -186,7 +354,7 @@ struct SceneResource
             num_total_vertices +=
                 round_up(geometry_infos[i_geometry_info].m_dst_num_vertices, static_cast<size_t>(32));
             num_total_indices +=
-                round_up(geometry_infos[i_geometry_info].m_dst_num_indices, static_cast<size_t>(32));
+                round_up(geometry_infos[i_geometry_info].get_dst_num_index_words(), static_cast<size_t>(32));
         }
 
         // allocate host vertex buffers and index buffer
@@ -198,115 +366,413 @@ struct SceneResource
         const urange32_t geometries_range(static_cast<uint32_t>(m_geometries.size()),
                                           static_cast<uint32_t>(m_geometries.size() + geometry_infos.size()));
         m_geometries.resize(geometries_range.m_end);
+        std::vector<AiGeometryQuantization> quantizations(geometry_infos.size());
+
+        // every geometry writes into its own slice of the host buffers, so geometries can be written in parallel
+        // remap tables are reused across geometries and freed once every geometry is written
+        AiVertexRemapTablePool remap_table_pool;
+        ThreadPool::Get().parallel_for(
+            0,
+            geometry_infos.size(),
+            [&](const size_t i_geometry_info)
+            {
+                std::unique_ptr<AiVertexRemapTable> remap_table = remap_table_pool.acquire();
 
-        for (size_t i_geometry_info = 0; i_geometry_info < geometry_infos.size(); i_geometry_info++)
-        {
-            const AiGeometryInfo &   geometry_info     = geometry_infos[i_geometry_info];
-            const uint32_t           vertices_base_index = vertices_base_indexs[i_geometry_info];
-            const uint32_t           indices_base_index  = indices_base_indexs[i_geometry_info];
-            std::span<float3>        span_vb_positions(vb_positions1.begin() + vertices_base_index,
-                                                geometry_info.m_dst_num_vertices);
-            std::span<CompactVertex> span_vb_packed(vb_packed1.begin() + vertices_base_index,
+                const AiGeometryInfo &   geometry_info       = geometry_infos[i_geometry_info];
+                const uint32_t           vertices_base_index = vertices_base_indexs[i_geometry_info];
+                const uint32_t           indices_base_index  = indices_base_indexs[i_geometry_info];
+                std::span<float3>        span_vb_positions(vb_positions1.begin() + vertices_base_index,
                                                     geometry_info.m_dst_num_vertices);
-            std::span<VertexIndexT> span_ib(ib1.begin() + indices_base_index, geometry_info.m_dst_num_indices);
+                std::span<CompactVertex> span_vb_packed(vb_packed1.begin() + vertices_base_index,
+                                                        geometry_info.m_dst_num_vertices);
+                std::span<VertexIndexT>  span_ib(ib1.begin() + indices_base_index,
+                                                 geometry_info.get_dst_num_index_words());
+
+                quantizations[i_geometry_info] = ai_scene->write_geometry_info(
+                    &span_vb_positions, &span_vb_packed, &span_ib, remap_table.get(), geometry_info);
+                remap_table_pool.release(std::move(remap_table));
+
+                SceneGeometry & model = m_geometries[i_geometry_info + geometries_range.m_begin];
+
+                model.m_texcoord_offset       = quantizations[i_geometry_info].m_texcoord_offset;
+                model.m_texcoord_scale        = quantizations[i_geometry_info].m_texcoord_scale;
+                model.m_vbuf_base_index       = vertices_base_index;
+                model.m_ibuf_base_index       = indices_base_index;
+                model.m_num_indices           = static_cast<BufferSizeT>(geometry_info.m_dst_num_indices);
+                model.m_num_vertices          = static_cast<BufferSizeT>(geometry_info.m_dst_num_vertices);
+                model.m_is_updatable          = false;
+                model.m_index_stride_in_words = geometry_info.m_index_stride_in_words;
+                model.m_material_index =
+                    static_cast<BufferSizeT>(material_offset + geometry_info.m_src_material_index);
+
+                // check if emission have any intensity
+                const StandardEmission & emission =
+                    m_h_emissions[emission_offset + geometry_info.m_src_material_index];
+                bool is_emitting_non_zero_intensity = false;
+                if (emission.is_emission_texture())
+                {
+                    is_emitting_non_zero_intensity = true;
+                }
+                else
+                {
+                    float3 emission_val            = emission.decode_rgb(emission.m_emission_tex_id);
+                    is_emitting_non_zero_intensity = (length(emission_val) > 0.0f);
+                }
+
+                if (is_emitting_non_zero_intensity)
+                {
+                    model.m_emission_index =
+                        static_cast<BufferSizeT>(emission_offset + geometry_info.m_src_material_index);
+                }
+                else
+                {
+                    model.m_emission_index = 0;
+                }
+
+                assert(geometry_info.m_dst_num_indices < std::numeric_limits<BufferSizeT>::max());
+                assert(geometry_info.m_dst_num_vertices < std::numeric_limits<BufferSizeT>::max());
+                assert(material_offset + geometry_info.m_src_material_index <
+                       std::numeric_limits<BufferSizeT>::max());
+            });
+
+        // a hit fetches three compact vertices and a geometry table entry, uncompressed they took 3 * 20 + 16 bytes
+        AiGeometryQuantization max_error;
+        for (const AiGeometryQuantization & quantization : quantizations)
+        {
+            max_error.merge_errors(quantization);
+        }
+        Logger::Info(__FUNCTION__,
+                     " ",
+                     path.string(),
+                     " : ",
+                     sizeof(CompactVertex),
+                     " bytes per compact vertex, ",
+                     3 * sizeof(CompactVertex) + sizeof(GeometryTableEntry),
+                     " bytes fetched per hit instead of ",
+                     3 * (sizeof(float3) + sizeof(float2)) + 4 * sizeof(uint32_t),
+                     ", max shading normal error ",
+                     max_error.m_max_snormal_error_in_degrees,
+                     " degrees, max texcoord error ",
+                     max_error.m_max_texcoord_error);
+
+        upload_geometries(geometries_range, vb_positions1, vb_packed1, ib1);
+
+        write_scene_cache(cache_path,
+                          *ai_scene,
+                          geometries_range,
+                          urange32_t(static_cast<uint32_t>(material_offset), static_cast<uint32_t>(m_h_materials.size())),
+                          urange32_t(static_cast<uint32_t>(emission_offset), static_cast<uint32_t>(m_h_emissions.size())),
+                          &decoded_textures,
+                          std::move(vb_positions1),
+                          std::move(vb_packed1),
+                          std::move(ib1));
 
-            ai_scene->write_geometry_info(&span_vb_positions, &span_vb_packed, &span_ib, geometry_info);
+        return geometries_range;
+    }
 
-            SceneGeometry & model = m_geometries[i_geometry_info + geometries_range.m_begin];
+    std::optional<urange32_t>
+    add_geometries_from_cache(const std::filesystem::path & cache_path)
+    {
+        SceneCacheReader cache;
+        if (!cache.open(cache_path))
+        {
+            return std::nullopt;
+        }
+        if (!cache.is_up_to_date())
+        {
+            Logger::Info(__FUNCTION__, " cache ", cache_path.string(), " is out of date");
+            return std::nullopt;
+        }
+
+        // textures, reuse the ones that are already loaded
+        const std::span<const SceneCacheTexture> cached_textures =
+            cache.get_section<SceneCacheTexture>(SceneCacheSection::Textures);
+        std::vector<size_t> tex_ids(cached_textures.size());
+        for (size_t i_tex = 0; i_tex < cached_textures.size(); i_tex++)
+        {
+            const SceneCacheTexture &   cached_texture = cached_textures[i_tex];
+            const std::filesystem::path tex_path =
+                cache.get_string(cached_texture.m_path_offset, cached_texture.m_path_length);
+
+            auto q = m_texture_id_from_path.find(tex_path);
+            if (q != m_texture_id_from_path.end())
+            {
+                tex_ids[i_tex] = q->second;
+                continue;
+            }
+
+            tex_ids[i_tex] = add_decoded_texture(tex_path,
+                                                 int2(cached_texture.m_width, cached_texture.m_height),
+                                                 static_cast<Rhi::FormatEnum>(cached_texture.m_format),
+                                                 cached_texture.m_num_levels,
+                                                 cache.get_texture_payload(cached_texture));
+        }
 
-            model.m_vbuf_base_index = vertices_base_index;
-            model.m_ibuf_base_index = indices_base_index;
-            model.m_num_indices   = static_cast<BufferSizeT>(geometry_info.m_dst_num_indices);
-            model.m_num_vertices  = static_cast<BufferSizeT>(geometry_info.m_dst_num_vertices);
-            model.m_is_updatable  = true;
+        // payloads point into the mapped cache, so they must be uploaded before the cache is closed
+        flush_pending_textures();
+
+        // materials and emissions, texture ids are local to the cache
+        const size_t material_offset = m_h_materials.size();
+        const size_t emission_offset = m_h_emissions.size();
+        for (StandardMaterial material : cache.get_section<StandardMaterial>(SceneCacheSection::Materials))
+        {
+            material.m_diffuse_tex_id   = RemapTextureBlob(material.m_diffuse_tex_id, tex_ids);
+            material.m_specular_tex_id  = RemapTextureBlob(material.m_specular_tex_id, tex_ids);
+            material.m_roughness_tex_id = RemapTextureBlob(material.m_roughness_tex_id, tex_ids);
+            m_h_materials.push_back(material);
+        }
+        for (StandardEmission emission : cache.get_section<StandardEmission>(SceneCacheSection::Emissions))
+        {
+            emission.m_emission_tex_id = RemapTextureBlob(emission.m_emission_tex_id, tex_ids);
+            m_h_emissions.push_back(emission);
+        }
+
+        // geometries
+        const std::span<const SceneCacheGeometry> cached_geometries =
+            cache.get_section<SceneCacheGeometry>(SceneCacheSection::Geometries);
+        const urange32_t geometries_range(static_cast<uint32_t>(m_geometries.size()),
+                                          static_cast<uint32_t>(m_geometries.size() + cached_geometries.size()));
+        for (const SceneCacheGeometry & cached_geometry : cached_geometries)
+        {
+            SceneGeometry model;
+            model.m_vbuf_base_index       = cached_geometry.m_vbuf_base_index;
+            model.m_ibuf_base_index       = cached_geometry.m_ibuf_base_index;
+            model.m_texcoord_offset       = cached_geometry.m_texcoord_offset;
+            model.m_texcoord_scale        = cached_geometry.m_texcoord_scale;
+            model.m_num_indices           = cached_geometry.m_num_indices;
+            model.m_num_vertices          = cached_geometry.m_num_vertices;
+            model.m_is_updatable          = false;
+            model.m_index_stride_in_words = cached_geometry.m_index_stride_in_words;
             model.m_material_index =
-                static_cast<BufferSizeT>(material_offset + geometry_info.m_src_material_index);
+                static_cast<BufferSizeT>(material_offset + cached_geometry.m_src_material_index);
+            model.m_emission_index =
+                cached_geometry.m_is_emissive
+                    ? static_cast<BufferSizeT>(emission_offset + cached_geometry.m_src_material_index)
+                    : 0;
+            m_geometries.push_back(model);
+        }
+
+        // vertices and indices go straight from the mapped file into the staging ring
+        upload_geometries(geometries_range,
+                          cache.get_section<float3>(SceneCacheSection::Positions),
+                          cache.get_section<CompactVertex>(SceneCacheSection::CompactVertices),
+                          cache.get_section<VertexIndexT>(SceneCacheSection::Indices));
+
+        return geometries_range;
+    }
+
+    // copies are queued in the staging ring, the graphics queue acquires them before the blases read the buffers.
+    // positions stay float3 on the host and in the scene cache, they are converted to CompactPosition here
+    void
+    upload_geometries(const urange32_t                       geometries_range,
+                      const std::span<const float3> &        positions,
+                      const std::span<const CompactVertex> & compact_vertices,
+                      const std::span<const VertexIndexT> &  indices)
+    {
+        static_assert(Rhi::GetSizeInBytes(m_vbuf_position_type) == sizeof(CompactPosition));
 
-            // check if emission have any intensity
-            const StandardEmission & emission =
-                m_h_emissions[emission_offset + geometry_info.m_src_material_index];
-            bool is_emitting_non_zero_intensity = false;
-            if (emission.is_emission_texture())
+        std::vector<CompactPosition> compact_positions(positions.size());
+        if constexpr (COMPACT_POSITION_QUANTIZED)
+        {
+            quantize_positions(geometries_range, positions, &compact_positions);
+        }
+        else
+        {
+            for (size_t i_vertex = 0; i_vertex < positions.size(); i_vertex++)
             {
-                is_emitting_non_zero_intensity = true;
+                compact_positions[i_vertex].set_position(positions[i_vertex], float3(0.0f), float3(0.0f));
             }
-            else
+        }
+
+        upload_buffer(m_d_vbuf_position,
+                      m_num_vertices * Rhi::GetSizeInBytes(m_vbuf_position_type),
+                      std::span<const CompactPosition>(compact_positions));
+        upload_buffer(m_d_ibuf, m_num_indices * sizeof(VertexIndexT), indices);
+        upload_buffer(m_d_vbuf_packed, m_num_vertices * sizeof(CompactVertex), compact_vertices);
+        release_uploads();
+
+        m_num_vertices += positions.size();
+        m_num_indices += indices.size();
+    }
+
+    // positions of a geometry become snorm16 within its bounding box, the blas build maps them back through the
+    // geometry transform. the transforms are queued for upload, the largest errors are logged
+    void
+    quantize_positions(const urange32_t                geometries_range,
+                       const std::span<const float3> & positions,
+                       std::vector<CompactPosition> *  compact_positions)
+    {
+        if (geometries_range.m_begin == geometries_range.m_end)
+        {
+            return;
+        }
+
+        std::vector<BlasGeometryTransform> transforms(geometries_range.m_end - geometries_range.m_begin);
+        std::vector<float>                 max_errors(transforms.size(), 0.0f);
+        std::vector<float>                 max_relative_errors(transforms.size(), 0.0f);
+        ThreadPool::Get().parallel_for(
+            0,
+            transforms.size(),
+            [&](const size_t i_geometry)
+            {
+                SceneGeometry &         geometry            = m_geometries[geometries_range.m_begin + i_geometry];
+                const size_t            vertices_base_index = geometry.m_vbuf_base_index;
+                std::span<const float3> geometry_positions  = positions.subspan(vertices_base_index, geometry.m_num_vertices);
+
+                float3 min_position(std::numeric_limits<float>::max());
+                float3 max_position(std::numeric_limits<float>::lowest());
+                for (const float3 & position : geometry_positions)
+                {
+                    min_position = min(min_position, position);
+                    max_position = max(max_position, position);
+                }
+                if (geometry_positions.empty())
+                {
+                    min_position = max_position = float3(0.0f);
+                }
+                geometry.m_position_offset = (min_position + max_position) * 0.5f;
+                geometry.m_position_scale  = (max_position - min_position) * 0.5f;
+
+                const float diagonal = std::max(length(max_position - min_position), std::numeric_limits<float>::min());
+                for (size_t i_vertex = 0; i_vertex < geometry_positions.size(); i_vertex++)
+                {
+                    CompactPosition & compact_position = (*compact_positions)[vertices_base_index + i_vertex];
+                    compact_position.set_position(geometry_positions[i_vertex],
+                                                  geometry.m_position_offset,
+                                                  geometry.m_position_scale);
+                    const float error =
+                        length(compact_position.get_position(geometry.m_position_offset, geometry.m_position_scale) -
+                               geometry_positions[i_vertex]);
+                    max_errors[i_geometry]          = std::max(max_errors[i_geometry], error);
+                    max_relative_errors[i_geometry] = std::max(max_relative_errors[i_geometry], error / diagonal);
+                }
+
+                const float3 & t = geometry.m_position_offset;
+                const float3 & s = geometry.m_position_scale;
+                transforms[i_geometry] = { s.x, 0.0f, 0.0f, t.x, 0.0f, s.y, 0.0f, t.y, 0.0f, 0.0f, s.z, t.z };
+            });
+
+        upload_buffer(m_d_blas_geometry_transforms,
+                      geometries_range.m_begin * sizeof(BlasGeometryTransform),
+                      std::span<const BlasGeometryTransform>(transforms));
+
+        Logger::Info(__FUNCTION__,
+                     " ",
+                     positions.size() * sizeof(CompactPosition) / 1024,
+                     " KiB of positions instead of ",
+                     positions.size() * sizeof(float3) / 1024,
+                     " KiB, max error ",
+                     *std::max_element(max_errors.begin(), max_errors.end()),
+                     ", max error relative to the bounding box diagonal ",
+                     *std::max_element(max_relative_errors.begin(), max_relative_errors.end()));
+    }
+
+    // dump what add_geometries_from_source produced, so the next run can skip assimp and stb_image
+    void
+    write_scene_cache(const std::filesystem::path &    cache_path,
+                      const AiScene &                  ai_scene,
+                      const urange32_t                 geometries_range,
+                      const urange32_t                 materials_range,
+                      const urange32_t                 emissions_range,
+                      std::map<size_t, TextureImage> * decoded_textures,
+                      std::vector<float3> &&           positions,
+                      std::vector<CompactVertex> &&    compact_vertices,
+                      std::vector<VertexIndexT> &&     indices)
+    {
+        SceneCacheWriter writer;
+
+        // every file assimp read (.obj, .mtl, ...) invalidates the cache
+        for (const std::filesystem::path & src_file_path : ai_scene.m_src_file_paths)
+        {
+            if (!writer.add_dependency(src_file_path))
             {
-                float3 emission_val            = emission.decode_rgb(emission.m_emission_tex_id);
-                is_emitting_non_zero_intensity = (length(emission_val) > 0.0f);
+                Logger::Warn(__FUNCTION__, " cannot hash ", src_file_path.string(), ", cache is not written");
+                return;
             }
+        }
 
-            if (is_emitting_non_zero_intensity)
+        // textures referenced by the scene get local ids in the order they are first used
+        std::map<size_t, uint32_t> local_tex_id_from_tex_id;
+        auto                       localize_blob = [&](const uint32_t blob)
+        {
+            if ((blob & (1 << 24)) != 0)
             {
-                model.m_emission_index =
-                    static_cast<BufferSizeT>(emission_offset + geometry_info.m_src_material_index);
+                return blob;
             }
-            else
+            auto [q, is_inserted] =
+                local_tex_id_from_tex_id.try_emplace(blob, static_cast<uint32_t>(local_tex_id_from_tex_id.size()));
+            if (is_inserted)
             {
-                model.m_emission_index = 0;
+                const std::filesystem::path & tex_path = m_texture_paths[blob];
+                writer.add_dependency(tex_path);
+
+                // texture could have been loaded by a previous scene, then we have to decode it again
+                auto decoded = decoded_textures->find(blob);
+                if (decoded == decoded_textures->end())
+                {
+                    decoded = decoded_textures->emplace(blob, TextureBaker::Bake(tex_path, m_texture_num_channels[blob])).first;
+                }
+                const TextureImage & image = decoded->second;
+                writer.add_texture(tex_path,
+                                   static_cast<uint32_t>(image.m_resolution.x),
+                                   static_cast<uint32_t>(image.m_resolution.y),
+                                   static_cast<uint32_t>(image.m_format),
+                                   image.m_num_levels,
+                                   image.m_pixels);
             }
+            return q->second;
+        };
 
-            assert(geometry_info.m_dst_num_indices < std::numeric_limits<BufferSizeT>::max());
-            assert(geometry_info.m_dst_num_vertices < std::numeric_limits<BufferSizeT>::max());
-            assert(material_offset + geometry_info.m_src_material_index <
-                   std::numeric_limits<BufferSizeT>::max());
+        for (uint32_t i_mat = materials_range.m_begin; i_mat < materials_range.m_end; i_mat++)
+        {
+            StandardMaterial material   = m_h_materials[i_mat];
+            material.m_diffuse_tex_id   = localize_blob(material.m_diffuse_tex_id);
+            material.m_specular_tex_id  = localize_blob(material.m_specular_tex_id);
+            material.m_roughness_tex_id = localize_blob(material.m_roughness_tex_id);
+            writer.m_materials.push_back(material);
+        }
+        for (uint32_t i_emission = emissions_range.m_begin; i_emission < emissions_range.m_end; i_emission++)
+        {
+            StandardEmission emission  = m_h_emissions[i_emission];
+            emission.m_emission_tex_id = localize_blob(emission.m_emission_tex_id);
+            writer.m_emissions.push_back(emission);
         }
 
-        Rhi::CommandBuffer cmd_buffer = m_transfer_cmd_pool.get_command_buffer();
+        for (uint32_t i_geometry = geometries_range.m_begin; i_geometry < geometries_range.m_end; i_geometry++)
+        {
+            const SceneGeometry & geometry = m_geometries[i_geometry];
+            SceneCacheGeometry    cached_geometry;
+            cached_geometry.m_vbuf_base_index       = geometry.m_vbuf_base_index;
+            cached_geometry.m_ibuf_base_index       = geometry.m_ibuf_base_index;
+            cached_geometry.m_num_vertices          = geometry.m_num_vertices;
+            cached_geometry.m_num_indices           = geometry.m_num_indices;
+            cached_geometry.m_src_material_index    = geometry.m_material_index - materials_range.m_begin;
+            cached_geometry.m_is_emissive           = geometry.m_emission_index != 0 ? 1 : 0;
+            cached_geometry.m_index_stride_in_words = geometry.m_index_stride_in_words;
+            cached_geometry.m_texcoord_offset       = geometry.m_texcoord_offset;
+            cached_geometry.m_texcoord_scale        = geometry.m_texcoord_scale;
+            writer.m_geometries.push_back(cached_geometry);
+        }
 
-        Rhi::Buffer staging_buffer("scene_staging_buffer_vb",
-                                   m_device,
-                                   Rhi::BufferUsageEnum::TransferSrc,
-                                   Rhi::MemoryUsageEnum::CpuOnly,
-                                   vb_positions1.size() * sizeof(vb_positions1[0]));
-        Rhi::Buffer staging_buffer2("scene_staging_buffer_ib",
-                                    m_device,
-                                    Rhi::BufferUsageEnum::TransferSrc,
-                                    Rhi::MemoryUsageEnum::CpuOnly,
-                                    ib1.size() * sizeof(ib1[0]));
-        Rhi::Buffer staging_buffer3("scene_staging_buffer_vb_packed",
-                                    m_device,
-                                    Rhi::BufferUsageEnum::TransferSrc,
-                                    Rhi::MemoryUsageEnum::CpuOnly,
-                                    vb_packed1.size() * sizeof(vb_packed1[0]));
-
-        std::memcpy(staging_buffer.map(), vb_positions1.data(), vb_positions1.size() * sizeof(vb_positions1[0]));
-        std::memcpy(staging_buffer2.map(), ib1.data(), ib1.size() * sizeof(ib1[0]));
-        std::memcpy(staging_buffer3.map(), vb_packed1.data(), vb_packed1.size() * sizeof(vb_packed1[0]));
-        staging_buffer.unmap();
-        staging_buffer2.unmap();
-        staging_buffer3.unmap();
-
-        static_assert(Rhi::GetSizeInBytes(m_vbuf_position_type) == sizeof(vb_positions1[0]));
-        static_assert(Rhi::GetSizeInBytes(m_ibuf_index_type) == sizeof(ib1[0]));
-
-        cmd_buffer.begin();
-        cmd_buffer.copy_buffer_to_buffer(m_d_vbuf_position,
-                                         m_num_vertices * Rhi::GetSizeInBytes(m_vbuf_position_type),
-                                         staging_buffer,
-                                         0,
-                                         vb_positions1.size() * sizeof(vb_positions1[0]));
-        cmd_buffer.copy_buffer_to_buffer(m_d_ibuf,
-                                         m_num_indices * Rhi::GetSizeInBytes(m_ibuf_index_type),
-                                         staging_buffer2,
-                                         0,
-                                         ib1.size() * sizeof(ib1[0]));
-        cmd_buffer.copy_buffer_to_buffer(m_d_vbuf_packed,
-                                         m_num_vertices * sizeof(CompactVertex),
-                                         staging_buffer3,
-                                         0,
-                                         vb_packed1.size() * sizeof(vb_packed1[0]));
-        cmd_buffer.end();
-
-        Rhi::Fence tmp_fence("fence upload " + path.string(), m_device);
-        tmp_fence.reset();
-        cmd_buffer.submit(&tmp_fence);
-        tmp_fence.wait();
-
-        m_num_vertices += vb_positions1.size();
-        m_num_indices += ib1.size();
+        writer.m_positions        = std::move(positions);
+        writer.m_compact_vertices = std::move(compact_vertices);
+        writer.m_indices          = std::move(indices);
 
-        return geometries_range;
+        if (writer.write(cache_path))
+        {
+            Logger::Info(__FUNCTION__, " wrote scene cache ", cache_path.string());
+        }
+    }
+
+    // texture blob is either an encoded value or a texture id (see StandardMaterial)
+    static uint32_t
+    RemapTextureBlob(const uint32_t blob, const std::span<const size_t> & tex_ids)
+    {
+        if ((blob & (1 << 24)) != 0)
+        {
+            return blob;
+        }
+        return static_cast<uint32_t>(tex_ids[blob]);
     }
 
     size_t
@@ -420,6 +886,7 @@ struct SceneResource
         return result;
     }
 
+    // texture id is returned right away, the texture itself is decoded and uploaded by flush_pending_textures
     size_t
     add_texture(const std::filesystem::path & path, const size_t desired_channel)
     {
@@ -430,78 +897,175 @@ struct SceneResource
             return q->second;
         }
 
-        const std::string filepath_str = path.string();
+        PendingTexture pending_texture;
+        pending_texture.m_path            = path;
+        pending_texture.m_desired_channel = desired_channel;
+        return add_pending_texture(std::move(pending_texture));
+    }
 
-        // Load Raw image
-        int2 resolution;
-        stbi_set_flip_vertically_on_load(true);
-        void * image =
-            stbi_load(filepath_str.c_str(), &resolution.x, &resolution.y, nullptr, static_cast<int>(desired_channel));
-        assert(image);
-        std::byte * image_bytes = reinterpret_cast<std::byte *>(image);
-        assert(desired_channel == 4 || desired_channel == 1);
-        Rhi::FormatEnum format_enum =
-            desired_channel == 4 ? Rhi::FormatEnum::R8G8B8A8_UNorm_Srgb : Rhi::FormatEnum::R8_UNorm;
-
-        // Prepare texture
-        Rhi::Texture texture(filepath_str,
-                             m_device,
-                             Rhi::TextureCreateInfo(resolution.x, resolution.y, 1, 1, format_enum, Rhi::TextureUsageEnum::TransferDst),
-                             Rhi::TextureStateEnum::TransferDst);
-
-        // Calculate necessary sizes
-        const size_t size_in_bytes_per_row = resolution.x * EnumHelper::GetSizeInBytesPerPixel(format_enum);
-        const size_t aligned_size_in_bytes_per_row =
-            round_up(size_in_bytes_per_row, m_device.get_data_pitch_alignment());
-        const size_t aligned_size_in_bytes = resolution.y * aligned_size_in_bytes_per_row;
-
-        Rhi::CommandBuffer cmd_buffer = m_transfer_cmd_pool.get_command_buffer();
-        cmd_buffer.begin();
-
-        // Get staging buffer
-        Rhi::Buffer staging_buffer("scene_staging_buffer_material",
-                                   m_device,
-                                   Rhi::BufferUsageEnum::TransferSrc,
-                                   Rhi::MemoryUsageEnum::CpuOnly,
-                                   aligned_size_in_bytes);
-
-        // Copy from image_bytes to staging buffer
-        void *      mapped_result = staging_buffer.map();
-        std::byte * mapped_byte   = reinterpret_cast<std::byte *>(mapped_result);
-        for (int y = 0; y < resolution.y; y++)
-        {
-            std::memcpy(&mapped_byte[y * aligned_size_in_bytes_per_row],
-                        &image_bytes[y * size_in_bytes_per_row],
-                        size_in_bytes_per_row);
-        }
-        staging_buffer.unmap();
-
-        // Free raw image
-        stbi_image_free(image);
-
-        // Issue command buffer to copy to texture
-        cmd_buffer.copy_buffer_to_texture(texture, texture.m_resolution, uint3(0, 0, 0), staging_buffer, 0, aligned_size_in_bytes_per_row);
-        // cmd_buffer.transition_texture(texture, Rhi::TextureStateEnum::TransferDst, Rhi::TextureStateEnum::ReadOnly);
-
-        // submit and wait
-        Rhi::Fence fence("texture_upload_fence", m_device);
-        fence.reset();
-        cmd_buffer.end();
-        cmd_buffer.submit(&fence);
-        fence.wait();
-
-        // emplace back
-        m_d_textures.emplace_back(std::move(texture));
-        const size_t tex_id          = m_d_textures.size() - 1;
-        m_texture_id_from_path[path] = tex_id;
+    // same as add_texture but the texture is already baked, pixels must stay alive until flush_pending_textures
+    size_t
+    add_decoded_texture(const std::filesystem::path &      path,
+                        const int2                         resolution,
+                        const Rhi::FormatEnum              format_enum,
+                        const uint32_t                     num_levels,
+                        const std::span<const std::byte> & pixels)
+    {
+        PendingTexture pending_texture;
+        pending_texture.m_path            = path;
+        pending_texture.m_desired_channel = EnumHelper::GetNumChannels(format_enum);
+        pending_texture.m_resolution      = resolution;
+        pending_texture.m_format          = format_enum;
+        pending_texture.m_num_levels      = num_levels;
+        pending_texture.m_decoded_pixels  = pixels;
+        return add_pending_texture(std::move(pending_texture));
+    }
 
+    size_t
+    add_pending_texture(PendingTexture && pending_texture)
+    {
+        // textures are appended into m_d_textures in the order they are requested
+        const size_t tex_id = m_d_textures.size() + m_pending_textures.size();
+        m_texture_id_from_path[pending_texture.m_path] = tex_id;
+        m_texture_paths.push_back(pending_texture.m_path);
+        m_texture_num_channels.push_back(pending_texture.m_desired_channel);
+        m_pending_textures.emplace_back(std::move(pending_texture));
         return tex_id;
     }
 
+    // decode all pending textures on the thread pool and upload them through the staging ring
+    // rows of a texture are copied into the ring as soon as it is decoded, and the ring is flushed every
+    // TextureUploadBatchSize textures so their copies overlap with the remaining decodes
+    void
+    flush_pending_textures()
+    {
+        if (m_pending_textures.empty())
+        {
+            return;
+        }
+
+        StopWatch    stop_watch;
+        const size_t num_textures = m_pending_textures.size();
+
+        // kick off all decodes, results are consumed in request order while later ones are still decoding
+        std::vector<std::future<TextureImage>> decode_futures(num_textures);
+        for (size_t i_tex = 0; i_tex < num_textures; i_tex++)
+        {
+            const PendingTexture & pending_texture = m_pending_textures[i_tex];
+            if (pending_texture.m_decoded_pixels.empty())
+            {
+                decode_futures[i_tex] = ThreadPool::Get().submit(
+                    [path = pending_texture.m_path, desired_channel = pending_texture.m_desired_channel]()
+                    { return TextureBaker::Bake(path, desired_channel); });
+            }
+        }
+
+        for (size_t i_tex = 0; i_tex < num_textures; i_tex++)
+        {
+            // baked image, released once its rows are in the ring
+            PendingTexture & pending_texture = m_pending_textures[i_tex];
+            TextureImage     image;
+            if (decode_futures[i_tex].valid())
+            {
+                image                            = decode_futures[i_tex].get();
+                pending_texture.m_resolution     = image.m_resolution;
+                pending_texture.m_format         = image.m_format;
+                pending_texture.m_num_levels     = image.m_num_levels;
+                pending_texture.m_decoded_pixels = image.m_pixels;
+            }
+
+            Rhi::Texture texture(pending_texture.m_path.string(),
+                                 m_device,
+                                 Rhi::TextureCreateInfo(pending_texture.m_resolution.x,
+                                                        pending_texture.m_resolution.y,
+                                                        1,
+                                                        pending_texture.m_num_levels,
+                                                        pending_texture.m_format,
+                                                        Rhi::TextureUsageEnum::TransferDst),
+                                 Rhi::TextureStateEnum::TransferDst);
+
+            // every level starts at a placement aligned offset with pitch aligned rows, levels bigger than half of
+            // the ring are split into bands of rows
+            const uint32_t block_height = EnumHelper::IsBlockCompressed(pending_texture.m_format) ? 4 : 1;
+            const std::vector<TextureImageLevel> levels =
+                TextureImage::GetLevels(pending_texture.m_resolution, pending_texture.m_format, pending_texture.m_num_levels);
+            for (uint32_t i_level = 0; i_level < levels.size(); i_level++)
+            {
+                const TextureImageLevel & level              = levels[i_level];
+                const size_t              row_pitch_in_bytes = round_up(level.m_row_size_in_bytes, m_device.get_data_pitch_alignment());
+                const size_t max_num_band_rows = std::max(m_staging_ring.m_size_in_bytes / 2 / row_pitch_in_bytes, size_t(1));
+                for (size_t i_first_row = 0; i_first_row < level.m_num_rows; i_first_row += max_num_band_rows)
+                {
+                    const size_t                 num_rows   = std::min(level.m_num_rows - i_first_row, max_num_band_rows);
+                    Rhi::StagingRing::Allocation allocation = m_staging_ring.allocate(
+                        num_rows * row_pitch_in_bytes,
+                        static_cast<size_t>(m_device.get_data_placement_alignment()));
+
+                    // copy baked rows into staging memory in parallel
+                    const std::byte * src = pending_texture.m_decoded_pixels.data() + level.m_offset_in_bytes +
+                                            i_first_row * level.m_row_size_in_bytes;
+                    ThreadPool::Get().parallel_for(0,
+                                                   num_rows,
+                                                   [&](const size_t i_row)
+                                                   {
+                                                       std::memcpy(allocation.m_mapped + i_row * row_pitch_in_bytes,
+                                                                   src + i_row * level.m_row_size_in_bytes,
+                                                                   level.m_row_size_in_bytes);
+                                                   },
+                                                   MinNumTextureRowsPerTask);
+
+                    // the last band of a block compressed level may end inside a block
+                    const uint32_t y      = static_cast<uint32_t>(i_first_row) * block_height;
+                    const uint32_t height = std::min(static_cast<uint32_t>(num_rows) * block_height,
+                                                     static_cast<uint32_t>(level.m_resolution.y) - y);
+                    m_staging_ring.get_command_buffer().copy_buffer_to_texture(texture,
+                                                                               uint3(level.m_resolution.x, height, 1),
+                                                                               uint3(0, y, 0),
+                                                                               *allocation.m_buffer,
+                                                                               allocation.m_offset_in_bytes,
+                                                                               row_pitch_in_bytes,
+                                                                               i_level);
+                }
+            }
+            m_unreleased_uploads.m_texture_ids.push_back(m_d_textures.size());
+            m_d_textures.emplace_back(std::move(texture));
+
+            // keep the baked image if someone asks for it
+            if (m_decoded_texture_sink && !image.m_pixels.empty())
+            {
+                m_decoded_texture_sink->emplace(m_d_textures.size() - 1, std::move(image));
+            }
+
+            // submit without waiting, the ring waits only when it has to reuse memory of an earlier batch
+            if ((i_tex + 1) % EngineSetting::TextureUploadBatchSize == 0)
+            {
+                release_uploads();
+            }
+        }
+        release_uploads();
+        m_pending_textures.clear();
+
+        Logger::Info(__FUNCTION__, " uploaded ", num_textures, " textures in ", stop_watch.time_milli_sec(), " ms");
+    }
+
     void
     commit(const SceneDesc & scene_desc, Rhi::StagingBufferManager & staging_buffer_manager)
     {
-        // create blas for all base instance
+        // textures must exist before materials referencing them are used, and the blas builds on the graphics queue
+        // read geometries uploaded on the transfer queue. the graphics queue waits for them on the device, and the
+        // builds are submitted after that wait
+        flush_pending_textures();
+        {
+            m_graphics_cmd_pool.reset();
+            Rhi::CommandBuffer cmd_buffer = m_graphics_cmd_pool.get_command_buffer();
+            cmd_buffer.begin();
+            acquire_uploads(&cmd_buffer);
+            cmd_buffer.end();
+            cmd_buffer.submit(nullptr);
+        }
+
+        // blas builds of all base instances are recorded together, static ones are compacted before the tlas build
+        Rhi::RayTracingBlasBatch blas_batch;
         {
             std::vector<Rhi::RayTracingGeometryDesc> geom_descs;
             m_rt_blases.resize(m_base_instances.size());
@@ -528,14 +1092,20 @@ struct SceneResource
                         Rhi::RayTracingGeometryDesc geom_desc;
                         geom_desc.set_flag(Rhi::RayTracingGeometryFlag::Opaque);
                         geom_desc.set_index_buffer(m_d_ibuf,
-                                                   geometry.m_ibuf_base_index * Rhi::GetSizeInBytes(m_ibuf_index_type),
-                                                   m_ibuf_index_type,
+                                                   geometry.m_ibuf_base_index * sizeof(VertexIndexT),
+                                                   geometry.m_index_stride_in_words == 2 ? Rhi::IndexType::Uint32
+                                                                                         : Rhi::IndexType::Uint16,
                                                    geometry.m_num_indices);
                         geom_desc.set_vertex_buffer(m_d_vbuf_position,
                                                     geometry.m_vbuf_base_index * Rhi::GetSizeInBytes(m_vbuf_position_type),
                                                     m_vbuf_position_type,
                                                     Rhi::GetSizeInBytes(m_vbuf_position_type),
                                                     geometry.m_num_vertices);
+                        if constexpr (COMPACT_POSITION_QUANTIZED)
+                        {
+                            geom_desc.set_transform_matrix4x3(m_d_blas_geometry_transforms,
+                                                              geometry_id * sizeof(BlasGeometryTransform));
+                        }
                         geom_descs.push_back(geom_desc);
                     }
                 }
@@ -544,75 +1114,78 @@ struct SceneResource
                 Rhi::RayTracingBuildHint hint = is_updatable ? Rhi::RayTracingBuildHint::Deformable
                                                              : Rhi::RayTracingBuildHint::NonDeformable;
 
-                // build blas
-                m_rt_blases[i_binst] =
-                    Rhi::RayTracingBlas("blas_" + std::to_string(i_binst), m_device, geom_descs, hint, &staging_buffer_manager);
-                staging_buffer_manager.submit_all_pending_upload();
+                blas_batch.add(&m_rt_blases[i_binst], "blas_" + std::to_string(i_binst), m_device, geom_descs, hint);
             }
+            blas_batch.build("scene_blas_batch", m_device, &staging_buffer_manager);
+
+            // compacted sizes are known once the builds have executed
+            staging_buffer_manager.submit_all_pending_upload();
+            const size_t num_reclaimed_bytes = blas_batch.compact(m_device, &staging_buffer_manager);
+
+            // uncompacted blases are freed with blas_batch after the compaction copies have executed
+            staging_buffer_manager.submit_all_pending_upload();
+            Logger::Info(__FUNCTION__, " blas compaction reclaimed ", num_reclaimed_bytes / 1024, " KB");
         }
 
-        // TODO:: move tlas to async compute
-        // build tlas
+        // one instance leaf per scene instance, the tlas is built by the first update_tlas
         {
-            // populate instances list to be build tlas
-            std::vector<Rhi::RayTracingInstance> instances(scene_desc.m_instances.size());
-            for (size_t i_inst = 0; i_inst < scene_desc.m_instances.size(); i_inst++)
+            const size_t num_instances = scene_desc.m_instances.size();
+            m_instances                = scene_desc.m_instances;
+            m_rt_instances.resize(num_instances);
+            SceneGraphNodeDesc                root(false);
+            std::vector<SceneGraphNodeDesc> & instance_nodes = std::get<1>(root.m_info);
+            instance_nodes.resize(num_instances, SceneGraphNodeDesc(true));
+            for (size_t i_inst = 0; i_inst < num_instances; i_inst++)
             {
-                const size_t base_instance_id = scene_desc.m_instances[i_inst].m_base_instance_id;
-                const Rhi::RayTracingBlas & blas = m_rt_blases[base_instance_id];
-                instances[i_inst]                = Rhi::RayTracingInstance(blas,
-                                                            scene_desc.m_instances[i_inst].m_transform,
-                                                            scene_desc.m_instances[i_inst].m_hit_group_id,
-                                                            static_cast<uint32_t>(base_instance_id));
+                SceneGraphLeaf & leaf              = std::get<0>(instance_nodes[i_inst].m_info);
+                leaf.m_is_instance                 = true;
+                leaf.m_instance_id                 = static_cast<uint32_t>(i_inst);
+                instance_nodes[i_inst].m_transform = m_instances[i_inst].m_transform;
             }
 
-            // build tlas
-            m_rt_tlas = Rhi::RayTracingTlas("ray_tracing_tlas", m_device, instances, &staging_buffer_manager);
-            staging_buffer_manager.submit_all_pending_upload();
-        }
+            // the desc only describes the hierarchy, instances are addressed by their flat node index
+            m_scene_graph = FlatSceneGraph::Flatten(root);
+            m_instance_node_indices.resize(num_instances);
+            for (size_t i_leaf = 0; i_leaf < m_scene_graph.m_leaves.size(); i_leaf++)
+            {
+                const SceneGraphLeaf & leaf = m_scene_graph.m_leaves[i_leaf];
+                if (leaf.m_is_instance)
+                {
+                    m_instance_node_indices[leaf.m_instance_id] = m_scene_graph.m_leaf_node_indices[i_leaf];
+                }
+            }
 
-        Rhi::CommandBuffer cmd_buffer = m_transfer_cmd_pool.get_command_buffer();
-        cmd_buffer.begin();
-
-        // build material buffer
-        Rhi::Buffer material_staging_buffer("scene_material_staging_buffer_material",
-                                            m_device,
-                                            Rhi::BufferUsageEnum::TransferSrc,
-                                            Rhi::MemoryUsageEnum::CpuOnly,
-                                            m_h_materials.size() * sizeof(m_h_materials[0]));
-        {
-            std::memcpy(material_staging_buffer.map(),
-                        m_h_materials.data(),
-                        m_h_materials.size() * sizeof(m_h_materials[0]));
-            material_staging_buffer.unmap();
-            cmd_buffer.copy_buffer_to_buffer(m_d_materials,
-                                             0,
-                                             material_staging_buffer,
-                                             0,
-                                             m_h_materials.size() * sizeof(m_h_materials[0]));
-        }
-
-        // build emission buffer
-        Rhi::Buffer emission_staging_buffer("scene_staging_buffer_emission",
-                                            m_device,
-                                            Rhi::BufferUsageEnum::TransferSrc,
-                                            Rhi::MemoryUsageEnum::CpuOnly,
-                                            m_h_emissions.size() * sizeof(m_h_emissions[0]));
-        {
-            std::memcpy(emission_staging_buffer.map(),
-                        m_h_emissions.data(),
-                        m_h_emissions.size() * sizeof(m_h_emissions[0]));
-            emission_staging_buffer.unmap();
-            cmd_buffer.copy_buffer_to_buffer(m_d_emissions,
-                                             0,
-                                             emission_staging_buffer,
-                                             0,
-                                             m_h_emissions.size() * sizeof(m_h_emissions[0]));
+            // tlas builds submitted by update_tlas may still read the instances and write the tlases replaced below
+            m_tlas_timeline.wait(m_tlas_timeline_value);
+            if (m_mapped_rt_instances != nullptr)
+            {
+                m_d_rt_instances.unmap();
+            }
+            const size_t num_flights = m_flight_tlases.size();
+            m_d_rt_instances = Rhi::Buffer("scene_rt_instances",
+                                           m_device,
+                                           Rhi::BufferUsageEnum::RayTracingAccelStructBufferInput,
+                                           Rhi::MemoryUsageEnum::CpuToGpu,
+                                           sizeof(Rhi::RayTracingInstance) * std::max(num_instances, size_t(1)) * num_flights);
+            m_mapped_rt_instances = reinterpret_cast<Rhi::RayTracingInstance *>(m_d_rt_instances.map());
+            for (size_t i_flight = 0; i_flight < num_flights; i_flight++)
+            {
+                FlightTlas & flight_tlas = m_flight_tlases[i_flight];
+                flight_tlas.m_tlas       = Rhi::RayTracingTlas("ray_tracing_tlas_flight" + std::to_string(i_flight),
+                                                         m_device,
+                                                         static_cast<uint32_t>(num_instances));
+                flight_tlas.m_pending_instance_ids.clear();
+                flight_tlas.m_is_pending.assign(num_instances, false);
+                flight_tlas.m_is_built                  = false;
+                flight_tlas.m_num_refit_instance_writes = 0;
+            }
         }
 
+        // materials and emissions
+        upload_buffer(m_d_materials, 0, std::span<const StandardMaterial>(m_h_materials));
+        upload_buffer(m_d_emissions, 0, std::span<const StandardEmission>(m_h_emissions));
+
         // build mesh table
-        Rhi::Buffer staging_buffer2 = {};
-        Rhi::Buffer staging_buffer3 = {};
         {
             std::vector<GeometryTableEntry>     geometry_table;
             std::vector<BaseInstanceTableEntry> base_instance_table;
@@ -630,51 +1203,204 @@ struct SceneResource
                     {
                         const auto &       geometry = m_geometries[j];
                         GeometryTableEntry geometry_entry;
-                        geometry_entry.m_vertex_base_index = geometry.m_vbuf_base_index;
-                        geometry_entry.m_index_base_index  = geometry.m_ibuf_base_index;
-                        geometry_entry.m_material_index    = geometry.m_material_index;
-                        geometry_entry.m_emission_index    = geometry.m_emission_index;
+                        geometry_entry.m_vertex_base_index     = geometry.m_vbuf_base_index;
+                        geometry_entry.m_index_base_index      = geometry.m_ibuf_base_index;
+                        geometry_entry.m_material_index        = geometry.m_material_index;
+                        geometry_entry.m_emission_index        = geometry.m_emission_index;
+                        geometry_entry.m_index_stride_in_words = geometry.m_index_stride_in_words;
+                        geometry_entry.m_texcoord_offset       = geometry.m_texcoord_offset;
+                        geometry_entry.m_texcoord_scale        = geometry.m_texcoord_scale;
+#if COMPACT_POSITION_QUANTIZED
+                        geometry_entry.m_position_offset = geometry.m_position_offset;
+                        geometry_entry.m_position_scale  = geometry.m_position_scale;
+#endif
                         geometry_table.push_back(geometry_entry);
                     }
                 }
             }
 
-            staging_buffer2 = Rhi::Buffer("scene_staging_buffer_geometry_table",
-                                          m_device,
-                                          Rhi::BufferUsageEnum::TransferSrc,
-                                          Rhi::MemoryUsageEnum::CpuOnly,
-                                          sizeof(GeometryTableEntry) * geometry_table.size());
-            staging_buffer3 = Rhi::Buffer("scene_staging_buffer_base_instance",
-                                          m_device,
-                                          Rhi::BufferUsageEnum::TransferSrc,
-                                          Rhi::MemoryUsageEnum::CpuOnly,
-                                          sizeof(BaseInstanceTableEntry) * base_instance_table.size());
-            std::memcpy(staging_buffer2.map(),
-                        geometry_table.data(),
-                        geometry_table.size() * sizeof(geometry_table[0]));
-            std::memcpy(staging_buffer3.map(),
-                        base_instance_table.data(),
-                        base_instance_table.size() * sizeof(base_instance_table[0]));
-            staging_buffer2.unmap();
-            staging_buffer3.unmap();
-            cmd_buffer.copy_buffer_to_buffer(m_d_geometry_table,
-                                             0,
-                                             staging_buffer2,
-                                             0,
-                                             sizeof(GeometryTableEntry) * geometry_table.size());
-            cmd_buffer.copy_buffer_to_buffer(m_d_base_instance_table,
-                                             0,
-                                             staging_buffer3,
-                                             0,
-                                             sizeof(BaseInstanceTableEntry) * base_instance_table.size());
+            upload_buffer(m_d_geometry_table, 0, std::span<const GeometryTableEntry>(geometry_table));
+            upload_buffer(m_d_base_instance_table, 0, std::span<const BaseInstanceTableEntry>(base_instance_table));
             m_num_base_instance_table_entries = base_instance_table.size();
             m_num_geometry_table_entries      = geometry_table.size();
         }
-        cmd_buffer.end();
 
-        Rhi::Fence fence("scene_commit_fence", m_device);
-        fence.reset();
-        cmd_buffer.submit(&fence);
-        fence.wait();
+        // rendering reads the tables on the graphics queue, the first frame acquires them
+        release_uploads();
+
+        // tlases are recreated, descriptors written before this point are stale
+        m_descriptor_version++;
+    }
+
+    // copies dst_buffer out of the staging ring and remembers the range for the next release_uploads
+    template <typename T>
+    void
+    upload_buffer(const Rhi::Buffer & dst_buffer, const size_t dst_offset_in_bytes, const std::span<const T> & data)
+    {
+        if (data.empty())
+        {
+            return;
+        }
+        m_staging_ring.upload_buffer(dst_buffer, dst_offset_in_bytes, data);
+        m_unreleased_uploads.m_buffer_ranges.push_back({ &dst_buffer, dst_offset_in_bytes, data.size_bytes() });
+    }
+
+    // releases everything uploaded since the last call from the transfer queue and submits it without waiting.
+    // the resources are usable on the graphics queue after the next acquire_uploads
+    void
+    release_uploads()
+    {
+        const Rhi::QueueType src_queue_type = m_staging_ring.m_queue_type;
+        if (!m_unreleased_uploads.m_buffer_ranges.empty() || !m_unreleased_uploads.m_texture_ids.empty())
+        {
+            Rhi::CommandBuffer & cmd_buffer = m_staging_ring.get_command_buffer();
+            for (const UploadedBufferRange & range : m_unreleased_uploads.m_buffer_ranges)
+            {
+                cmd_buffer.transfer_buffer_ownership(m_device,
+                                                     *range.m_buffer,
+                                                     range.m_offset_in_bytes,
+                                                     range.m_size_in_bytes,
+                                                     src_queue_type,
+                                                     Rhi::QueueType::Graphics,
+                                                     true);
+            }
+            for (const size_t tex_id : m_unreleased_uploads.m_texture_ids)
+            {
+                cmd_buffer.transfer_texture_ownership(m_device,
+                                                      m_d_textures[tex_id],
+                                                      Rhi::TextureStateEnum::TransferDst,
+                                                      Rhi::TextureStateEnum::ReadOnly,
+                                                      src_queue_type,
+                                                      Rhi::QueueType::Graphics,
+                                                      true);
+            }
+        }
+        const uint64_t timeline_value = m_staging_ring.flush();
+
+        m_unacquired_uploads.m_buffer_ranges.insert(m_unacquired_uploads.m_buffer_ranges.end(),
+                                                    m_unreleased_uploads.m_buffer_ranges.begin(),
+                                                    m_unreleased_uploads.m_buffer_ranges.end());
+        m_unacquired_uploads.m_texture_ids.insert(m_unacquired_uploads.m_texture_ids.end(),
+                                                  m_unreleased_uploads.m_texture_ids.begin(),
+                                                  m_unreleased_uploads.m_texture_ids.end());
+        m_unacquired_uploads.m_timeline_value = std::max(m_unacquired_uploads.m_timeline_value, timeline_value);
+        m_unreleased_uploads.m_buffer_ranges.clear();
+        m_unreleased_uploads.m_texture_ids.clear();
+    }
+
+    // records the acquires of released uploads into a graphics queue command buffer, whose submit waits for the
+    // transfer queue on the device. called every frame so uploads stream in without stalling the host
+    void
+    acquire_uploads(Rhi::CommandBuffer * cmd_buffer)
+    {
+        m_staging_ring.retire_signaled();
+        if (m_unacquired_uploads.m_buffer_ranges.empty() && m_unacquired_uploads.m_texture_ids.empty())
+        {
+            return;
+        }
+
+        const Rhi::QueueType src_queue_type = m_staging_ring.m_queue_type;
+        for (const UploadedBufferRange & range : m_unacquired_uploads.m_buffer_ranges)
+        {
+            cmd_buffer->transfer_buffer_ownership(m_device,
+                                                  *range.m_buffer,
+                                                  range.m_offset_in_bytes,
+                                                  range.m_size_in_bytes,
+                                                  src_queue_type,
+                                                  Rhi::QueueType::Graphics,
+                                                  false);
+        }
+        for (const size_t tex_id : m_unacquired_uploads.m_texture_ids)
+        {
+            cmd_buffer->transfer_texture_ownership(m_device,
+                                                   m_d_textures[tex_id],
+                                                   Rhi::TextureStateEnum::TransferDst,
+                                                   Rhi::TextureStateEnum::ReadOnly,
+                                                   src_queue_type,
+                                                   Rhi::QueueType::Graphics,
+                                                   false);
+        }
+        cmd_buffer->wait_timeline_semaphore(m_staging_ring.m_timeline, m_unacquired_uploads.m_timeline_value);
+
+        m_unacquired_uploads.m_buffer_ranges.clear();
+        m_unacquired_uploads.m_texture_ids.clear();
+    }
+
+    // moves a committed instance, the tlas picks it up in the next update_tlas
+    void
+    set_instance_transform(const size_t i_inst, const float4x4 & transform)
+    {
+        m_scene_graph.set_transform(m_instance_node_indices[i_inst], transform);
+    }
+
+    // writes instances under dirty scene graph nodes into the instance region of this flight, then refits the tlas
+    // of this flight, or rebuilds it once refits have moved too many instances since its last rebuild. the build is
+    // submitted right away on the compute queue and the next submit of graphics_cmd_buffer waits for it on the device
+    void
+    update_tlas(Rhi::CommandPool & compute_cmd_pool, Rhi::CommandBuffer * graphics_cmd_buffer, const size_t i_flight)
+    {
+        m_scene_graph.update_dirty_transforms(
+            [&](const SceneGraphLeaf & leaf)
+            {
+                const uint32_t        instance_id = leaf.m_instance_id;
+                const SceneInstance & instance    = m_instances[instance_id];
+                m_rt_instances[instance_id]       = Rhi::RayTracingInstance(m_rt_blases[instance.m_base_instance_id],
+                                                                      leaf.m_total_transform,
+                                                                      instance.m_hit_group_id,
+                                                                      instance.m_base_instance_id);
+                for (FlightTlas & flight_tlas : m_flight_tlases)
+                {
+                    if (!flight_tlas.m_is_pending[instance_id])
+                    {
+                        flight_tlas.m_is_pending[instance_id] = true;
+                        flight_tlas.m_pending_instance_ids.push_back(instance_id);
+                    }
+                }
+            });
+
+        // catch this flight up, including changes made while the other flights were recorded
+        const size_t              num_instances       = m_rt_instances.size();
+        Rhi::RayTracingInstance * mapped_instances    = m_mapped_rt_instances + i_flight * num_instances;
+        FlightTlas &              flight_tlas         = m_flight_tlases[i_flight];
+        const size_t              num_dirty_instances = flight_tlas.m_pending_instance_ids.size();
+        for (const uint32_t instance_id : flight_tlas.m_pending_instance_ids)
+        {
+            mapped_instances[instance_id]         = m_rt_instances[instance_id];
+            flight_tlas.m_is_pending[instance_id] = false;
+        }
+        flight_tlas.m_pending_instance_ids.clear();
+
+        if (num_instances == 0 || (flight_tlas.m_is_built && num_dirty_instances == 0))
+        {
+            return;
+        }
+
+        flight_tlas.m_num_refit_instance_writes += num_dirty_instances;
+        const bool is_refit = flight_tlas.m_is_built && static_cast<float>(flight_tlas.m_num_refit_instance_writes) <=
+                                                            EngineSetting::TlasRebuildRatio * static_cast<float>(num_instances);
+        if (!is_refit)
+        {
+            flight_tlas.m_num_refit_instance_writes = 0;
+        }
+
+        // the graphics queue finished with this flight before the host got here, so only the build needs waiting for
+        Rhi::CommandBuffer compute_cmd_buffer = compute_cmd_pool.get_command_buffer();
+        compute_cmd_buffer.begin();
+        compute_cmd_buffer.build_tlas(flight_tlas.m_tlas,
+                                      m_d_rt_instances,
+                                      i_flight * num_instances * sizeof(Rhi::RayTracingInstance),
+                                      static_cast<uint32_t>(num_instances),
+                                      is_refit);
+        compute_cmd_buffer.end();
+        compute_cmd_buffer.signal_timeline_semaphore(m_tlas_timeline, ++m_tlas_timeline_value);
+        compute_cmd_buffer.submit(nullptr);
+        graphics_cmd_buffer->wait_timeline_semaphore(m_tlas_timeline, m_tlas_timeline_value);
+        flight_tlas.m_is_built = true;
+    }
+
+    const Rhi::RayTracingTlas &
+    get_tlas(const size_t i_flight) const
+    {
+        return m_flight_tlases[i_flight].m_tlas;
     }
 };
\ No newline at end of file
@@ -1,8 +1,15 @@
 #ifndef SHADER_H
 #define SHADER_H
 
+// guarded since c++ headers may already provide them when these headers are compiled on the cpu
+#ifndef M_PI
 #define M_PI 3.1415926535897932384626433832795
+#endif
+#ifndef M_1_PI
 #define M_1_PI 0.31830988618
+#endif
+#ifndef UINT32_MAX
 #define UINT32_MAX 4294967295u
+#endif
 
 #endif
@@ -165,4 +165,33 @@ struct RWStructuredBuffer : public RegisterBase
 
     #define REGISTER(SPACE, VARIABLE_NAME, TYPE, BINDING) \
         VARIABLE_NAME = { BINDING, SPACE, 1, this };
-#endif
\ No newline at end of file
+#endif
+
+// unit vector to 2 x snorm16 through the octahedral mapping of Cigolle et al. 2014, "A Survey of Efficient
+// Representations for Independent Unit Vectors"
+inline uint32_t
+encode_octahedral_snorm16x2(const float3 n)
+{
+    float2 p = float2(n.x, n.y) / (abs(n.x) + abs(n.y) + abs(n.z));
+    if (n.z < 0.0f)
+    {
+        const float2 folded = 1.0f - abs(float2(p.y, p.x));
+        p.x                 = p.x >= 0.0f ? folded.x : -folded.x;
+        p.y                 = p.y >= 0.0f ? folded.y : -folded.y;
+    }
+    const int2 q = int2(round(clamp(p, -1.0f, 1.0f) * 32767.0f));
+    return (uint32_t(q.x) & 0xffff) | (uint32_t(q.y) << 16);
+}
+
+inline float3
+decode_octahedral_snorm16x2(const uint32_t v)
+{
+    // sign extends both halves
+    const int2   q = int2(int(v << 16) >> 16, int(v) >> 16);
+    const float2 p = max(float2(q) / 32767.0f, -1.0f);
+    float3       n = float3(p.x, p.y, 1.0f - abs(p.x) - abs(p.y));
+    const float  t = max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
@@ -1,9 +1,39 @@
-#include "common/mapping.h"
-#include "common/onb.h"
 #include "cpp_compatible.h"
+#include "path_tracing_hit.h"
 #include "path_tracing_params.h"
 #include "rng/pcg.h"
 
+float3
+FetchPosition(const uint index, const GeometryTableEntry geometry_entry)
+{
+#if COMPACT_POSITION_QUANTIZED
+    return u_positions[index].get_position(geometry_entry.m_position_offset, geometry_entry.m_position_scale);
+#else
+    return u_positions[index].get_position(0.0f.xxx, 0.0f.xxx);
+#endif
+}
+
+uint
+FetchIndex(const uint i_index, const GeometryTableEntry geometry_entry)
+{
+    const uint word = geometry_entry.get_index_word(i_index);
+    if (geometry_entry.m_index_stride_in_words == 1)
+    {
+        return u_indices[word];
+    }
+    return uint(u_indices[word]) | (uint(u_indices[word + 1]) << 16);
+}
+
+// texture lod from the base lod of a ray cone (Ray Tracing Gems, chapter 20)
+float4
+SampleTextureRayCone(const uint tex_id, const float2 texcoord, const float base_lod)
+{
+    uint width;
+    uint height;
+    u_textures[tex_id].GetDimensions(width, height);
+    return u_textures[tex_id].SampleLevel(u_sampler, texcoord, base_lod + 0.5f * log2(float(width * height)));
+}
+
 RAY_GEN_SHADER
 void
 RayGen()
@@ -88,9 +118,9 @@ ClosestHit(INOUT(PathTracingPayload) payload, const PathTracingAttributes attrib
     const GeometryTableEntry geometry_entry  = u_geometry_table[geometry_offset];
 
     // Index into subbuffer
-    const uint index0 = u_indices[PrimitiveIndex() * 3 + geometry_entry.m_index_base_index];
-    const uint index1 = u_indices[PrimitiveIndex() * 3 + geometry_entry.m_index_base_index + 1];
-    const uint index2 = u_indices[PrimitiveIndex() * 3 + geometry_entry.m_index_base_index + 2];
+    const uint index0 = FetchIndex(PrimitiveIndex() * 3, geometry_entry);
+    const uint index1 = FetchIndex(PrimitiveIndex() * 3 + 1, geometry_entry);
+    const uint index2 = FetchIndex(PrimitiveIndex() * 3 + 2, geometry_entry);
 
     // Shading Normal & Texcoord
     const CompactVertex cv0 = u_compact_vertices[index0 + geometry_entry.m_vertex_base_index];
@@ -98,11 +128,7 @@ ClosestHit(INOUT(PathTracingPayload) payload, const PathTracingAttributes attrib
     const CompactVertex cv2 = u_compact_vertices[index2 + geometry_entry.m_vertex_base_index];
 
     // Interpolate Shading Normal
-    const float3 snormal0 = cv0.get_snormal();
-    const float3 snormal1 = cv1.get_snormal();
-    const float3 snormal2 = cv2.get_snormal();
-    float3       snormal  = normalize(snormal0 * (1.0f - barycentric.x - barycentric.y) +
-                               snormal1 * barycentric.x + snormal2 * barycentric.y);
+    const float3 snormal = InterpolateShadingNormal(cv0, cv1, cv2, barycentric);
 
     if (payload.m_is_first_bounce)
     {
@@ -112,12 +138,28 @@ ClosestHit(INOUT(PathTracingPayload) payload, const PathTracingAttributes attrib
     }
 
     // Interpolate Texcoord
-    const float2 texcoord0 = cv0.m_texcoord;
-    const float2 texcoord1 = cv1.m_texcoord;
-    const float2 texcoord2 = cv2.m_texcoord;
+    const float2 texcoord0 = cv0.get_texcoord(geometry_entry.m_texcoord_offset, geometry_entry.m_texcoord_scale);
+    const float2 texcoord1 = cv1.get_texcoord(geometry_entry.m_texcoord_offset, geometry_entry.m_texcoord_scale);
+    const float2 texcoord2 = cv2.get_texcoord(geometry_entry.m_texcoord_offset, geometry_entry.m_texcoord_scale);
     const float2 texcoord  = texcoord0 * (1.0f - barycentric.x - barycentric.y) +
                             texcoord1 * barycentric.x + texcoord2 * barycentric.y;
 
+    // Texture Lod
+    // only primary rays reach here, so the ray cone starts at the camera with the pixel spread angle
+    const float3 position0   = FetchPosition(index0 + geometry_entry.m_vertex_base_index, geometry_entry);
+    const float3 position1   = FetchPosition(index1 + geometry_entry.m_vertex_base_index, geometry_entry);
+    const float3 position2   = FetchPosition(index2 + geometry_entry.m_vertex_base_index, geometry_entry);
+    const float3 world_edge1 = mul(ObjectToWorld3x4(), float4(position1 - position0, 0.0f));
+    const float3 world_edge2 = mul(ObjectToWorld3x4(), float4(position2 - position0, 0.0f));
+    const float3 world_cross = cross(world_edge1, world_edge2);
+    const float  world_area  = max(length(world_cross), 1e-10f);
+    const float2 uv_edge1    = texcoord1 - texcoord0;
+    const float2 uv_edge2    = texcoord2 - texcoord0;
+    const float  uv_area     = max(abs(uv_edge1.x * uv_edge2.y - uv_edge2.x * uv_edge1.y), 1e-10f);
+    const float  cos_theta   = max(abs(dot(world_cross / world_area, WorldRayDirection())), 1e-4f);
+    const float  cone_width  = u_params.m_pixel_spread_angle * RayTCurrent();
+    const float  base_lod    = 0.5f * log2(uv_area / world_area) + log2(cone_width / cos_theta);
+
     // TODO:: Add material graph evaluation here
 
     float3 diffuse_reflectance;
@@ -137,14 +179,14 @@ ClosestHit(INOUT(PathTracingPayload) payload, const PathTracingAttributes attrib
         // Material Reflectance / Roughness
         diffuse_reflectance =
             mat.has_diffuse_texture()
-                ? u_textures[mat.m_diffuse_tex_id].SampleLevel(u_sampler, texcoord, 0).rgb
+                ? SampleTextureRayCone(mat.m_diffuse_tex_id, texcoord, base_lod).rgb
                 : mat.decode_rgb(mat.m_diffuse_tex_id);
         specular_reflectance =
             mat.has_specular_texture()
-                ? u_textures[mat.m_specular_tex_id].SampleLevel(u_sampler, texcoord, 0).rgb
+                ? SampleTextureRayCone(mat.m_specular_tex_id, texcoord, base_lod).rgb
                 : mat.decode_rgb(mat.m_specular_tex_id);
         roughness = mat.has_roughness_texture()
-                        ? u_textures[mat.m_roughness_tex_id].SampleLevel(u_sampler, texcoord, 0).r
+                        ? SampleTextureRayCone(mat.m_roughness_tex_id, texcoord, base_lod).r
                         : mat.decode_rgb(mat.m_roughness_tex_id).r;
     }
 
@@ -166,17 +208,12 @@ ClosestHit(INOUT(PathTracingPayload) payload, const PathTracingAttributes attrib
         const StandardEmission emissive_mat = u_emissions[geometry_entry.m_emission_index];
         emission =
             emissive_mat.is_emission_texture()
-                ? u_textures[emissive_mat.m_emission_tex_id].SampleLevel(u_sampler, texcoord, 0).rgb
+                ? SampleTextureRayCone(emissive_mat.m_emission_tex_id, texcoord, base_lod).rgb
                 : emissive_mat.decode_rgb(emissive_mat.m_emission_tex_id);
     }
 
-    // Construct Orthonormal basis
-    const float3 dir_to_hit_pos = WorldRayDirection();
-    snormal                     = faceforward(snormal, dir_to_hit_pos, snormal);
-    Onb snormal_onb             = Onb_create(snormal);
-
     // Sample the next direction
-    payload.m_next_dir = snormal_onb.to_global(cosine_hemisphere_from_square(payload.m_rnd2));
+    payload.m_next_dir = SampleNextDirection(snormal, WorldRayDirection(), payload.m_rnd2);
     payload.m_t        = RayTCurrent();
 }
 
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "common/mapping.h"
+#include "common/onb.h"
+#include "cpp_compatible.h"
+#include "shared/compact_vertex.h"
+
+// shading math of ClosestHit in path_tracing.hlsl.h, shared with the cpu reference path tracer so both follow the same
+// paths. buffers and textures are fetched by each side on its own
+
+// shading normal of the hit point, interpolated over the triangle
+float3
+InterpolateShadingNormal(const CompactVertex cv0, const CompactVertex cv1, const CompactVertex cv2, const float2 barycentric)
+{
+    const float3 snormal0 = cv0.get_snormal();
+    const float3 snormal1 = cv1.get_snormal();
+    const float3 snormal2 = cv2.get_snormal();
+    return normalize(snormal0 * (1.0f - barycentric.x - barycentric.y) + snormal1 * barycentric.x +
+                     snormal2 * barycentric.y);
+}
+
+// cosine distributed around the shading normal, which is turned to face the ray first
+float3
+SampleNextDirection(const float3 snormal, const float3 ray_direction, const float2 rnd2)
+{
+    const float3 facing_snormal = faceforward(snormal, ray_direction, snormal);
+    Onb          snormal_onb    = Onb_create(facing_snormal);
+    return snormal_onb.to_global(cosine_hemisphere_from_square(rnd2));
+}
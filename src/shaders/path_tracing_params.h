@@ -3,6 +3,7 @@
 #include "cpp_compatible.h"
 #include "shared/bindless_table.h"
 #include "shared/camera_params.h"
+#include "shared/compact_position.h"
 #include "shared/compact_vertex.h"
 #include "shared/standard_emission.h"
 #include "shared/standard_material.h"
@@ -13,6 +14,8 @@ struct PathTracingCbParams
     float4x4 m_camera_inv_proj;
     uint32_t m_radiance_miss_shader_index;
     uint32_t m_shadow_miss_shader_index;
+    // angle between rays of neighboring pixels, used to pick texture lods
+    float    m_pixel_spread_angle;
 };
 
 struct RAY_PAYLOAD PathTracingPayload
@@ -56,5 +59,6 @@ StructuredBuffer<uint16_t>               REGISTER(1, u_indices, t, 3);
 StructuredBuffer<CompactVertex>          REGISTER(1, u_compact_vertices, t, 4);
 StructuredBuffer<StandardMaterial>       REGISTER(1, u_materials, t, 5);
 StructuredBuffer<StandardEmission>       REGISTER(1, u_emissions, t, 6);
-Texture2D<float4>                        REGISTER_ARRAY(1, u_textures, 100, t, 7);
+StructuredBuffer<CompactPosition>        REGISTER(1, u_positions, t, 7);
+Texture2D<float4>                        REGISTER_ARRAY(1, u_textures, 100, t, 8);
 REGISTER_WRAP_END
\ No newline at end of file
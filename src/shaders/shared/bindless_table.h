@@ -1,6 +1,7 @@
 #ifndef BINDLESS_TABLE_H
 #define BINDLESS_TABLE_H
 
+#include "compact_position.h"
 #include "types.h"
 
 // In bindless rendering, InstanceId, GeometryId and PrimitiveId are provided.
@@ -18,8 +19,33 @@ struct GeometryTableEntry
     uint32_t m_index_base_index;
     uint32_t m_material_index;
     uint32_t m_emission_index;
+    // 1 for 16 bit indices, 2 for 32 bit indices
+    uint32_t m_index_stride_in_words;
+    // texcoord range of the geometry, see CompactVertex::get_texcoord
+    float2 m_texcoord_offset;
+    float2 m_texcoord_scale;
+#if COMPACT_POSITION_QUANTIZED
+    // bounding box of the geometry, see CompactPosition::get_position
+    float3 m_position_offset;
+    float3 m_position_scale;
+#endif
+
+    // position of the first word of an index of the geometry in the index buffer
+    uint32_t
+    get_index_word(const uint32_t i_index) CONST_FUNC
+    {
+        return m_index_base_index + i_index * m_index_stride_in_words;
+    }
 };
 
+#ifdef __cplusplus
+    #if COMPACT_POSITION_QUANTIZED
+static_assert(sizeof(GeometryTableEntry) == 60);
+    #else
+static_assert(sizeof(GeometryTableEntry) == 36);
+    #endif
+#endif
+
 struct BaseInstanceTableEntry
 {
     uint16_t m_geometry_table_index_base;
@@ -0,0 +1,55 @@
+#ifndef COMPACT_POSITION_H
+#define COMPACT_POSITION_H
+
+#include "../cpp_compatible.h"
+
+// 1 : xyz as 3 x snorm16 within the bounding box of the geometry and a padding snorm16, 8 bytes. the blas undoes the
+//     quantization through the geometry transform, shaders through the GeometryTableEntry
+// 0 : float3, 12 bytes
+// host and shaders both include this header, so they always agree on the layout
+#ifndef COMPACT_POSITION_QUANTIZED
+    #define COMPACT_POSITION_QUANTIZED 0
+#endif
+
+struct CompactPosition
+{
+#if COMPACT_POSITION_QUANTIZED
+    uint32_t m_xy;
+    uint32_t m_z;
+#else
+    float m_x;
+    float m_y;
+    float m_z;
+#endif
+
+    // position_offset and position_scale are the center and the half extent of the bounding box of the geometry
+    void
+    set_position(const float3 position, const float3 position_offset, const float3 position_scale)
+    {
+#if COMPACT_POSITION_QUANTIZED
+        const float3 scaled = float3(position_scale.x > 0.0f ? (position.x - position_offset.x) / position_scale.x : 0.0f,
+                                     position_scale.y > 0.0f ? (position.y - position_offset.y) / position_scale.y : 0.0f,
+                                     position_scale.z > 0.0f ? (position.z - position_offset.z) / position_scale.z : 0.0f);
+        const int3   snorm  = int3(round(clamp(scaled, -1.0f, 1.0f) * 32767.0f));
+        m_xy                = (uint32_t(snorm.x) & 0xffff) | (uint32_t(snorm.y) << 16);
+        m_z                 = uint32_t(snorm.z) & 0xffff;
+#else
+        m_x = position.x;
+        m_y = position.y;
+        m_z = position.z;
+#endif
+    }
+
+    float3
+    get_position(const float3 position_offset, const float3 position_scale) CONST_FUNC
+    {
+#if COMPACT_POSITION_QUANTIZED
+        const int3 snorm = int3(int(m_xy << 16) >> 16, int(m_xy) >> 16, int(m_z << 16) >> 16);
+        return position_offset + float3(snorm) / 32767.0f * position_scale;
+#else
+        return float3(m_x, m_y, m_z);
+#endif
+    }
+};
+
+#endif // COMPACT_POSITION_H
@@ -1,10 +1,24 @@
 #ifndef COMPACT_VERTEX_H
 #define COMPACT_VERTEX_H
 
+#include "../cpp_compatible.h"
+
+// 1 : octahedral normal in 32 bits and texcoords as 2 x unorm16 within the texcoord range of the geometry, 8 bytes
+// 0 : float3 normal and float2 texcoord, 20 bytes
+// host and shaders both include this header, so they always agree on the layout
+#ifndef COMPACT_VERTEX_COMPRESSED
+    #define COMPACT_VERTEX_COMPRESSED 1
+#endif
+
 struct CompactVertex
 {
+#if COMPACT_VERTEX_COMPRESSED
+    uint32_t m_snormal;
+    uint32_t m_texcoord;
+#else
     float3 m_snormal;
     float2 m_texcoord;
+#endif
 
     void
     set_snormal(const float3 snormal)
@@ -12,15 +26,48 @@ struct CompactVertex
 #ifdef __cplusplus
         assert(abs(1.0f - length(snormal)) <= 0.001f);
 #endif
+#if COMPACT_VERTEX_COMPRESSED
+        m_snormal = encode_octahedral_snorm16x2(snormal);
+#else
         m_snormal.x = snormal.x;
         m_snormal.y = snormal.y;
         m_snormal.z = snormal.z;
+#endif
     }
 
     float3
-    get_snormal()
+    get_snormal() CONST_FUNC
     {
+#if COMPACT_VERTEX_COMPRESSED
+        return decode_octahedral_snorm16x2(m_snormal);
+#else
         return float3(m_snormal.x, m_snormal.y, m_snormal.z);
+#endif
+    }
+
+    // texcoord_offset and texcoord_scale come from the GeometryTableEntry, a texcoord is
+    // offset + scale * (0 .. 65535)
+    void
+    set_texcoord(const float2 texcoord, const float2 texcoord_offset, const float2 texcoord_scale)
+    {
+#if COMPACT_VERTEX_COMPRESSED
+        const float u = texcoord_scale.x > 0.0f ? (texcoord.x - texcoord_offset.x) / texcoord_scale.x : 0.0f;
+        const float v = texcoord_scale.y > 0.0f ? (texcoord.y - texcoord_offset.y) / texcoord_scale.y : 0.0f;
+        m_texcoord    = uint32_t(round(clamp(u, 0.0f, 65535.0f))) | (uint32_t(round(clamp(v, 0.0f, 65535.0f))) << 16);
+#else
+        m_texcoord.x = texcoord.x;
+        m_texcoord.y = texcoord.y;
+#endif
+    }
+
+    float2
+    get_texcoord(const float2 texcoord_offset, const float2 texcoord_scale) CONST_FUNC
+    {
+#if COMPACT_VERTEX_COMPRESSED
+        return texcoord_offset + float2(m_texcoord & 0xffff, m_texcoord >> 16) * texcoord_scale;
+#else
+        return float2(m_texcoord.x, m_texcoord.y);
+#endif
     }
 };
 
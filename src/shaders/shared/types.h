@@ -3,6 +3,8 @@
 typedef uint32_t TextureSizeT;
 typedef uint32_t MaterialSizeT;
 typedef uint32_t BufferSizeT;
+// the index buffer is an array of 16 bit words. a geometry has either 16 bit indices of one word each, or 32 bit
+// indices of two words each with the low word first (see GeometryTableEntry::m_index_stride_in_words)
 typedef uint16_t VertexIndexT;
 
 #endif // TYPE_H
\ No newline at end of file
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "benchmark_util.h"
+#include "core/logger.h"
+#include "core/thread_pool.h"
+#include "importer/ai_mesh_importer.h"
+#include "pch/pch.h"
+
+// mesh splitting timings of the serial splitter that tracked used vertices in a std::set against the epoch stamped
+// splitter, run serially and on the thread pool, on sponza and on a synthetic mesh of about 10M faces. every splitter
+// must produce the same geometry infos. the serial std::set splitter is kept here as the reference.
+struct SplitBenchmark
+{
+    using aiFaceRange   = AiScene::aiFaceRange;
+    using aiFaceSizeT   = AiScene::aiFaceSizeT;
+    using aiMeshSizeT   = AiScene::aiMeshSizeT;
+    using aiVertexSizeT = AiScene::aiVertexSizeT;
+
+    static void
+    Run()
+    {
+        std::optional<AiScene> sponza = AiScene::ReadScene("scenes/sponza/sponza.obj");
+        if (sponza.has_value())
+        {
+            RunScene("sponza", sponza.value());
+        }
+        else
+        {
+            Logger::Warn(__FUNCTION__, " scenes/sponza/sponza.obj could not be read");
+        }
+
+        aiScene ai_scene;
+        BenchmarkUtil::ConstructGridScene(&ai_scene, BenchmarkUtil::LargeGridSize);
+        AiScene grid;
+        grid.m_ai_scene = &ai_scene;
+        RunScene("grid", grid);
+    }
+
+private:
+    static void
+    RunScene(const std::string & name, const AiScene & scene)
+    {
+        // the std::set splitter only knew 16 bit indices
+        AiIndexPolicy index_policy;
+        index_policy.m_max_num_vertices_per_16bit_geometry = std::numeric_limits<VertexIndexT>::max();
+        index_policy.m_is_32bit_index_allowed              = false;
+
+        size_t num_faces = 0;
+        for (aiMeshSizeT i_mesh = 0; i_mesh < scene.m_ai_scene->mNumMeshes; i_mesh++)
+        {
+            num_faces += scene.m_ai_scene->mMeshes[i_mesh]->mNumFaces;
+        }
+
+        std::vector<AiGeometryInfo> set_geometry_infos;
+        std::vector<AiGeometryInfo> epoch_geometry_infos;
+        std::vector<AiGeometryInfo> parallel_geometry_infos;
+        const float                 set_ms = BenchmarkUtil::MeasureMilliSec(
+            [&]() { set_geometry_infos = GetGeometryInfosWithSet(scene, index_policy.m_max_num_vertices_per_16bit_geometry); });
+        const float epoch_ms = BenchmarkUtil::MeasureMilliSec(
+            [&]()
+            {
+                epoch_geometry_infos.clear();
+                for (aiMeshSizeT i_mesh = 0; i_mesh < scene.m_ai_scene->mNumMeshes; i_mesh++)
+                {
+                    scene.get_geometry_infos(&epoch_geometry_infos, i_mesh, index_policy);
+                }
+            });
+        const float parallel_ms = BenchmarkUtil::MeasureMilliSec(
+            [&]() { parallel_geometry_infos = scene.get_geometry_infos(index_policy); });
+
+        if (!IsSame(set_geometry_infos, epoch_geometry_infos) || !IsSame(set_geometry_infos, parallel_geometry_infos))
+        {
+            Logger::Warn(__FUNCTION__, " ", name, " : splitters produced different geometry infos");
+        }
+
+        Logger::Info(__FUNCTION__,
+                     " ",
+                     name,
+                     " : ",
+                     scene.m_ai_scene->mNumMeshes,
+                     " meshes, ",
+                     num_faces,
+                     " faces, ",
+                     parallel_geometry_infos.size(),
+                     " geometries, ",
+                     set_ms,
+                     " ms std::set serial, ",
+                     epoch_ms,
+                     " ms epoch serial, ",
+                     parallel_ms,
+                     " ms epoch on ",
+                     ThreadPool::Get().get_num_threads(),
+                     " threads");
+    }
+
+    static bool
+    IsSame(const std::vector<AiGeometryInfo> & a, const std::vector<AiGeometryInfo> & b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (a[i].m_src_mesh_index != b[i].m_src_mesh_index ||
+                a[i].m_src_faces_range.m_begin != b[i].m_src_faces_range.m_begin ||
+                a[i].m_src_faces_range.m_end != b[i].m_src_faces_range.m_end ||
+                a[i].m_dst_num_indices != b[i].m_dst_num_indices ||
+                a[i].m_dst_num_vertices != b[i].m_dst_num_vertices ||
+                a[i].m_src_material_index != b[i].m_src_material_index ||
+                a[i].m_is_indices_reorder_needed != b[i].m_is_indices_reorder_needed)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the splitter AiScene::get_geometry_infos replaced, serial and with a std::set of used vertices
+    static std::vector<AiGeometryInfo>
+    GetGeometryInfosWithSet(const AiScene & scene, const size_t max_dst_num_vertices_per_geometry)
+    {
+        std::vector<AiGeometryInfo> result;
+        for (aiMeshSizeT i_mesh = 0; i_mesh < scene.m_ai_scene->mNumMeshes; i_mesh++)
+        {
+            const aiMesh & src_mesh = *scene.m_ai_scene->mMeshes[i_mesh];
+
+            aiVertexSizeT max_vindex      = std::numeric_limits<aiVertexSizeT>::min();
+            aiVertexSizeT min_vindex      = std::numeric_limits<aiVertexSizeT>::max();
+            aiFaceSizeT   num_dst_indices = 0;
+            for (aiFaceSizeT i_src_face = 0; i_src_face < src_mesh.mNumFaces; i_src_face++)
+            {
+                const aiFace & src_face = src_mesh.mFaces[i_src_face];
+                num_dst_indices += (src_face.mNumIndices - 2) * 3;
+                for (aiVertexSizeT i_index = 0; i_index < src_face.mNumIndices; i_index++)
+                {
+                    max_vindex = std::max(src_face.mIndices[i_index], max_vindex);
+                    min_vindex = std::min(src_face.mIndices[i_index], min_vindex);
+                }
+            }
+
+            AiGeometryInfo geometry;
+            geometry.m_src_mesh_index     = static_cast<uint32_t>(i_mesh);
+            geometry.m_src_material_index = src_mesh.mMaterialIndex;
+
+            const aiVertexSizeT num_vindices = max_vindex - min_vindex + 1;
+            if (num_vindices < max_dst_num_vertices_per_geometry)
+            {
+                geometry.m_src_faces_range           = aiFaceRange(0, src_mesh.mNumFaces);
+                geometry.m_dst_num_indices           = num_dst_indices;
+                geometry.m_dst_num_vertices          = num_vindices;
+                geometry.m_is_indices_reorder_needed = false;
+                result.push_back(geometry);
+                continue;
+            }
+
+            size_t                  used_num_indices = 0;
+            std::set<aiVertexSizeT> used_ai_vertex_indices;
+            aiFaceSizeT             i_range_begin = 0;
+            geometry.m_is_indices_reorder_needed  = true;
+            for (aiFaceSizeT i_src_face = 0; i_src_face < src_mesh.mNumFaces;)
+            {
+                const size_t num_indices_before_increment  = used_num_indices;
+                const size_t num_vertices_before_increment = used_ai_vertex_indices.size();
+
+                const aiFace & src_face = src_mesh.mFaces[i_src_face];
+                used_num_indices += static_cast<size_t>((src_face.mNumIndices - 2) * 3);
+                for (unsigned int i_index = 0; i_index < src_face.mNumIndices; i_index++)
+                {
+                    used_ai_vertex_indices.insert(src_face.mIndices[i_index]);
+                }
+
+                if (used_ai_vertex_indices.size() >= max_dst_num_vertices_per_geometry)
+                {
+                    geometry.m_src_faces_range  = aiFaceRange(i_range_begin, i_src_face);
+                    geometry.m_dst_num_indices  = num_indices_before_increment;
+                    geometry.m_dst_num_vertices = num_vertices_before_increment;
+                    result.push_back(geometry);
+
+                    i_range_begin    = i_src_face;
+                    used_num_indices = 0;
+                    used_ai_vertex_indices.clear();
+                }
+                else
+                {
+                    i_src_face++;
+                }
+            }
+
+            geometry.m_src_faces_range  = aiFaceRange(i_range_begin, src_mesh.mNumFaces);
+            geometry.m_dst_num_indices  = used_num_indices;
+            geometry.m_dst_num_vertices = used_ai_vertex_indices.size();
+            result.push_back(geometry);
+        }
+        return result;
+    }
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "benchmark_util.h"
+#include "core/logger.h"
+#include "core/thread_pool.h"
+#include "importer/texture_baker.h"
+#include "pch/pch.h"
+
+// TextureBaker::Compress throughput and error on a synthetic 2048 x 2048 image, once as R8G8B8A8 sRGB (BC1) and once
+// as R8 (BC4). throughput counts the texels of the whole mip chain, error is measured on level 0 by decoding the
+// blocks back and comparing them against the source texels.
+struct TextureBenchmark
+{
+    static constexpr size_t NumIterations = 3;
+    static constexpr int    ImageSize     = 2048;
+
+    static void
+    Run()
+    {
+        RunFormat("bc1", ConstructImage(Rhi::FormatEnum::R8G8B8A8_UNorm_Srgb));
+        RunFormat("bc4", ConstructImage(Rhi::FormatEnum::R8_UNorm));
+    }
+
+private:
+    static void
+    RunFormat(const std::string & name, const TextureImage & src_image)
+    {
+        TextureImage dst_image;
+        bool         is_compressed = true;
+        const float  best_ms       = BenchmarkUtil::MeasureMilliSec(
+            [&]() { dst_image = src_image; },
+            [&]() { is_compressed = TextureBaker::Compress(&dst_image); },
+            NumIterations);
+        if (!is_compressed)
+        {
+            Logger::Warn(__FUNCTION__, " ", name, " : no encoder for the source format or size");
+            return;
+        }
+
+        // mean squared error over the color channels of level 0
+        const bool              is_bc4              = dst_image.m_format == Rhi::FormatEnum::BC4_UNorm;
+        const size_t            num_channels        = is_bc4 ? 1 : 3;
+        const size_t            src_stride          = EnumHelper::GetSizeInBytesPerPixel(src_image.m_format);
+        const size_t            block_size_in_bytes = EnumHelper::GetSizeInBytesPerBlock(dst_image.m_format);
+        const TextureImageLevel src_level           = src_image.get_levels()[0];
+        const TextureImageLevel dst_level           = dst_image.get_levels()[0];
+        std::vector<double>     sum_squared_errors(dst_level.m_num_rows, 0.0);
+        ThreadPool::Get().parallel_for(
+            0,
+            dst_level.m_num_rows,
+            [&](const size_t block_y)
+            {
+                const size_t num_blocks_x = dst_level.m_row_size_in_bytes / block_size_in_bytes;
+                for (size_t block_x = 0; block_x < num_blocks_x; block_x++)
+                {
+                    const std::byte * block =
+                        &dst_image.m_pixels[block_y * dst_level.m_row_size_in_bytes + block_x * block_size_in_bytes];
+                    std::array<std::array<uint8_t, 4>, 16> texels;
+                    if (is_bc4)
+                    {
+                        TextureBaker::DecodeBc4Block(block, &texels);
+                    }
+                    else
+                    {
+                        TextureBaker::DecodeBc1Block(block, &texels);
+                    }
+
+                    // ImageSize is a multiple of 4, every texel of a block is inside the image
+                    for (size_t i_texel = 0; i_texel < 16; i_texel++)
+                    {
+                        const size_t      x = block_x * 4 + i_texel % 4;
+                        const size_t      y = block_y * 4 + i_texel / 4;
+                        const std::byte * src_texel =
+                            &src_image.m_pixels[y * src_level.m_row_size_in_bytes + x * src_stride];
+                        for (size_t c = 0; c < num_channels; c++)
+                        {
+                            const double d = static_cast<double>(texels[i_texel][c]) - std::to_integer<int>(src_texel[c]);
+                            sum_squared_errors[block_y] += d * d;
+                        }
+                    }
+                }
+            });
+
+        const double num_samples = static_cast<double>(src_level.m_resolution.x) *
+                                   static_cast<double>(src_level.m_resolution.y) * static_cast<double>(num_channels);
+        const double rmse =
+            std::sqrt(std::accumulate(sum_squared_errors.begin(), sum_squared_errors.end(), 0.0) / num_samples);
+        const double psnr = rmse > 0.0 ? 20.0 * std::log10(255.0 / rmse) : std::numeric_limits<double>::infinity();
+
+        Logger::Info(__FUNCTION__,
+                     " ",
+                     name,
+                     " : ",
+                     src_image.m_resolution.x,
+                     "x",
+                     src_image.m_resolution.y,
+                     " with ",
+                     src_image.m_num_levels,
+                     " levels in ",
+                     best_ms,
+                     " ms, ",
+                     static_cast<float>(src_image.get_num_texels()) / 1000.0f / best_ms,
+                     " MTexel/s on ",
+                     ThreadPool::Get().get_num_threads(),
+                     " threads, level 0 rmse ",
+                     rmse,
+                     ", psnr ",
+                     psnr,
+                     " dB");
+    }
+
+    // smooth gradients with a little noise on top, so blocks are neither flat nor random
+    static TextureImage
+    ConstructImage(const Rhi::FormatEnum format)
+    {
+        TextureImage image;
+        image.m_resolution = int2(ImageSize, ImageSize);
+        image.m_format     = format;
+
+        const size_t num_channels = EnumHelper::GetSizeInBytesPerPixel(format);
+        image.m_pixels.resize(static_cast<size_t>(ImageSize) * static_cast<size_t>(ImageSize) * num_channels);
+        for (size_t y = 0; y < static_cast<size_t>(ImageSize); y++)
+        {
+            for (size_t x = 0; x < static_cast<size_t>(ImageSize); x++)
+            {
+                const uint32_t noise = static_cast<uint32_t>((x * 73856093u) ^ (y * 19349663u)) % 17u;
+                const std::array<uint32_t, 4> color = { static_cast<uint32_t>(x * 239 / ImageSize) + noise,
+                                                        static_cast<uint32_t>(y * 239 / ImageSize) + noise,
+                                                        static_cast<uint32_t>((x + y) * 119 / ImageSize) + noise,
+                                                        255 };
+                for (size_t c = 0; c < num_channels; c++)
+                {
+                    image.m_pixels[(y * ImageSize + x) * num_channels + c] = static_cast<std::byte>(color[c]);
+                }
+            }
+        }
+
+        TextureBaker::GenerateMipChain(&image);
+        return image;
+    }
+};
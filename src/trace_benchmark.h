@@ -0,0 +1,100 @@
+#pragma once
+
+#include "benchmark_util.h"
+#include "core/logger.h"
+#include "core/trace.h"
+#include "pch/pch.h"
+
+#include <barrier>
+#include <sstream>
+
+// cost of a trace scope on the recording thread, with no trace, with a trace on one thread and with a trace on every
+// hardware thread. each thread records as many scopes as its buffer holds, so no event is dropped however slow the
+// flusher is, drops are still counted and reported.
+struct TraceBenchmark
+{
+    static constexpr size_t NumScopesPerThread = Trace::NumEventsPerThread;
+
+    static void
+    Run()
+    {
+        const uint32_t name_id              = Trace::Get().intern("trace_benchmark_scope");
+        const size_t   num_hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+        size_t      num_dropped = 0;
+        const float inactive_ns = MeasureNanoSecPerScope(name_id, num_hardware_threads, false, &num_dropped);
+        Logger::Info(__FUNCTION__, " inactive : ", inactive_ns, " ns per scope");
+
+        const float single_thread_ns = MeasureNanoSecPerScope(name_id, 1, true, &num_dropped);
+        const float multi_thread_ns  = MeasureNanoSecPerScope(name_id, num_hardware_threads, true, &num_dropped);
+        Logger::Info(__FUNCTION__,
+                     " active : ",
+                     single_thread_ns,
+                     " ns per scope on 1 thread, ",
+                     multi_thread_ns,
+                     " ns per scope on each of ",
+                     num_hardware_threads,
+                     " threads, ",
+                     num_dropped,
+                     " events dropped");
+    }
+
+private:
+    // best of a few runs, each of num_threads threads records NumScopesPerThread empty scopes. the threads live for
+    // every run so only the first one pays for registering their buffers
+    static float
+    MeasureNanoSecPerScope(const uint32_t name_id, const size_t num_threads, const bool is_active, size_t * num_dropped)
+    {
+        const size_t       num_participants = num_threads + 1;
+        std::barrier<>     start_barrier(static_cast<ptrdiff_t>(num_participants));
+        std::barrier<>     done_barrier(static_cast<ptrdiff_t>(num_participants));
+        std::ostringstream stream;
+
+        std::vector<std::thread> threads;
+        for (size_t i_thread = 0; i_thread < num_threads; i_thread++)
+        {
+            threads.emplace_back(
+                [&]()
+                {
+                    for (size_t i_iteration = 0; i_iteration < BenchmarkUtil::NumIterations; i_iteration++)
+                    {
+                        start_barrier.arrive_and_wait();
+                        for (size_t i_scope = 0; i_scope < NumScopesPerThread; i_scope++)
+                        {
+                            const TraceScope scope(name_id);
+                        }
+                        done_barrier.arrive_and_wait();
+                    }
+                });
+        }
+
+        const float best_ms = BenchmarkUtil::MeasureMilliSec(
+            [&]()
+            {
+                if (is_active)
+                {
+                    stream.str("");
+                    Trace::Get().begin(&stream);
+                }
+            },
+            [&]()
+            {
+                start_barrier.arrive_and_wait();
+                done_barrier.arrive_and_wait();
+            },
+            [&]()
+            {
+                if (is_active)
+                {
+                    *num_dropped += Trace::Get().end();
+                }
+            },
+            BenchmarkUtil::NumIterations);
+
+        for (std::thread & thread : threads)
+        {
+            thread.join();
+        }
+        return best_ms * 1e6f / static_cast<float>(NumScopesPerThread);
+    }
+};